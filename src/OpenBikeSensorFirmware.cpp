@@ -24,6 +24,7 @@
 #include <utils/obsutils.h>
 #include <utils/button.h>
 #include <utils/timeutils.h>
+#include <utils/objectpool.h>
 #include "OpenBikeSensorFirmware.h"
 #include "variant.h"
 
@@ -99,6 +100,9 @@ uint16_t minDistanceToConfirmIndex = 0;
 bool transmitConfirmedData = false;
 
 CircularBuffer<DataSet*, 10> dataBuffer;
+// loop() drains dataBuffer below its capacity, so the buffered sets and
+// the current set always fit into a pool of the same size
+ObjectPool<DataSet, 10> dataSetPool;
 
 FileWriter* writer;
 
@@ -159,8 +163,13 @@ void setupSensors() {
 #endif
 
   sensorManager->setOffsets(config.sensorOffsets);
+  sensorManager->setDistanceFilter(config.distanceFilter);
 
   sensorManager->setPrimarySensor(LEFT_SENSOR_ID);
+#if defined(OBSCLASSIC) && HCSR04_TRIGGER_BY_TIMER
+  sensorManager->setParallelTrigger(HCSR04_TRIGGER_PARALLEL);
+  sensorManager->startTriggerTimer();
+#endif
 }
 
 static void setupBluetooth(const ObsConfig &cfg, const String &trackUniqueIdentifier) {
@@ -191,8 +200,8 @@ static void reportBluetooth() {
     uint16_t right_median = 0;
 #endif
 #ifdef OBSCLASSIC
-    uint16_t left_median = sensorManager->m_sensors[LEFT_SENSOR_ID].median->median();
-    uint16_t right_median = sensorManager->m_sensors[RIGHT_SENSOR_ID].median->median();
+    uint16_t left_median = sensorManager->m_sensors[LEFT_SENSOR_ID].median.median();
+    uint16_t right_median = sensorManager->m_sensors[RIGHT_SENSOR_ID].median.median();
 #endif
     log_d("Reporting BT: %d/%d cm", left_median, right_median);
     lastBluetoothInterval = currentInterval;
@@ -214,12 +223,12 @@ static void buttonBluetooth(const DataSet *dataSet, uint16_t measureIndex) {
     if (left > MAX_DURATION_MICRO_SEC || left == 0) {
       left = MAX_SENSOR_VALUE;
     } else {
-      left /= MICRO_SEC_TO_CM_DIVIDER;
+      left = SoundSpeed::toCentimeter(left, dataSet->factorCenti);
     }
     if (right > MAX_DURATION_MICRO_SEC || right == 0) {
       right = MAX_SENSOR_VALUE;
     } else {
-      right /= MICRO_SEC_TO_CM_DIVIDER;
+      right = SoundSpeed::toCentimeter(right, dataSet->factorCenti);
     }
     bluetoothManager->newPassEvent(
       dataSet->millis + (uint32_t) dataSet->startOffsetMilliseconds[measureIndex],
@@ -297,6 +306,10 @@ void setup() {
 
   if (SD.begin()) {
     obsDisplay->showTextOnGrid(2, obsDisplay->currentLine(), "SD... OK");
+    // the last ride usually ended by switching the power off
+    FileWriter::recoverTrack();
+    // once, older firmware kept all tracks in the root directory
+    TrackIndex::migrate();
   }
   delay(333); // Added for user experience
 
@@ -354,7 +367,11 @@ void setup() {
 
 
   if (SD.begin()) {
+#if BINARY_TRACK_FORMAT
+    writer = new BinaryFileWriter;
+#else
     writer = new CSVFileWriter;
+#endif
     writer->setFileName();
     writer->writeHeader(trackUniqueIdentifier);
     obsDisplay->showTextOnGrid(2, obsDisplay->currentLine(), "CSV file... OK");
@@ -426,13 +443,13 @@ void handleButtonInServerMode() {
 }
 
 void writeDataset(const uint8_t confirmationSensorID, DataSet *dataset) {
-  if (dataset->confirmedDistances.empty()) {
+  if (dataset->confirmedCount == 0) {
     if (writer) {
       writer->append(*dataset);
     }
   }
   // write record as many times as we have confirmed values
-  for (int i = 0; i < dataset->confirmedDistances.size(); i++) {
+  for (int i = 0; i < dataset->confirmedCount; i++) {
     // make sure the distance reported is the one that was confirmed
     dataset->sensorValues[confirmationSensorID] = dataset->confirmedDistances[i];
     dataset->confirmed = 1 + dataset->confirmedDistancesIndex[i];
@@ -446,8 +463,14 @@ void writeDataset(const uint8_t confirmationSensorID, DataSet *dataset) {
 void loop() {
   //specify which sensors value can be confirmed by pressing the button, should be configurable
   const uint8_t confirmationSensorID = LEFT_SENSOR_ID;
-  auto* currentSet = new DataSet;
+  DataSet* currentSet = dataSetPool.acquire();
   uint32_t thisLoopTow;
+  if (currentSet == nullptr) {
+    // can not happen, all sets not in dataBuffer are released each loop
+    log_e("No free data set.");
+    return;
+  }
+  currentSet->reset();
 
   if(shutdownState != 0) {
     obsDisplay->clear();
@@ -468,10 +491,14 @@ void loop() {
     thisLoopTow = 0;
   }
   currentSet->millis = startTimeMillis;
-  currentSet->batteryLevel = voltageMeter->read();
+  currentSet->batteryLevelCenti = lround(voltageMeter->read() * 100);
 
   lastMeasurements = sensorManager->m_sensors[confirmationSensorID].numberOfTriggers;
 
+  if (BMP280_active) {
+    // the air temperature changes slowly, adjusting once per set is sufficient
+    sensorManager->setTemperature(TemperatureValue);
+  }
   sensorManager->reset(startTimeMillis);
 
   // if the detected minimum was measured more than 5s ago, it is discarded and cannot be confirmed
@@ -493,6 +520,7 @@ void loop() {
       break;
     }
     button.handle(currentTimeMillis);
+    // only needed if the GPS reader task could not be started
     gps.handle();
     if (sensorManager->pollDistancesAlternating()) {
       // if a new minimum on the selected sensor is detected, the value and the time of detection will be stored
@@ -510,7 +538,6 @@ void loop() {
         timeOfMinimum = currentTimeMillis;
       }
     }
-    gps.handle();
     if (lastDisplayInterval != (currentTimeMillis / DISPLAY_INTERVAL_MILLIS)) {
       lastDisplayInterval = currentTimeMillis / DISPLAY_INTERVAL_MILLIS;
       obsDisplay->showValues(
@@ -525,7 +552,6 @@ void loop() {
         gps.getValidSatellites()
       );
     }
-    gps.handle();
     reportBluetooth();
 
     if (button.gotPressed()) { // after button was released, detect long press here
@@ -535,14 +561,15 @@ void loop() {
       transmitConfirmedData = true;
       numButtonReleased++;
       if (datasetToConfirm != nullptr) {
-        datasetToConfirm->confirmedDistances.push_back(minDistanceToConfirm);
-        datasetToConfirm->confirmedDistancesIndex.push_back(minDistanceToConfirmIndex);
+        if (!datasetToConfirm->addConfirmation(minDistanceToConfirm, minDistanceToConfirmIndex)) {
+          log_w("Too many confirmations in one set, dropped.");
+        }
         buttonBluetooth(datasetToConfirm, minDistanceToConfirmIndex);
         datasetToConfirm = nullptr;
       } else { // confirming an overtake without left measure
-        currentSet->confirmedDistances.push_back(MAX_SENSOR_VALUE);
-        currentSet->confirmedDistancesIndex.push_back(
-          sensorManager->getCurrentMeasureIndex());
+        if (!currentSet->addConfirmation(MAX_SENSOR_VALUE, sensorManager->getCurrentMeasureIndex())) {
+          log_w("Too many confirmations in one set, dropped.");
+        }
         buttonBluetooth(currentSet, sensorManager->getCurrentMeasureIndex());
       }
       minDistanceToConfirm = MAX_SENSOR_VALUE; // ready for next confirmation
@@ -550,12 +577,13 @@ void loop() {
 
     // TODO: Add support for temperature reading from PGA460
     if(BMP280_active == true)  TemperatureValue = bmp280.readTemperature();
-
-    gps.handle();
   } // end measureInterval while
 
   currentSet->gpsRecord = gps.getCurrentGpsRecord();
+  currentSet->gpsEpochs = gps.getCurrentGpsEpochs();
   currentSet->isInsidePrivacyArea = gps.isInsidePrivacyArea();
+  // currentSet might go back to the pool below, keep what we need of it
+  const bool insidePrivacyArea = currentSet->isInsidePrivacyArea;
   if (currentSet->gpsRecord.getTow() == thisLoopTow) {
     copyCollectedSensorData(currentSet);
     log_d("NEW SET: TOW: %u GPSms: %u, SETms: %u, GPS Time: %s, SET Time: %s, innerLoops: %d, buffer: %d, write time %3ums, loop time: %4ums, measurements: %2d",
@@ -574,6 +602,7 @@ void loop() {
       datasetToConfirm = nullptr;
       minDistanceToConfirm = MAX_SENSOR_VALUE;
     }
+    dataSetPool.release(currentSet);
   }
 
   // convert all data that does not wait for confirmation.
@@ -585,24 +614,24 @@ void loop() {
       datasetToConfirm = nullptr;
       minDistanceToConfirm = MAX_SENSOR_VALUE;
     }
-    delete dataset;
+    dataSetPool.release(dataset);
   }
 
   // After confirmation make sure it will be written to SD card directly
   if (transmitConfirmedData ||
     // also write if we are inside a privacy area ...
-    (currentSet->isInsidePrivacyArea
+    (insidePrivacyArea
     // ... and privacy mode does not require to write all sets
       && (config.privacyConfig & AbsolutePrivacy) || (config.privacyConfig & OverridePrivacy))) {
     // so no confirmed sets might be lost
     if (writer) {
-      writer->flush();
+      writer->flush(transmitConfirmedData);
     }
     // there might be a confirmed value in the current set and also already a
     // new value to be confirmed flagged in the current set.
     // In this case the dataset is kept until we know if there are further
     // confirmed values in the set to be written.
-    if (dataBuffer.isEmpty() || dataBuffer.first()->confirmedDistancesIndex.empty()) {
+    if (dataBuffer.isEmpty() || dataBuffer.first()->confirmedCount == 0) {
       log_d("Confirmed data flushed to sd.");
       transmitConfirmedData = false;
     }
@@ -613,16 +642,24 @@ void loop() {
 }
 
 void copyCollectedSensorData(DataSet *set) {// Write the minimum values of the while-loop to a set
-  for (auto & m_sensor : sensorManager->m_sensors) {
-    set->sensorValues.push_back(m_sensor.minDistance);
+  for (size_t idx = 0; idx < NUMBER_OF_TOF_SENSORS; ++idx) {
+    set->sensorValues[idx] = sensorManager->m_sensors[idx].minDistance;
   }
   set->measurements = sensorManager->lastReadingCount;
+  set->factorCenti = sensorManager->getMicroSecToCmDividerCenti();
+  set->cadenceMode = sensorManager->getCadenceMode();
   memcpy(&(set->readDurationsRightInMicroseconds),
          &(sensorManager->m_sensors[0].echoDurationMicroseconds), set->measurements * sizeof(int32_t));
   memcpy(&(set->readDurationsLeftInMicroseconds),
          &(sensorManager->m_sensors[1].echoDurationMicroseconds), set->measurements * sizeof(int32_t));
   memcpy(&(set->startOffsetMilliseconds),
          &(sensorManager->startOffsetMilliseconds), set->measurements * sizeof(uint16_t));
+#if ECHO_OBJECTS_PER_MEASUREMENT > 0
+  memcpy(&(set->echoesRight),
+         &(sensorManager->m_sensors[0].echoes), set->measurements * sizeof(EchoProfile));
+  memcpy(&(set->echoesLeft),
+         &(sensorManager->m_sensors[1].echoes), set->measurements * sizeof(EchoProfile));
+#endif
 }
 
 uint8_t batteryPercentage() {
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cadence.h"
+
+void MeasurementCadence::addReading(uint16_t distance, uint32_t millisTicks) {
+  if (distance < MAX_SENSOR_VALUE) {
+    lastObjectMillis = millisTicks;
+  }
+  if (distance <= CADENCE_TRACKING_DISTANCE_CM) {
+    lastInRangeMillis = millisTicks;
+  }
+  if (distance <= CADENCE_TRACKING_DISTANCE_CM
+      && distance + CADENCE_APPROACH_CM <= lastDistance) {
+    // new or approaching target, a parked car besides us does not count
+    hasTarget = true;
+    lastTargetMillis = millisTicks;
+  }
+  lastDistance = distance;
+
+  CadenceMode newMode;
+  if (hasTarget
+      && millisTicks - lastTargetMillis < CADENCE_TRACKING_HOLD_MILLIS
+      && millisTicks - lastInRangeMillis < CADENCE_TRACKING_LOST_MILLIS) {
+    newMode = CadenceTracking;
+  } else if (millisTicks - lastObjectMillis > CADENCE_IDLE_AFTER_MILLIS) {
+    hasTarget = false;
+    newMode = CadenceIdle;
+  } else {
+    hasTarget = false;
+    newMode = CadenceNormal;
+  }
+  if (newMode != mode) {
+    log_d("Measurement cadence %s -> %s at %ucm.",
+          modeToString(mode), modeToString(newMode), distance);
+    mode = newMode;
+  }
+  if (mode > intervalMode) {
+    intervalMode = mode;
+  }
+}
+
+CadenceMode MeasurementCadence::getMode() const {
+  return mode;
+}
+
+CadenceMode MeasurementCadence::getIntervalMode() const {
+  return intervalMode;
+}
+
+void MeasurementCadence::resetInterval() {
+  intervalMode = mode;
+}
+
+const char* MeasurementCadence::modeToString(CadenceMode mode) {
+  switch (mode) {
+    case CadenceIdle:
+      return "idle";
+    case CadenceTracking:
+      return "tracking";
+    default:
+      return "normal";
+  }
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OBS_CADENCE_H
+#define OBS_CADENCE_H
+
+#include <Arduino.h>
+#include "variant.h"
+
+/* How often the distance sensors are measured, see MeasurementCadence. */
+enum CadenceMode : uint8_t {
+  CadenceIdle = 0,     // nothing in range for a while, fewer measurements
+  CadenceNormal = 1,   // default measurement rate
+  CadenceTracking = 2  // approaching target, measurement rate raised
+};
+
+/* Closer than this an approaching object is tracked. */
+static const uint16_t CADENCE_TRACKING_DISTANCE_CM = 200;
+
+/* Minimum decrease of the distance between 2 readings for an approaching
+ * object, lower than that is noise.
+ */
+static const uint16_t CADENCE_APPROACH_CM = 3;
+
+/* Tracking continues this long after the last reading of the target. */
+static const uint32_t CADENCE_TRACKING_HOLD_MILLIS = 2000;
+
+/* Tracking ends early if the target was not seen for this time. */
+static const uint32_t CADENCE_TRACKING_LOST_MILLIS = 500;
+
+/* Without any object in range for this time the cadence goes idle. */
+static const uint32_t CADENCE_IDLE_AFTER_MILLIS = 5000;
+
+/* Decides on the measurement cadence based on the readings of the primary
+ * sensor. The sensor managers use the mode to raise the rate of the
+ * primary sensor while a target approaches and to lower the rate of
+ * both sensors when there has been nothing in range for a while, so the
+ * average number of pings does not go up.
+ */
+class MeasurementCadence {
+  public:
+    /* Filtered distance of the primary sensor, MAX_SENSOR_VALUE if there
+     * is no object in range.
+     */
+    void addReading(uint16_t distance, uint32_t millisTicks);
+    CadenceMode getMode() const;
+    /* Highest mode since the last call to resetInterval(). */
+    CadenceMode getIntervalMode() const;
+    void resetInterval();
+    static const char* modeToString(CadenceMode mode);
+
+  private:
+    CadenceMode mode = CadenceNormal;
+    CadenceMode intervalMode = CadenceNormal;
+    uint16_t lastDistance = MAX_SENSOR_VALUE;
+    uint32_t lastObjectMillis = 0;
+    uint32_t lastTargetMillis = 0;
+    uint32_t lastInRangeMillis = 0;
+    bool hasTarget = false;
+};
+
+#endif
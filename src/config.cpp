@@ -56,6 +56,12 @@ const String ObsConfig::PROPERTY_PA_LAT_T = String("latT");
 const String ObsConfig::PROPERTY_PA_LONG_T = String("longT");
 const String ObsConfig::PROPERTY_PA_RADIUS = String("radius");
 const String ObsConfig::PROPERTY_HTTP_PIN = String("httpPin");
+const String ObsConfig::PROPERTY_FILTER_CONFIG = String("filterConfig");
+const String ObsConfig::PROPERTY_FILTER_MIN_DISTANCE = String("filterMinDistance");
+const String ObsConfig::PROPERTY_FILTER_MAX_DISTANCE = String("filterMaxDistance");
+const String ObsConfig::PROPERTY_FILTER_TRACKER_ALPHA = String("filterTrackerAlpha");
+const String ObsConfig::PROPERTY_FILTER_TRACKER_BETA = String("filterTrackerBeta");
+const String ObsConfig::PROPERTY_FILTER_TRACKER_GATE = String("filterTrackerGate");
 
 // Filenames 8.3 here!
 const String OLD_CONFIG_FILENAME = "/config.txt";
@@ -168,6 +174,13 @@ void ObsConfig::makeSureSystemDefaultsAreSet() {
     data[PROPERTY_CONFIRMATION_TIME_SECONDS] = 5;
   }
   ensureSet(data, PROPERTY_SELECTED_PRESET, 0);
+  const DistanceFilterConfig filterDefaults;
+  ensureSet(data, PROPERTY_FILTER_CONFIG, filterDefaults.options);
+  ensureSet(data, PROPERTY_FILTER_MIN_DISTANCE, filterDefaults.minDistanceCm);
+  ensureSet(data, PROPERTY_FILTER_MAX_DISTANCE, filterDefaults.maxDistanceCm);
+  ensureSet(data, PROPERTY_FILTER_TRACKER_ALPHA, filterDefaults.trackerAlphaPercent);
+  ensureSet(data, PROPERTY_FILTER_TRACKER_BETA, filterDefaults.trackerBetaPercent);
+  ensureSet(data, PROPERTY_FILTER_TRACKER_GATE, filterDefaults.trackerGateCm);
   if (!data.containsKey(PROPERTY_PRIVACY_AREA)) {
     data.createNestedArray(PROPERTY_PRIVACY_AREA);
   }
@@ -374,6 +387,20 @@ void ObsConfig::fill(Config &cfg) const {
   cfg.confirmationTimeWindow = getProperty<int>(PROPERTY_CONFIRMATION_TIME_SECONDS);
   cfg.privacyConfig = getProperty<int>(PROPERTY_PRIVACY_CONFIG);
   cfg.bluetooth = getProperty<bool>(PROPERTY_BLUETOOTH);
+  cfg.distanceFilter.options = getProperty<uint>(PROPERTY_FILTER_CONFIG);
+  const int minDistanceCm = getProperty<int>(PROPERTY_FILTER_MIN_DISTANCE);
+  const int maxDistanceCm = getProperty<int>(PROPERTY_FILTER_MAX_DISTANCE);
+  if (RangeGateStage::isValidRange(minDistanceCm, maxDistanceCm)) {
+    cfg.distanceFilter.minDistanceCm = minDistanceCm;
+    cfg.distanceFilter.maxDistanceCm = maxDistanceCm;
+  } else {
+    log_w("Ignoring filter range %d - %d cm, using the default.", minDistanceCm, maxDistanceCm);
+    cfg.distanceFilter.minDistanceCm = MIN_DISTANCE_MEASURED_CM;
+    cfg.distanceFilter.maxDistanceCm = MAX_DISTANCE_MEASURED_CM;
+  }
+  cfg.distanceFilter.trackerAlphaPercent = getProperty<uint8_t>(PROPERTY_FILTER_TRACKER_ALPHA);
+  cfg.distanceFilter.trackerBetaPercent = getProperty<uint8_t>(PROPERTY_FILTER_TRACKER_BETA);
+  cfg.distanceFilter.trackerGateCm = getProperty<uint16_t>(PROPERTY_FILTER_TRACKER_GATE);
   cfg.privacyAreas.clear();
   if (selectedProfile != 0) { // not sure if we ever support PAs per profile.
     for (int i = 0; i < jsonData["obs"][selectedProfile][PROPERTY_PRIVACY_AREA].size(); i++) {
@@ -383,6 +410,7 @@ void ObsConfig::fill(Config &cfg) const {
   for (int i = 0; i < jsonData["obs"][0][PROPERTY_PRIVACY_AREA].size(); i++) {
     cfg.privacyAreas.push_back(getPrivacyArea(0, i));
   }
+  cfg.privacyAreaIndex.build(cfg.privacyAreas);
 }
 
 bool ObsConfig::parseJson(const String &json) {
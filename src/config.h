@@ -28,6 +28,8 @@
 #include <ArduinoJson.h>
 #include <vector>
 #include <FS.h>
+#include "utils/distancefilter.h"
+#include "privacyareaindex.h"
 
 enum DisplayOptions {
   DisplaySatellites = 0x01,  // 1
@@ -80,7 +82,10 @@ struct Config {
   bool bluetooth;
   int privacyConfig;
   int confirmationTimeWindow;
+  DistanceFilterConfig distanceFilter;
   std::vector<PrivacyArea> privacyAreas;
+  // built from privacyAreas by ObsConfig::fill()
+  PrivacyAreaIndex privacyAreaIndex;
   std::vector<WifiConfig> wifiConfigs;
 };
 
@@ -157,6 +162,12 @@ class ObsConfig {
     static const String PROPERTY_PA_LONG_T;
     static const String PROPERTY_PA_RADIUS;
     static const String PROPERTY_HTTP_PIN;
+    static const String PROPERTY_FILTER_CONFIG;
+    static const String PROPERTY_FILTER_MIN_DISTANCE;
+    static const String PROPERTY_FILTER_MAX_DISTANCE;
+    static const String PROPERTY_FILTER_TRACKER_ALPHA;
+    static const String PROPERTY_FILTER_TRACKER_BETA;
+    static const String PROPERTY_FILTER_TRACKER_GATE;
 
   private:
     static bool loadJson(JsonDocument &jsonDocument, const String &filename);
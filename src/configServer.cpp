@@ -39,6 +39,7 @@
 #include "utils/https.h"
 #include "utils/timeutils.h"
 #include "obsimprov.h"
+#include "trackindex.h"
 #include <WiFi.h>
 #include <WiFiMulti.h>
 #include <esp_wifi.h>
@@ -321,6 +322,19 @@ static const char* const configIndex =
   "<hr>"
   "Swap Sensors (Left &#8660; Right)<input type='checkbox' name='displaySwapSensors' {displaySwapSensors}>"
   ""
+  "<h3>Distance Filter</h3>"
+  "Range Gate<br>(ignore distances measured outside of min and max, cm before offset)<input type='checkbox' name='filterRangeGate' {filterRangeGate}>"
+  "<hr>"
+  "Minimum Distance<input name='filterMinDistance' placeholder='cm' value='{filterMinDistance}'>"
+  "<hr>"
+  "Maximum Distance<input name='filterMaxDistance' placeholder='cm' value='{filterMaxDistance}'>"
+  "<hr>"
+  "Phantom Suppression<br>(median of the last 3 measurements without short phantom echos)<input type='checkbox' name='filterPhantomSuppression' {filterPhantomSuppression}>"
+  "<hr>"
+  "Median<br>(median of the last 5 measurements)<input type='checkbox' name='filterMedian' {filterMedian}>"
+  "<hr>"
+  "Tracker<br>(smooth the distance of a single object)<input type='checkbox' name='filterTracker' {filterTracker}>"
+  ""
   "<h3>Generic Display</h3>"
   "Invert<br>(black &#8660; white)<input type='checkbox' name='displayInvert' {displayInvert}>"
   "<hr>"
@@ -397,7 +411,7 @@ static const char* const deleteIndex =
   "<input type='checkbox' id='config' name='config'>"
   "<h3>SD Card</h3>"
   "<label for='sdcard'>Delete OBS related content (aid_ini.ubx, tracknumber.txt, current_14d.*, "
-  "*.obsdata.csv, sdflash/*, trash/*, uploaded/*). The files are just removed from to filesystem "
+  "*.obsdata.csv(.gz), sdflash/*, trash/*, tracks/*, uploaded/*). The files are just removed from to filesystem "
   "part of the data might be still read from the card. Be patient.</label>"
   "<input type='checkbox' id='sdcard' name='sdcard'>"
   "<input type='submit' class='btn' value='Delete' onclick=\"return confirm('Are you sure?')\" />";
@@ -501,9 +515,10 @@ bool configServerWasConnectedViaHttpFlag = false;
 bool wifiNetworkIsTrusted = false;
 
 static void tryWiFiConnect();
-static uint16_t countFilesInRoot();
 static String ensureSdIsAvailable();
-static void moveToUploaded(const String &fileName);
+static String moveToUploaded(const String &fileName);
+static void loadTrackIndex(std::vector<TrackSummary> &tracks);
+static bool isUploadPending(const TrackSummary &track);
 
 String getIp() {
   if (WiFiClass::status() != WL_CONNECTED) {
@@ -1081,6 +1096,8 @@ static void handleAbout(HTTPRequest *req, HTTPResponse * res) {
   page += keyValue("Right Sensor min duration", sensorManager->getMinDurationUs(RIGHT_SENSOR_ID), "&#xB5;s");
   page += keyValue("Right Sensor last start delay", sensorManager->getLastDelayTillStartUs(RIGHT_SENSOR_ID), "&#xB5;s");
   page += keyValue("Right Sensor signal errors", sensorManager->getNoSignalReadings(RIGHT_SENSOR_ID));
+  page += keyValue("Left Sensor cross-talk dropped", sensorManager->getNumberOfCrossTalkRejections(LEFT_SENSOR_ID));
+  page += keyValue("Right Sensor cross-talk dropped", sensorManager->getNumberOfCrossTalkRejections(RIGHT_SENSOR_ID));
 
   res->print(page);
   page.clear();
@@ -1088,6 +1105,10 @@ static void handleAbout(HTTPRequest *req, HTTPResponse * res) {
   page += keyValue("GPS valid checksum", gps.getValidMessageCount());
   page += keyValue("GPS failed checksum", gps.getMessagesWithFailedCrcCount());
   page += keyValue("GPS unexpected chars", gps.getUnexpectedCharReceivedCount());
+  page += keyValue("GPS dropped bytes", gps.getDroppedBytes());
+  page += keyValue("GPS receive overflows", gps.getRxOverflowCount());
+  page += keyValue("GPS parse latency avg", gps.getAverageParseLatencyMillis(), "ms");
+  page += keyValue("GPS parse latency max", gps.getMaxParseLatencyMillis(), "ms");
   page += keyValue("GPS hdop", gps.getCurrentGpsRecord().getHdopString());
   page += keyValue("GPS fix", String(gps.getCurrentGpsRecord().getFixStatus(), 16));
   page += keyValue("GPS fix flags", String(gps.getCurrentGpsRecord().getFixStatusFlags(), 16));
@@ -1359,6 +1380,23 @@ static void handleConfigSave(HTTPRequest * req, HTTPResponse * res) {
   theObsConfig->setProperty(0, ObsConfig::PROPERTY_PORTAL_URL,
                             getParameter(params, "hostname"));
 
+  theObsConfig->setBitMaskProperty(0, ObsConfig::PROPERTY_FILTER_CONFIG, FilterRangeGate,
+                                   getParameter(params, "filterRangeGate") == "on");
+  theObsConfig->setBitMaskProperty(0, ObsConfig::PROPERTY_FILTER_CONFIG, FilterPhantomSuppression,
+                                   getParameter(params, "filterPhantomSuppression") == "on");
+  theObsConfig->setBitMaskProperty(0, ObsConfig::PROPERTY_FILTER_CONFIG, FilterMedian,
+                                   getParameter(params, "filterMedian") == "on");
+  theObsConfig->setBitMaskProperty(0, ObsConfig::PROPERTY_FILTER_CONFIG, FilterTracker,
+                                   getParameter(params, "filterTracker") == "on");
+  const int filterMinDistance = atoi(getParameter(params, "filterMinDistance").c_str());
+  const int filterMaxDistance = atoi(getParameter(params, "filterMaxDistance").c_str());
+  if (RangeGateStage::isValidRange(filterMinDistance, filterMaxDistance)) {
+    theObsConfig->setProperty(0, ObsConfig::PROPERTY_FILTER_MIN_DISTANCE, filterMinDistance);
+    theObsConfig->setProperty(0, ObsConfig::PROPERTY_FILTER_MAX_DISTANCE, filterMaxDistance);
+  } else {
+    log_w("Ignoring filter range %d - %d cm, keeping the former.", filterMinDistance, filterMaxDistance);
+  }
+
   std::vector<int> offsets;
   offsets.push_back(atoi(getParameter(params, "offsetS2").c_str()));
   offsets.push_back(atoi(getParameter(params, "offsetS1").c_str()));
@@ -1422,6 +1460,16 @@ static void handleConfig(HTTPRequest *, HTTPResponse * res) {
   html = replaceHtml(html, "{displayNumConfirmed}", displayNumConfirmed ? "checked" : "");
   html = replaceHtml(html, "{displayDistanceDetail}", displayDistanceDetail ? "checked" : "");
 
+  const uint filterConfig = theObsConfig->getProperty<uint>(ObsConfig::PROPERTY_FILTER_CONFIG);
+  html = replaceHtml(html, "{filterRangeGate}", (filterConfig & FilterRangeGate) ? "checked" : "");
+  html = replaceHtml(html, "{filterPhantomSuppression}", (filterConfig & FilterPhantomSuppression) ? "checked" : "");
+  html = replaceHtml(html, "{filterMedian}", (filterConfig & FilterMedian) ? "checked" : "");
+  html = replaceHtml(html, "{filterTracker}", (filterConfig & FilterTracker) ? "checked" : "");
+  html = replaceHtml(html, "{filterMinDistance}",
+               theObsConfig->getProperty<String>(ObsConfig::PROPERTY_FILTER_MIN_DISTANCE));
+  html = replaceHtml(html, "{filterMaxDistance}",
+               theObsConfig->getProperty<String>(ObsConfig::PROPERTY_FILTER_MAX_DISTANCE));
+
   html = replaceHtml(html, "{bluetooth}",
                theObsConfig->getProperty<bool>(ObsConfig::PROPERTY_BLUETOOTH) ? "checked" : "");
 
@@ -1488,51 +1536,53 @@ void uploadTracks(HTTPResponse *res) {
     return;
   }
 
-  const uint16_t numberOfFiles = countFilesInRoot();
+  std::vector<TrackSummary> tracks;
+  loadTrackIndex(tracks);
+  const uint16_t numberOfFiles = std::count_if(tracks.begin(), tracks.end(), isUploadPending);
 
   uint16_t currentFileIndex = 0;
   uint16_t okCount = 0;
   uint16_t failedCount = 0;
-  File root = SDFileSystem.open("/");
-  File file = root.openNextFile();
-  while (file) {
-    const String fileName(String("/") + file.name());
+  for (const TrackSummary &track : tracks) {
+    if (!isUploadPending(track)) {
+      continue;
+    }
+    const String &fileName = track.fileName;
     log_d("Upload file: %s", fileName.c_str());
-    if (!file.isDirectory()
-        && fileName.endsWith(CSVFileWriter::EXTENSION)) {
-      const String friendlyFileName = ObsUtils::stripCsvFileName(fileName);
-      currentFileIndex++;
-
-      obsDisplay->showTextOnGrid(0, 4, friendlyFileName);
-      obsDisplay->drawProgressBar(3, currentFileIndex, numberOfFiles);
-      if (res) {
-        res->print(friendlyFileName);
-      }
-      const boolean uploaded = uploader.upload(fileName);
-      file.close();
-      if (uploaded) {
-        moveToUploaded(fileName);
-        html += "<a href='" + ObsUtils::encodeForXmlAttribute(uploader.getLastLocation())
-                + "' title='" + ObsUtils::encodeForXmlAttribute(uploader.getLastStatusMessage())
-                + "' target='_blank'>" + HTML_ENTITY_OK_MARK  + "</a>";
-        okCount++;
-      } else {
-        html += "<a href='#' title='" + ObsUtils::encodeForXmlAttribute(uploader.getLastStatusMessage())
-                + "'>" + HTML_ENTITY_FAILED_CROSS + "</a><p><tt>" + ObsUtils::encodeForXmlAttribute(uploader.getLastStatusMessage()) + "</tt></p>";
-        failedCount++;
-      }
-      if (res) {
-        html += "<br />\n";
-        res->print(html);
+    const String friendlyFileName = ObsUtils::stripCsvFileName(fileName);
+    currentFileIndex++;
+
+    obsDisplay->showTextOnGrid(0, 4, friendlyFileName);
+    obsDisplay->drawProgressBar(3, currentFileIndex, numberOfFiles);
+    if (res) {
+      res->print(friendlyFileName);
+    }
+    const boolean uploaded = uploader.upload(fileName);
+    if (uploaded) {
+      const String uploadedFileName = moveToUploaded(fileName);
+      if (uploadedFileName != fileName) {
+        TrackIndex::move(fileName, uploadedFileName);
       }
-      html.clear();
-      obsDisplay->clearProgressBar(5);
+      html += "<a href='" + ObsUtils::encodeForXmlAttribute(uploader.getLastLocation())
+              + "' title='" + ObsUtils::encodeForXmlAttribute(uploader.getLastStatusMessage())
+              + "' target='_blank'>" + HTML_ENTITY_OK_MARK  + "</a>";
+      okCount++;
     } else {
-      file.close();
+      if (!SD.exists(fileName)) {
+        // removed from the card elsewhere
+        TrackIndex::remove(fileName);
+      }
+      html += "<a href='#' title='" + ObsUtils::encodeForXmlAttribute(uploader.getLastStatusMessage())
+              + "'>" + HTML_ENTITY_FAILED_CROSS + "</a><p><tt>" + ObsUtils::encodeForXmlAttribute(uploader.getLastStatusMessage()) + "</tt></p>";
+      failedCount++;
     }
-    file = root.openNextFile();
+    if (res) {
+      html += "<br />\n";
+      res->print(html);
+    }
+    html.clear();
+    obsDisplay->clearProgressBar(5);
   }
-  root.close();
 
   obsDisplay->clearProgressBar(3);
   obsDisplay->showTextOnGrid(0, 4, "");
@@ -1551,15 +1601,39 @@ void uploadTracks(HTTPResponse *res) {
   }
 }
 
-static void moveToUploaded(const String &fileName) {
-  int i = 0;
-  while (!SDFileSystem.rename(
-    fileName, String("/uploaded") + fileName + (i == 0 ? "" : String(i)))) {
-    i++;
+/* Returns the new name, or the old one if the file could not be moved. */
+static String moveToUploaded(const String &fileName) {
+  const String uploadedName = TrackIndex::uploadedName(fileName);
+  TrackIndex::createDirectories(uploadedName);
+  String newName = uploadedName;
+  // a number is added if the track was uploaded before
+  for (int i = 1; SDFileSystem.exists(newName); i++) {
     if (i > 100) {
-      break;
+      return fileName;
     }
+    newName = uploadedName + String(i);
+  }
+  if (!SDFileSystem.rename(fileName, newName)) {
+    log_e("Failed to move %s to %s.", fileName.c_str(), newName.c_str());
+    return fileName;
   }
+  return newName;
+}
+
+/* Loads the track index, cards written by older firmware are indexed
+ * first.
+ */
+static void loadTrackIndex(std::vector<TrackSummary> &tracks) {
+  if (!TrackIndex::load(tracks)) {
+    obsDisplay->showTextOnGrid(0, 4, "Indexing tracks...");
+    TrackIndex::rebuild();
+    TrackIndex::load(tracks);
+    obsDisplay->showTextOnGrid(0, 4, "");
+  }
+}
+
+static bool isUploadPending(const TrackSummary &track) {
+  return !track.uploaded && CSVFileWriter::isTrackFile(track.fileName);
 }
 
 static void handleUpload(HTTPRequest *, HTTPResponse * res) {
@@ -1811,7 +1885,7 @@ static void handleDeleteFiles(HTTPRequest *req, HTTPResponse * res) {
 
   String html;
   if (moveToRoot) {
-    html = replaceDefault(header, "Move to /");
+    html = replaceDefault(header, "Move for new upload");
     html += "<h3>Moving files</h3>";
     html += "<div>In: " + ObsUtils::encodeForXmlText(path);
     html += "</div><br /><div>";
@@ -1832,16 +1906,22 @@ static void handleDeleteFiles(HTTPRequest *req, HTTPResponse * res) {
 
       html += ObsUtils::encodeForXmlText(file) + " &#10140; ";
       if (moveToRoot) {
-        if (SD.rename(fullName, "/" + file)) {
-          log_i("Moved '%s' to /", fullName.c_str());
+        const String pendingName = TrackIndex::pendingName(fullName);
+        TrackIndex::createDirectories(pendingName);
+        if (SD.rename(fullName, pendingName)) {
+          log_i("Moved '%s' to '%s'", fullName.c_str(), pendingName.c_str());
+          TrackIndex::move(fullName, pendingName);
           html += HTML_ENTITY_OK_MARK;
         } else {
-          log_w("Failed to moved '%s' to /", fullName.c_str());
+          log_w("Failed to moved '%s' to '%s'", fullName.c_str(), pendingName.c_str());
           html += HTML_ENTITY_FAILED_CROSS;
         }
       } else if (path != "/trash") {
         if (SD.rename(fullName, "/trash/" + file)) {
           log_i("Moved '%s'.", fullName.c_str());
+          if (TrackIndex::isTrack(fullName)) {
+            TrackIndex::remove(fullName);
+          }
           html += HTML_ENTITY_WASTEBASKET;
         } else {
           log_w("Failed to move '%s'.", fullName.c_str());
@@ -1869,6 +1949,23 @@ static void handleDeleteFiles(HTTPRequest *req, HTTPResponse * res) {
 }
 
 
+static String directoryListEntry(const String &path, const String &name, bool isDirectory,
+                                 const String &tip) {
+  const String fileName = ObsUtils::encodeForXmlAttribute(name);
+  return "<li class=\""
+         + String(isDirectory ? "directory" : "file")
+         + "\" title='" + ObsUtils::encodeForXmlAttribute(tip) + "'>"
+         + "<input class='small' type='checkbox' value='" + fileName + "' name='delete'"
+         + String(isDirectory ? "disabled" : "")
+         + "><a href=\"/sd?path="
+         + path + name
+         + "\">"
+         + String(isDirectory ? "&#x1F4C1;" : "&#x1F4C4;")
+         + fileName
+         + String(isDirectory ? "/" : "")
+         + "</a></li>";
+}
+
 static void handleSd(HTTPRequest *req, HTTPResponse *res) {
   String path = getParameter(req, "path", "/");
 
@@ -1894,42 +1991,79 @@ static void handleSd(HTTPRequest *req, HTTPResponse *res) {
       path += "/";
     }
 
-// Iterate over directories
-    File child = file.openNextFile();
+    if (!getParameter(req, "rebuild").isEmpty()) {
+      obsDisplay->showTextOnGrid(0, 4, "Indexing tracks...");
+      TrackIndex::rebuild();
+      obsDisplay->showTextOnGrid(0, 4, "");
+    }
+    // the track directories are listed from the track index, the full
+    // listing opens every file
+    const bool fromIndex = getParameter(req, "all").isEmpty()
+      && (path == "/" || path.startsWith(String(TrackIndex::TRACKS_DIRECTORY) + "/")
+          || path.startsWith(String(TrackIndex::UPLOADED_DIRECTORY) + "/"));
     uint16_t counter = 0;
-    while (child) {
-      obsDisplay->drawWaitBar(5, counter++);
-
-      auto fileName = String(child.name());
-      auto fileTip = ObsUtils::encodeForXmlAttribute(
-        TimeUtils::dateTimeToString(child.getLastWrite())
-        + " - " + ObsUtils::toScaledByteString(child.size()));
-
-      fileName = ObsUtils::encodeForXmlAttribute(fileName);
-      bool isDirectory = child.isDirectory();
-      html +=
-        ("<li class=\""
-         + String(isDirectory ? "directory" : "file")
-         + "\" title='" + fileTip + "'>"
-         + "<input class='small' type='checkbox' value='" + fileName + "' name='delete'"
-         + String(isDirectory ? "disabled" : "")
-         + "><a href=\"/sd?path="
-         + path + String(child.name())
-         + "\">"
-         + String(isDirectory ? "&#x1F4C1;" : "&#x1F4C4;")
-         + fileName
-         + String(isDirectory ? "/" : "")
-         + "</a></li>");
+    if (fromIndex) {
+      file.close();
+      std::vector<TrackSummary> tracks;
+      loadTrackIndex(tracks);
+      std::vector<String> directories;
+      if (path == "/") {
+        for (const char *directory : {"tracks", "uploaded", "trash", "sdflash"}) {
+          if (SD.exists(String("/") + directory)) {
+            directories.emplace_back(directory);
+          }
+        }
+      } else {
+        // the year and month directories, known from their tracks
+        for (const TrackSummary &track : tracks) {
+          const int end = track.fileName.indexOf('/', path.length());
+          if (end > 0 && track.fileName.startsWith(path)) {
+            const String directory = track.fileName.substring(path.length(), end);
+            if (std::find(directories.begin(), directories.end(), directory) == directories.end()) {
+              directories.push_back(directory);
+            }
+          }
+        }
+      }
+      for (const String &directory : directories) {
+        html += directoryListEntry(path, directory, true, "");
+        counter++;
+      }
+      for (const TrackSummary &track : tracks) {
+        const int nameStart = track.fileName.lastIndexOf('/') + 1;
+        if (track.fileName.substring(0, nameStart) != path) {
+          continue;
+        }
+        obsDisplay->drawWaitBar(5, counter++);
+        html += directoryListEntry(path, track.fileName.substring(nameStart), false,
+          (track.start ? TimeUtils::dateTimeToString(track.start) : String("no time"))
+          + " - " + String(track.durationSeconds / 60) + "min - "
+          + String(track.records) + " records - " + String(track.overtakes) + " overtakes");
+        if (html.length() >= (HTTP_UPLOAD_BUFLEN - 80)) {
+          res->print(html);
+          html.clear();
+        }
+      }
+    } else {
+// Iterate over directories
+      File child = file.openNextFile();
+      while (child) {
+        obsDisplay->drawWaitBar(5, counter++);
 
-      child.close();
-      child = file.openNextFile();
+        html += directoryListEntry(path, child.name(), child.isDirectory(),
+          TimeUtils::dateTimeToString(child.getLastWrite())
+          + " - " + ObsUtils::toScaledByteString(child.size()));
 
-      if (html.length() >= (HTTP_UPLOAD_BUFLEN - 80)) {
-        res->print(html);
-        html.clear();
+        child.close();
+        child = file.openNextFile();
+
+        if (html.length() >= (HTTP_UPLOAD_BUFLEN - 80)) {
+          res->print(html);
+          html.clear();
+        }
       }
+      file.close();
     }
-    file.close();
     if (counter > 0) {
       html += "<hr/>";
       html += "<li class=\"file\"><input class='small' type='checkbox' id='select-all' "
@@ -1951,10 +2085,17 @@ static void handleSd(HTTPRequest *req, HTTPResponse *res) {
       html += "<input type=button onclick=\"window.location.href='/'\" "
               "class='btn' value='Home' />";
     }
+    if (fromIndex) {
+      html += "<input type=button onclick=\"window.location.href='/sd?all=1&path="
+              + ObsUtils::encodeForUrl(path) + "'\" class='btn' value='All Files' />";
+    } else if (path == "/") {
+      html += "<input type=button onclick=\"window.location.href='/sd?rebuild=1&path=/'\" "
+              "class='btn' value='Rebuild Track Index' />";
+    }
 
     if (counter > 0) {
-      if (path == "/uploaded/") {
-        html += "<hr /><p>Move for new upload will move selected files to the root directory, where "
+      if (path.startsWith(String(TrackIndex::UPLOADED_DIRECTORY) + "/")) {
+        html += "<hr /><p>Move for new upload will move selected files back to /tracks, where "
                 "they will be considered as new tracks and uploaded to the portal with the next "
                 "Track upload.</p><input type='submit' class='btn' name='move' value='Move for new upload' />";
       }
@@ -1993,6 +2134,8 @@ static void handleSd(HTTPRequest *req, HTTPResponse *res) {
     dataType = "application/zip";
   } else if (path.endsWith(".csv")) {
     dataType = "text/csv";
+  } else if (path.endsWith(".gz")) {
+    dataType = "application/gzip";
   } else if (path.endsWith(".txt")) {
     dataType = "text/plain";
   }
@@ -2029,23 +2172,6 @@ static String ensureSdIsAvailable() {
   return result;
 }
 
-static uint16_t countFilesInRoot() {
-  uint16_t numberOfFiles = 0;
-  File root = SDFileSystem.open("/");
-  File file = root.openNextFile("r");
-  while (file) {
-    if (!file.isDirectory()
-        && String(file.name()).endsWith(CSVFileWriter::EXTENSION)) {
-      numberOfFiles++;
-      obsDisplay->drawWaitBar(4, numberOfFiles);
-    }
-    file = root.openNextFile();
-  }
-  root.close();
-  obsDisplay->clearProgressBar(4);
-  return numberOfFiles;
-}
-
 static void accessFilter(HTTPRequest * req, HTTPResponse * res, std::function<void()> next) {
   configServerWasConnectedViaHttpFlag = true;
 
@@ -2359,6 +2485,30 @@ static void deleteFilesFromDirectory(String dirName) {
   dir.close();
 }
 
+/* With the year and month directories below. */
+static void deleteDirectory(const String &dirName) {
+  File dir = SD.open(dirName);
+  if (!dir.isDirectory()) {
+    dir.close();
+    return;
+  }
+  File entry = dir.openNextFile();
+  while (entry) {
+    const String fileName = entry.path();
+    const bool isDirectory = entry.isDirectory();
+    entry.close();
+    if (isDirectory) {
+      deleteDirectory(fileName);
+    } else {
+      log_d("Will delete %s", fileName.c_str());
+      SD.remove(fileName);
+    }
+    entry = dir.openNextFile();
+  }
+  dir.close();
+  SD.rmdir(dirName);
+}
+
 static void deleteObsdataFiles() {
   File dir = SD.open("/");
   if (dir.isDirectory()) {
@@ -2367,7 +2517,7 @@ static void deleteObsdataFiles() {
       if (!entry.isDirectory()) {
         String fileName = entry.name();
         entry.close();
-        if (fileName.endsWith("obsdata.csv")) {
+        if (CSVFileWriter::isTrackFile(fileName)) {
           log_d("Will delete %s", fileName.c_str());
           SD.remove(fileName);
         }
@@ -2379,11 +2529,11 @@ static void deleteObsdataFiles() {
 }
 
 static void deleteAllFromSd() {
-  // ald_ini.ubx, tracknumber.txt, current_14d.*, *.obsdata.csv, sdflash/*, trash/*, uploaded/*
+  // ald_ini.ubx, tracknumber.txt, current_14d.*, *.obsdata.csv(.gz), sdflash/*, trash/*, tracks/*, uploaded/*
   deleteFilesFromDirectory("/trash");
   SD.rmdir("/trash");
-  deleteFilesFromDirectory("/uploaded");
-  SD.rmdir("/uploaded");
+  deleteDirectory(TrackIndex::TRACKS_DIRECTORY);
+  deleteDirectory(TrackIndex::UPLOADED_DIRECTORY);
   deleteFilesFromDirectory("/sdflash");
   SD.rmdir("/sdflash");
   SD.remove("/tracknumber.txt");
@@ -2392,6 +2542,7 @@ static void deleteAllFromSd() {
   SD.remove(ALP_DATA_FILE_NAME);
   SD.remove(ALP_NEW_DATA_FILE_NAME);
   deleteObsdataFiles();
+  TrackIndex::clear();
 }
 
 static void handleDeleteAction(HTTPRequest *req, HTTPResponse * res) {
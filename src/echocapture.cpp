@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#include "echocapture.h"
+#include "sensor.h"
+#include <driver/gpio.h>
+#include <driver/mcpwm.h>
+
+/* APB clock ticks of the MCPWM capture timer per micro second. */
+static const uint32_t CAPTURE_TICKS_PER_MICRO_SEC = APB_CLK_FREQ / 1000000;
+
+EchoCapture *EchoCapture::create() {
+#if HCSR04_ECHO_CAPTURE_MCPWM
+  return new McpwmEchoCapture;
+#else
+  return new GpioInterruptEchoCapture;
+#endif
+}
+
+// Hack to get the pointers to the isr
+static HCSR04SensorInfo * TOF_SENSOR[NUMBER_OF_TOF_SENSORS];
+
+static void IRAM_ATTR gpioIsr(HCSR04SensorInfo* const sensor) {
+  // since the measurement of start and stop use the same interrupt
+  // mechanism we should see a similar delay.
+  HCSR04SensorManager::recordEdge(sensor, micros(), digitalRead(sensor->echoPin));
+}
+
+static void IRAM_ATTR gpioIsr0() {
+  gpioIsr(TOF_SENSOR[0]);
+}
+
+static void IRAM_ATTR gpioIsr1() {
+  gpioIsr(TOF_SENSOR[1]);
+}
+
+bool GpioInterruptEchoCapture::attach(uint8_t idx, HCSR04SensorInfo *sensor) {
+  TOF_SENSOR[idx] = sensor;
+  // bad bad bad ....
+  if (idx == 0) {
+    attachInterrupt(sensor->echoPin, gpioIsr0, CHANGE);
+  } else {
+    attachInterrupt(sensor->echoPin, gpioIsr1, CHANGE);
+  }
+
+  // a solution like below leads to crashes with:
+  // Guru Meditation Error: Core  1 panic'ed (Cache disabled but cached memory region accessed)
+  // Core 1 was running in ISR context:
+  //   attachInterrupt(sensorInfo.echoPin,
+  //                  std::bind(&isr, sensorInfo.echoPin, &sensorInfo.start, &sensorInfo.end), CHANGE);
+  return true;
+}
+
+void GpioInterruptEchoCapture::detach(uint8_t idx) {
+  if (TOF_SENSOR[idx]) {
+    detachInterrupt(TOF_SENSOR[idx]->echoPin);
+  }
+}
+
+const char *GpioInterruptEchoCapture::getName() const {
+  return "gpio interrupt";
+}
+
+static bool IRAM_ATTR mcpwmCaptureIsr(mcpwm_unit_t /*mcpwm*/, mcpwm_capture_channel_id_t /*channelId*/,
+                                      const cap_event_data_t *edata, void *userData) {
+  auto * const channel = static_cast<McpwmEchoCapture::Channel *>(userData);
+  uint32_t micros;
+  uint8_t level;
+  if (edata->cap_edge == MCPWM_POS_EDGE) {
+    micros = ::micros();
+    level = HIGH;
+    channel->risingTicks = edata->cap_value;
+    channel->risingMicros = micros;
+  } else {
+    const uint32_t ticks = edata->cap_value - channel->risingTicks;
+    micros = channel->risingMicros
+      + (ticks + CAPTURE_TICKS_PER_MICRO_SEC / 2) / CAPTURE_TICKS_PER_MICRO_SEC;
+    level = LOW;
+  }
+  HCSR04SensorManager::recordEdge(channel->sensor, micros, level);
+  return false; // no task was woken
+}
+
+bool McpwmEchoCapture::attach(uint8_t idx, HCSR04SensorInfo *sensor) {
+  Channel * const channel = &mChannels[idx];
+  channel->sensor = sensor;
+  const auto captureId = static_cast<mcpwm_capture_channel_id_t>(MCPWM_SELECT_CAP0 + idx);
+  const auto signal = static_cast<mcpwm_io_signals_t>(MCPWM_CAP_0 + idx);
+  esp_err_t err = mcpwm_gpio_init(MCPWM_UNIT_0, signal, sensor->echoPin);
+  if (err == ESP_OK) {
+    mcpwm_capture_config_t config = {};
+    config.cap_edge = MCPWM_BOTH_EDGE;
+    config.cap_prescale = 1;
+    config.capture_cb = mcpwmCaptureIsr;
+    config.user_data = channel;
+    err = mcpwm_capture_enable_channel(MCPWM_UNIT_0, captureId, &config);
+  }
+  if (err != ESP_OK) {
+    log_e("Failed to setup MCPWM capture for echo pin %d: %s", sensor->echoPin, esp_err_to_name(err));
+    return false;
+  }
+  gpio_pullup_en(static_cast<gpio_num_t>(sensor->echoPin));
+  return true;
+}
+
+void McpwmEchoCapture::detach(uint8_t idx) {
+  if (mChannels[idx].sensor) {
+    mcpwm_capture_disable_channel(
+      MCPWM_UNIT_0, static_cast<mcpwm_capture_channel_id_t>(MCPWM_SELECT_CAP0 + idx));
+  }
+}
+
+const char *McpwmEchoCapture::getName() const {
+  return "mcpwm capture";
+}
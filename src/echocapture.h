@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OBS_ECHOCAPTURE_H
+#define OBS_ECHOCAPTURE_H
+
+#include <Arduino.h>
+#include "variant.h"
+
+/* Select the backend that timestamps the echo pin edges of the HC-SR04
+ * sensors. If set to 1 the MCPWM capture unit latches the edges in
+ * hardware, 0 uses GPIO interrupts and micros().
+ */
+#ifndef HCSR04_ECHO_CAPTURE_MCPWM
+#define HCSR04_ECHO_CAPTURE_MCPWM 0
+#endif
+
+struct HCSR04SensorInfo;
+
+/* Delivers the edges of the echo pins to the sensor manager, see
+ * HCSR04SensorManager::recordEdge(). Implementations must be
+ * interchangeable, a backend for host tests can call recordEdge() with
+ * synthetic edges.
+ */
+class EchoCapture {
+  public:
+    virtual ~EchoCapture() = default;
+    /* Start to capture the echo pin edges of the given sensor. */
+    virtual bool attach(uint8_t idx, HCSR04SensorInfo *sensor) = 0;
+    /* Stop capturing, e.g. before flash is written. */
+    virtual void detach(uint8_t idx) = 0;
+    virtual const char *getName() const = 0;
+    static EchoCapture *create();
+};
+
+/* Edges are timestamped with micros() in a GPIO interrupt. Suffers from
+ * interrupt latency and lost interrupts if both echo pins change at the
+ * same time.
+ */
+class GpioInterruptEchoCapture : public EchoCapture {
+  public:
+    bool attach(uint8_t idx, HCSR04SensorInfo *sensor) override;
+    void detach(uint8_t idx) override;
+    const char *getName() const override;
+};
+
+/* Edges are latched by the MCPWM capture unit with the 80MHz APB clock,
+ * each sensor has its own capture channel so no edge gets lost. The
+ * capture timer is not in sync with micros(), so the rising edge is
+ * stamped when the capture interrupt is served and the falling edge gets
+ * the exact hardware measured distance to the rising edge.
+ */
+class McpwmEchoCapture : public EchoCapture {
+  public:
+    bool attach(uint8_t idx, HCSR04SensorInfo *sensor) override;
+    void detach(uint8_t idx) override;
+    const char *getName() const override;
+
+    struct Channel {
+      HCSR04SensorInfo *sensor = nullptr;
+      uint32_t risingTicks = 0;
+      uint32_t risingMicros = 0;
+    };
+
+  private:
+    Channel mChannels[NUMBER_OF_TOF_SENSORS];
+};
+
+#endif
@@ -22,6 +22,8 @@
  */
 
 #include "gps.h"
+
+#include <algorithm>
 #include "utils/timeutils.h"
 
 /* Most input from u-blox6_ReceiverDescrProtSpec_(GPS.G6-SW-10018)_Public.pdf */
@@ -66,6 +68,9 @@ String Gps::hw() const {
 }
 
 void Gps::begin() {
+  if (!mMessagesLock) {
+    mMessagesLock = xSemaphoreCreateMutex();
+  }
   setBaud();
   softResetGps();
   if (mGpsNeedsConfigUpdate) {
@@ -86,25 +91,29 @@ void Gps::begin() {
   pollStatistics();
 #endif
 
+  setNavigationRate();
   if (is_neo6()) {
     enableAlpIfDataIsAvailable();
   }
   
   if (mLastTimeTimeSet == 0) {
 #ifdef UBX_M10
-    setMessageInterval(UBX_CFG_KEY_ID::CFG_MSGOUT_UBX_NAV_TIMEGPS_UART1, 1);
+    setMessageInterval(UBX_CFG_KEY_ID::CFG_MSGOUT_UBX_NAV_TIMEGPS_UART1, solutions(1));
 #endif
 #ifdef UBX_M6
-    setMessageInterval(UBX_MSG::NAV_TIMEGPS, 1);
+    setMessageInterval(UBX_MSG::NAV_TIMEGPS, solutions(1));
 #endif
   } else {
 #ifdef UBX_M10
-    setMessageInterval(UBX_CFG_KEY_ID::CFG_MSGOUT_UBX_NAV_TIMEGPS_UART1, 240);
+    setMessageInterval(UBX_CFG_KEY_ID::CFG_MSGOUT_UBX_NAV_TIMEGPS_UART1, solutions(240));
 #endif
 #ifdef UBX_M6
-    setMessageInterval(UBX_MSG::NAV_TIMEGPS, 240);
+    setMessageInterval(UBX_MSG::NAV_TIMEGPS, solutions(240));
 #endif
   }
+#ifndef GPS_TRANSPARENT_UART
+  startReaderTask();
+#endif
 
   //Serial.updateBaudRate(9600);
   //mSerial.begin(9600, SERIAL_8N1);
@@ -234,7 +243,6 @@ void Gps::configureGpsModule() {
 #endif
 
 #ifdef UBX_M6
-  setMessageInterval(UBX_MSG::NAV_SBAS, 59);
   setMessageInterval(UBX_MSG::NAV_POSLLH, 1);
   setMessageInterval(UBX_MSG::NAV_DOP, 1);
   setMessageInterval(UBX_MSG::NAV_SOL, 1);
@@ -242,12 +250,13 @@ void Gps::configureGpsModule() {
   setMessageInterval(UBX_MSG::NAV_TIMEGPS, 1);
 #endif
 #ifdef UBX_M10
-  setMessageInterval(UBX_CFG_KEY_ID::CFG_MSGOUT_UBX_NAV_SBAS_UART1, 59);
-  setMessageInterval(UBX_CFG_KEY_ID::CFG_MSGOUT_UBX_NAV_POSLLH_UART1, 1);
-  setMessageInterval(UBX_CFG_KEY_ID::CFG_MSGOUT_UBX_NAV_DOP_UART1, 1);
-  setMessageInterval(UBX_CFG_KEY_ID::CFG_MSGOUT_UBX_NAV_VELNED_UART1, 1);
-  // SOL not available in M10, the message NAV-PVT is used instead
+  // NAV-PVT alone fills the record, POSLLH, DOP and VELNED only cost
+  // UART time and parsing. Disabled explicitly, older firmware enabled them.
+  setMessageInterval(UBX_CFG_KEY_ID::CFG_MSGOUT_UBX_NAV_POSLLH_UART1, 0);
+  setMessageInterval(UBX_CFG_KEY_ID::CFG_MSGOUT_UBX_NAV_DOP_UART1, 0);
+  setMessageInterval(UBX_CFG_KEY_ID::CFG_MSGOUT_UBX_NAV_VELNED_UART1, 0);
   setMessageInterval(UBX_CFG_KEY_ID::CFG_MSGOUT_UBX_NAV_PVT_UART1, 1);
+  // for the week and the clock, slowed down once the clock is set
   setMessageInterval(UBX_CFG_KEY_ID::CFG_MSGOUT_UBX_NAV_TIMEGPS_UART1, 1);
 #endif
 
@@ -311,12 +320,6 @@ void Gps::configureGpsModule() {
                     inv.length());
 #endif
 
-#ifdef UBX_M6
-  // AID only available in M6 modules
-  // Used to store GPS AID data every 3 minutes+
-  setMessageInterval(UBX_MSG::AID_INI, 185);
-#endif
-
   // Persist configuration
 #ifdef UBX_M6
   const uint8_t UBX_CFG_CFG_SAVE[] = {
@@ -435,13 +438,61 @@ void Gps::pollStatistics() {
  */
 void Gps::setStatisticsIntervalInSeconds(uint16_t seconds) {
 #ifdef UBX_M6
-  setMessageInterval(UBX_MSG::NAV_STATUS, seconds);
-  setMessageInterval(UBX_MSG::MON_HW, seconds);
+  setMessageInterval(UBX_MSG::NAV_STATUS, solutions(seconds));
+  setMessageInterval(UBX_MSG::MON_HW, solutions(seconds));
+#endif
+#ifdef UBX_M10
+  setMessageInterval(UBX_CFG_KEY_ID::CFG_MSGOUT_UBX_NAV_STATUS_UART1, solutions(seconds));
+  setMessageInterval(UBX_CFG_KEY_ID::CFG_MSGOUT_UBX_MON_HW_UART1, solutions(seconds));
+#endif
+}
+
+static_assert(GPS_NAV_RATE_HZ >= 1 && GPS_NAV_RATE_HZ <= 10 && 1000 % GPS_NAV_RATE_HZ == 0,
+              "GPS_NAV_RATE_HZ must be 1, 2, 4, 5, 8 or 10 so the epochs are at whole seconds.");
+
+void Gps::setNavigationRate() {
+  uint8_t rateHz = GPS_NAV_RATE_HZ;
+  if (is_neo6() && rateHz > 5) {
+    rateHz = 5;
+  }
+  const uint16_t measurementMillis = 1000 / rateHz;
+#ifdef UBX_M6
+  // measRate, navRate 1, timeRef GPS so there are epochs at whole seconds
+  const uint8_t UBX_CFG_RATE[] = {
+    (uint8_t) measurementMillis, (uint8_t) (measurementMillis >> 8), 0x01, 0x00, 0x01, 0x00
+  };
+  const bool rateSet = sendAndWaitForAck(UBX_MSG::CFG_RATE, UBX_CFG_RATE, sizeof(UBX_CFG_RATE));
 #endif
 #ifdef UBX_M10
-  setMessageInterval(UBX_CFG_KEY_ID::CFG_MSGOUT_UBX_NAV_STATUS_UART1, seconds);
-  setMessageInterval(UBX_CFG_KEY_ID::CFG_MSGOUT_UBX_MON_HW_UART1, seconds);
+  const bool rateSet =
+    sendCfgAndWaitForAck(UBX_CFG_LAYER::RAM, UBX_CFG_KEY_ID::CFG_RATE_TIMEREF, 1)
+    && sendCfgAndWaitForAck(UBX_CFG_LAYER::RAM, UBX_CFG_KEY_ID::CFG_RATE_MEAS, measurementMillis);
 #endif
+  if (rateSet) {
+    mNavigationRateHz = rateHz;
+  } else {
+    log_e("Failed to set the navigation rate to %dHz.", rateHz);
+    mNavigationRateHz = 1;
+  }
+#ifdef UBX_M6
+  setMessageInterval(UBX_MSG::NAV_SBAS, solutions(59));
+  // AID only available in M6 modules
+  // Used to store GPS AID data every 3 minutes+
+  setMessageInterval(UBX_MSG::AID_INI, solutions(185));
+#endif
+#ifdef UBX_M10
+  setMessageInterval(UBX_CFG_KEY_ID::CFG_MSGOUT_UBX_NAV_SBAS_UART1, solutions(59));
+#endif
+}
+
+uint8_t Gps::solutions(uint16_t seconds) const {
+  const uint32_t solutions = (uint32_t) seconds * mNavigationRateHz;
+  if (solutions > MAX_MESSAGE_INTERVAL) {
+    log_w("No message every %ds at %dHz, every %ds instead.",
+          seconds, mNavigationRateHz, MAX_MESSAGE_INTERVAL / mNavigationRateHz);
+    return MAX_MESSAGE_INTERVAL;
+  }
+  return solutions;
 }
 
 #ifdef UBX_M6
@@ -488,7 +539,7 @@ bool Gps::setMessageInterval(UBX_CFG_KEY_ID msgId, uint8_t seconds, bool waitFor
  */
 bool Gps::setBaud() {
   mSerial.end();
-  mSerial.setRxBufferSize(512);
+  mSerial.setRxBufferSize(GPS_RX_BUFFER_SIZE);
 
   mSerial.begin(115200, SERIAL_8N1);
   while(mSerial.read() >= 0) ;
@@ -633,6 +684,12 @@ void Gps::handle(uint32_t milliSeconds) {
 }
 
 bool Gps::handle() {
+  if (mReaderTask) {
+    const uint16_t messages = mValidMessagesReceived;
+    const bool gotGpsData = messages != mHandledMessages;
+    mHandledMessages = messages;
+    return gotGpsData;
+  }
   auto handleStart = millis();
   auto messageStarted = mMessageStarted;
   auto lastCallDelayMs = handleStart - messageStarted;
@@ -643,6 +700,7 @@ bool Gps::handle() {
                          + " bytes in buffer, lastCall " + String(lastCallDelayMs)
                          + "ms ago, at " + TimeUtils::dateTimeToString() + ")");
     mMessageStarted = handleStart;
+    mDroppedBytes += bytesAvailable;
     for (int i = 0; i < bytesAvailable; i++) {
       mSerial.read();
     }
@@ -692,7 +750,65 @@ bool Gps::handle() {
   return gotGpsData;
 }
 
+bool Gps::startReaderTask() {
+  // Same core as the SD card writer, a higher priority so SD card writes
+  // do not delay the GPS data.
+  if (xTaskCreatePinnedToCore(readerTask, "gps", 4 * 1024, this, 2,
+                              &mReaderTask, 0) != pdPASS) {
+    log_e("Failed to create GPS reader task, reading in the loop.");
+    mReaderTask = nullptr;
+    return false;
+  }
+  mSerial.onReceive([this]() {
+    xTaskNotifyGive(mReaderTask);
+  });
+  mSerial.onReceiveError([this](hardwareSerial_error_t error) {
+    if (error == UART_BUFFER_FULL_ERROR || error == UART_FIFO_OVF_ERROR) {
+      mRxOverflows++;
+    }
+  });
+  return true;
+}
+
+void Gps::readerTask(void *param) {
+  auto * const gps = static_cast<Gps *>(param);
+  while (true) {
+    // notified by the UART event task, the timeout only covers a lost
+    // notification
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+    gps->readAvailable();
+  }
+}
+
+// Runs in the reader task.
+void Gps::readAvailable() {
+  const int bytesAvailable = mSerial.available();
+  if (bytesAvailable <= 0) {
+    return;
+  }
+  if (mReceiverState == GPS_NULL) {
+    // a new message burst, it started as long ago as the available
+    // bytes took to arrive with 10 bits each
+    mMessageStarted = millis() - bytesAvailable * 10000 / mSerial.baudRate();
+  }
+  int data;
+  while ((data = mSerial.read()) >= 0) {
+#ifdef GPS_LOW_LEVEL_DEBUGGING
+    log_w("GPS in: 0x%02x", data);
+#endif
+    encode(data);
+  }
+}
+
 bool Gps::waitForData(const uint16_t timeoutMs) {
+  if (mReaderTask) {
+    const uint16_t messages = mValidMessagesReceived;
+    const auto end = millis() + timeoutMs;
+    while (mValidMessagesReceived == messages && millis() < end) {
+      delay(1);
+    }
+    return mValidMessagesReceived != messages;
+  }
   if (mSerial.available() > 0) {
     return true;
   }
@@ -708,6 +824,7 @@ static const String STATIC_MSG_PREFIX[] = {
 };
 
 void Gps::addStatisticsMessage(String newMessage) {
+  lockMessages();
   int prefix = -1;
   for (int i = 0; i < (sizeof(STATIC_MSG_PREFIX)/sizeof(*STATIC_MSG_PREFIX)); i++) {
     if (newMessage.startsWith(STATIC_MSG_PREFIX[i])) {
@@ -734,41 +851,25 @@ void Gps::addStatisticsMessage(String newMessage) {
   if (mMessages.size() > 20) {
     mMessages.erase(mMessages.cbegin());
   }
+  unlockMessages();
 }
 
-bool Gps::isInsidePrivacyArea() {
-  // quite accurate haversine formula
-  // consider using simplified flat earth calculation to save time
-
-  // TODO: Config must not be read from the globals here!
-  const double lon = mCurrentGpsRecord.getLongitude();
-  const double lat = mCurrentGpsRecord.getLatitude();
-
-  for (auto pa : config.privacyAreas) {
-    double distance = haversine(
-      lat, lon, pa.transformedLatitude, pa.transformedLongitude);
-    if (distance < pa.radius) {
-      return true;
-    }
+void Gps::lockMessages() const {
+  if (mMessagesLock) {
+    xSemaphoreTake(mMessagesLock, portMAX_DELAY);
   }
-  return false;
 }
 
-double Gps::haversine(double lat1, double lon1, double lat2, double lon2) {
-  // https://www.geeksforgeeks.org/haversine-formula-to-find-distance-between-two-points-on-a-sphere/
-  // distance between latitudes and longitudes
-  double dLat = (lat2 - lat1) * M_PI / 180.0;
-  double dLon = (lon2 - lon1) * M_PI / 180.0;
-
-  // convert to radians
-  lat1 = (lat1) * M_PI / 180.0;
-  lat2 = (lat2) * M_PI / 180.0;
+void Gps::unlockMessages() const {
+  if (mMessagesLock) {
+    xSemaphoreGive(mMessagesLock);
+  }
+}
 
-  // apply formulae
-  double a = pow(sin(dLat / 2), 2) + pow(sin(dLon / 2), 2) * cos(lat1) * cos(lat2);
-  double rad = 6371000;
-  double c = 2 * asin(sqrt(a));
-  return rad * c;
+bool Gps::isInsidePrivacyArea() {
+  // TODO: Config must not be read from the globals here!
+  const GpsRecord record = getCurrentGpsRecord();
+  return config.privacyAreaIndex.contains(record.getLatitude(), record.getLongitude());
 }
 
 void Gps::randomOffset(PrivacyArea &p) {
@@ -828,7 +929,7 @@ PrivacyArea Gps::newPrivacyArea(double latitude, double longitude, int radius) {
 
 bool Gps::hasFix(DisplayDevice *display) const {
   bool result = false;
-  if (mCurrentGpsRecord.hasValidFix() && mLastTimeTimeSet) {
+  if (getCurrentGpsRecord().hasValidFix() && mLastTimeTimeSet) {
     log_d("Got location...");
     display->showTextOnGrid(2, 4, "Got location");
     result = true;
@@ -850,15 +951,16 @@ void Gps::showWaitStatus(DisplayDevice const * display) const {
      obsDisplay->clear();
      clear = true;
   }
+  const GpsRecord record = getCurrentGpsRecord();
   String satellitesString[2];
   if (mValidMessagesReceived == 0) { // could not get any valid char from GPS module
     satellitesString[0] = "OFF?";
   } else if (mLastTimeTimeSet == 0) {
     satellitesString[0] = "aGain:" + String(mLastGain);
-    satellitesString[1] = String(mCurrentGpsRecord.mSatellitesUsed) + "sats SN:" + String(mLastNoiseLevel);
+    satellitesString[1] = String(record.mSatellitesUsed) + "sats SN:" + String(mLastNoiseLevel);
   } else {
     satellitesString[0] = String(hw()).substring(1) + TimeUtils::timeToString();
-    satellitesString[1] = String(mCurrentGpsRecord.mSatellitesUsed) + "sats SN:" + String(mLastNoiseLevel);
+    satellitesString[1] = String(record.mSatellitesUsed) + "sats SN:" + String(mLastNoiseLevel);
   }
   obsDisplay->showTextOnGrid(2, display->currentLine() - 1, satellitesString[0]);
   obsDisplay->showTextOnGrid(2, display->currentLine(), satellitesString[1]);
@@ -868,12 +970,12 @@ void Gps::showWaitStatus(DisplayDevice const * display) const {
 
     obsDisplay->showTextOnGrid(0, 2, "Jam: " + String(mLastJamInd));
     obsDisplay->showTextOnGrid(2, 2, "Msgs: " + String(mValidMessagesReceived));
-    obsDisplay->showTextOnGrid(2, 3, "Fix: " + String(mCurrentGpsRecord.mFixStatus) + "D");
+    obsDisplay->showTextOnGrid(2, 3, "Fix: " + String(record.mFixStatus) + "D");
     obsDisplay->showTextOnGrid(0, 3, "lat,lon:");
 
 
-    obsDisplay->showTextOnGrid(0, 4, String(mCurrentGpsRecord.mLatitude));
-    obsDisplay->showTextOnGrid(0, 5, String(mCurrentGpsRecord.mLongitude));
+    obsDisplay->showTextOnGrid(0, 4, String(record.mLatitude));
+    obsDisplay->showTextOnGrid(0, 5, String(record.mLongitude));
   }
 }
 
@@ -882,49 +984,57 @@ bool Gps::moduleIsAlive() const {
 }
 
 uint8_t Gps::getValidSatellites() const {
-  return mCurrentGpsRecord.mSatellitesUsed;
+  return getCurrentGpsRecord().mSatellitesUsed;
 }
 
 double Gps::getSpeed() const {
-  return (double) mCurrentGpsRecord.mSpeed * (60.0 * 60.0) / 100.0 / 1000.0;
+  return (double) getCurrentGpsRecord().mSpeed * (60.0 * 60.0) / 100.0 / 1000.0;
 }
 
 String Gps::getHdopAsString() const {
-  return mCurrentGpsRecord.getHdopString();
+  return getCurrentGpsRecord().getHdopString();
 }
 
 String Gps::getMessages() const {
   String theGpsMessage = "";
+  lockMessages();
   for (const String& msg : mMessages) {
     theGpsMessage += " // ";
     theGpsMessage += msg;
   }
+  unlockMessages();
   return theGpsMessage;
 }
 
 String Gps::popMessage() {
   String theGpsMessage = "";
+  lockMessages();
   if (mMessages.size() > 0) {
     theGpsMessage = mMessages[0];
     mMessages.erase(mMessages.begin());
   }
+  unlockMessages();
   return theGpsMessage;
 }
 
 String Gps::getMessage(uint16_t idx) const {
   String theGpsMessage = "";
+  lockMessages();
   if (mMessages.size() > idx) {
     theGpsMessage = mMessages[idx];
   }
+  unlockMessages();
   return theGpsMessage;
 }
 
 String Gps::getMessagesHtml() const {
   String theGpsMessage = "";
+  lockMessages();
   for (const String& msg : mMessages) {
     theGpsMessage += "<br/>";
     theGpsMessage += ObsUtils::encodeForXmlText(msg);
   }
+  unlockMessages();
   return theGpsMessage;
 }
 
@@ -942,6 +1052,12 @@ bool Gps::encode(uint8_t data) {
   checkForCharThatCausesMessageReset(data);
   if (mReceiverState == GPS_NULL) {
     mGpsBufferBytePos = 0;
+  } else if (mGpsBufferBytePos >= MAX_MESSAGE_LENGTH - 1) {
+    // NMEA messages have no length, keep room for the terminating 0
+    log_w("GPS message longer than %d bytes, reset.", MAX_MESSAGE_LENGTH);
+    mUnexpectedCharReceivedCount++;
+    mReceiverState = GPS_NULL;
+    mGpsBufferBytePos = 0;
   }
   mGpsBuffer.u1Data[mGpsBufferBytePos++] = data;
   switch (mReceiverState) {
@@ -974,10 +1090,12 @@ bool Gps::encode(uint8_t data) {
       mUbxChB += mUbxChA;
       if (mGpsBufferBytePos == 6) {
         mGpsPayloadLength = mGpsBuffer.ubxHeader.length;
-        if (mGpsPayloadLength + 6 > MAX_MESSAGE_LENGTH) {
+        if (mGpsPayloadLength + 8 >= MAX_MESSAGE_LENGTH) { // with header and checksum
           log_w("Message claims to be %d (0x%04x) bytes long. Will ignore it, reset.",
                 mGpsPayloadLength, mGpsPayloadLength);
           mReceiverState = GPS_NULL;
+        } else if (mGpsPayloadLength == 0) {
+          mReceiverState = UBX_CHECKSUM;
         } else {
           mReceiverState = UBX_PAYLOAD;
           log_v("Expecting UBX Payload: %d bytes", mGpsPayloadLength);
@@ -1011,6 +1129,8 @@ bool Gps::encode(uint8_t data) {
         mValidMessagesReceived++;
         result = true;
         parseUbxMessage();
+        publish();
+        countParseLatency(millis() - mMessageStarted);
       }
       break;
     case NMEA_START:
@@ -1114,297 +1234,331 @@ void Gps::checkForCharThatCausesMessageReset(uint8_t data) {
   }
 }
 
-/* Note: splitting this up eats memory */
+#define UBX_HANDLER(msg, Message, handler) \
+  { (uint16_t) UBX_MSG::msg, sizeof(Message) - sizeof(GpsBuffer::UBX_HEADER), \
+    &Gps::handleUbx<Message, &Gps::handler> }
+// for messages of variable length
+#define UBX_HANDLER_MIN(msg, Message, handler, minPayloadLength) \
+  { (uint16_t) UBX_MSG::msg, minPayloadLength, &Gps::handleUbx<Message, &Gps::handler> }
+
+/* Sorted by class, then id, see classAndId(). */
+const Gps::UbxHandler Gps::UBX_HANDLERS[] = {
+  UBX_HANDLER(NAV_POSLLH, GpsBuffer::NavPosllh, handleUbxNavPosllh),
+  UBX_HANDLER(NAV_STATUS, GpsBuffer::NavStatus, handleUbxNavStatus),
+  UBX_HANDLER(NAV_DOP, GpsBuffer::NavDop, handleUbxNavDop),
+  UBX_HANDLER(NAV_SOL, GpsBuffer::NavSol, handleUbxNavSol),
+  UBX_HANDLER(NAV_PVT, GpsBuffer::NavPvt, handleUbxNavPvt),
+  UBX_HANDLER(NAV_VELNED, GpsBuffer::NavVelned, handleUbxNavVelned),
+  UBX_HANDLER(NAV_TIMEGPS, GpsBuffer::UbxNavTimeGps, handleUbxNavTimeGps),
+  UBX_HANDLER(NAV_TIMEUTC, GpsBuffer::NavTimeUtc, handleUbxNavTimeUtc),
+  UBX_HANDLER(NAV_SBAS, GpsBuffer::NavSbas, handleUbxNavSbas),
+  UBX_HANDLER_MIN(INF_ERROR, GpsBuffer::Inf, handleUbxInf, 0),
+  UBX_HANDLER_MIN(INF_WARNING, GpsBuffer::Inf, handleUbxInf, 0),
+  UBX_HANDLER_MIN(INF_NOTICE, GpsBuffer::Inf, handleUbxInf, 0),
+  UBX_HANDLER_MIN(INF_TEST, GpsBuffer::Inf, handleUbxInf, 0),
+  UBX_HANDLER_MIN(INF_DEBUG, GpsBuffer::Inf, handleUbxInf, 0),
+  UBX_HANDLER(ACK_NAK, GpsBuffer::Ack, handleUbxAckNak),
+  UBX_HANDLER(ACK_ACK, GpsBuffer::Ack, handleUbxAckAck),
+  UBX_HANDLER(CFG_PRT, GpsBuffer::CfgPrt, handleUbxCfgPrt),
+  UBX_HANDLER_MIN(CFG_SBAS, GpsBuffer::UBX_HEADER, handleUbxCfgPollResponse, 0),
+  UBX_HANDLER_MIN(CFG_NAV5, GpsBuffer::UBX_HEADER, handleUbxCfgPollResponse, 0),
+  UBX_HANDLER_MIN(CFG_RINV, GpsBuffer::CfgRinv, handleUbxCfgRinv, 1),
+  UBX_HANDLER_MIN(CFG_GNSS, GpsBuffer::UBX_HEADER, handleUbxCfgPollResponse, 0),
+  UBX_HANDLER_MIN(MON_VER, GpsBuffer::MonVer, handleUbxMonVer, 40),
+  // M8 and M10 send 60 bytes, M6 68
+  UBX_HANDLER_MIN(MON_HW, GpsBuffer, handleUbxMonHw, sizeof(GpsBuffer::MonHwNew) - 6),
+  UBX_HANDLER(AID_INI, GpsBuffer::AidIni, handleUbxAidIni),
+  UBX_HANDLER(AID_HUI, GpsBuffer::AidHui, handleUbxAidHui),
+  UBX_HANDLER(AID_ALPSRV, GpsBuffer::AidAlpsrvClientReq, handleUbxAidAlpsrv),
+  UBX_HANDLER(AID_ALP, GpsBuffer::AidAlpStatus, handleUbxAidAlp),
+};
+
+const size_t Gps::UBX_HANDLER_COUNT = sizeof(UBX_HANDLERS) / sizeof(*UBX_HANDLERS);
+
+/* The message id has the class in the low byte. */
+static inline uint16_t classAndId(uint16_t ubxMsgId) {
+  return (ubxMsgId << 8) | (ubxMsgId >> 8);
+}
+
 void Gps::parseUbxMessage() {
-  const uint32_t receivedMs = millis();
-  const uint32_t delayMs = receivedMs - mMessageStarted;
-  switch (mGpsBuffer.ubxHeader.ubxMsgId) {
-    case (uint16_t) UBX_MSG::ACK_ACK: {
-      if (mLastAckMsgId != 0) {
-        log_e("ACK overrun had ack: %d for 0x%04x", mAckReceived, mLastAckMsgId);
-      }
-      log_v("ACK-ACK 0x%04x", mGpsBuffer.ack.ubxMsgId);
-      mAckReceived = true;
-      mNakReceived = false;
-      mLastAckMsgId = mGpsBuffer.ack.ubxMsgId;
-    }
-      break;
-    case (uint16_t) UBX_MSG::ACK_NAK: {
-      if (mLastAckMsgId != 0) {
-        log_e("ACK-NAK overrun had ack: %d for 0x%04x", mAckReceived, mLastAckMsgId);
-      }
-      log_e("ACK-NAK 0x%04x", mGpsBuffer.ack.ubxMsgId);
-      mAckReceived = false;
-      mNakReceived = true;
-      mLastAckMsgId = mGpsBuffer.ack.ubxMsgId;
-    }
-      break;
-    case (uint16_t) UBX_MSG::CFG_PRT:
-      log_i("CFG-PRT Port: %d, Baud: %d",
-            mGpsBuffer.cfgPrt.portId, mGpsBuffer.cfgPrt.baudRate);
-      break;
-    case (uint16_t) UBX_MSG::CFG_RINV: {
-      mGpsBuffer.u1Data[mGpsBufferBytePos - 2] = 0;
-      log_v("CFG-RINV flags: %02x, Message %s",
-            mGpsBuffer.cfgRinv.flags, &mGpsBuffer.cfgRinv.data);
-      String rinv = String(mGpsBuffer.cfgRinv.data);
-      addStatisticsMessage(String("RINV: ") + rinv);
-      if (!rinv.equals(String("openbikesensor.org/") + OBSVersion)) {
-        log_i("GPS config from %s outdated - will trigger update.", rinv.c_str());
-        mGpsNeedsConfigUpdate = true;
-      } else {
-        mGpsNeedsConfigUpdate = false;
-      }
-    }
-      break;
-    case (uint16_t) UBX_MSG::MON_VER: {
+  mMessageReceived = millis();
+  const uint16_t ubxMsgId = mGpsBuffer.ubxHeader.ubxMsgId;
+  const UbxHandler *end = UBX_HANDLERS + UBX_HANDLER_COUNT;
+  const UbxHandler *handler = std::lower_bound(
+    UBX_HANDLERS, end, classAndId(ubxMsgId),
+    [](const UbxHandler &h, uint16_t key) { return classAndId(h.ubxMsgId) < key; });
+  if (handler == end || handler->ubxMsgId != ubxMsgId) {
+    log_e("Got unparsed UBX_MESSAGE! Id: 0x%04x Len %d iTOW %d", ubxMsgId,
+          mGpsBuffer.ubxHeader.length, mGpsBuffer.navStatus.iTow);
+  } else if (mGpsPayloadLength < handler->minPayloadLength) {
+    log_w("UBX message 0x%04x too short, %d bytes, expected %d.",
+          ubxMsgId, mGpsPayloadLength, handler->minPayloadLength);
+  } else {
+    (this->*handler->handle)();
+  }
+}
+
+void Gps::handleUbxAckAck(const GpsBuffer::Ack &message) {
+  if (mLastAckMsgId != 0) {
+    log_e("ACK overrun had ack: %d for 0x%04x", mAckReceived, mLastAckMsgId);
+  }
+  log_v("ACK-ACK 0x%04x", message.ubxMsgId);
+  mAckReceived = true;
+  mNakReceived = false;
+  mLastAckMsgId = message.ubxMsgId;
+}
+
+void Gps::handleUbxAckNak(const GpsBuffer::Ack &message) {
+  if (mLastAckMsgId != 0) {
+    log_e("ACK-NAK overrun had ack: %d for 0x%04x", mAckReceived, mLastAckMsgId);
+  }
+  log_e("ACK-NAK 0x%04x", message.ubxMsgId);
+  mAckReceived = false;
+  mNakReceived = true;
+  mLastAckMsgId = message.ubxMsgId;
+}
+
+void Gps::handleUbxCfgPrt(const GpsBuffer::CfgPrt &message) {
+  log_i("CFG-PRT Port: %d, Baud: %d", message.portId, message.baudRate);
+}
+
+void Gps::handleUbxCfgRinv(const GpsBuffer::CfgRinv &message) {
+  mGpsBuffer.u1Data[mGpsBufferBytePos - 2] = 0;
+  log_v("CFG-RINV flags: %02x, Message %s", message.flags, &message.data);
+  String rinv = String(message.data);
+  addStatisticsMessage(String("RINV: ") + rinv);
+  if (!rinv.equals(String("openbikesensor.org/") + OBSVersion)) {
+    log_i("GPS config from %s outdated - will trigger update.", rinv.c_str());
+    mGpsNeedsConfigUpdate = true;
+  } else {
+    mGpsNeedsConfigUpdate = false;
+  }
+}
+
+/* Answers to polls of CFG messages we do not evaluate. */
+void Gps::handleUbxCfgPollResponse(const GpsBuffer::UBX_HEADER &message) {
+  log_d("CFG 0x%04x", message.ubxMsgId);
+}
+
+void Gps::handleUbxMonVer(const GpsBuffer::MonVer &message) {
 // a bit a hack - but do not let the strings none zero terminated.
-      mGpsBuffer.monVer.swVersion[sizeof(mGpsBuffer.monVer.swVersion) - 1] = 0;
-      mGpsBuffer.monVer.hwVersion[sizeof(mGpsBuffer.monVer.hwVersion) - 1] = 0;
-      mGpsBuffer.monVer.romVersion[sizeof(mGpsBuffer.monVer.romVersion) - 1] = 0;
-      mGpsBuffer.monVer.extension0[sizeof(mGpsBuffer.monVer.extension0) - 1] = 0;
-      mGpsBuffer.monVer.extension1[sizeof(mGpsBuffer.monVer.extension1) - 1] = 0;
-
-      addStatisticsMessage("swVersion: " + String(mGpsBuffer.monVer.swVersion));
-      addStatisticsMessage("hwVersion: " + String(mGpsBuffer.monVer.hwVersion));
-      if (mGpsPayloadLength > 40) {
-        addStatisticsMessage("romVersion: " + String(mGpsBuffer.monVer.romVersion));
-      }
-      if (mGpsPayloadLength > 70) {
-        addStatisticsMessage("extension: " + String(mGpsBuffer.monVer.extension0));
-      }
-      if (mGpsPayloadLength > 100) {
-        addStatisticsMessage("extension: " + String(mGpsBuffer.monVer.extension1));
-      }
-      log_d("MON-VER SW Version: %s, HW Version %s, len %d",
-            String(mGpsBuffer.monVer.swVersion).c_str(),
-            String(mGpsBuffer.monVer.hwVersion).c_str(),
-            mGpsBuffer.ubxHeader.length);
-      for (int i = 0; i < sizeof(hwString) && i < sizeof(mGpsBuffer.monVer.hwVersion) ; i++) {
-        hwString[i]=mGpsBuffer.monVer.hwVersion[i];
-      }
-    }
-      break;
-    case (uint16_t) UBX_MSG::MON_HW: {
-      const char* aStatus;
-      if (is_neo6()) {
-        switch (mGpsBuffer.monHw.aStatus) {
-          case mGpsBuffer.monHw.INIT: aStatus = "init"; break;
-          case mGpsBuffer.monHw.DONTKNOW: aStatus = "?"; break;
-          case mGpsBuffer.monHw.OK: aStatus = "ok"; break;
-          case mGpsBuffer.monHw.SHORT: aStatus = "short"; break;
-          case mGpsBuffer.monHw.OPEN: aStatus = "open"; break;
-          default: aStatus = "invalid";
-        }
-        log_d("MON-HW Antenna Status %d %s, Antenna Power %d, Gain (0-8191) %d, noise level %d", mGpsBuffer.monHw.aStatus, aStatus, mGpsBuffer.monHw.aPower, mGpsBuffer.monHw.agcCnt, mGpsBuffer.monHw.noisePerMs);
-        mLastNoiseLevel = mGpsBuffer.monHw.noisePerMs;
-        mLastGain = mGpsBuffer.monHw.agcCnt;
-        mLastJamInd = mGpsBuffer.monHw.jamInd;
-      } else {
-        switch (mGpsBuffer.monHwNew.aStatus) {
-          case mGpsBuffer.monHwNew.INIT: aStatus = "init"; break;
-          case mGpsBuffer.monHwNew.DONTKNOW: aStatus = "?"; break;
-          case mGpsBuffer.monHwNew.OK: aStatus = "ok"; break;
-          case mGpsBuffer.monHwNew.SHORT: aStatus = "short"; break;
-          case mGpsBuffer.monHwNew.OPEN: aStatus = "open"; break;
-          default: aStatus = "invalid";
-        }
-        log_d("MON-HW Antenna Status %d %s, Antenna Power %d, Gain (0-8191) %d, noise level %d", mGpsBuffer.monHwNew.aStatus, aStatus, mGpsBuffer.monHwNew.aPower, mGpsBuffer.monHwNew.agcCnt, mGpsBuffer.monHwNew.noisePerMs);
-        mLastNoiseLevel = mGpsBuffer.monHwNew.noisePerMs;
-        mLastGain = mGpsBuffer.monHwNew.agcCnt;
-        mLastJamInd = mGpsBuffer.monHwNew.jamInd;
-      }
-    }
-      break;
-    case (uint16_t) UBX_MSG::NAV_STATUS: {
-      log_v("NAV-STATUS uptime: %d, timeToFix: %d, gpsFix: %02x",
-            mGpsBuffer.navStatus.msss, mGpsBuffer.navStatus.ttff,
-            mGpsBuffer.navStatus.gpsFix);
-      mGpsUptime = mGpsBuffer.navStatus.msss;
-      if (mGpsBuffer.navStatus.ttff != 0) {
-        addStatisticsMessage("TimeToFix: " + String(mGpsBuffer.navStatus.ttff) + "ms");
-      } else if (!mAidIniSent and is_neo6()) {
-        mAidIniSent = true;
-        aidIni();
-      }
-    }
-      break;
-    case (uint16_t) UBX_MSG::NAV_DOP: {
-      log_v("DOP: iTOW: %u, gDop: %04d, pDop: %04d, tDop: %04d, "
-            "vDop: %04d, hDop: %04d, nDop: %04d, eDop: %04d",
-            mGpsBuffer.navDop.iTow, mGpsBuffer.navDop.gDop, mGpsBuffer.navDop.pDop,
-            mGpsBuffer.navDop.tDop, mGpsBuffer.navDop.vDop, mGpsBuffer.navDop.hDop,
-            mGpsBuffer.navDop.nDop, mGpsBuffer.navDop.eDop);
-      prepareGpsData(mGpsBuffer.navDop.iTow, mMessageStarted);
-      mIncomingGpsRecord.setHdop(mGpsBuffer.navDop.hDop);
-    }
-      break;
-    case (uint16_t) UBX_MSG::NAV_SOL: {
-      log_d("SOL: iTOW: %u, gpsFix: %d, flags: %02x, numSV: %d, pDop: %04d.",
-            mGpsBuffer.navSol.iTow, mGpsBuffer.navSol.gpsFix, mGpsBuffer.navSol.flags,
-            mGpsBuffer.navSol.numSv, mGpsBuffer.navSol.pDop);
-      if (mGpsBuffer.navSol.flags & 4) { // WKNSET
-        if (mLastGpsWeek != mGpsBuffer.navSol.week) {
-          // debugging #294
-          addStatisticsMessage(String("NAVSOL gps week changed: ")
-                               + mLastGpsWeek + " -> " + mGpsBuffer.navSol.week
-                               + " at " + TimeUtils::dateTimeToString());
-        }
-        mLastGpsWeek = mGpsBuffer.navSol.week;
-        mIncomingGpsRecord.setWeek(mLastGpsWeek);
-      }
-      prepareGpsData(mGpsBuffer.navDop.iTow, mMessageStarted);
-      mIncomingGpsRecord.setInfo(mGpsBuffer.navSol.numSv, mGpsBuffer.navSol.gpsFix, mGpsBuffer.navSol.flags);
-    }
-      break;
-    case (uint16_t) UBX_MSG::NAV_PVT: {
-      log_d("PVT: iTOW: %u, fixType: %d, flags: %02x, numSV: %d, pDop: %04d.",
-            mGpsBuffer.navPvt.iTow, mGpsBuffer.navPvt.fixType, mGpsBuffer.navPvt.flags,
-            mGpsBuffer.navPvt.numSV, mGpsBuffer.navPvt.pDOP);
-      prepareGpsData(mGpsBuffer.navPvt.iTow, mMessageStarted);
-      mIncomingGpsRecord.setInfo(mGpsBuffer.navPvt.numSV, mGpsBuffer.navPvt.fixType, mGpsBuffer.navPvt.flags);
+  mGpsBuffer.monVer.swVersion[sizeof(mGpsBuffer.monVer.swVersion) - 1] = 0;
+  mGpsBuffer.monVer.hwVersion[sizeof(mGpsBuffer.monVer.hwVersion) - 1] = 0;
+  mGpsBuffer.monVer.romVersion[sizeof(mGpsBuffer.monVer.romVersion) - 1] = 0;
+  mGpsBuffer.monVer.extension0[sizeof(mGpsBuffer.monVer.extension0) - 1] = 0;
+  mGpsBuffer.monVer.extension1[sizeof(mGpsBuffer.monVer.extension1) - 1] = 0;
+
+  addStatisticsMessage("swVersion: " + String(message.swVersion));
+  addStatisticsMessage("hwVersion: " + String(message.hwVersion));
+  if (mGpsPayloadLength > 40) {
+    addStatisticsMessage("romVersion: " + String(message.romVersion));
+  }
+  if (mGpsPayloadLength > 70) {
+    addStatisticsMessage("extension: " + String(message.extension0));
+  }
+  if (mGpsPayloadLength > 100) {
+    addStatisticsMessage("extension: " + String(message.extension1));
+  }
+  log_d("MON-VER SW Version: %s, HW Version %s, len %d",
+        String(message.swVersion).c_str(),
+        String(message.hwVersion).c_str(),
+        message.ubxHeader.length);
+  for (int i = 0; i < sizeof(hwString) && i < sizeof(message.hwVersion) ; i++) {
+    hwString[i]=message.hwVersion[i];
+  }
+}
+
+void Gps::handleUbxMonHw(const GpsBuffer &message) {
+  const char* aStatus;
+  if (is_neo6()) {
+    switch (message.monHw.aStatus) {
+      case message.monHw.INIT: aStatus = "init"; break;
+      case message.monHw.DONTKNOW: aStatus = "?"; break;
+      case message.monHw.OK: aStatus = "ok"; break;
+      case message.monHw.SHORT: aStatus = "short"; break;
+      case message.monHw.OPEN: aStatus = "open"; break;
+      default: aStatus = "invalid";
     }
-      break;
-    case (uint16_t) UBX_MSG::NAV_VELNED: {
-      log_d("VELNED: iTOW: %u, speed: %d cm/s, gSpeed: %d cm/s, heading: %d,"
-            " speedAcc: %d, cAcc: %d",
-            mGpsBuffer.navVelned.iTow, mGpsBuffer.navVelned.speed, mGpsBuffer.navVelned.gSpeed,
-            mGpsBuffer.navVelned.heading, mGpsBuffer.navVelned.sAcc, mGpsBuffer.navVelned.cAcc);
-      prepareGpsData(mGpsBuffer.navVelned.iTow, mMessageStarted);
-      mIncomingGpsRecord.setVelocity(mGpsBuffer.navVelned.gSpeed, mGpsBuffer.navVelned.heading);
+    log_d("MON-HW Antenna Status %d %s, Antenna Power %d, Gain (0-8191) %d, noise level %d", message.monHw.aStatus, aStatus, message.monHw.aPower, message.monHw.agcCnt, message.monHw.noisePerMs);
+    mLastNoiseLevel = message.monHw.noisePerMs;
+    mLastGain = message.monHw.agcCnt;
+    mLastJamInd = message.monHw.jamInd;
+  } else {
+    switch (message.monHwNew.aStatus) {
+      case message.monHwNew.INIT: aStatus = "init"; break;
+      case message.monHwNew.DONTKNOW: aStatus = "?"; break;
+      case message.monHwNew.OK: aStatus = "ok"; break;
+      case message.monHwNew.SHORT: aStatus = "short"; break;
+      case message.monHwNew.OPEN: aStatus = "open"; break;
+      default: aStatus = "invalid";
     }
-      break;
-    case (uint16_t) UBX_MSG::NAV_POSLLH: {
-      log_d("POSLLH: iTOW: %u lon: %d lat: %d height: %d hMsl %d, hAcc %d, vAcc %d delay %dms",
-            mGpsBuffer.navPosllh.iTow, mGpsBuffer.navPosllh.lon, mGpsBuffer.navPosllh.lat,
-            mGpsBuffer.navPosllh.height, mGpsBuffer.navPosllh.hMsl, mGpsBuffer.navPosllh.hAcc,
-            mGpsBuffer.navPosllh.vAcc, delayMs);
-      prepareGpsData(mGpsBuffer.navPosllh.iTow, mMessageStarted);
-      mIncomingGpsRecord.setPosition(mGpsBuffer.navPosllh.lon, mGpsBuffer.navPosllh.lat, mGpsBuffer.navPosllh.hMsl);
+    log_d("MON-HW Antenna Status %d %s, Antenna Power %d, Gain (0-8191) %d, noise level %d", message.monHwNew.aStatus, aStatus, message.monHwNew.aPower, message.monHwNew.agcCnt, message.monHwNew.noisePerMs);
+    mLastNoiseLevel = message.monHwNew.noisePerMs;
+    mLastGain = message.monHwNew.agcCnt;
+    mLastJamInd = message.monHwNew.jamInd;
+  }
+}
+
+void Gps::handleUbxNavStatus(const GpsBuffer::NavStatus &message) {
+  log_v("NAV-STATUS uptime: %d, timeToFix: %d, gpsFix: %02x",
+        message.msss, message.ttff, message.gpsFix);
+  mGpsUptime = message.msss;
+  if (message.ttff != 0) {
+    addStatisticsMessage("TimeToFix: " + String(message.ttff) + "ms");
+  } else if (!mAidIniSent and is_neo6()) {
+    mAidIniSent = true;
+    aidIni();
+  }
+}
+
+void Gps::handleUbxNavDop(const GpsBuffer::NavDop &message) {
+  log_v("DOP: iTOW: %u, gDop: %04d, pDop: %04d, tDop: %04d, "
+        "vDop: %04d, hDop: %04d, nDop: %04d, eDop: %04d",
+        message.iTow, message.gDop, message.pDop,
+        message.tDop, message.vDop, message.hDop,
+        message.nDop, message.eDop);
+  GpsRecord &record = prepareGpsData(message.iTow, mMessageStarted);
+  record.setHdop(message.hDop);
+}
+
+void Gps::handleUbxNavSol(const GpsBuffer::NavSol &message) {
+  log_d("SOL: iTOW: %u, gpsFix: %d, flags: %02x, numSV: %d, pDop: %04d.",
+        message.iTow, message.gpsFix, message.flags,
+        message.numSv, message.pDop);
+  if (message.flags & 4) { // WKNSET
+    if (mLastGpsWeek != message.week) {
+      // debugging #294
+      addStatisticsMessage(String("NAVSOL gps week changed: ")
+                           + mLastGpsWeek + " -> " + message.week
+                           + " at " + TimeUtils::dateTimeToString());
     }
-      break;
-    case (uint16_t) UBX_MSG::NAV_TIMEGPS:
-      handleUbxNavTimeGps(mGpsBuffer.navTimeGps, receivedMs, delayMs);
-      break;
-    case (uint16_t) UBX_MSG::NAV_TIMEUTC: {
-      prepareGpsData(mGpsBuffer.navTimeUtc.iTow, mMessageStarted);
-      log_d("TIMEUTC: iTOW: %u acc: %uns nano: %d %04u-%02u-%02uT%02u:%02u:%02u valid 0x%02x delay %dms",
-            mGpsBuffer.navTimeUtc.iTow, mGpsBuffer.navTimeUtc.tAcc, mGpsBuffer.navTimeUtc.nano,
-            mGpsBuffer.navTimeUtc.year, mGpsBuffer.navTimeUtc.month, mGpsBuffer.navTimeUtc.day,
-            mGpsBuffer.navTimeUtc.hour, mGpsBuffer.navTimeUtc.minute, mGpsBuffer.navTimeUtc.sec,
-            mGpsBuffer.navTimeUtc.valid, delayMs);
+    mLastGpsWeek = message.week;
+    mIncomingGpsRecord.setWeek(mLastGpsWeek);
+  }
+  GpsRecord &record = prepareGpsData(message.iTow, mMessageStarted);
+  record.setInfo(message.numSv, message.gpsFix, message.flags);
+  // WKNSET and TOWSET
+  record.setTimeValid((message.flags & 0x0C) == 0x0C);
+}
+
+void Gps::handleUbxNavPvt(const GpsBuffer::NavPvt &message) {
+  log_d("PVT: iTOW: %u, fixType: %d, flags: %02x, numSV: %d, pDop: %04d.",
+        message.iTow, message.fixType, message.flags,
+        message.numSV, message.pDOP);
+  GpsRecord &record = prepareGpsData(message.iTow, mMessageStarted);
+  record.setInfo(message.numSV, message.fixType, message.flags);
+  record.setPosition(message.lon, message.lat, message.hMSL);
+  record.setHorizontalAccuracy(message.hAcc);
+  // gSpeed is mm/s, VELNED reports cm/s
+  record.setVelocity(message.gSpeed / 10, message.headMot);
+  // there is no HDOP in NAV-PVT, the PDOP is never smaller, the CSV
+  // format documents that HDOP holds the PDOP for the M10
+  record.setHdop(message.pDOP);
+  // validTime and fullyResolved
+  record.setTimeValid((message.valid & 0x06) == 0x06);
+}
+
+void Gps::handleUbxNavVelned(const GpsBuffer::NavVelned &message) {
+  log_d("VELNED: iTOW: %u, speed: %d cm/s, gSpeed: %d cm/s, heading: %d,"
+        " speedAcc: %d, cAcc: %d",
+        message.iTow, message.speed, message.gSpeed,
+        message.heading, message.sAcc, message.cAcc);
+  GpsRecord &record = prepareGpsData(message.iTow, mMessageStarted);
+  record.setVelocity(message.gSpeed, message.heading);
+}
+
+void Gps::handleUbxNavPosllh(const GpsBuffer::NavPosllh &message) {
+  log_d("POSLLH: iTOW: %u lon: %d lat: %d height: %d hMsl %d, hAcc %d, vAcc %d delay %dms",
+        message.iTow, message.lon, message.lat,
+        message.height, message.hMsl, message.hAcc,
+        message.vAcc, mMessageReceived - mMessageStarted);
+  GpsRecord &record = prepareGpsData(message.iTow, mMessageStarted);
+  record.setPosition(message.lon, message.lat, message.hMsl);
+  record.setHorizontalAccuracy(message.hAcc);
+}
+
+void Gps::handleUbxNavTimeUtc(const GpsBuffer::NavTimeUtc &message) {
+  prepareGpsData(message.iTow, mMessageStarted);
+  log_d("TIMEUTC: iTOW: %u acc: %uns nano: %d %04u-%02u-%02uT%02u:%02u:%02u valid 0x%02x delay %dms",
+        message.iTow, message.tAcc, message.nano,
+        message.year, message.month, message.day,
+        message.hour, message.minute, message.sec,
+        message.valid, mMessageReceived - mMessageStarted);
+}
+
+void Gps::handleUbxNavSbas(const GpsBuffer::NavSbas &message) {
+  prepareGpsData(message.iTow, mMessageStarted);
+  log_d("SBAS: iTOW: %u geo: %u, mode: %u, sys: %u, service: %02x, cnt: %d",
+        message.iTow, message.geo, message.mode,
+        message.sys, message.service, message.cnt);
+  addStatisticsMessage(String("SBAS: mode: ")
+                       + String((int16_t) message.mode)
+                       + " System: " + String((int16_t) message.sys)
+                       + " cnt: " + String((int16_t) message.cnt));
+}
+
+/* Answers the data request in place, the message is sent back. */
+void Gps::handleUbxAidAlpsrv(const GpsBuffer::AidAlpsrvClientReq &message) {
+  uint16_t startOffset = message.idSize + 6;
+  if (message.type != 0xFF) {
+    log_d("AID-ALPSRV-REQ Got data request %d for type %d, offset %d, size %d",
+          message.idSize, message.type, message.ofs, message.size);
+
+    mGpsBuffer.aidAlpsrvClientReq.fileId = 2;
+    uint16_t length = (uint16_t) MAX_MESSAGE_LENGTH - startOffset;
+    if (length > 2 * message.size) {
+      length = 2 * message.size;
     }
-      break;
-    case (uint16_t) UBX_MSG::NAV_SBAS: {
-      prepareGpsData(mGpsBuffer.navSbas.iTow, mMessageStarted);
-      log_d("SBAS: iTOW: %u geo: %u, mode: %u, sys: %u, service: %02x, cnt: %d",
-            mGpsBuffer.navSbas.iTow, mGpsBuffer.navSbas.geo, mGpsBuffer.navSbas.mode,
-            mGpsBuffer.navSbas.sys, mGpsBuffer.navSbas.service, mGpsBuffer.navSbas.cnt);
-      addStatisticsMessage(String("SBAS: mode: ")
-                           + String((int16_t) mGpsBuffer.navSbas.mode)
-                           + " System: " + String((int16_t) mGpsBuffer.navSbas.sys)
-                           + " cnt: " + String((int16_t) mGpsBuffer.navSbas.cnt));
+    mGpsBuffer.aidAlpsrvClientReq.dataSize =
+      mAlpData.fill(&mGpsBuffer.u1Data[startOffset], 2u * message.ofs, length);
+    const uint16_t dataSize = mGpsBuffer.aidAlpsrvClientReq.dataSize;
+    if (dataSize > 0) {
+      mGpsBuffer.ubxHeader.length = dataSize + message.idSize;
+      sendUbxDirect();
+      mAlpBytesSent += dataSize;
+      log_d("Did send %d bytes Pos: 0x%x", mGpsBuffer.ubxHeader.length, 2 * message.ofs);
     }
-      break;
-    case (uint16_t) UBX_MSG::AID_INI:
-      handleUbxAidIni(mGpsBuffer.aidIni);
-      break;
-    case (uint16_t) UBX_MSG::AID_HUI:
-      handleUbxAidHui(mGpsBuffer.aidHui);
-      break;
-    case (uint16_t) UBX_MSG::AID_ALPSRV: {
-      uint16_t startOffset
-        = mGpsBuffer.aidAlpsrvClientReq.idSize + 6;
-      if (mGpsBuffer.aidAlpsrvClientReq.type != 0xFF) {
-        log_d("AID-ALPSRV-REQ Got data request %d for type %d, offset %d, size %d",
-              mGpsBuffer.aidAlpsrvClientReq.idSize,
-              mGpsBuffer.aidAlpsrvClientReq.type,
-              mGpsBuffer.aidAlpsrvClientReq.ofs,
-              mGpsBuffer.aidAlpsrvClientReq.size);
-
-        mGpsBuffer.aidAlpsrvClientReq.fileId = 2;
-        uint16_t length = (uint16_t) MAX_MESSAGE_LENGTH - startOffset;
-        if (length > 2 * mGpsBuffer.aidAlpsrvClientReq.size) {
-          length = 2 * mGpsBuffer.aidAlpsrvClientReq.size;
-        }
-        mGpsBuffer.aidAlpsrvClientReq.dataSize =
-          mAlpData.fill(&mGpsBuffer.u1Data[startOffset],
-                        2u * mGpsBuffer.aidAlpsrvClientReq.ofs,
-                        length);
-        if (mGpsBuffer.aidAlpsrvClientReq.dataSize > 0) {
-          mGpsBuffer.ubxHeader.length
-            = mGpsBuffer.aidAlpsrvClientReq.dataSize + mGpsBuffer.aidAlpsrvClientReq.idSize;
-          sendUbxDirect();
-          mAlpBytesSent += mGpsBuffer.aidAlpsrvClientReq.dataSize;
-          log_d("Did send %d bytes Pos: 0x%x",
-                mGpsBuffer.ubxHeader.length,
-                2 * mGpsBuffer.aidAlpsrvClientReq.ofs);
-        }
 #ifdef RANDOM_ACCESS_FILE_AVAILAVLE
-        } else {
-          log_e("AID-ALPSRV-REQ Got store data request %d for type %d, offset %d, size %d, file %d",
-                mGpsBuffer.aidAlpsrvClientReq.idSize,
-                mGpsBuffer.aidAlpsrvClientReq.type,
-                mGpsBuffer.aidAlpsrvClientReq.ofs,
-                mGpsBuffer.aidAlpsrvClientReq.size,
-                mGpsBuffer.aidAlpsrvClientReq.fileId);
-          // Check boundaries!
-          mAlpData.save(&mGpsBuffer.u1Data[startOffset],
-                        2 * mGpsBuffer.aidAlpsrvClientReq.ofs,
-                        2 * mGpsBuffer.aidAlpsrvClientReq.size);
-          log_e("save %d bytes took %d ms", 2 * mGpsBuffer.aidAlpsrvClientReq.size, millis() - start);
+  } else {
+    log_e("AID-ALPSRV-REQ Got store data request %d for type %d, offset %d, size %d, file %d",
+          message.idSize, message.type, message.ofs, message.size, message.fileId);
+    // Check boundaries!
+    mAlpData.save(&mGpsBuffer.u1Data[startOffset], 2 * message.ofs, 2 * message.size);
+    log_e("save %d bytes took %d ms", 2 * message.size, millis() - start);
 #endif
-      }
-    }
-      break;
-    case (uint16_t) UBX_MSG::AID_ALP: {
-      log_d("AID-ALP status data age %d duration %d valid from %s to %s",
-            mGpsBuffer.aidAlpStatus.age,
-            mGpsBuffer.aidAlpStatus.predDur,
-            TimeUtils::dateTimeToString(
-              TimeUtils::toTime(mGpsBuffer.aidAlpStatus.predWno, mGpsBuffer.aidAlpStatus.predTow)).c_str(),
-            TimeUtils::dateTimeToString(
-              TimeUtils::toTime(mGpsBuffer.aidAlpStatus.predWno,
-                     mGpsBuffer.aidAlpStatus.predDur + mGpsBuffer.aidAlpStatus.predTow)).c_str());
-      if (mGpsBuffer.aidAlpStatus.predWno != 0) {
-        addStatisticsMessage(String("ALP Data valid from: ") +
-                               TimeUtils::dateTimeToString(
-                                 TimeUtils::toTime(mGpsBuffer.aidAlpStatus.predWno, mGpsBuffer.aidAlpStatus.predTow)));
-        addStatisticsMessage(String("ALP Data valid to: ") +
-                               TimeUtils::dateTimeToString(
-                               TimeUtils::toTime(mGpsBuffer.aidAlpStatus.predWno,
-                                      mGpsBuffer.aidAlpStatus.predDur + mGpsBuffer.aidAlpStatus.predTow)).c_str());
-      }
-    }
-      break;
-    case (uint16_t) UBX_MSG::INF_ERROR:
-    case (uint16_t) UBX_MSG::INF_WARNING:
-    case (uint16_t) UBX_MSG::INF_NOTICE:
-    case (uint16_t) UBX_MSG::INF_TEST:
-    case (uint16_t) UBX_MSG::INF_DEBUG: {
-      mGpsBuffer.u1Data[mGpsBufferBytePos - 2] = 0;
-      log_d("INF %d message: %s",
-            mGpsBuffer.ubxHeader.ubxMsgId, String(mGpsBuffer.inf.message).c_str());
-      addStatisticsMessage(
-        INF_SEVERITY_STRING[mGpsBuffer.u1Data[3]] + ": " + String(mGpsBuffer.inf.message));
-    }
-      break;
-    case (uint16_t) UBX_MSG::CFG_SBAS:
-      log_d("CFG_SBAS");
-      break;
-    case (uint16_t) UBX_MSG::CFG_NAV5:
-      log_d("CFG_NAV5");
-      break;
-    case (uint16_t) UBX_MSG::CFG_GNSS:
-      log_d("CFG_GNSS");
-      break;
-    default:
-      log_e("Got unparsed UBX_MESSAGE! Id: 0x%04x Len %d iTOW %d", mGpsBuffer.ubxHeader.ubxMsgId,
-            mGpsBuffer.ubxHeader.length, mGpsBuffer.navStatus.iTow);
   }
 }
 
-void Gps::handleUbxNavTimeGps(const GpsBuffer::UbxNavTimeGps &message, const uint32_t receivedMs, const uint32_t delayMs) {
+void Gps::handleUbxAidAlp(const GpsBuffer::AidAlpStatus &message) {
+  log_d("AID-ALP status data age %d duration %d valid from %s to %s",
+        message.age,
+        message.predDur,
+        TimeUtils::dateTimeToString(
+          TimeUtils::toTime(message.predWno, message.predTow)).c_str(),
+        TimeUtils::dateTimeToString(
+          TimeUtils::toTime(message.predWno,
+                 message.predDur + message.predTow)).c_str());
+  if (message.predWno != 0) {
+    addStatisticsMessage(String("ALP Data valid from: ") +
+                           TimeUtils::dateTimeToString(
+                             TimeUtils::toTime(message.predWno, message.predTow)));
+    addStatisticsMessage(String("ALP Data valid to: ") +
+                           TimeUtils::dateTimeToString(
+                           TimeUtils::toTime(message.predWno,
+                                  message.predDur + message.predTow)).c_str());
+  }
+}
+
+void Gps::handleUbxInf(const GpsBuffer::Inf &message) {
+  mGpsBuffer.u1Data[mGpsBufferBytePos - 2] = 0;
+  log_d("INF %d message: %s", message.ubxHeader.ubxMsgId, String(message.message).c_str());
+  addStatisticsMessage(
+    INF_SEVERITY_STRING[mGpsBuffer.u1Data[3]] + ": " + String(message.message));
+}
+
+void Gps::handleUbxNavTimeGps(const GpsBuffer::UbxNavTimeGps &message) {
+  const uint32_t receivedMs = mMessageReceived;
+  const uint32_t delayMs = receivedMs - mMessageStarted;
   prepareGpsData(message.iTow, mMessageStarted);
   log_i("TIMEGPS: iTOW: %u, fTOW: %d, week %d, leapS: %d, valid: 0x%02x (%s%s%s), tAcc %uns, DATE: %s, delay %dms",
         message.iTow, message.fTow, message.week, message.leapS, message.valid,
@@ -1443,10 +1597,10 @@ void Gps::handleUbxNavTimeGps(const GpsBuffer::UbxNavTimeGps &message, const uin
       }
       // This triggers another NAV-TIMEGPS message! more often until good time is received
 #ifdef UBX_M6
-      setMessageInterval(UBX_MSG::NAV_TIMEGPS, (delayMs>100) ? 5 : 240, false); // every 4 minutes
+      setMessageInterval(UBX_MSG::NAV_TIMEGPS, solutions((delayMs>100) ? 5 : 240), false); // every 4 minutes
 #endif
 #ifdef UBX_M10
-      setMessageInterval(UBX_CFG_KEY_ID::CFG_MSGOUT_UBX_NAV_TIMEGPS_UART1, 240, false); // every 4 minutes
+      setMessageInterval(UBX_CFG_KEY_ID::CFG_MSGOUT_UBX_NAV_TIMEGPS_UART1, solutions(240), false); // every 4 minutes
 #endif
     } else {
       mLastTimeTimeSet = receivedMs;
@@ -1454,7 +1608,7 @@ void Gps::handleUbxNavTimeGps(const GpsBuffer::UbxNavTimeGps &message, const uin
   }
 }
 
-void Gps::handleUbxAidIni(const GpsBuffer::AidIni &message) const {
+void Gps::handleUbxAidIni(const GpsBuffer::AidIni &message) {
   log_d("AidIni received Status: 0x%04x, Location valid: %d.", message.flags,
         (message.flags & GpsBuffer::AidIni::POS));
   if ((message.flags & GpsBuffer::AidIni::POS)
@@ -1464,7 +1618,7 @@ void Gps::handleUbxAidIni(const GpsBuffer::AidIni &message) const {
   }
 }
 
-void Gps::handleUbxAidHui(const GpsBuffer::AidHui &massage) const {
+void Gps::handleUbxAidHui(const GpsBuffer::AidHui &massage) {
   if ((uint32_t) massage.flags & (uint32_t) GpsBuffer::AidHui::Flags::utc) {
     log_i("AID_HUI received Flags: %04x, Current Leap Seconds %d"
           " Event: %s, Leap Seconds after Event: %d",
@@ -1536,16 +1690,31 @@ uint32_t Gps::getBaudRate() {
 }
 
 void Gps::resetMessages() {
+  lockMessages();
   mMessages.clear();
+  unlockMessages();
 }
 
 /* Prepare the GPS data record for incoming data for the given tow. */
-void Gps::prepareGpsData(uint32_t tow, uint32_t messageStartedMillisTicks) {
+GpsRecord &Gps::prepareGpsData(uint32_t tow, uint32_t messageStartedMillisTicks) {
+  if (mEpochGpsRecord.mCollectTow != 0 && mEpochGpsRecord.mCollectTow != tow) {
+    addEpoch(mEpochGpsRecord);
+    mEpochGpsRecord.reset(0, 0, 0);
+  }
+  if (mNavigationRateHz > 1 && tow > mIncomingGpsRecord.mCollectTow
+      && tow / 1000 == mIncomingGpsRecord.mCollectTow / 1000) {
+    // an epoch between the whole seconds, only its position is kept
+    if (mEpochGpsRecord.mCollectTow != tow) {
+      mEpochGpsRecord.reset(tow, mLastGpsWeek, messageStartedMillisTicks);
+    }
+    return mEpochGpsRecord;
+  }
   if (mIncomingGpsRecord.mCollectTow == tow) {
     // fine already prepared
   } else if (mIncomingGpsRecord.mCollectTow == 0) {
     // new tow
     mIncomingGpsRecord.reset(tow, mLastGpsWeek, messageStartedMillisTicks);
+    mIncomingGpsEpochs.reset(tow);
   } else {
     if (mIncomingGpsRecord.mCollectTow > tow) {
       log_e("TOW getting smaller -  published: %d, received: %d",
@@ -1561,26 +1730,67 @@ void Gps::prepareGpsData(uint32_t tow, uint32_t messageStartedMillisTicks) {
             mIncomingGpsRecord.mVelocitySet,
             mIncomingGpsRecord.mCreatedAtMillisTicks);
     }
+    addEpoch(mIncomingGpsRecord);
     mCurrentGpsRecord = mIncomingGpsRecord;
+    mCurrentGpsEpochs = mIncomingGpsEpochs;
     mIncomingGpsRecord.reset(tow, mLastGpsWeek, messageStartedMillisTicks);
+    mIncomingGpsEpochs.reset(tow);
   }
+  return mIncomingGpsRecord;
+}
+
+void Gps::addEpoch(const GpsRecord &record) {
+  const uint32_t offset = record.mCollectTow - mIncomingGpsEpochs.mTow;
+  if (record.mPositionSet && record.hasValidFix()
+      && record.mCollectTow >= mIncomingGpsEpochs.mTow && offset < 1000) {
+    mIncomingGpsEpochs.add(offset, record.mLatitude, record.mLongitude,
+                           record.mSpeed, record.mCourseOverGround);
+  }
+}
+
+void Gps::publish() {
+  const uint32_t sequence = mSnapshotSequence.load(std::memory_order_relaxed) + 1;
+  // the buffer is written after the previous sequence is visible
+  std::atomic_thread_fence(std::memory_order_release);
+  GpsSnapshot &target = mSnapshots[sequence & 1];
+  target.current = mCurrentGpsRecord;
+  target.incoming = mIncomingGpsRecord;
+  target.epochs = mCurrentGpsEpochs;
+  mSnapshotSequence.store(sequence, std::memory_order_release);
+}
+
+Gps::GpsSnapshot Gps::snapshot() const {
+  GpsSnapshot result;
+  uint32_t sequence;
+  do {
+    sequence = mSnapshotSequence.load(std::memory_order_acquire);
+    result = mSnapshots[sequence & 1];
+    std::atomic_thread_fence(std::memory_order_acquire);
+    // the buffer is only written again after the next publish()
+  } while (sequence != mSnapshotSequence.load(std::memory_order_relaxed));
+  return result;
 }
 
 GpsRecord Gps::getIncomingGpsRecord() const {
-  return mIncomingGpsRecord;
+  return snapshot(&GpsSnapshot::incoming);
 }
 
 bool Gps::currentTowEquals(uint32_t tow) const {
-  return mIncomingGpsRecord.mCollectTow == tow;
+  return snapshot(&GpsSnapshot::incoming).mCollectTow == tow;
 };
 
 bool Gps::hasTowTicks() const {
-  return mIncomingGpsRecord.mCollectTow != 0
-    || mIncomingGpsRecord.mCollectTow != mCurrentGpsRecord.mCollectTow;
+  const GpsSnapshot records = snapshot();
+  return records.incoming.mCollectTow != 0
+    || records.incoming.mCollectTow != records.current.mCollectTow;
 };
 
 GpsRecord Gps::getCurrentGpsRecord() const {
-  return mCurrentGpsRecord;
+  return snapshot(&GpsSnapshot::current);
+}
+
+GpsEpochs Gps::getCurrentGpsEpochs() const {
+  return snapshot(&GpsSnapshot::epochs);
 }
 
 uint32_t Gps::getNumberOfAlpBytesSent() const {
@@ -1590,3 +1800,28 @@ uint32_t Gps::getNumberOfAlpBytesSent() const {
 uint32_t Gps::getUnexpectedCharReceivedCount() const {
   return mUnexpectedCharReceivedCount;
 }
+
+void Gps::countParseLatency(uint32_t milliseconds) {
+  if (milliseconds > mMaxParseLatencyMs) {
+    mMaxParseLatencyMs = milliseconds;
+  }
+  mParseLatencySumMs += milliseconds;
+  mParseLatencyCount++;
+}
+
+uint32_t Gps::getDroppedBytes() const {
+  return mDroppedBytes;
+}
+
+uint32_t Gps::getRxOverflowCount() const {
+  return mRxOverflows;
+}
+
+uint32_t Gps::getMaxParseLatencyMillis() const {
+  return mMaxParseLatencyMs;
+}
+
+uint32_t Gps::getAverageParseLatencyMillis() const {
+  const uint32_t count = mParseLatencyCount;
+  return count ? mParseLatencySumMs / count : 0;
+}
@@ -26,9 +26,11 @@
 
 #include <Arduino.h>
 #include <HardwareSerial.h>
+#include <atomic>
 #include "utils/alpdata.h"
 #include "config.h" // PrivacyArea
 #include "displays.h"
+#include "gpsepochs.h"
 #include "gpsrecord.h"
 #include "variant.h"
 
@@ -36,9 +38,19 @@
 // If set, also disable serial logging (DCORE_DEBUG_LEVEL=0 in platformio.ini)
 //#define GPS_TRANSPARENT_UART
 
+/* Receive buffer of the GPS UART, the reader task empties it but this
+ * covers the time the task is not scheduled.
+ */
+#ifndef GPS_RX_BUFFER_SIZE
+#define GPS_RX_BUFFER_SIZE 4096
+#endif
+
 class DisplayDevice;
 
 class Gps {
+  // host tests, see test/stubs/hostgps.h
+  friend class GpsTest;
+
   public:
     enum class WaitFor {
         FIX_NO_WAIT = 0,
@@ -49,7 +61,10 @@ class Gps {
     /* init all gps stuff, incl port and config. */
     void begin();
 
-    /* read and process data from serial, true if there was valid data. */
+    /* read and process data from serial, true if there was valid data.
+     * Once begin() started the reader task this only reports if messages
+     * were received since the last call.
+     */
     bool handle();
 
     bool hasFix(DisplayDevice *display) const;
@@ -101,6 +116,10 @@ class Gps {
     void enableSbas();
 
     GpsRecord getCurrentGpsRecord() const;
+    /* Positions of the epochs within the second of the current record,
+     * check getTow() against the record, they are read separately.
+     */
+    GpsEpochs getCurrentGpsEpochs() const;
     GpsRecord getIncomingGpsRecord() const;
     bool currentTowEquals(uint32_t tow) const;
     bool hasTowTicks() const;
@@ -110,6 +129,15 @@ class Gps {
 
     uint32_t getNumberOfAlpBytesSent() const;
     uint32_t getUnexpectedCharReceivedCount() const;
+    /* Bytes thrown away unread because they were outdated. */
+    uint32_t getDroppedBytes() const;
+    /* Number of times the UART receive buffer overflowed. */
+    uint32_t getRxOverflowCount() const;
+    /* Time from the first byte of a message burst till a message of it
+     * was parsed.
+     */
+    uint32_t getMaxParseLatencyMillis() const;
+    uint32_t getAverageParseLatencyMillis() const;
 
     void coldStartGps();
 
@@ -170,6 +198,7 @@ class Gps {
         CFG_VALSET = 0x8a06,  // Only available in M10
         CFG_RST = 0x0406,
         CFG_TP = 0x0706,
+        CFG_RATE = 0x0806,  // Only available in M6, replaced with CFG-RATE-*
         CFG_TP5 = 0x3106,
 
         CFG_CFG = 0x0906,
@@ -217,6 +246,8 @@ class Gps {
       CFG_MSGOUT_UBX_NAV_VELNED_UART1 = 0x20910043,  // Type: U1, Output rate of the UBX-NAV-VELNED message on port UART1
       CFG_MSGOUT_UBX_NAV_PVT_UART1 = 0x20910007,  // Type: U1, Output rate of the UBX-NAV-PVT message on port UART1
       CFG_SIGNAL_GLO_ENA = 0x10310025,  // Type: L, GLONASS enable
+      CFG_RATE_MEAS = 0x30210001,  // Type: U2, Nominal time between GNSS measurements in ms
+      CFG_RATE_TIMEREF = 0x20210003,  // Type: E1, Time system to which measurements are aligned, 1=GPS
       CFG_NAVSPG_DYNMODEL = 0x20110021,  // Type: E1, Dynamic platform model, 0=portable, 2=stationary, 3=pedestrian, 4=automotive, 5=sea, 6..8=airborne, ...
     };
 #endif
@@ -235,11 +266,11 @@ class Gps {
         uint16_t ubxMsgId;
         uint16_t length;
       } ubxHeader;
-      struct __attribute__((__packed__)) {
+      struct __attribute__((__packed__)) Ack {
         UBX_HEADER ubxHeader;
         uint16_t ubxMsgId;
       } ack;
-      struct __attribute__((__packed__)) {
+      struct __attribute__((__packed__)) CfgPrt {
         UBX_HEADER ubxHeader;
         uint8_t portId;
         uint8_t reserved0;
@@ -278,12 +309,12 @@ class Gps {
         uint32_t reserved3;
         uint32_t reserved4;
       } cfgNavx5;
-      struct __attribute__((__packed__)) {
+      struct __attribute__((__packed__)) CfgRinv {
         UBX_HEADER ubxHeader;
         uint8_t flags;
         char data[30];
       } cfgRinv;
-      struct __attribute__((__packed__)) {
+      struct __attribute__((__packed__)) MonVer {
         UBX_HEADER ubxHeader;
         char swVersion[30];
         char hwVersion[10];
@@ -291,7 +322,7 @@ class Gps {
         char extension0[30]; // could be multiple...
         char extension1[30]; // could be multiple...
       } monVer;
-      struct __attribute__((__packed__)) {
+      struct __attribute__((__packed__)) MonHwNew {
         UBX_HEADER ubxHeader;
         uint32_t pinSel;
         uint32_t pinBank;
@@ -321,7 +352,7 @@ class Gps {
         uint32_t pullH;
         uint32_t pullL;
       } monHwNew;
-      struct __attribute__((__packed__)) {
+      struct __attribute__((__packed__)) MonHw {
         UBX_HEADER ubxHeader;
         uint32_t pinSel;
         uint32_t pinBank;
@@ -351,7 +382,7 @@ class Gps {
         uint32_t pullH;
         uint32_t pullL;
       } monHw;
-      struct __attribute__((__packed__)) {
+      struct __attribute__((__packed__)) NavPosllh {
         UBX_HEADER ubxHeader;
         uint32_t iTow;
         int32_t lon;
@@ -361,7 +392,7 @@ class Gps {
         uint32_t hAcc;
         uint32_t vAcc;
       } navPosllh;
-      struct __attribute__((__packed__)) {
+      struct __attribute__((__packed__)) NavStatus {
         UBX_HEADER ubxHeader;
         uint32_t iTow;
         GpsRecord::GPS_FIX gpsFix;
@@ -371,7 +402,7 @@ class Gps {
         uint32_t ttff; // Time to first fix (millisecond time tag)
         uint32_t msss; // Milliseconds since Startup / Reset
       } navStatus;
-      struct __attribute__((__packed__)) {
+      struct __attribute__((__packed__)) NavDop {
         UBX_HEADER ubxHeader;
         uint32_t iTow;
         uint16_t gDop;
@@ -382,7 +413,7 @@ class Gps {
         uint16_t nDop;
         uint16_t eDop;
       } navDop;
-      struct __attribute__((__packed__)) {
+      struct __attribute__((__packed__)) NavSol {
         UBX_HEADER ubxHeader;
         uint32_t iTow;
         int32_t fTow;
@@ -402,7 +433,7 @@ class Gps {
         uint8_t numSv;
         uint32_t reserved2;
       } navSol;
-      struct __attribute__((__packed__)) {
+      struct __attribute__((__packed__)) NavPvt {
         UBX_HEADER ubxHeader;
         uint32_t iTow;
         uint16_t year;
@@ -438,7 +469,7 @@ class Gps {
         int16_t magDec;
         uint16_t magAcc;
       } navPvt;
-      struct __attribute__((__packed__)) {
+      struct __attribute__((__packed__)) NavVelned {
         UBX_HEADER ubxHeader;
         uint32_t iTow;
         int32_t velN;
@@ -459,7 +490,7 @@ class Gps {
         uint8_t valid; // 1 == tow; 2 = week; 4 = UTC
         uint32_t tAcc;
       } navTimeGps;
-      struct __attribute__((__packed__)) {
+      struct __attribute__((__packed__)) NavTimeUtc {
         UBX_HEADER ubxHeader;
         uint32_t iTow;
         uint32_t tAcc;
@@ -472,7 +503,7 @@ class Gps {
         uint8_t sec;
         uint8_t valid; // 1 == validTOW // 2 == validWKN // 4 == validUTC
       } navTimeUtc;
-      struct __attribute__((__packed__)) {
+      struct __attribute__((__packed__)) NavSbas {
         UBX_HEADER ubxHeader;
         uint32_t iTow;
         uint8_t geo;
@@ -545,7 +576,7 @@ class Gps {
           klob = 1 << 2,
         } flags;
       } aidHui;
-      struct __attribute__((__packed__)) {
+      struct __attribute__((__packed__)) AidAlpsrvClientReq {
         UBX_HEADER ubxHeader;
         uint8_t idSize;
         uint8_t type;
@@ -557,7 +588,7 @@ class Gps {
         uint8_t id2;
         uint32_t id3;
       } aidAlpsrvClientReq;
-      struct __attribute__((__packed__)) {
+      struct __attribute__((__packed__)) AidAlpStatus {
         UBX_HEADER ubxHeader;
         uint32_t predTow;
         uint32_t predDur;
@@ -569,7 +600,7 @@ class Gps {
         uint8_t reserved2;
         uint16_t reserved3;
       } aidAlpStatus;
-      struct __attribute__((__packed__)) {
+      struct __attribute__((__packed__)) Inf {
         UBX_HEADER ubxHeader;
         char message[MAX_MESSAGE_LENGTH - 6];
       } inf;
@@ -577,16 +608,18 @@ class Gps {
     GpsBuffer mGpsBuffer;
     GpsReceiverState mReceiverState = GPS_NULL;
     uint32_t mMessageStarted = 0;
+    /* When the UBX message being handled was complete. */
+    uint32_t mMessageReceived = 0;
     uint32_t mGpsUptime = 0;
     uint8_t mUbxChA = 0;
     uint8_t mUbxChB = 0;
     std::vector<String> mMessages;
-    bool mAckReceived = false;
-    bool mNakReceived = false;
+    volatile bool mAckReceived = false;
+    volatile bool mNakReceived = false;
     /* MsgId of the last received ack or nak message. */
-    uint16_t mLastAckMsgId;
+    volatile uint16_t mLastAckMsgId;
     uint32_t mGpsPayloadLength;
-    uint16_t mValidMessagesReceived = 0;
+    volatile uint16_t mValidMessagesReceived = 0;
     uint16_t mMessagesWithFailedCrcReceived = 0;
     uint32_t mUnexpectedCharReceivedCount = 0;
     uint8_t mNmeaChk;
@@ -599,9 +632,36 @@ class Gps {
     GpsRecord mCurrentGpsRecord;
     /* record that is currently filled with data. */
     GpsRecord mIncomingGpsRecord;
+    /* Epoch between the whole seconds that is currently filled with data,
+     * only used above 1 Hz.
+     */
+    GpsRecord mEpochGpsRecord;
+    /* Epochs of the second of mIncomingGpsRecord and mCurrentGpsRecord. */
+    GpsEpochs mIncomingGpsEpochs;
+    GpsEpochs mCurrentGpsEpochs;
+    /* Copy of both records for other tasks, see publish(). */
+    struct GpsSnapshot {
+      GpsRecord current;
+      GpsRecord incoming;
+      GpsEpochs epochs;
+    };
+    GpsSnapshot mSnapshots[2];
+    std::atomic<uint32_t> mSnapshotSequence{0};
+    /* Parses the received data once begin() is done. */
+    TaskHandle_t mReaderTask = nullptr;
+    /* mMessages is filled by the reader task. */
+    SemaphoreHandle_t mMessagesLock = nullptr;
+    uint16_t mHandledMessages = 0;
+    uint32_t mDroppedBytes = 0;
+    uint32_t mRxOverflows = 0;
+    uint32_t mMaxParseLatencyMs = 0;
+    uint64_t mParseLatencySumMs = 0;
+    uint32_t mParseLatencyCount = 0;
     /* last time, when the ESP clock was adjusted to the GPR UTC time,
      * in millis ticker. */
     uint32_t mLastTimeTimeSet = 0;
+    /* Navigation solutions per second the module was configured for. */
+    uint8_t mNavigationRateHz = 1;
     /* GPS week as received with time. */
     uint32_t mLastGpsWeek = 0;
     /* Number of bytes sent for alp request. */
@@ -616,6 +676,39 @@ class Gps {
 
     bool encode(uint8_t data);
 
+    bool startReaderTask();
+
+    static void readerTask(void *param);
+
+    void readAvailable();
+
+    /* Hands the records to other tasks, only called by the one task that
+     * parses the data. Each call fills the other buffer, a reader that is
+     * overtaken while copying retries.
+     */
+    void publish();
+
+    GpsSnapshot snapshot() const;
+
+    /* One field of the snapshot, saves copying the others. */
+    template<typename T>
+    T snapshot(T GpsSnapshot::*field) const {
+      T result;
+      uint32_t sequence;
+      do {
+        sequence = mSnapshotSequence.load(std::memory_order_acquire);
+        result = mSnapshots[sequence & 1].*field;
+        std::atomic_thread_fence(std::memory_order_acquire);
+      } while (sequence != mSnapshotSequence.load(std::memory_order_relaxed));
+      return result;
+    }
+
+    void countParseLatency(uint32_t milliseconds);
+
+    void lockMessages() const;
+
+    void unlockMessages() const;
+
     bool setBaud();
 
     String hw() const;
@@ -651,8 +744,6 @@ class Gps {
 
     static uint8_t hexCharToInt(uint8_t data);
 
-    static double haversine(double lat1, double lon1, double lat2, double lon2);
-
     static void randomOffset(PrivacyArea &p);
 
     static bool validNmeaMessageChar(uint8_t chr);
@@ -664,18 +755,70 @@ class Gps {
     bool setMessageInterval(UBX_CFG_KEY_ID msgId, uint8_t seconds, bool waitForAck = true);
 #endif
 
+    /* Configures GPS_NAV_RATE_HZ and the messages that are sent every
+     * few seconds, their interval counts navigation solutions.
+     */
+    void setNavigationRate();
+
+    /* Message intervals are one byte in CFG-MSG and CFG-MSGOUT. */
+    static const uint8_t MAX_MESSAGE_INTERVAL = UINT8_MAX;
+    /* Interval in navigation solutions for the given seconds. Longer
+     * intervals are cut to MAX_MESSAGE_INTERVAL solutions, at 2 Hz
+     * NAV-TIMEGPS comes every 127s instead of 240s and AID-INI every 127s
+     * instead of 185s.
+     */
+    uint8_t solutions(uint16_t seconds) const;
+
     /* Make sure fresh GPS data can be added to the current internal record.
      * Add TOW and millis ticks to the record if not already set,
      * force record switch and creation of a new record if tow existed
-     * but changed.
+     * but changed. Returns the record to fill, for epochs between the
+     * whole seconds this is mEpochGpsRecord.
      */
-    void prepareGpsData(uint32_t tow, uint32_t messageStartedMillisTicks);
+    GpsRecord &prepareGpsData(uint32_t tow, uint32_t messageStartedMillisTicks);
+
+    /* Keeps the position of the completed epoch record. */
+    void addEpoch(const GpsRecord &record);
 
     void softResetGps();
 
-    void handleUbxNavTimeGps(const GpsBuffer::UbxNavTimeGps & message, const uint32_t receivedMs, const uint32_t delayMs);
-    void handleUbxAidIni(const GpsBuffer::AidIni &message) const;
-    void handleUbxAidHui(const GpsBuffer::AidHui &massage) const;
+    /* Calls the handler with the message in the receive buffer. */
+    template<typename Message, void (Gps::*handler)(const Message &)>
+    void handleUbx() {
+      (this->*handler)(*reinterpret_cast<const Message *>(mGpsBuffer.u1Data));
+    }
+
+    /* Handler for a UBX message that is at least minPayloadLength long. */
+    struct UbxHandler {
+      uint16_t ubxMsgId;
+      uint16_t minPayloadLength;
+      void (Gps::*handle)();
+    };
+    /* Sorted by ubxMsgId. */
+    static const UbxHandler UBX_HANDLERS[];
+    static const size_t UBX_HANDLER_COUNT;
+
+    void handleUbxAckAck(const GpsBuffer::Ack &message);
+    void handleUbxAckNak(const GpsBuffer::Ack &message);
+    void handleUbxCfgPrt(const GpsBuffer::CfgPrt &message);
+    void handleUbxCfgRinv(const GpsBuffer::CfgRinv &message);
+    void handleUbxCfgPollResponse(const GpsBuffer::UBX_HEADER &message);
+    void handleUbxMonVer(const GpsBuffer::MonVer &message);
+    void handleUbxMonHw(const GpsBuffer &message);
+    void handleUbxNavStatus(const GpsBuffer::NavStatus &message);
+    void handleUbxNavDop(const GpsBuffer::NavDop &message);
+    void handleUbxNavSol(const GpsBuffer::NavSol &message);
+    void handleUbxNavPvt(const GpsBuffer::NavPvt &message);
+    void handleUbxNavVelned(const GpsBuffer::NavVelned &message);
+    void handleUbxNavPosllh(const GpsBuffer::NavPosllh &message);
+    void handleUbxNavTimeGps(const GpsBuffer::UbxNavTimeGps &message);
+    void handleUbxNavTimeUtc(const GpsBuffer::NavTimeUtc &message);
+    void handleUbxNavSbas(const GpsBuffer::NavSbas &message);
+    void handleUbxAidIni(const GpsBuffer::AidIni &message);
+    void handleUbxAidHui(const GpsBuffer::AidHui &massage);
+    void handleUbxAidAlpsrv(const GpsBuffer::AidAlpsrvClientReq &message);
+    void handleUbxAidAlp(const GpsBuffer::AidAlpStatus &message);
+    void handleUbxInf(const GpsBuffer::Inf &message);
 };
 
 #endif
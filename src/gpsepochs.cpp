@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gpsepochs.h"
+
+/* Length of a degree of latitude, and of longitude at the equator. */
+static const float METERS_PER_DEGREE = 111319.49f;
+
+void GpsEpochs::reset(uint32_t tow) {
+  mTow = tow;
+  mCount = 0;
+}
+
+void GpsEpochs::add(uint16_t offsetMillis, int32_t latitude, int32_t longitude,
+                    uint32_t speed, int32_t course) {
+  if (mCount >= GPS_NAV_RATE_HZ) {
+    return;
+  }
+  uint8_t idx = mCount++;
+  for (; idx > 0 && mEpochs[idx - 1].offsetMillis > offsetMillis; idx--) {
+    mEpochs[idx] = mEpochs[idx - 1];
+  }
+  Epoch &epoch = mEpochs[idx];
+  epoch.latitude = latitude;
+  epoch.longitude = longitude;
+  epoch.course = course;
+  epoch.offsetMillis = offsetMillis;
+  epoch.speed = speed > UINT16_MAX ? UINT16_MAX : speed;
+}
+
+uint32_t GpsEpochs::getTow() const {
+  return mTow;
+}
+
+uint8_t GpsEpochs::getCount() const {
+  return mCount;
+}
+
+bool GpsEpochs::positionAt(int32_t offsetMillis, int32_t &latitude, int32_t &longitude) const {
+  if (mCount == 0) {
+    return false;
+  }
+  // last epoch at or before the offset, else the first
+  uint8_t idx = 0;
+  while (idx + 1 < mCount && mEpochs[idx + 1].offsetMillis <= offsetMillis) {
+    idx++;
+  }
+  const Epoch &from = mEpochs[idx];
+  if (idx + 1 < mCount && from.offsetMillis <= offsetMillis) {
+    const Epoch &to = mEpochs[idx + 1];
+    const float fraction = (float) (offsetMillis - from.offsetMillis)
+      / (float) (to.offsetMillis - from.offsetMillis);
+    latitude = from.latitude + lroundf((float) (to.latitude - from.latitude) * fraction);
+    const int32_t longitudeDelta = normalizeLongitude((int64_t) to.longitude - from.longitude);
+    longitude = normalizeLongitude(
+      (int64_t) from.longitude + lroundf((float) longitudeDelta * fraction));
+  } else {
+    extrapolate(from, offsetMillis - from.offsetMillis, latitude, longitude);
+  }
+  return true;
+}
+
+void GpsEpochs::extrapolate(const Epoch &epoch, int32_t millis, int32_t &latitude, int32_t &longitude) {
+  latitude = epoch.latitude;
+  longitude = epoch.longitude;
+  if (epoch.speed < MIN_EXTRAPOLATION_SPEED || millis == 0) {
+    return;
+  }
+  if (millis > MAX_EXTRAPOLATION_MILLIS) {
+    millis = MAX_EXTRAPOLATION_MILLIS;
+  } else if (millis < -MAX_EXTRAPOLATION_MILLIS) {
+    millis = -MAX_EXTRAPOLATION_MILLIS;
+  }
+  // cm/s * ms = 10 µm
+  const float meters = (float) epoch.speed * (float) millis / 100000.0f;
+  const float course = (float) epoch.course * (float) (PI / 180e5);
+  const float degreesNorth = meters * cosf(course) / METERS_PER_DEGREE;
+  const float degreesEast = meters * sinf(course)
+    / (METERS_PER_DEGREE * cosf((float) epoch.latitude * (float) (PI / 180e7)));
+  latitude += lroundf(degreesNorth * 1e7f);
+  longitude = normalizeLongitude((int64_t) longitude + lroundf(degreesEast * 1e7f));
+}
+
+int32_t GpsEpochs::normalizeLongitude(int64_t longitude) {
+  if (longitude > 1800000000LL) {
+    longitude -= 3600000000LL;
+  } else if (longitude < -1800000000LL) {
+    longitude += 3600000000LL;
+  }
+  return (int32_t) longitude;
+}
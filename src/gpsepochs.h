@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OBS_GPSEPOCHS_H
+#define OBS_GPSEPOCHS_H
+
+#include <Arduino.h>
+#include <cstdint>
+
+/* Navigation solutions per second, 1 to 10. Above 1 Hz the positions of
+ * the epochs between the whole seconds are kept so each measurement gets
+ * its own position, the data sets are still written once per second.
+ * NEO-6 modules are limited to 5 Hz. Messages sent every few minutes
+ * come more often above 1 Hz, see Gps::solutions().
+ */
+#ifndef GPS_NAV_RATE_HZ
+#define GPS_NAV_RATE_HZ 1
+#endif
+
+class Gps;
+
+/* The positions of the navigation epochs within one second. */
+class GpsEpochs {
+    friend Gps;
+  public:
+    /* Tow of the whole second the epochs belong to. */
+    uint32_t getTow() const;
+    uint8_t getCount() const;
+    /* Position at the given milliseconds after the whole second,
+     * interpolated between the epochs and continued with the velocity of
+     * the nearest epoch before the first or after the last. False if
+     * there is no epoch with a valid fix.
+     */
+    bool positionAt(int32_t offsetMillis, int32_t &latitude, int32_t &longitude) const;
+
+  protected:
+    void reset(uint32_t tow);
+    /* Adds the epoch in order of time, ignored if there is no room. */
+    void add(uint16_t offsetMillis, int32_t latitude, int32_t longitude,
+             uint32_t speed, int32_t course);
+
+  private:
+    struct Epoch {
+      /* deg, scale 1e-7 */
+      int32_t latitude;
+      int32_t longitude;
+      /* deg, scale 1e-5 */
+      int32_t course;
+      uint16_t offsetMillis;
+      /* cm/s */
+      uint16_t speed;
+    };
+    /* Below this speed in cm/s the course is too noisy to continue a
+     * position with it.
+     */
+    static const uint16_t MIN_EXTRAPOLATION_SPEED = 100;
+    static const int32_t MAX_EXTRAPOLATION_MILLIS = 1000;
+    static void extrapolate(const Epoch &epoch, int32_t millis, int32_t &latitude, int32_t &longitude);
+    static int32_t normalizeLongitude(int64_t longitude);
+    uint32_t mTow = 0;
+    uint8_t mCount = 0;
+    Epoch mEpochs[GPS_NAV_RATE_HZ];
+};
+
+#endif //OBS_GPSEPOCHS_H
@@ -35,7 +35,9 @@ void GpsRecord::reset(uint32_t tow, uint32_t gpsWeek, uint32_t createdAtMillisTi
   mFixStatusFlags = 0;
   mHdop = 0;
   mHeight = 0;
+  mHorizontalAccuracy = 0;
   mSpeed = 0;
+  mTimeValid = false;
   mPositionSet = false;
   mVelocitySet = false;
   mInfoSet = false;
@@ -71,6 +73,14 @@ void GpsRecord::setHdop(uint16_t hDop) {
   mHdopSet = true;
 }
 
+void GpsRecord::setHorizontalAccuracy(uint32_t horizontalAccuracy) {
+  mHorizontalAccuracy = horizontalAccuracy;
+}
+
+void GpsRecord::setTimeValid(bool timeValid) {
+  mTimeValid = timeValid;
+}
+
 bool GpsRecord::isAllSet() const {
   return mPositionSet && mVelocitySet && mInfoSet && mHdopSet;
 }
@@ -84,8 +94,7 @@ uint32_t GpsRecord::getWeek() const {
 }
 
 String GpsRecord::getAltitudeMetersString() const {
-  // 3 digits is problematic, 2 are enough any way.
-  return toScaledString((mHeight + 5) / 10, 2);
+  return toScaledString(getAltitudeCentimeters(), 2);
 }
 
 String GpsRecord::getCourseString() const {
@@ -93,25 +102,44 @@ String GpsRecord::getCourseString() const {
 }
 
 String GpsRecord::getSpeedKmHString() const {
-  return toScaledString((mSpeed * 60 * 60) / 10000, 1);
+  return toScaledString(getSpeedDeciKmH(), 1);
 }
 
 String GpsRecord::getHdopString() const {
   return toScaledString(mHdop, 2);
 }
 
+void GpsRecord::appendCsvFields(LineBuffer &line, bool withPosition) const {
+  if (withPosition) {
+    line.appendScaled(mLatitude, 7);
+    line.append(';');
+    line.appendScaled(mLongitude, 7);
+    line.append(';');
+    line.appendScaled(getAltitudeCentimeters(), 2);
+    line.append(';');
+    line.appendScaled(mCourseOverGround, 5);
+    line.append(';');
+    line.appendScaled(getSpeedDeciKmH(), 1);
+    line.append(';');
+  } else {
+    line.append(";;;;;");
+  }
+  line.appendScaled(mHdop, 2);
+}
+
+int32_t GpsRecord::getAltitudeCentimeters() const {
+  // 3 digits is problematic, 2 are enough any way.
+  return (mHeight + 5) / 10;
+}
 
-const int32_t GpsRecord::pow10[] = {
-  1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
-};
+int32_t GpsRecord::getSpeedDeciKmH() const {
+  return (mSpeed * 60 * 60) / 10000;
+}
 
 String GpsRecord::toScaledString(const int32_t value, const uint16_t scale) {
-  if (value == 0) {
-    return "";
-  }
-  char buffer[32];
-  const int32_t scl = pow10[scale];
-  snprintf(buffer, sizeof(buffer), "%d.%0*d", value / scl, scale, abs(value % scl) );
+  char buffer[16];
+  LineBuffer line(buffer, sizeof(buffer));
+  line.appendScaled(value, scale);
   return String(buffer);
 }
 
@@ -151,3 +179,11 @@ uint32_t GpsRecord::getCreatedAtMillisTicks() const {
 uint8_t GpsRecord::getFixStatusFlags() const {
   return mFixStatusFlags;
 }
+
+uint32_t GpsRecord::getHorizontalAccuracy() const {
+  return mHorizontalAccuracy;
+}
+
+bool GpsRecord::isTimeValid() const {
+  return mTimeValid;
+}
@@ -27,8 +27,10 @@
 
 #include <Arduino.h>
 #include <cstdint>
+#include "utils/linebuffer.h"
 
 class Gps;
+class BinaryFileWriter;
 
 class GpsRecord {
     enum GPS_FIX : uint8_t {
@@ -43,6 +45,7 @@ class GpsRecord {
 
 
     friend Gps;
+    friend BinaryFileWriter;
   public:
     String getAltitudeMetersString() const;
     String getCourseString() const;
@@ -50,6 +53,10 @@ class GpsRecord {
     String getHdopString() const;
     String getLatString() const;
     String getLongString() const;
+    /* The CSV fields Latitude till HDOP separated by ";", the position
+     * fields are left empty if withPosition is false.
+     */
+    void appendCsvFields(LineBuffer &line, bool withPosition) const;
     bool hasValidFix() const;
     double getLatitude() const;
     double getLongitude() const;
@@ -59,6 +66,10 @@ class GpsRecord {
     uint32_t getTow() const;
     uint32_t getWeek() const;
     uint32_t getCreatedAtMillisTicks() const;
+    /* Horizontal accuracy estimate in mm, 0 if not reported. */
+    uint32_t getHorizontalAccuracy() const;
+    /* The receiver reported the time of week and week as valid. */
+    bool isTimeValid() const;
 
   protected:
     /* Clear all collected data */
@@ -75,6 +86,10 @@ class GpsRecord {
 
     void setHdop(uint16_t hDop);
 
+    void setHorizontalAccuracy(uint32_t horizontalAccuracy);
+
+    void setTimeValid(bool timeValid);
+
     bool isAllSet() const;
 
   private:
@@ -92,15 +107,19 @@ class GpsRecord {
     int mHdop; // * 100
     /* millimeter */
     int32_t mHeight; // * 10?
+    /* millimeter */
+    uint32_t mHorizontalAccuracy = 0;
     uint8_t mSatellitesUsed;
     GPS_FIX mFixStatus; //
     uint8_t mFixStatusFlags;
+    bool mTimeValid = false;
     bool mPositionSet = false;
     bool mVelocitySet = false;
     bool mInfoSet = false;
     bool mHdopSet = false;
     uint32_t mCreatedAtMillisTicks;
-    static const int32_t pow10[10];
+    int32_t getAltitudeCentimeters() const;
+    int32_t getSpeedDeciKmH() const;
     static String toScaledString(int32_t value, uint16_t scale);
 };
 
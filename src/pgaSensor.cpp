@@ -2,7 +2,8 @@
 
 #ifdef OBSPRO
 
-PGASensorManager::PGASensorManager()
+PGASensorManager::PGASensorManager() :
+  transport(PGATransport::create())
 {
   for(int i = 0; i < NUMBER_OF_TOF_SENSORS; i++)
     sensorValues[i] = 0;
@@ -11,7 +12,7 @@ PGASensorManager::PGASensorManager()
 
 PGASensorManager::~PGASensorManager()
 {
-
+  delete transport;
 }
 
 void PGASensorManager::registerSensor(const PGASensorInfo &sensorInfo, uint8_t sensorId)
@@ -23,7 +24,6 @@ void PGASensorManager::registerSensor(const PGASensorInfo &sensorInfo, uint8_t s
   m_sensors[sensorId] = sensorInfo;
   m_sensors[sensorId].numberOfTriggers = 0;
   sensorValues[sensorId] = MAX_SENSOR_VALUE;
-  m_sensors[sensorId].median = new Median<uint16_t>(5, MAX_SENSOR_VALUE);
   setupSensor(sensorId);
 
   // DEBUG: Dump complete config register map
@@ -64,7 +64,13 @@ bool PGASensorManager::pollDistancesAlternating()
   // Check if the next sensor is the primary sensor, which means that all sensors have been
   // triggered. Then collect the results of both.
   if(nextSensor == primarySensor)
+  {
+    // Idle cadence: measure less often while nothing is in range
+    if(cadence.getMode() == CadenceIdle && millis() - lastTriggerTimeMs < PGA_IDLE_CYCLE_MS)
+      return false;
     newMeasurements = collectSensorResults();
+    lastTriggerTimeMs = millis();
+  }
 
   // Trigger next sensor
 #if PGA_DUMP_ENABLE
@@ -81,7 +87,9 @@ bool PGASensorManager::pollDistancesAlternating()
     m_sensors[nextSensor].lastMeasurementWasDump = false;
   }
 #endif
-  spiBurstAndListen(nextSensor, 1, 1);
+  // Tracking cadence: shorter listen window with preset 2
+  const uint8_t preset = cadence.getMode() == CadenceTracking ? 2 : 1;
+  spiBurstAndListen(nextSensor, preset, PGA_NUMBER_OF_OBJECTS);
   m_sensors[nextSensor].numberOfTriggers++;
 
   lastSensor = nextSensor;
@@ -104,6 +112,14 @@ void PGASensorManager::setOffsets(std::vector<uint16_t> offsets)
   }
 }
 
+void PGASensorManager::setDistanceFilter(const DistanceFilterConfig &config)
+{
+  for (auto & sensor : m_sensors) {
+    sensor.filter.configure(config);
+    sensor.filter.reset();
+  }
+}
+
 /* The primary sensor defines the measurement interval, we trigger a measurement if this
  * sensor is ready.
  */
@@ -115,23 +131,49 @@ void PGASensorManager::reset(uint32_t startMillisTicks) {
   for (auto & sensor : m_sensors) {
     sensor.minDistance = MAX_SENSOR_VALUE;
     memset(&(sensor.echoDurationMicroseconds), 0, sizeof(sensor.echoDurationMicroseconds));
+#if ECHO_OBJECTS_PER_MEASUREMENT > 0
+    memset(&(sensor.echoes), 0, sizeof(sensor.echoes));
+#endif
     sensor.numberOfTriggers = 0;
   }
   lastReadingCount = 0;
+  cadence.resetInterval();
   lastSensor = 1 - primarySensor;
   memset(&(startOffsetMilliseconds), 0, sizeof(startOffsetMilliseconds));
   startReadingMilliseconds = startMillisTicks;
 }
 
+void PGASensorManager::setTemperature(float celsius) {
+  microSecToCmDividerCenti = SoundSpeed::microSecToCmDividerCenti(celsius);
+  temperatureSet = true;
+}
+
+/* Converts the time of flight with the factor set by setTemperature(),
+ * without a temperature with the former fixed 343m/s.
+ */
+uint16_t PGASensorManager::toCentimeter(uint16_t tof) const {
+  if (temperatureSet) {
+    return SoundSpeed::toCentimeter(tof, microSecToCmDividerCenti);
+  }
+  // tof * 343m/s / 2, same result as the former double calculation
+  return static_cast<uint16_t>((uint32_t) tof * 1715 / 100000);
+}
+
+uint16_t PGASensorManager::getMicroSecToCmDividerCenti() const {
+  return microSecToCmDividerCenti;
+}
+
+CadenceMode PGASensorManager::getCadenceMode() const {
+  return cadence.getIntervalMode();
+}
+
 void PGASensorManager::setupSensor(int sensorId)
 {
   PGASensorInfo &sensorInfo = m_sensors[sensorId];
 
   // Set pin modes
-  digitalWrite(sensorInfo.sck_pin, LOW);
-  pinMode(sensorInfo.sck_pin, OUTPUT);
-  pinMode(sensorInfo.mosi_pin, OUTPUT);
-  pinMode(sensorInfo.miso_pin, INPUT);
+  transport->attach(sensorId, sensorInfo.sck_pin, sensorInfo.mosi_pin, sensorInfo.miso_pin);
+  log_i("Sensor %d is connected by %s.", sensorId, transport->getName());
 
   // Wait at least 15 ms to sync the synchronous UART
   safe_usleep(20000);
@@ -150,9 +192,10 @@ void PGASensorManager::setupSensor(int sensorId)
   spiRegWrite(sensorId, PGA_REG_FREQUENCY, 55);  // 55 = 41 kHz, Frequency = 0.2 × FREQ + 30 [kHz]
   //spiRegWrite(sensorId, PGA_REG_DEADTIME, 0x00);  // Deglitch not described in DS, deadtime only relevant for direct drive mode
   spiRegWrite(sensorId, PGA_REG_PULSE_P1, PGA_IO_IF_SEL(0) | PGA_UART_DIAG(0) | PGA_IO_DIS(0) | P1_PULSE(17)); // Number of pulses
+  spiRegWrite(sensorId, PGA_REG_PULSE_P2, P2_PULSE(17)); // Same for preset 2, bit 5..7 are the UART address
   spiRegWrite(sensorId, PGA_REG_CURR_LIM_P1, PGA_DIS_CL(0) | PGA_CURR_LIM1(0));  // CURR_LIM1*7mA + 50mA
   spiRegWrite(sensorId, PGA_REG_CURR_LIM_P2, PGA_LPF_CO(0) | PGA_CURR_LIM2(0));  // CURR_LIM1*7mA + 50mA
-  spiRegWrite(sensorId, PGA_REG_REC_LENGTH, PGA_P1_REC(8) | PGA_P2_REC(0));  // Record time = 4.096 × (Px_REC + 1) [ms], 8 = 36,9ms = 6m range
+  spiRegWrite(sensorId, PGA_REG_REC_LENGTH, PGA_P1_REC(PGA_P1_REC_LENGTH) | PGA_P2_REC(PGA_P2_REC_LENGTH));  // Record time = 4.096 × (Px_REC + 1) [ms]
   spiRegWrite(sensorId, PGA_REG_DECPL_TEMP, PGA_AFE_GAIN_RNG(3) | PGA_LPM_EN(0) | PGA_DECPL_TEMP_SEL(0) | PGA_DECPL_T(0));  // Time = 4096 × (DECPL_T + 1) [μs], 0 = 4ms = 0,66m?!?
   spiRegWrite(sensorId, PGA_REG_EE_CNTRL, PGA_DATADUMP_EN(0));  // Disable data dump
 
@@ -210,55 +253,27 @@ void PGASensorManager::safe_usleep(unsigned long us)
   while(micros() - tstart < us);
 }
 
-uint8_t PGASensorManager::spiTransfer(uint8_t sensorId, uint8_t data_out)
-{
-  assert(sensorId >= 0 && sensorId <= 1);
-  PGASensorInfo &sensorInfo = m_sensors[sensorId];
-  uint8_t data_in = 0;
-  for(uint8_t i = 0; i < 8; i++)
-  {
-    // It seems that the datasheet is wrong about the SPI mode...
-    // It says: ... with data set on the rising edge of the clock and sampled on the falling edge of the clock
-    // But we have to set the data before the rising edge.
-    digitalWrite(sensorInfo.mosi_pin, data_out&0x01);
-    data_out >>= 1;
-    digitalWrite(sensorInfo.sck_pin, HIGH);
-    data_in >>= 1;
-    data_in |= digitalRead(sensorInfo.miso_pin)<<7;
-    digitalWrite(sensorInfo.sck_pin, LOW);
-  }
-  return data_in;
-}
-
 // Returns the register value or -1 on checksum error
 // pdiag: return the value of the diag byte, can be nullptr
 int PGASensorManager::spiRegRead(uint8_t sensorId, uint8_t reg_addr, uint8_t *pdiag)
 {
-  PGASensorInfo &sensorInfo = m_sensors[sensorId];
+  assert(sensorId >= 0 && sensorId <= 1);
 
-  // Transmit
-  checksum_clear();
-  spiTransfer(sensorId, 0x55);  // Sync byte
-  spiTransfer(sensorId, 0<<5 | PGA_CMD_REGISTER_READ); // Command: chip address + register read
-  checksum_append_byte(0<<5 | PGA_CMD_REGISTER_READ);
-  spiTransfer(sensorId, reg_addr); // Register address
-  checksum_append_byte(reg_addr);
-  spiTransfer(sensorId, checksum_get());  // Checksum
-  uint8_t tx_checksum = checksum_get();
-
-  // Receive
-  checksum_clear();
-  uint8_t diag = spiTransfer(sensorId, 0x00);
-  checksum_append_byte(diag);
+  // Sync byte, command (chip address + register read), register address and
+  // checksum, then clock in the diag byte, the register value and checksum
+  uint8_t tx[7] = {0x55, 0<<5 | PGA_CMD_REGISTER_READ, reg_addr, 0, 0x00, 0x00, 0x00};
+  uint8_t rx[sizeof(tx)];
+  tx[3] = checksum(&tx[1], 2);
+  transport->transfer(sensorId, tx, rx, sizeof(tx));
+
+  uint8_t diag = rx[4];
   if(pdiag != nullptr)
     *pdiag = diag;
-  uint8_t reg_val = spiTransfer(sensorId, 0x00);
-  checksum_append_byte(reg_val);
-  uint8_t checksum = spiTransfer(sensorId, 0x00);
+  uint8_t reg_val = rx[5];
 
-  //Serial.printf("Data: 0x%02x, Checksum (pga): 0x%02x, Checksum (local): 0x%02x, Checksum (tx): %02x\n", reg_val, checksum, checksum_get(), tx_checksum);
+  //Serial.printf("Data: 0x%02x, Checksum (pga): 0x%02x, Checksum (local): 0x%02x\n", reg_val, rx[6], checksum(&rx[4], 2));
 
-  if(checksum != checksum_get())
+  if(rx[6] != checksum(&rx[4], 2))
     return -1;
 
   return reg_val;
@@ -268,15 +283,10 @@ void PGASensorManager::spiRegWrite(uint8_t sensorId, uint8_t reg_addr, uint8_t v
 {
   assert(sensorId >= 0 && sensorId <= 1);
 
-  checksum_clear();
-  spiTransfer(sensorId, 0x55);  // Sync byte
-  spiTransfer(sensorId, 0<<5 | PGA_CMD_REGISTER_WRITE); // Command: chip address + register write
-  checksum_append_byte(0<<5 | PGA_CMD_REGISTER_WRITE);
-  spiTransfer(sensorId, reg_addr);  // Register address
-  checksum_append_byte(reg_addr);
-  spiTransfer(sensorId, value);  // Register address
-  checksum_append_byte(value);
-  spiTransfer(sensorId, checksum_get());  // Checksum
+  // Sync byte, command (chip address + register write), register address, value and checksum
+  uint8_t tx[5] = {0x55, 0<<5 | PGA_CMD_REGISTER_WRITE, reg_addr, value, 0};
+  tx[4] = checksum(&tx[1], 3);
+  transport->transfer(sensorId, tx, nullptr, sizeof(tx));
 
   // Wait a bit to apply changes, depending on the register
   if(reg_addr == PGA_REG_INIT_GAIN || (reg_addr >= PGA_REG_TVGAIN0 & reg_addr <= PGA_REG_TVGAIN6) || (reg_addr >= PGA_REG_P1_THR_0 && reg_addr <= PGA_REG_P2_THR_15) ||
@@ -336,14 +346,11 @@ void PGASensorManager::spiBurstAndListen(uint8_t sensorId, uint8_t preset, uint8
   assert(preset >= 1 && preset <= 2);
   assert(numberOfObjectsToDetect >= 1 && numberOfObjectsToDetect <= 8);
 
-  checksum_clear();
-  spiTransfer(sensorId, 0x55);  // Sync byte
+  // Sync byte, command, number of objects and checksum
   uint8_t cmd = 0<<5 | (preset == 1 ? PGA_CMD_BURST_AND_LISTEN_1 : PGA_CMD_BURST_AND_LISTEN_2);
-  spiTransfer(sensorId, cmd); // Command
-  checksum_append_byte(cmd);
-  spiTransfer(sensorId, numberOfObjectsToDetect);
-  checksum_append_byte(numberOfObjectsToDetect);
-  spiTransfer(sensorId, checksum_get());
+  uint8_t tx[4] = {0x55, cmd, numberOfObjectsToDetect, 0};
+  tx[3] = checksum(&tx[1], 2);
+  transport->transfer(sensorId, tx, nullptr, sizeof(tx));
 }
 
 // Get the last ultrasonic results (triggered by spiBurstAndListen)
@@ -353,40 +360,24 @@ bool PGASensorManager::spiUSResult(uint8_t sensorId, uint8_t numberOfObjectsToDe
   assert(sensorId >= 0 && sensorId <= 1);
   assert(numberOfObjectsToDetect >= 1 && numberOfObjectsToDetect <= 8);
 
-  spiTransfer(sensorId, 0x55);  // Sync byte
-  spiTransfer(sensorId, 0<<5 | PGA_CMD_ULTRASONIC_RESULT); // Command
-
-  // Get diag data
-  checksum_clear();
-  uint8_t diag = spiTransfer(sensorId, 0x00);
-  checksum_append_byte(diag);
+  // Sync byte and command, then clock in the diag byte, 4 bytes for each
+  // object and the checksum
+  const size_t length = 2 + 1 + 4 * numberOfObjectsToDetect + 1;
+  uint8_t tx[2 + 1 + 4 * 8 + 1] = {0x55, 0<<5 | PGA_CMD_ULTRASONIC_RESULT};
+  uint8_t rx[sizeof(tx)];
+  transport->transfer(sensorId, tx, rx, length);
 
-  // Read result data of 4 bytes for each object
-  for(int obj = 0; obj < numberOfObjectsToDetect; obj++)
+  const uint8_t *data = &rx[3];
+  for(int obj = 0; obj < numberOfObjectsToDetect; obj++, data += 4)
   {
-    uint8_t data = spiTransfer(sensorId, 0x00);
-    usResults[obj].tof = ((uint16_t)data)<<8;
-    checksum_append_byte(data);
-    data = spiTransfer(sensorId, 0x00);
-    usResults[obj].tof |= data;
-    checksum_append_byte(data);
-    data = spiTransfer(sensorId, 0x00);
-    usResults[obj].width = data;
-    checksum_append_byte(data);
-    data = spiTransfer(sensorId, 0x00);
-    usResults[obj].peakAmplitude = data;
-    checksum_append_byte(data);
-
-    // Convert tof to distance in cm
-    // TODO: Add temperature compensation by reading tempearture from sensor (somewhere else)
-    const double tof = usResults[obj].tof*1e-6;
-    const double v = 343.0;
-    usResults[obj].distance = (uint16_t)(tof*v/2.0*100.0);
+    usResults[obj].tof = ((uint16_t)data[0])<<8 | data[1];
+    usResults[obj].width = data[2];
+    usResults[obj].peakAmplitude = data[3];
+
+    usResults[obj].distance = toCentimeter(usResults[obj].tof);
   }
 
-  // Get checksum
-  uint8_t checksum = spiTransfer(sensorId, 0x00);
-  return checksum == checksum_get();
+  return rx[length - 1] == checksum(&rx[2], length - 3);
 }
 
 bool PGASensorManager::spiIsBusy(uint8_t sensorId)
@@ -404,62 +395,27 @@ bool PGASensorManager::spiDataDump(const uint8_t sensorId, uint8_t *data)
 {
   assert(sensorId >= 0 && sensorId <= 1);
 
-  spiTransfer(sensorId, 0x55);  // Sync byte
-  spiTransfer(sensorId, 0<<5 | PGA_CMD_DATA_DUMP); // Command
-
-  // Get diag data
-  checksum_clear();
-  uint8_t diag = spiTransfer(sensorId, 0x00);
-  checksum_append_byte(diag);
+  // Sync byte and command, then clock in the diag byte, the data dump of
+  // 128 bytes and the checksum
+  uint8_t tx[2 + 1 + 128 + 1] = {0x55, 0<<5 | PGA_CMD_DATA_DUMP};
+  uint8_t rx[sizeof(tx)];
+  transport->transfer(sensorId, tx, rx, sizeof(tx));
+  memcpy(data, &rx[3], 128);
 
-  // Read data dump of 128 bytes
-  for(int i = 0; i < 128; i++)
-  {
-    data[i] = spiTransfer(sensorId, 0x00);
-    checksum_append_byte(data[i]);
-  }
-
-  // Get checksum
-  uint8_t checksum = spiTransfer(sensorId, 0x00);
-  return checksum == checksum_get();
-}
-
-void PGASensorManager::checksum_clear()
-{
-  checksum_sum = 0;
-  checksum_tmp_data = 0;
-  checksum_offset = 7;
-  checksum_carry = 0;
+  return rx[sizeof(rx) - 1] == checksum(&rx[2], 1 + 128);
 }
 
-void PGASensorManager::checksum_append_bit(uint8_t val)
+// The checksum is the inverted sum of all bytes, the carry of each
+// addition is added to the next one.
+uint8_t PGASensorManager::checksum(const uint8_t *data, size_t length)
 {
-  checksum_tmp_data |= (val << checksum_offset);
-  if(!checksum_offset)
+  uint16_t sum = 0;
+  for(size_t i = 0; i < length; i++)
   {
-    // Add tmp_data and last carry to sum and calculate new carry
-    checksum_append_byte(checksum_tmp_data);
+    sum += data[i];
+    sum = (sum & 0xff) + (sum >> 8);
   }
-  else
-    checksum_offset--;
-}
-
-void PGASensorManager::checksum_append_byte(uint8_t val)
-{
-    // Add tmp_data and last carry to sum and calculate new carry
-    uint16_t sum = (uint16_t)checksum_sum + (uint16_t)val + (uint16_t)checksum_carry;
-    checksum_carry = sum >> 8;
-    checksum_sum = (uint8_t)sum;
-    checksum_offset = 7;
-    checksum_tmp_data = 0;
-}
-
-uint8_t PGASensorManager::checksum_get()
-{
-  // Add zero bits until we added the last padded byte
-  while(checksum_offset != 7)
-    checksum_append_bit(0);
-  return ~(checksum_sum + checksum_carry);  // Checksum is the inverted sum + carry
+  return ~(uint8_t)sum;
 }
 
 // Gets the distances from the sensors
@@ -468,8 +424,8 @@ bool PGASensorManager::collectSensorResults() {
   bool validReading = false;
   for (size_t sensorId = 0; sensorId < NUMBER_OF_TOF_SENSORS; ++sensorId) {
     PGASensorInfo* const sensor = &m_sensors[sensorId];
-    PGAResult usResults[1];
-    if(!spiUSResult(sensorId, 1, usResults))
+    PGAResult usResults[PGA_NUMBER_OF_OBJECTS];
+    if(!spiUSResult(sensorId, PGA_NUMBER_OF_OBJECTS, usResults))
       continue;
 #if PGA_DUMP_ENABLE
     if(sensor->lastMeasurementWasDump)
@@ -491,10 +447,16 @@ bool PGASensorManager::collectSensorResults() {
     }
     else
     {
-    Serial.printf("meas,%d,%d,%d,%d\n", sensorId, usResults[0].tof, usResults[0].width, usResults[0].peakAmplitude);
+    Serial.printf("meas,%d", sensorId);
+    for(int obj = 0; obj < PGA_NUMBER_OF_OBJECTS; obj++)
+      Serial.printf(",%d,%d,%d", usResults[obj].tof, usResults[obj].width, usResults[obj].peakAmplitude);
+    Serial.printf("\n");
 #endif
 
       sensor->echoDurationMicroseconds[lastReadingCount] = usResults[0].tof;
+#if ECHO_OBJECTS_PER_MEASUREMENT > 0
+      storeEchoes(sensor->echoes[lastReadingCount], usResults);
+#endif
       uint16_t dist;
       if(usResults[0].distance < MIN_DISTANCE_MEASURED_CM || usResults[0].distance >= MAX_DISTANCE_MEASURED_CM) {
         dist = MAX_SENSOR_VALUE;
@@ -503,16 +465,18 @@ bool PGASensorManager::collectSensorResults() {
         dist = static_cast<uint16_t>(usResults[0].distance);
       }
       sensor->rawDistance = dist;
-      sensor->median->addValue(dist);
-      sensorValues[sensorId] = sensor->distance = correctSensorOffset(medianMeasure(sensor, dist), sensor->offset);
+      sensor->median.addValue(dist);
+      sensorValues[sensorId] = sensor->distance = correctSensorOffset(sensor->filter.apply(dist), sensor->offset);
 
-      log_v("Raw sensor[%d] distance read %03u / %03u (%03u, %03u, %03u) -> *%03ucm*, duration: %zu us",
-        sensorId, sensor->rawDistance, dist, sensor->distances[0], sensor->distances[1],
-        sensor->distances[2], sensorValues[sensorId], usResults[0].tof);
+      log_v("Raw sensor[%d] distance read %03u / %03u -> *%03ucm*, duration: %zu us",
+        sensorId, sensor->rawDistance, dist, sensorValues[sensorId], usResults[0].tof);
 
       if (sensor->distance > 0 && sensor->distance < sensor->minDistance) {
         sensor->minDistance = sensor->distance;
       }
+      if (sensorId == primarySensor) {
+        cadence.addReading(sensor->distance, millis());
+      }
 #if PGA_DUMP_ENABLE
     }
 #endif
@@ -523,6 +487,24 @@ bool PGASensorManager::collectSensorResults() {
   return validReading;
 }
 
+#if ECHO_OBJECTS_PER_MEASUREMENT > 0
+// Keep the detected objects, the PGA460 reports them ordered by time of flight.
+// Slots without an object (time of flight 0 or 0xffff) end the list.
+void PGASensorManager::storeEchoes(EchoProfile &profile, const PGAResult *usResults) {
+  profile.count = 0;
+  for(int obj = 0; obj < PGA_NUMBER_OF_OBJECTS; obj++)
+  {
+    const PGAResult &result = usResults[obj];
+    if(result.tof == 0 || result.tof == 0xffff)
+      break;
+    EchoObject &object = profile.objects[profile.count++];
+    object.tofMicroSeconds = result.tof;
+    object.widthMicroSeconds = result.width;
+    object.peakAmplitude = result.peakAmplitude;
+  }
+}
+#endif
+
 // Store the relative times of this reading (a pair of measurements?)
 void PGASensorManager::registerReadings() {
   startOffsetMilliseconds[lastReadingCount] = millisSince(startReadingMilliseconds);
@@ -551,38 +533,4 @@ uint16_t PGASensorManager::correctSensorOffset(uint16_t dist, uint16_t offset) {
   return result;
 }
 
-uint16_t PGASensorManager::medianMeasure(PGASensorInfo *const sensor, uint16_t value) {
-  sensor->distances[sensor->nextMedianDistance] = value;
-  sensor->nextMedianDistance++;
-
-  // if we got "fantom" measures, they are <= the current measures, so remove
-  // all values <= the current measure from the median data
-  for (unsigned short & distance : sensor->distances) {
-    if (distance < value) {
-      distance = value;
-    }
-  }
-  if (sensor->nextMedianDistance >= MEDIAN_DISTANCE_MEASURES) {
-    sensor->nextMedianDistance = 0;
-  }
-  return median(sensor->distances[0], sensor->distances[1], sensor->distances[2]);
-}
-
-uint16_t PGASensorManager::median(uint16_t a, uint16_t b, uint16_t c) {
-  if (a < b) {
-    if (a >= c) {
-      return a;
-    } else if (b < c) {
-      return b;
-    }
-  } else {
-    if (a < c) {
-      return a;
-    } else if (b >= c) {
-      return b;
-    }
-  }
-  return c;
-}
-
 #endif  // OBSPro
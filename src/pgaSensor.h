@@ -2,6 +2,11 @@
 #include <vector>
 #include "variant.h"
 #include "utils/median.h"
+#include "utils/distancefilter.h"
+#include "utils/soundspeed.h"
+#include "utils/echoprofile.h"
+#include "cadence.h"
+#include "pgatransport.h"
 
 #ifndef OBS_PGASENSOR_H
 #define OBS_PGASENSOR_H
@@ -55,6 +60,7 @@
 #define PGA_IO_DIS(val) ((val&0x01) << 5)
 #define P1_PULSE(val) (val&0x1f)
 #define PGA_REG_PULSE_P2  0x1f
+#define P2_PULSE(val) (val&0x1f)
 #define PGA_REG_CURR_LIM_P1  0x20
 #define PGA_DIS_CL(val) ((val&0x01) << 7)  // Disable Current Limit for Preset1 and Preset2
 #define PGA_CURR_LIM1(val) (val&0x3f)  // Current_Limit = 7 × CURR_LIM1 + 50 [mA]
@@ -138,19 +144,35 @@
 #define PGA_REG_THR_CRC  0x7f
 
 #define PGA_DIAG_BUSY_MASK  0x01
+#ifndef PGA_DUMP_ENABLE
 #define PGA_DUMP_ENABLE 0  // Prints raw data of the measurements, for debugging or calibration of a new transducer
+#endif
 #define PGA_DUMP_TIME  500   // Period for dumping a complete raw data measurement (RX amplitude over time)
 
+// Adaptive cadence, preset 1 listens for the full range, preset 2 is used while a target is tracked
+#define PGA_P1_REC_LENGTH  8  // 36.9ms = 6m range
+#define PGA_P2_REC_LENGTH  3  // 16.4ms = 2.8m range
+#define PGA_IDLE_CYCLE_MS  150  // In idle cadence a new cycle of both sensors is started at most every 150ms
+
+// Objects detected per burst-and-listen (1..8), the nearest one is used as distance
+#if ECHO_OBJECTS_PER_MEASUREMENT > 0
+#define PGA_NUMBER_OF_OBJECTS  ECHO_OBJECTS_PER_MEASUREMENT
+#else
+#define PGA_NUMBER_OF_OBJECTS  1
+#endif
+
 
 struct PGASensorInfo
 {
   // General stuff
   uint16_t numberOfTriggers;
   int32_t echoDurationMicroseconds[MAX_NUMBER_MEASUREMENTS_PER_INTERVAL + 1];
-  Median<uint16_t>*median = nullptr;
+#if ECHO_OBJECTS_PER_MEASUREMENT > 0
+  EchoProfile echoes[MAX_NUMBER_MEASUREMENTS_PER_INTERVAL + 1];
+#endif
+  Median<uint16_t, RAW_MEDIAN_DISTANCE_MEASURES> median{MAX_SENSOR_VALUE};
   uint16_t rawDistance = 0;  // Current distance value in cm
-  uint16_t distances[MEDIAN_DISTANCE_MEASURES] = { MAX_SENSOR_VALUE, MAX_SENSOR_VALUE, MAX_SENSOR_VALUE };
-  uint16_t nextMedianDistance = 0;
+  SensorDistanceFilter filter;
   uint16_t minDistance = MAX_SENSOR_VALUE;
   uint16_t distance = MAX_SENSOR_VALUE;
   const char* sensorLocation;
@@ -308,8 +330,11 @@ public:
   uint16_t getCurrentMeasureIndex();
 
   void setOffsets(std::vector<uint16_t> offsets);
+  void setDistanceFilter(const DistanceFilterConfig &config);
   void setPrimarySensor(uint8_t idx);
   void reset(uint32_t startMillisTicks);
+  void setTemperature(float celsius);
+  uint16_t getMicroSecToCmDividerCenti() const;
 
   // TODO: This is just legacy interrupt stuff for the HCSR04 sensor - not required for PGA460
   void detachInterrupts() {};
@@ -324,6 +349,8 @@ public:
   uint32_t getNumberOfLowAfterMeasurement(const uint8_t sensorId) { return 0; };
   uint32_t getNumberOfToLongMeasurement(const uint8_t sensorId) { return 0; };
   uint32_t getNumberOfInterruptAdjustments(const uint8_t sensorId) { return 0; };
+  uint32_t getNumberOfCrossTalkRejections(const uint8_t sensorId) { return 0; };
+  CadenceMode getCadenceMode() const;
 
   // TODO: These variables should not be public!
   PGASensorInfo m_sensors[NUMBER_OF_TOF_SENSORS];
@@ -337,7 +364,7 @@ protected:
   void safe_usleep(unsigned long us);
 
   // Synchronous UART mode (aka SPI without chip-select)
-  uint8_t spiTransfer(uint8_t sensorId, uint8_t data_out);
+  PGATransport * const transport;
   int spiRegRead(uint8_t sensorId, uint8_t reg_addr, uint8_t *pdiag = nullptr);
   void spiRegWrite(uint8_t sensorId, uint8_t reg_addr, uint8_t value);
   void spiRegWriteGains(uint8_t sensorId, PGATVGain &gains);
@@ -347,27 +374,25 @@ protected:
   bool spiIsBusy(uint8_t sensorId);
   bool spiDataDump(const uint8_t sensorId, uint8_t *data);
 
-  // Checksum
-  uint8_t checksum_sum;
-  uint8_t checksum_carry;
-  uint8_t checksum_tmp_data;
-  uint8_t checksum_offset;
-  void checksum_clear();
-  void checksum_append_bit(uint8_t val);
-  void checksum_append_byte(uint8_t val);
-  uint8_t checksum_get();
+  static uint8_t checksum(const uint8_t *data, size_t length);
 
   // Alternating state
   unsigned long lastTriggerTimeMs;
+  MeasurementCadence cadence;
   uint8_t lastSensor = 1;
   uint8_t primarySensor = 1;
   uint32_t startReadingMilliseconds = 0;
+  // reported as factor also without temperature, like the former fixed 58
+  uint16_t microSecToCmDividerCenti = SoundSpeed::DEFAULT_MICRO_SEC_TO_CM_DIVIDER_CENTI;
+  bool temperatureSet = false;
+  uint16_t toCentimeter(uint16_t tof) const;
   bool collectSensorResults();
   void registerReadings();
+#if ECHO_OBJECTS_PER_MEASUREMENT > 0
+  static void storeEchoes(EchoProfile &profile, const PGAResult *usResults);
+#endif
   uint16_t millisSince(uint16_t milliseconds);
   uint16_t correctSensorOffset(uint16_t dist, uint16_t offset);
-  static uint16_t medianMeasure(PGASensorInfo* const sensor, uint16_t value);
-  static uint16_t median(uint16_t a, uint16_t b, uint16_t c);
 };
 
 #endif  // OBSPRO
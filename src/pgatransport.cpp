@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#include "pgatransport.h"
+#include <esp32-hal-spi.h>
+
+#ifdef OBSPRO
+
+PGATransport *PGATransport::create() {
+#if PGA_TRANSPORT_HARDWARE_SPI
+  return new PGAHardwareSpiTransport;
+#else
+  return new PGABitBangTransport;
+#endif
+}
+
+bool PGABitBangTransport::attach(uint8_t idx, uint8_t sckPin, uint8_t mosiPin, uint8_t misoPin) {
+  mPins[idx] = {sckPin, mosiPin, misoPin};
+  digitalWrite(sckPin, LOW);
+  pinMode(sckPin, OUTPUT);
+  pinMode(mosiPin, OUTPUT);
+  pinMode(misoPin, INPUT);
+  return true;
+}
+
+void PGABitBangTransport::transfer(uint8_t idx, const uint8_t *tx, uint8_t *rx, size_t length) {
+  const Pins &pins = mPins[idx];
+  for (size_t pos = 0; pos < length; pos++) {
+    uint8_t dataOut = tx[pos];
+    uint8_t dataIn = 0;
+    for (uint8_t i = 0; i < 8; i++) {
+      // It seems that the datasheet is wrong about the SPI mode...
+      // It says: ... with data set on the rising edge of the clock and sampled on the falling edge of the clock
+      // But we have to set the data before the rising edge.
+      digitalWrite(pins.mosi, dataOut & 0x01);
+      dataOut >>= 1;
+      digitalWrite(pins.sck, HIGH);
+      dataIn >>= 1;
+      dataIn |= digitalRead(pins.miso) << 7;
+      digitalWrite(pins.sck, LOW);
+    }
+    if (rx) {
+      rx[pos] = dataIn;
+    }
+  }
+}
+
+const char *PGABitBangTransport::getName() const {
+  return "bit-bang";
+}
+
+bool PGAHardwareSpiTransport::attach(uint8_t idx, uint8_t sckPin, uint8_t mosiPin, uint8_t misoPin) {
+  if (!mSpi) {
+    mSpi = spiStartBus(HSPI, spiFrequencyToClockDiv(PGA_SPI_FREQUENCY), SPI_MODE0, SPI_LSBFIRST);
+    if (!mSpi) {
+      log_e("Failed to start HSPI bus for PGA460 sensors.");
+      return false;
+    }
+  }
+  if (mRoutedIdx == idx) {
+    release(idx);
+  }
+  mPins[idx] = {sckPin, mosiPin, misoPin};
+  digitalWrite(sckPin, LOW);
+  pinMode(sckPin, OUTPUT);
+  pinMode(mosiPin, OUTPUT);
+  pinMode(misoPin, INPUT);
+  return true;
+}
+
+void PGAHardwareSpiTransport::transfer(uint8_t idx, const uint8_t *tx, uint8_t *rx, size_t length) {
+  if (mRoutedIdx != idx) {
+    if (mRoutedIdx >= 0) {
+      release(mRoutedIdx);
+    }
+    route(idx);
+  }
+  // Transfers up to 64 bytes per FIFO fill, our frames are at most 132
+  // bytes (data dump) so DMA setup would cost more than it saves.
+  spiTransferBytes(mSpi, tx, rx, length);
+}
+
+void PGAHardwareSpiTransport::route(uint8_t idx) {
+  const Pins &pins = mPins[idx];
+  spiAttachSCK(mSpi, pins.sck);
+  spiAttachMOSI(mSpi, pins.mosi);
+  spiAttachMISO(mSpi, pins.miso);
+  mRoutedIdx = idx;
+}
+
+void PGAHardwareSpiTransport::release(uint8_t idx) {
+  const Pins &pins = mPins[idx];
+  spiDetachSCK(mSpi, pins.sck);
+  spiDetachMOSI(mSpi, pins.mosi);
+  spiDetachMISO(mSpi, pins.miso);
+  // detach leaves the pins floating, keep the idle levels of the bus
+  digitalWrite(pins.sck, LOW);
+  pinMode(pins.sck, OUTPUT);
+  digitalWrite(pins.mosi, LOW);
+  pinMode(pins.mosi, OUTPUT);
+  mRoutedIdx = -1;
+}
+
+const char *PGAHardwareSpiTransport::getName() const {
+  return "hardware spi";
+}
+
+#endif  // OBSPRO
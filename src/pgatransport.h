@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OBS_PGATRANSPORT_H
+#define OBS_PGATRANSPORT_H
+
+#include <Arduino.h>
+#include "variant.h"
+
+#ifdef OBSPRO  // PGA460 sensors are only available on OBSPro
+
+/* Select the backend that talks to the PGA460 in synchronous UART mode.
+ * If set to 1 the HSPI peripheral shifts the frames, 0 toggles the pins
+ * with digitalWrite()/digitalRead().
+ */
+#ifndef PGA_TRANSPORT_HARDWARE_SPI
+#define PGA_TRANSPORT_HARDWARE_SPI 0
+#endif
+
+/* Clock of the synchronous UART, the PGA460 supports up to 1MHz. */
+#ifndef PGA_SPI_FREQUENCY
+#define PGA_SPI_FREQUENCY 1000000
+#endif
+
+/* Shifts complete frames to and from the PGA460 sensors, the interface is
+ * full duplex so rx receives one byte for each byte sent. The data is
+ * transferred LSB first, set before the rising edge of the clock and
+ * sampled while the clock is high. Implementations must be
+ * interchangeable, a backend for host tests can answer the frames with a
+ * register model of the PGA460.
+ */
+class PGATransport {
+  public:
+    virtual ~PGATransport() = default;
+    /* Configure the pins of the given sensor, the clock idles low. */
+    virtual bool attach(uint8_t idx, uint8_t sckPin, uint8_t mosiPin, uint8_t misoPin) = 0;
+    /* rx can be nullptr if the answer is not of interest. */
+    virtual void transfer(uint8_t idx, const uint8_t *tx, uint8_t *rx, size_t length) = 0;
+    virtual const char *getName() const = 0;
+    static PGATransport *create();
+};
+
+/* Bit-banged transfer, costs about 3 GPIO calls per bit. */
+class PGABitBangTransport : public PGATransport {
+  public:
+    bool attach(uint8_t idx, uint8_t sckPin, uint8_t mosiPin, uint8_t misoPin) override;
+    void transfer(uint8_t idx, const uint8_t *tx, uint8_t *rx, size_t length) override;
+    const char *getName() const override;
+
+  private:
+    struct Pins {
+      uint8_t sck;
+      uint8_t mosi;
+      uint8_t miso;
+    };
+    Pins mPins[NUMBER_OF_TOF_SENSORS] = {};
+};
+
+struct spi_struct_t;
+
+/* The HSPI peripheral shifts the frames, the SD card uses VSPI. Both
+ * sensors have their own pins and no chip select, so the bus is routed
+ * to the pins of the addressed sensor through the GPIO matrix when the
+ * sensor changes.
+ */
+class PGAHardwareSpiTransport : public PGATransport {
+  public:
+    bool attach(uint8_t idx, uint8_t sckPin, uint8_t mosiPin, uint8_t misoPin) override;
+    void transfer(uint8_t idx, const uint8_t *tx, uint8_t *rx, size_t length) override;
+    const char *getName() const override;
+
+  private:
+    void route(uint8_t idx);
+    void release(uint8_t idx);
+
+    struct Pins {
+      uint8_t sck;
+      uint8_t mosi;
+      uint8_t miso;
+    };
+    Pins mPins[NUMBER_OF_TOF_SENSORS] = {};
+    spi_struct_t *mSpi = nullptr;
+    int8_t mRoutedIdx = -1;
+};
+
+#endif  // OBSPRO
+#endif
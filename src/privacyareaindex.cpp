@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#include "privacyareaindex.h"
+
+#include <algorithm>
+#include <cmath>
+#include "config.h"
+
+void PrivacyAreaIndex::build(const std::vector<PrivacyArea> &areas) {
+  mAreas.clear();
+  mCells.clear();
+  mLargeAreas.clear();
+  for (const PrivacyArea &pa : areas) {
+    if (mAreas.size() > UINT16_MAX) {
+      log_e("Too many privacy areas, ignoring the rest.");
+      break;
+    }
+    Area area;
+    area.latitude = pa.transformedLatitude;
+    area.longitude = pa.transformedLongitude;
+    area.radius = pa.radius;
+    const double angle = pa.radius / EARTH_RADIUS;
+    const double cosLatitude = cos(area.latitude * M_PI / 180.0);
+    // the longitude of points at the distance differs most where they
+    // touch the meridian, slightly widened against rounding
+    area.maxDeltaLatitude = angle * 180.0 / M_PI * 1.001 + 1e-6;
+    area.maxDeltaLongitude = sin(angle) < cosLatitude
+      ? asin(sin(angle) / cosLatitude) * 180.0 / M_PI * 1.001 + 1e-6 : 180.0;
+    area.metersPerDegreeLongitude = METERS_PER_DEGREE * cosLatitude;
+    // the flat earth distance uses the longitude scale of the center,
+    // within the area it is off by less than this
+    const double error = angle * (fabs(tan(area.latitude * M_PI / 180.0)) + 1.0) + 0.001;
+    if (error < 0.2) {
+      area.innerRadiusSquared = pow(pa.radius * (1.0 - error), 2);
+      area.outerRadiusSquared = pow(pa.radius * (1.0 + error), 2);
+    } else {
+      area.innerRadiusSquared = 0;
+      area.outerRadiusSquared = INFINITY;
+    }
+    const uint16_t index = mAreas.size();
+    mAreas.push_back(area);
+
+    const uint32_t firstRow = latitudeCell(area.latitude - area.maxDeltaLatitude);
+    const uint32_t lastRow = latitudeCell(area.latitude + area.maxDeltaLatitude);
+    const uint32_t firstColumn = longitudeCell(area.longitude - area.maxDeltaLongitude);
+    const uint32_t columns = (longitudeCell(area.longitude + area.maxDeltaLongitude)
+                              + LONGITUDE_CELLS - firstColumn) % LONGITUDE_CELLS + 1;
+    if (area.maxDeltaLongitude >= 90.0
+        || (lastRow - firstRow + 1) * columns > MAX_CELLS_PER_AREA) {
+      mLargeAreas.push_back(index);
+      continue;
+    }
+    for (uint32_t row = firstRow; row <= lastRow; row++) {
+      for (uint32_t column = 0; column < columns; column++) {
+        mCells.push_back({row * LONGITUDE_CELLS + (firstColumn + column) % LONGITUDE_CELLS, index});
+      }
+    }
+  }
+  std::sort(mCells.begin(), mCells.end(),
+            [](const Cell &a, const Cell &b) { return a.key < b.key; });
+  log_i("Indexed %u privacy areas in %u cells, %u large areas.",
+        mAreas.size(), mCells.size(), mLargeAreas.size());
+}
+
+bool PrivacyAreaIndex::contains(double latitude, double longitude) const {
+  for (const uint16_t area : mLargeAreas) {
+    if (isInside(mAreas[area], latitude, longitude)) {
+      return true;
+    }
+  }
+  const uint32_t key = latitudeCell(latitude) * LONGITUDE_CELLS + longitudeCell(longitude);
+  auto cell = std::lower_bound(mCells.begin(), mCells.end(), key,
+                               [](const Cell &c, uint32_t k) { return c.key < k; });
+  for (; cell != mCells.end() && cell->key == key; ++cell) {
+    if (isInside(mAreas[cell->area], latitude, longitude)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool PrivacyAreaIndex::isInside(const Area &area, double latitude, double longitude) {
+  const double deltaLatitude = fabs(latitude - area.latitude);
+  if (deltaLatitude > area.maxDeltaLatitude) {
+    return false;
+  }
+  double deltaLongitude = fabs(longitude - area.longitude);
+  if (deltaLongitude > 180.0) {
+    deltaLongitude = 360.0 - deltaLongitude;
+  }
+  if (deltaLongitude > area.maxDeltaLongitude) {
+    return false;
+  }
+  const double north = deltaLatitude * METERS_PER_DEGREE;
+  const double east = deltaLongitude * area.metersPerDegreeLongitude;
+  const double distanceSquared = north * north + east * east;
+  if (distanceSquared < area.innerRadiusSquared) {
+    return true;
+  }
+  if (distanceSquared > area.outerRadiusSquared) {
+    return false;
+  }
+  return haversine(latitude, longitude, area.latitude, area.longitude) < area.radius;
+}
+
+uint32_t PrivacyAreaIndex::latitudeCell(double latitude) {
+  const double cell = floor((latitude + 90.0) / CELL_DEGREES);
+  if (cell < 0) {
+    return 0;
+  }
+  return cell >= LATITUDE_CELLS ? LATITUDE_CELLS - 1 : (uint32_t) cell;
+}
+
+uint32_t PrivacyAreaIndex::longitudeCell(double longitude) {
+  const double cell = fmod(floor((longitude + 180.0) / CELL_DEGREES), LONGITUDE_CELLS);
+  return (uint32_t) (cell < 0 ? cell + LONGITUDE_CELLS : cell);
+}
+
+double PrivacyAreaIndex::haversine(double lat1, double lon1, double lat2, double lon2) {
+  // https://www.geeksforgeeks.org/haversine-formula-to-find-distance-between-two-points-on-a-sphere/
+  // distance between latitudes and longitudes
+  double dLat = (lat2 - lat1) * M_PI / 180.0;
+  double dLon = (lon2 - lon1) * M_PI / 180.0;
+
+  // convert to radians
+  lat1 = (lat1) * M_PI / 180.0;
+  lat2 = (lat2) * M_PI / 180.0;
+
+  // apply formulae
+  double a = pow(sin(dLat / 2), 2) + pow(sin(dLon / 2), 2) * cos(lat1) * cos(lat2);
+  double rad = 6371000;
+  double c = 2 * asin(sqrt(a));
+  return rad * c;
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OBS_PRIVACYAREAINDEX_H
+#define OBS_PRIVACYAREAINDEX_H
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+struct PrivacyArea;
+
+/* Finds the privacy areas around a position without looking at each.
+ * The areas are sorted into a grid of CELL_DEGREES cells, a position
+ * only checks the areas that overlap its cell. Each check is a bounding
+ * box and a flat earth distance, only positions close to the border of
+ * an area need the haversine distance.
+ */
+class PrivacyAreaIndex {
+  public:
+    /* Replaces the index with the transformed positions of the areas. */
+    void build(const std::vector<PrivacyArea> &areas);
+    /* True if the position is inside of one of the areas. */
+    bool contains(double latitude, double longitude) const;
+    /* Distance in meters on a sphere. */
+    static double haversine(double lat1, double lon1, double lat2, double lon2);
+
+  private:
+    struct Area {
+      double latitude;
+      double longitude;
+      float radius;
+      /* No point of the area is further away in latitude or longitude. */
+      float maxDeltaLatitude;
+      float maxDeltaLongitude;
+      float metersPerDegreeLongitude;
+      /* Squared flat earth distances that are inside or outside for sure. */
+      float innerRadiusSquared;
+      float outerRadiusSquared;
+    };
+    struct Cell {
+      uint32_t key;
+      uint16_t area;
+    };
+    static constexpr double EARTH_RADIUS = 6371000.0;
+    static constexpr double METERS_PER_DEGREE = EARTH_RADIUS * M_PI / 180.0;
+    static constexpr double CELL_DEGREES = 0.01;
+    static const uint32_t LATITUDE_CELLS = 18000;
+    static const uint32_t LONGITUDE_CELLS = 36000;
+    /* Larger areas are checked for each position instead. */
+    static const uint32_t MAX_CELLS_PER_AREA = 64;
+    static uint32_t latitudeCell(double latitude);
+    static uint32_t longitudeCell(double longitude);
+    static bool isInside(const Area &area, double latitude, double longitude);
+    std::vector<Area> mAreas;
+    /* Sorted by key, one entry per cell an area overlaps. */
+    std::vector<Cell> mCells;
+    std::vector<uint16_t> mLargeAreas;
+};
+
+#endif //OBS_PRIVACYAREAINDEX_H
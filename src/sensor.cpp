@@ -22,7 +22,6 @@
  */
 
 #include "sensor.h"
-#include "FunctionalInterrupt.h"
 /*
  * Sensor types:
  *  getLastDelayTillStartUs:
@@ -68,6 +67,47 @@ static const uint32_t SENSOR_QUIET_PERIOD_AFTER_START_MICRO_SEC = 35 * 1000;
 /* Value of HCSR04SensorInfo::end during an ongoing measurement. */
 static const uint32_t MEASUREMENT_IN_PROGRESS = 0;
 
+/* Interval of the trigger timer, this is also the length of the trigger
+ * pulse since the trigger pin is set back to LOW with the next tick.
+ */
+static const uint32_t TRIGGER_TIMER_TICK_MICRO_SEC = 200;
+
+/* Hardware timer used to trigger the sensors, timer 0 is reserved for
+ * power management.
+ */
+static const uint8_t TRIGGER_TIMER_NUMBER = 1;
+
+/* With parallel triggers the second sensor is triggered this number of
+ * timer ticks after the trigger pulse of the primary sensor ended. The
+ * offset changes from cycle to cycle, so a reading caused by the ping of
+ * the other sensor jumps by at least one tick (200us, ~3.5cm) between
+ * cycles while a real echo does not.
+ */
+static const uint8_t PARALLEL_TRIGGER_OFFSET_TICKS[] = { 1, 3, 2, 4 };
+
+/* The later triggered sensor is suspected to have received the ping of
+ * the other sensor, if both echos ended within this time. Must be less
+ * than the smallest trigger offset.
+ */
+static const uint32_t CROSS_TALK_WINDOW_MICRO_SEC = 300;
+
+/* A suspected reading is still accepted if its echo duration differs by
+ * less than this from the former reading of the sensor.
+ */
+static const uint32_t CROSS_TALK_TRACK_GATE_MICRO_SEC = 150;
+
+/* In tracking cadence the other sensor is only triggered after this number
+ * of cycles of the primary sensor, this nearly doubles the measurement rate
+ * on the side of the target.
+ */
+static const uint8_t TRACKING_PRIMARY_CYCLES_PER_SECONDARY = 3;
+
+/* In idle cadence a new cycle is started at most once within this time. */
+static const uint32_t IDLE_CYCLE_MICRO_SEC = 150 * 1000;
+
+/* Sensors triggered within this time are treated as triggered together. */
+static const uint32_t PARALLEL_TRIGGER_MAX_OFFSET_MICRO_SEC = 2000;
+
 /* Some calculations:
  *
  * Assumption:
@@ -97,8 +137,18 @@ static const uint32_t MEASUREMENT_IN_PROGRESS = 0;
  *    close to the needed 148ms
  */
 
-// Hack to get the pointers to the isr
-static HCSR04SensorInfo * TOF_SENSOR[NUMBER_OF_TOF_SENSORS];
+// Hack to get the pointer to the isr
+static HCSR04SensorManager * TRIGGER_TIMER_MANAGER;
+
+HCSR04SensorManager::HCSR04SensorManager() :
+  echoCapture(EchoCapture::create()) {
+}
+
+HCSR04SensorManager::~HCSR04SensorManager() {
+  stopTriggerTimer();
+  detachInterrupts();
+  delete echoCapture;
+}
 
 void HCSR04SensorManager::registerSensor(const HCSR04SensorInfo& sensorInfo, uint8_t idx) {
   if (idx >= NUMBER_OF_TOF_SENSORS) {
@@ -109,51 +159,40 @@ void HCSR04SensorManager::registerSensor(const HCSR04SensorInfo& sensorInfo, uin
   pinMode(sensorInfo.triggerPin, OUTPUT);
   pinMode(sensorInfo.echoPin, INPUT_PULLUP); // hint from https://youtu.be/xwsT-e1D9OY?t=354
   sensorValues[idx] = MAX_SENSOR_VALUE;
-  m_sensors[idx].median = new Median<uint16_t>(5, MAX_SENSOR_VALUE);
 
-  TOF_SENSOR[idx] = &m_sensors[idx];
+  log_i("Sensor %d echo is captured by %s.", idx, echoCapture->getName());
   attachSensorInterrupt(idx);
 }
 
-static void IRAM_ATTR isr(HCSR04SensorInfo* const sensor) {
-  // since the measurement of start and stop use the same interrupt
-  // mechanism we should see a similar delay.
+/* Called by the echo capture backend for each level change of the echo
+ * pin.
+ */
+void IRAM_ATTR HCSR04SensorManager::recordEdge(
+  HCSR04SensorInfo * const sensor, uint32_t micros, uint8_t level) {
+  if (!sensor->edges.push({micros, level})) {
+    sensor->numberOfLostEdges++;
+  }
+  // start and end are only used to schedule the next trigger, the
+  // measurement result is taken from the edges.
   if (sensor->end == MEASUREMENT_IN_PROGRESS) {
-    const uint32_t now = micros();
-    if (HIGH == digitalRead(sensor->echoPin)) {
-      sensor->start = now;
+    if (HIGH == level) {
+      sensor->start = micros;
     } else { // LOW
-      sensor->end = now;
+      sensor->end = micros;
     }
   }
 }
 
-static void IRAM_ATTR isr0() {
-  isr(TOF_SENSOR[0]);
-}
-
-static void IRAM_ATTR isr1() {
-  isr(TOF_SENSOR[1]);
-}
-
 void HCSR04SensorManager::attachSensorInterrupt(uint8_t idx) {
-  // bad bad bad ....
-  if (idx == 0) {
-    attachInterrupt(TOF_SENSOR[idx]->echoPin, isr0, CHANGE);
-  } else {
-    attachInterrupt(TOF_SENSOR[idx]->echoPin, isr1, CHANGE);
-  }
-
-  // a solution like below leads to crashes with:
-  // Guru Meditation Error: Core  1 panic'ed (Cache disabled but cached memory region accessed)
-  // Core 1 was running in ISR context:
-  //   attachInterrupt(sensorInfo.echoPin,
-  //                  std::bind(&isr, sensorInfo.echoPin, &sensorInfo.start, &sensorInfo.end), CHANGE);
+  echoCapture->attach(idx, &m_sensors[idx]);
 }
 
 void HCSR04SensorManager::detachInterrupts() {
-  for (auto & sensor : m_sensors) {
-    detachInterrupt(sensor.echoPin);
+  if (triggerTimer) {
+    timerAlarmDisable(triggerTimer);
+  }
+  for (size_t idx = 0; idx < NUMBER_OF_TOF_SENSORS; ++idx) {
+    echoCapture->detach(idx);
   }
 }
 
@@ -161,16 +200,27 @@ void HCSR04SensorManager::attachInterrupts() {
   for (size_t idx = 0; idx < NUMBER_OF_TOF_SENSORS; ++idx) {
     attachSensorInterrupt(idx);
   }
+  if (triggerTimer) {
+    timerAlarmEnable(triggerTimer);
+  }
 }
 
 void HCSR04SensorManager::reset(uint32_t startMillisTicks) {
   for (auto & sensor : m_sensors) {
     sensor.minDistance = MAX_SENSOR_VALUE;
     memset(&(sensor.echoDurationMicroseconds), 0, sizeof(sensor.echoDurationMicroseconds));
+  }
+  // the trigger timer isr counts the triggers
+  portENTER_CRITICAL(&triggerMux);
+  for (auto & sensor : m_sensors) {
     sensor.numberOfTriggers = 0;
   }
+  portEXIT_CRITICAL(&triggerMux);
   lastReadingCount = 0;
-  lastSensor = 1 - primarySensor;
+  cadence.resetInterval();
+  if (!triggerTimer) { // owned by the timer isr otherwise
+    lastSensor = 1 - primarySensor;
+  }
   memset(&(startOffsetMilliseconds), 0, sizeof(startOffsetMilliseconds));
   startReadingMilliseconds = startMillisTicks;
 }
@@ -185,6 +235,13 @@ void HCSR04SensorManager::setOffsets(std::vector<uint16_t> offsets) {
   }
 }
 
+void HCSR04SensorManager::setDistanceFilter(const DistanceFilterConfig &config) {
+  for (auto & sensor : m_sensors) {
+    sensor.filter.configure(config);
+    sensor.filter.reset();
+  }
+}
+
 /* The primary sensor defines the measurement interval, we trigger a measurement if this
  * sensor is ready.
  */
@@ -196,14 +253,18 @@ void HCSR04SensorManager::setPrimarySensor(uint8_t idx) {
  * method returns false.
  */
 bool HCSR04SensorManager::pollDistancesAlternating() {
+  if (triggerTimer) {
+    return collectTimerCycles();
+  }
   bool newMeasurements = false;
-  if (lastSensor == primarySensor && isReadyForStart(1 - primarySensor)) {
+  if (lastSensor == primarySensor && !isSecondarySkipped() && isReadyForStart(1 - primarySensor)) {
     setSensorTriggersToLow();
     lastSensor = 1 - primarySensor;
     sendTriggerToSensor(1 - primarySensor);
-  } else if (isReadyForStart(primarySensor)) {
+  } else if (isReadyForStart(primarySensor) && isIdleCyclePassed(micros())) {
     newMeasurements = collectSensorResults();
     setSensorTriggersToLow();
+    countPrimaryCycle();
     lastSensor = primarySensor;
     sendTriggerToSensor(primarySensor);
   }
@@ -219,7 +280,9 @@ bool HCSR04SensorManager::pollDistancesAlternating() {
  */
 bool HCSR04SensorManager::pollDistancesParallel() {
   bool newMeasurements = false;
-  if (isReadyForStart(primarySensor)) {
+  if (triggerTimer) {
+    log_e("Parallel polling is not supported while the trigger timer is active.");
+  } else if (isReadyForStart(primarySensor)) {
     setSensorTriggersToLow();
     newMeasurements = collectSensorResults();
     const bool secondSensorIsReady = isReadyForStart(1 - primarySensor);
@@ -240,18 +303,24 @@ uint16_t HCSR04SensorManager::getCurrentMeasureIndex() {
  */
 void HCSR04SensorManager::sendTriggerToSensor(uint8_t sensorId) {
   HCSR04SensorInfo * const sensor = &(m_sensors[sensorId]);
+  prepareTrigger(sensor, micros());
+  digitalWrite(sensor->triggerPin, HIGH);
+  // 10us are specified but some sensors are more stable with 20us according
+  // to internet reports
+  delayMicroseconds(200);
+  digitalWrite(sensor->triggerPin, LOW);
+}
+
+/* Prepares the measurement data structures, the trigger pin must be set
+ * to HIGH by the caller.
+ */
+void IRAM_ATTR HCSR04SensorManager::prepareTrigger(HCSR04SensorInfo * const sensor, uint32_t now) {
   updateStatistics(sensor);
   sensor->end = MEASUREMENT_IN_PROGRESS; // will be updated with LOW signal
   sensor->numberOfTriggers++;
   sensor->measurementRead = false;
-  const uint32_t now = micros();
   sensor->trigger = now; // will be updated with HIGH signal
   sensor->start = now;
-  digitalWrite(sensor->triggerPin, HIGH);
-  // 10us are specified but some sensors are more stable with 20us according
-  // to internet reports
-  delayMicroseconds(200);
-  digitalWrite(sensor->triggerPin, LOW);
 }
 
 /* Checks if the given sensor is ready for a new measurement cycle.
@@ -263,12 +332,7 @@ boolean HCSR04SensorManager::isReadyForStart(uint8_t sensorId) {
   const uint32_t start = sensor->start;
   const uint32_t end = sensor->end;
   if (end != MEASUREMENT_IN_PROGRESS) { // no measurement in flight or just finished
-    const uint32_t startOther = m_sensors[1 - sensorId].start;
-    if (   (microsBetween(now, end) > SENSOR_QUIET_PERIOD_AFTER_END_MICRO_SEC)
-        && (microsBetween(now, start) > SENSOR_QUIET_PERIOD_AFTER_START_MICRO_SEC)
-        && (microsBetween(now, startOther) > SENSOR_QUIET_PERIOD_AFTER_OPPOSITE_START_MICRO_SEC)) {
-      ready = true;
-    }
+    ready = quietPeriodsPassed(sensorId, now);
     if (digitalRead(sensor->echoPin) != LOW) {
       log_e("Measurement done, but echo pin is high for %s sensor", sensor->sensorLocation);
       sensor->numberOfLowAfterMeasurement++;
@@ -287,42 +351,387 @@ boolean HCSR04SensorManager::isReadyForStart(uint8_t sensorId) {
   return ready;
 }
 
+/* Same as isReadyForStart() but without logging so it can be used
+ * from within the trigger timer isr.
+ */
+boolean IRAM_ATTR HCSR04SensorManager::isReadyForTimerStart(uint8_t sensorId, uint32_t now) {
+  HCSR04SensorInfo * const sensor = &m_sensors[sensorId];
+  boolean ready = false;
+  if (sensor->end != MEASUREMENT_IN_PROGRESS) {
+    ready = quietPeriodsPassed(sensorId, now);
+    if (ready && digitalRead(sensor->echoPin) != LOW) {
+      sensor->numberOfLowAfterMeasurement++;
+    }
+  } else if (microsBetween(now, sensor->start) > MAX_TIMEOUT_MICRO_SEC) {
+    sensor->numberOfToLongMeasurement++;
+    ready = true;
+  }
+  return ready;
+}
+
+/* We do not start a new measurement within the quiet periods after the
+ * last start and end of this sensor, and the last start of the opposite
+ * sensor.
+ */
+boolean IRAM_ATTR HCSR04SensorManager::quietPeriodsPassed(uint8_t sensorId, uint32_t now) {
+  const HCSR04SensorInfo * const sensor = &m_sensors[sensorId];
+  return (microsBetween(now, sensor->end) > SENSOR_QUIET_PERIOD_AFTER_END_MICRO_SEC)
+    && (microsBetween(now, sensor->start) > SENSOR_QUIET_PERIOD_AFTER_START_MICRO_SEC)
+    && (parallelTrigger
+      || microsBetween(now, m_sensors[1 - sensorId].start) > SENSOR_QUIET_PERIOD_AFTER_OPPOSITE_START_MICRO_SEC);
+}
+
+static void IRAM_ATTR onTriggerTimerIsr() {
+  TRIGGER_TIMER_MANAGER->onTriggerTimer();
+}
+
+bool HCSR04SensorManager::startTriggerTimer() {
+  if (triggerTimer) {
+    return true;
+  }
+  setSensorTriggersToLow();
+  TRIGGER_TIMER_MANAGER = this;
+  triggerHighSensor = -1;
+  delayedTriggerSensor = -1;
+  cycleReadPos = cycleWritePos = 0;
+  lastSensor = 1 - primarySensor;
+  // 80MHz / 80 -> 1 tick per micro second
+  triggerTimer = timerBegin(TRIGGER_TIMER_NUMBER, 80, true);
+  if (!triggerTimer) {
+    log_e("Failed to setup trigger timer, will poll the sensors.");
+    return false;
+  }
+  timerAttachInterrupt(triggerTimer, &onTriggerTimerIsr, true);
+  timerAlarmWrite(triggerTimer, TRIGGER_TIMER_TICK_MICRO_SEC, true);
+  timerAlarmEnable(triggerTimer);
+  log_i("Sensors are triggered %s by timer %d every %uus.",
+        parallelTrigger ? "in parallel" : "alternating",
+        TRIGGER_TIMER_NUMBER, TRIGGER_TIMER_TICK_MICRO_SEC);
+  return true;
+}
+
+void HCSR04SensorManager::stopTriggerTimer() {
+  if (triggerTimer) {
+    timerAlarmDisable(triggerTimer);
+    timerDetachInterrupt(triggerTimer);
+    timerEnd(triggerTimer);
+    triggerTimer = nullptr;
+    setSensorTriggersToLow();
+    // measurements that are not collected by now are lost
+    cycleReadPos = cycleWritePos;
+  }
+}
+
+void HCSR04SensorManager::setParallelTrigger(bool parallel) {
+  if (triggerTimer) {
+    log_e("Trigger mode can not be changed while the trigger timer is active.");
+    return;
+  }
+  parallelTrigger = parallel;
+}
+
+bool HCSR04SensorManager::isTriggeredByTimer() const {
+  return triggerTimer != nullptr;
+}
+
+uint32_t HCSR04SensorManager::getNumberOfLostCycles() const {
+  return numberOfLostCycles;
+}
+
+void IRAM_ATTR HCSR04SensorManager::onTriggerTimer() {
+  portENTER_CRITICAL_ISR(&triggerMux);
+  onTriggerTick();
+  portEXIT_CRITICAL_ISR(&triggerMux);
+}
+
+/* Runs the alternating trigger schedule from the timer isr, see
+ * pollDistancesAlternating(). Each tick either ends a trigger pulse or
+ * starts the next one if the quiet periods of the sensor are over.
+ */
+void IRAM_ATTR HCSR04SensorManager::onTriggerTick() {
+  const int8_t highSensor = triggerHighSensor;
+  if (highSensor >= 0) {
+    digitalWrite(m_sensors[highSensor].triggerPin, LOW);
+    triggerHighSensor = -1;
+    return;
+  }
+  const uint32_t now = micros();
+  if (parallelTrigger) {
+    onParallelTriggerTimer(now);
+    return;
+  }
+  uint8_t sensorId;
+  if (lastSensor == primarySensor && !isSecondarySkipped()
+      && isReadyForTimerStart(1 - primarySensor, now)) {
+    sensorId = 1 - primarySensor;
+  } else if (isReadyForTimerStart(primarySensor, now) && isIdleCyclePassed(now)) {
+    captureCycle(now);
+    countPrimaryCycle();
+    sensorId = primarySensor;
+  } else {
+    return;
+  }
+  lastSensor = sensorId;
+  startTimerTrigger(sensorId, now);
+}
+
+/* Parallel schedule, once both sensors are ready the primary sensor is
+ * triggered and the other one follows with the next offset from
+ * PARALLEL_TRIGGER_OFFSET_TICKS.
+ */
+void IRAM_ATTR HCSR04SensorManager::onParallelTriggerTimer(uint32_t now) {
+  const int8_t delayedSensor = delayedTriggerSensor;
+  if (delayedSensor >= 0) {
+    const uint8_t ticks = delayedTriggerTicks - 1;
+    delayedTriggerTicks = ticks;
+    if (ticks == 0) {
+      delayedTriggerSensor = -1;
+      startTimerTrigger(delayedSensor, now);
+    }
+    return;
+  }
+  if (isReadyForTimerStart(primarySensor, now)
+      && isReadyForTimerStart(1 - primarySensor, now)
+      && isIdleCyclePassed(now)) {
+    captureCycle(now);
+    startTimerTrigger(primarySensor, now);
+    delayedTriggerTicks = PARALLEL_TRIGGER_OFFSET_TICKS[triggerOffsetIndex];
+    delayedTriggerSensor = 1 - primarySensor;
+    if (++triggerOffsetIndex >= sizeof(PARALLEL_TRIGGER_OFFSET_TICKS)) {
+      triggerOffsetIndex = 0;
+    }
+  }
+}
+
+/* While a target is tracked the other sensor is left out for some cycles
+ * of the primary sensor.
+ */
+boolean IRAM_ATTR HCSR04SensorManager::isSecondarySkipped() {
+  return cadenceMode == CadenceTracking
+    && primaryCyclesSinceSecondary < TRACKING_PRIMARY_CYCLES_PER_SECONDARY;
+}
+
+/* In idle cadence a new cycle of the primary sensor waits at least
+ * IDLE_CYCLE_MICRO_SEC since the former one.
+ */
+boolean IRAM_ATTR HCSR04SensorManager::isIdleCyclePassed(uint32_t now) {
+  return cadenceMode != CadenceIdle
+    || microsBetween(now, m_sensors[primarySensor].trigger) >= IDLE_CYCLE_MICRO_SEC;
+}
+
+/* Must be called before lastSensor is set to the primary sensor. */
+void IRAM_ATTR HCSR04SensorManager::countPrimaryCycle() {
+  if (lastSensor == primarySensor) {
+    if (primaryCyclesSinceSecondary < UINT8_MAX) {
+      primaryCyclesSinceSecondary++;
+    }
+  } else {
+    primaryCyclesSinceSecondary = 1;
+  }
+}
+
+/* Starts the trigger pulse, it ends with the next timer tick. */
+void IRAM_ATTR HCSR04SensorManager::startTimerTrigger(uint8_t sensorId, uint32_t now) {
+  HCSR04SensorInfo * const sensor = &m_sensors[sensorId];
+  prepareTrigger(sensor, now);
+  digitalWrite(sensor->triggerPin, HIGH);
+  triggerHighSensor = sensorId;
+}
+
+/* Called from the timer isr, stores the timing of all finished and not yet
+ * collected measurements for the main loop.
+ */
+void IRAM_ATTR HCSR04SensorManager::captureCycle(uint32_t now) {
+  const uint8_t writePos = cycleWritePos;
+  const uint8_t nextWritePos = (writePos + 1) % HCSR04_CYCLE_BUFFER_SIZE;
+  HCSR04MeasurementCycle * const cycle = &cycles[writePos];
+  for (size_t idx = 0; idx < NUMBER_OF_TOF_SENSORS; ++idx) {
+    captureTiming(&m_sensors[idx], &cycle->timing[idx], now);
+  }
+  if (nextWritePos == cycleReadPos) {
+    // main loop did not collect in time, the data of this cycle is lost
+    numberOfLostCycles++;
+    return;
+  }
+  cycle->capturedMicros = now;
+  cycle->capturedMillis = (uint16_t) millis();
+  cycleWritePos = nextWritePos;
+}
+
+/* Copies the current timing values of the sensor, if the measurement is
+ * complete it is flagged as read so it is only collected once.
+ */
+void IRAM_ATTR HCSR04SensorManager::captureTiming(
+  HCSR04SensorInfo * const sensor, HCSR04EchoTiming * const timing, uint32_t now) {
+  timing->trigger = sensor->trigger;
+  timing->start = sensor->start;
+  timing->end = sensor->end;
+  timing->pending = !sensor->measurementRead && isEchoComplete(*timing, now);
+  if (timing->pending) {
+    sensor->measurementRead = true;
+  }
+}
+
+/* Collects the results of all cycles completed by the trigger timer since
+ * the last call.
+ */
+bool HCSR04SensorManager::collectTimerCycles() {
+  bool newMeasurements = false;
+  while (cycleReadPos != cycleWritePos) {
+    const HCSR04MeasurementCycle * const cycle = &cycles[cycleReadPos];
+    HCSR04EchoTiming timing[NUMBER_OF_TOF_SENSORS];
+    memcpy(timing, cycle->timing, sizeof(timing));
+    for (size_t idx = 0; idx < NUMBER_OF_TOF_SENSORS; ++idx) {
+      if (timing[idx].pending) {
+        resolveEdges(&m_sensors[idx], &timing[idx], cycle->capturedMicros);
+      }
+    }
+    if (parallelTrigger) {
+      rejectCrossTalk(timing);
+    }
+    bool validReading = false;
+    for (size_t idx = 0; idx < NUMBER_OF_TOF_SENSORS; ++idx) {
+      if (timing[idx].pending
+          && collectSensorResult(idx, timing, cycle->capturedMicros)) {
+        validReading = true;
+      }
+    }
+    if (validReading) {
+      registerReadings(cycle->capturedMillis);
+      newMeasurements = true;
+    }
+    cycleReadPos = (cycleReadPos + 1) % HCSR04_CYCLE_BUFFER_SIZE;
+  }
+  return newMeasurements;
+}
+
 bool HCSR04SensorManager::collectSensorResults() {
   bool validReading = false;
+  const uint32_t now = micros();
+  HCSR04EchoTiming timing[NUMBER_OF_TOF_SENSORS];
   for (size_t idx = 0; idx < NUMBER_OF_TOF_SENSORS; ++idx) {
-    if (collectSensorResult(idx)) {
+    captureTiming(&m_sensors[idx], &timing[idx], now);
+    if (timing[idx].pending) {
+      resolveEdges(&m_sensors[idx], &timing[idx], now);
+    }
+  }
+  for (size_t idx = 0; idx < NUMBER_OF_TOF_SENSORS; ++idx) {
+    if (timing[idx].pending && collectSensorResult(idx, timing, now)) {
       validReading = true;
     }
   }
   if (validReading) {
-    registerReadings();
+    registerReadings((uint16_t) millis());
   }
   return validReading;
 }
 
-void HCSR04SensorManager::registerReadings() {
-  startOffsetMilliseconds[lastReadingCount] = millisSince(startReadingMilliseconds);
+void HCSR04SensorManager::registerReadings(uint16_t millisTicks) {
+  startOffsetMilliseconds[lastReadingCount] =
+    millisBetween(millisTicks, startReadingMilliseconds);
   if (lastReadingCount < MAX_NUMBER_MEASUREMENTS_PER_INTERVAL - 1) {
     lastReadingCount++;
   }
 }
 
-/* Returns true if there was a no timeout reading. */
-bool HCSR04SensorManager::collectSensorResult(uint8_t sensorId) {
-  HCSR04SensorInfo* const sensor = &m_sensors[sensorId];
-  if (sensor->measurementRead) {
-    return false; // already read
+/* Consumes the recorded echo edges of the measurement started with
+ * timing->trigger and received before `until`. The first rising and the
+ * following falling edge replace the start and end values captured from
+ * the isr. Edges of former measurements are dropped, edges of the
+ * following measurement stay in the buffer. If no edges were recorded,
+ * e.g. because the buffer overflowed, the captured values are kept.
+ */
+void HCSR04SensorManager::resolveEdges(
+  HCSR04SensorInfo * const sensor, HCSR04EchoTiming * const timing, uint32_t until) {
+  EchoEdge edge;
+  bool risingSeen = false;
+  bool fallingSeen = false;
+  uint32_t start = timing->trigger;
+  uint32_t end = MEASUREMENT_IN_PROGRESS;
+  while (sensor->edges.peek(edge)) {
+    if (!isBefore(edge.micros, until)) {
+      break; // belongs to the next measurement
+    }
+    sensor->edges.pop(edge);
+    if (isBefore(edge.micros, timing->trigger) || fallingSeen) {
+      continue; // former measurement or noise after the echo
+    }
+    if (edge.level == HIGH) {
+      if (!risingSeen) {
+        start = edge.micros;
+        risingSeen = true;
+      }
+    } else {
+      // a falling edge without a rising edge is the lost interrupt case
+      // handled in getFixedStart(), start stays at the trigger time then
+      end = edge.micros;
+      fallingSeen = true;
+    }
   }
+  if (risingSeen || fallingSeen) {
+    timing->start = start;
+    timing->end = end;
+  }
+}
+
+/* With parallel triggers the later triggered sensor can receive the ping
+ * of the other sensor before its own echo. Its echo then ends at about the
+ * same time as the one of the other sensor although it was triggered
+ * later, and it reads too short by the trigger offset, which changes with
+ * every cycle. Such a reading is dropped unless its duration matches the
+ * former reading of the sensor. The earlier triggered sensor would read
+ * too long in the opposite case, its own echo is usually received first.
+ */
+void HCSR04SensorManager::rejectCrossTalk(HCSR04EchoTiming * const timing) {
+  const uint8_t later = isBefore(timing[0].trigger, timing[1].trigger) ? 1 : 0;
+  const HCSR04EchoTiming &own = timing[later];
+  const HCSR04EchoTiming &other = timing[1 - later];
+  if (!own.pending || own.end == MEASUREMENT_IN_PROGRESS) {
+    return;
+  }
+  HCSR04SensorInfo * const sensor = &m_sensors[later];
+  const uint32_t duration = microsBetween(own.end, own.start);
+  if (other.end != MEASUREMENT_IN_PROGRESS
+      && microsBetween(own.trigger, other.trigger) < PARALLEL_TRIGGER_MAX_OFFSET_MICRO_SEC
+      && microsBetween(own.end, other.end) < CROSS_TALK_WINDOW_MICRO_SEC
+      && microsBetween(duration, sensor->trackDurationUs) >= CROSS_TALK_TRACK_GATE_MICRO_SEC) {
+    timing[later].pending = false;
+    sensor->numberOfCrossTalkRejections++;
+    log_d("Dropped cross-talk reading of %s sensor, %uus echo ended %dus after the other sensor.",
+          sensor->sensorLocation, duration, (int32_t) (own.end - other.end));
+  } else {
+    // only kept readings are tracked, a cross-talk reading must not
+    // become the reference for the next one
+    sensor->trackDurationUs = duration;
+  }
+}
+
+/* Compares 2 micros() values taking the overflow into account. */
+bool HCSR04SensorManager::isBefore(uint32_t a, uint32_t b) {
+  return (int32_t) (a - b) < 0;
+}
+
+/* A measurement is complete if the echo is received or if we do not want
+ * to wait any longer.
+ */
+bool IRAM_ATTR HCSR04SensorManager::isEchoComplete(const HCSR04EchoTiming &timing, uint32_t now) {
+  return timing.end != MEASUREMENT_IN_PROGRESS
+    || microsBetween(now, timing.start) >= MAX_DURATION_MICRO_SEC;
+}
+
+/* Returns true if there was a no timeout reading. The timing must be
+ * complete, see isEchoComplete().
+ */
+bool HCSR04SensorManager::collectSensorResult(
+  uint8_t sensorId, const HCSR04EchoTiming * const timing, uint32_t now) {
+  HCSR04SensorInfo* const sensor = &m_sensors[sensorId];
   bool validReading = false;
-  const uint32_t end = sensor->end;
-  const uint32_t start = getFixedStart(sensorId, sensor);
+  const uint32_t end = timing[sensorId].end;
+  const uint32_t start = getFixedStart(sensorId, timing);
   uint32_t duration;
   if (end == MEASUREMENT_IN_PROGRESS) {
-    duration = microsSince(start);
-    if (duration < MAX_DURATION_MICRO_SEC) {
-      return false;  // still measuring
-    }
     // measurement is still in flight! But the time we want to wait is up (> MAX_DURATION_MICRO_SEC)
+    duration = microsBetween(now, start);
     sensor->echoDurationMicroseconds[lastReadingCount] = -1;
   } else {
     duration = microsBetween(start, end);
@@ -333,26 +742,28 @@ bool HCSR04SensorManager::collectSensorResult(uint8_t sensorId) {
     dist = MAX_SENSOR_VALUE;
   } else {
     validReading = true;
-    dist = static_cast<uint16_t>(duration / MICRO_SEC_TO_CM_DIVIDER);
+    dist = SoundSpeed::toCentimeter(duration, microSecToCmDividerCenti);
   }
   sensor->rawDistance = dist;
-  sensor->median->addValue(dist);
+  sensor->median.addValue(dist);
   sensorValues[sensorId] =
-    sensor->distance = correctSensorOffset(medianMeasure(sensor, dist), sensor->offset);
+    sensor->distance = correctSensorOffset(sensor->filter.apply(dist), sensor->offset);
 
-  log_v("Raw sensor[%d] distance read %03u / %03u (%03u, %03u, %03u) -> *%03ucm*, duration: %zu us - echo pin state: %d",
-    sensorId, sensor->rawDistance, dist, sensor->distances[0], sensor->distances[1],
-    sensor->distances[2], sensorValues[sensorId], duration, digitalRead(sensor->echoPin));
+  log_v("Raw sensor[%d] distance read %03u / %03u -> *%03ucm*, duration: %zu us - echo pin state: %d",
+    sensorId, sensor->rawDistance, dist, sensorValues[sensorId], duration, digitalRead(sensor->echoPin));
 
   if (sensor->distance > 0 && sensor->distance < sensor->minDistance) {
     sensor->minDistance = sensor->distance;
   }
-  sensor->measurementRead = true;
+  if (sensorId == primarySensor) {
+    cadence.addReading(sensor->distance, millis());
+    cadenceMode = cadence.getMode();
+  }
   return validReading;
 }
 
 uint16_t HCSR04SensorManager::getRawMedianDistance(uint8_t sensorId) {
- return m_sensors[sensorId].median->median();
+ return m_sensors[sensorId].median.median();
 }
 
 uint32_t HCSR04SensorManager::getMaxDurationUs(uint8_t sensorId) {
@@ -383,23 +794,48 @@ uint32_t HCSR04SensorManager::getNumberOfInterruptAdjustments(const uint8_t sens
   return m_sensors[sensorId].numberOfInterruptAdjustments;
 }
 
+uint32_t HCSR04SensorManager::getNumberOfLostEdges(const uint8_t sensorId) {
+  return m_sensors[sensorId].numberOfLostEdges;
+}
+
+uint32_t HCSR04SensorManager::getNumberOfCrossTalkRejections(const uint8_t sensorId) {
+  return m_sensors[sensorId].numberOfCrossTalkRejections;
+}
+
+CadenceMode HCSR04SensorManager::getCadenceMode() const {
+  return cadence.getIntervalMode();
+}
+
+void HCSR04SensorManager::setTemperature(float celsius) {
+  microSecToCmDividerCenti = SoundSpeed::microSecToCmDividerCenti(celsius);
+  for (auto & sensor : m_sensors) {
+    sensor.filter.setMicroSecToCmDividerCenti(microSecToCmDividerCenti);
+  }
+}
+
+uint16_t HCSR04SensorManager::getMicroSecToCmDividerCenti() const {
+  return microSecToCmDividerCenti;
+}
+
 /* During debugging I observed readings that did not get `start` updated
  * By the interrupt. Since we also set start when we send the pulse to the
  * sensor this adds 300 microseconds or 5 centimeters to the measured result.
  * After research, is a bug in the ESP!? See https://esp32.com/viewtopic.php?t=10124
  */
 uint32_t HCSR04SensorManager::getFixedStart(
-  size_t idx, HCSR04SensorInfo * const sensor) {
-  uint32_t start = sensor->start;
+  size_t idx, const HCSR04EchoTiming * const timing) {
+  uint32_t start = timing[idx].start;
   // the error appears if both sensors trigger the interrupt at the exact same
   // time, if this happens, trigger time == start time
-  if (start == sensor->trigger && sensor->end != MEASUREMENT_IN_PROGRESS) {
-    // it should be save to use the start value from the other sensor.
-    const uint32_t alternativeStart = m_sensors[1 - idx].start;
-    if (alternativeStart != m_sensors[1 - idx].trigger
-      && microsBetween(alternativeStart, start) < 500) { // typically 290-310 microseconds {
-      start = alternativeStart;
-      sensor->numberOfInterruptAdjustments++;
+  if (start == timing[idx].trigger && timing[idx].end != MEASUREMENT_IN_PROGRESS) {
+    // it should be save to use the delay till start from the other sensor,
+    // if it was triggered at about the same time.
+    const uint32_t alternativeDelay = timing[1 - idx].start - timing[1 - idx].trigger;
+    if (alternativeDelay != 0
+      && alternativeDelay < 500 // typically 290-310 microseconds
+      && microsBetween(timing[1 - idx].trigger, timing[idx].trigger) < PARALLEL_TRIGGER_MAX_OFFSET_MICRO_SEC) {
+      start = timing[idx].trigger + alternativeDelay;
+      m_sensors[idx].numberOfInterruptAdjustments++;
     }
   }
   return start;
@@ -423,7 +859,7 @@ void HCSR04SensorManager::setSensorTriggersToLow() {
   }
 }
 
-void HCSR04SensorManager::updateStatistics(HCSR04SensorInfo * const sensor) {
+void IRAM_ATTR HCSR04SensorManager::updateStatistics(HCSR04SensorInfo * const sensor) {
   if (sensor->end != MEASUREMENT_IN_PROGRESS) {
     const uint32_t startDelay = sensor->start - sensor->trigger;
     if (startDelay != 0) {
@@ -448,7 +884,7 @@ void HCSR04SensorManager::updateStatistics(HCSR04SensorInfo * const sensor) {
  * We should not use 64bit variables for "start" and "end" because access
  * to 64bit vars is not atomic for our 32bit cpu.
  */
-uint32_t HCSR04SensorManager::microsBetween(uint32_t a, uint32_t b) {
+uint32_t IRAM_ATTR HCSR04SensorManager::microsBetween(uint32_t a, uint32_t b) {
   uint32_t result = a - b;
   if (result & 0x80000000) {
     result = -result;
@@ -456,53 +892,10 @@ uint32_t HCSR04SensorManager::microsBetween(uint32_t a, uint32_t b) {
   return result;
 }
 
-/* Determines the microseconds between the time counter given and now.
- * Internally we only count 32bit, this overflows after around 71 minutes,
- * so we take care for the overflow. Times we measure are way below the
- * possible maximum.
- */
-uint32_t HCSR04SensorManager::microsSince(uint32_t a) {
-  return microsBetween(micros(), a);
-}
-
-uint16_t HCSR04SensorManager::millisSince(uint16_t milliseconds) {
-  uint16_t result = ((uint16_t) millis()) - milliseconds;
+uint16_t HCSR04SensorManager::millisBetween(uint16_t a, uint16_t b) {
+  uint16_t result = a - b;
   if (result & 0x8000) {
     result = -result;
   }
   return result;
 }
-
-uint16_t HCSR04SensorManager::medianMeasure(HCSR04SensorInfo *const sensor, uint16_t value) {
-  sensor->distances[sensor->nextMedianDistance] = value;
-  sensor->nextMedianDistance++;
-
-  // if we got "fantom" measures, they are <= the current measures, so remove
-  // all values <= the current measure from the median data
-  for (unsigned short & distance : sensor->distances) {
-    if (distance < value) {
-      distance = value;
-    }
-  }
-  if (sensor->nextMedianDistance >= MEDIAN_DISTANCE_MEASURES) {
-    sensor->nextMedianDistance = 0;
-  }
-  return median(sensor->distances[0], sensor->distances[1], sensor->distances[2]);
-}
-
-uint16_t HCSR04SensorManager::median(uint16_t a, uint16_t b, uint16_t c) {
-  if (a < b) {
-    if (a >= c) {
-      return a;
-    } else if (b < c) {
-      return b;
-    }
-  } else {
-    if (a < c) {
-      return a;
-    } else if (b >= c) {
-      return b;
-    }
-  }
-  return c;
-}
@@ -30,6 +30,33 @@
 #include "variant.h"
 #include "globals.h"
 #include "utils/median.h"
+#include "utils/distancefilter.h"
+#include "utils/spscring.h"
+#include "utils/soundspeed.h"
+#include "echocapture.h"
+#include "cadence.h"
+
+/* If set to 1 the sensors are triggered from a hardware timer interrupt
+ * instead of from the main loop, the main loop then only collects the
+ * finished measurements. Set to 0 to fall back to the polling mode.
+ */
+#ifndef HCSR04_TRIGGER_BY_TIMER
+#define HCSR04_TRIGGER_BY_TIMER 1
+#endif
+
+/* If set to 1 the trigger timer fires both sensors in each cycle, the
+ * second one with a small offset, instead of alternating between them.
+ * This doubles the measurement rate per side, readings that look like
+ * cross-talk from the other sensor are dropped.
+ */
+#ifndef HCSR04_TRIGGER_PARALLEL
+#define HCSR04_TRIGGER_PARALLEL 0
+#endif
+
+/* Number of finished measurement cycles the trigger timer can store until
+ * the main loop must have collected them. One cycle takes at least 70ms.
+ */
+#define HCSR04_CYCLE_BUFFER_SIZE 8
 
 /* About the speed of sound:
    See also http://www.sengpielaudio.com/Rechner-schallgeschw.htm (german)
@@ -49,15 +76,25 @@
       −5             328.5
       −10            325.4
       −15            322.3
+    - the distance is calculated with the factor for the current temperature
+      from SoundSpeed, see utils/soundspeed.h
 */
 
+/* Echo pin level change as seen by the interrupt. */
+struct EchoEdge {
+  uint32_t micros;
+  uint8_t level;
+};
+
+/* Number of echo edges buffered per sensor, one measurement has 2 edges. */
+#define ECHO_EDGE_BUFFER_SIZE 16
+
 struct HCSR04SensorInfo {
   uint8_t triggerPin = 15;
   uint8_t echoPin = 4;
   uint16_t offset = 0;
   uint16_t rawDistance = 0;
-  uint16_t distances[MEDIAN_DISTANCE_MEASURES] = { MAX_SENSOR_VALUE, MAX_SENSOR_VALUE, MAX_SENSOR_VALUE };
-  uint16_t nextMedianDistance = 0;
+  SensorDistanceFilter filter;
   uint16_t minDistance = MAX_SENSOR_VALUE;
   uint16_t distance = MAX_SENSOR_VALUE;
   char* sensorLocation;
@@ -66,9 +103,11 @@ struct HCSR04SensorInfo {
   volatile uint32_t start = 0;
   /* if end == 0 - a measurement is in progress */
   volatile uint32_t end = 1;
+  /* all edges of the echo pin, written by the isr */
+  SpscRing<EchoEdge, ECHO_EDGE_BUFFER_SIZE> edges;
 
   int32_t echoDurationMicroseconds[MAX_NUMBER_MEASUREMENTS_PER_INTERVAL + 1];
-  Median<uint16_t>*median = nullptr;
+  Median<uint16_t, RAW_MEDIAN_DISTANCE_MEASURES> median{MAX_SENSOR_VALUE};
   // statistics
   uint32_t maxDurationUs = 0;
   uint32_t minDurationUs = UINT32_MAX;
@@ -79,17 +118,40 @@ struct HCSR04SensorInfo {
   uint32_t numberOfLowAfterMeasurement = 0;
   uint32_t numberOfToLongMeasurement = 0;
   uint32_t numberOfInterruptAdjustments = 0;
+  volatile uint32_t numberOfLostEdges = 0;
+  uint32_t numberOfCrossTalkRejections = 0;
+  // echo duration of the former kept parallel triggered measurement
+  uint32_t trackDurationUs = 0;
   uint16_t numberOfTriggers = 0;
-  bool measurementRead;
+  bool measurementRead = false;
+};
+
+/* Timing of one echo measurement, all values are micros() ticks. */
+struct HCSR04EchoTiming {
+  uint32_t trigger = 0;
+  uint32_t start = 0;
+  uint32_t end = 1;
+  /* true if the measurement is finished and not collected yet */
+  bool pending = false;
+};
+
+/* Snapshot of the sensors taken by the trigger timer right before the
+ * primary sensor is triggered again.
+ */
+struct HCSR04MeasurementCycle {
+  HCSR04EchoTiming timing[NUMBER_OF_TOF_SENSORS];
+  uint32_t capturedMicros;
+  uint16_t capturedMillis;
 };
 
 class HCSR04SensorManager {
   public:
-    HCSR04SensorManager() {}
-    virtual ~HCSR04SensorManager() {}
+    HCSR04SensorManager();
+    virtual ~HCSR04SensorManager();
     void reset(uint32_t startMillisTicks);
     void registerSensor(const HCSR04SensorInfo &, uint8_t idx);
     void setOffsets(std::vector<uint16_t>);
+    void setDistanceFilter(const DistanceFilterConfig &config);
     void setPrimarySensor(uint8_t idx);
     void detachInterrupts();
     void attachInterrupts();
@@ -106,6 +168,16 @@ class HCSR04SensorManager {
     uint32_t getNumberOfLowAfterMeasurement(const uint8_t sensorId);
     uint32_t getNumberOfToLongMeasurement(const uint8_t sensorId);
     uint32_t getNumberOfInterruptAdjustments(const uint8_t sensorId);
+    uint32_t getNumberOfLostEdges(const uint8_t sensorId);
+    uint32_t getNumberOfCrossTalkRejections(const uint8_t sensorId);
+    /* Highest cadence mode since the last reset(). */
+    CadenceMode getCadenceMode() const;
+    /* Adjusts the time of flight to distance conversion to the air
+     * temperature, meant to be called at low rate e.g. once per second.
+     */
+    void setTemperature(float celsius);
+    /* Current conversion factor in 1/100 microseconds per cm. */
+    uint16_t getMicroSecToCmDividerCenti() const;
 
     HCSR04SensorInfo m_sensors[NUMBER_OF_TOF_SENSORS];
     uint16_t sensorValues[NUMBER_OF_TOF_SENSORS];
@@ -113,28 +185,73 @@ class HCSR04SensorManager {
     uint16_t startOffsetMilliseconds[MAX_NUMBER_MEASUREMENTS_PER_INTERVAL + 1];
     bool pollDistancesParallel();
     bool pollDistancesAlternating();
+    /* Let a hardware timer trigger the sensors, pollDistancesAlternating()
+     * then only collects the finished measurements.
+     */
+    bool startTriggerTimer();
+    /* Must be set before the trigger timer is started. */
+    void setParallelTrigger(bool parallel);
+    void stopTriggerTimer();
+    bool isTriggeredByTimer() const;
+    uint32_t getNumberOfLostCycles() const;
+    void onTriggerTimer();
+    static void recordEdge(HCSR04SensorInfo * const sensor, uint32_t micros, uint8_t level);
 
   protected:
 
   private:
     void sendTriggerToSensor(uint8_t sensorId);
-    bool collectSensorResult(uint8_t sensorId);
+    void prepareTrigger(HCSR04SensorInfo * const sensor, uint32_t now);
+    bool collectSensorResult(uint8_t sensorId, const HCSR04EchoTiming * const timing, uint32_t now);
     void setSensorTriggersToLow();
     bool collectSensorResults();
+    bool collectTimerCycles();
+    void onTriggerTick();
+    void captureCycle(uint32_t now);
+    void onParallelTriggerTimer(uint32_t now);
+    void startTimerTrigger(uint8_t sensorId, uint32_t now);
+    void rejectCrossTalk(HCSR04EchoTiming * const timing);
+    boolean isSecondarySkipped();
+    boolean isIdleCyclePassed(uint32_t now);
+    void countPrimaryCycle();
     void attachSensorInterrupt(uint8_t idx);
-    uint32_t getFixedStart(size_t idx, HCSR04SensorInfo * const sensor);
+    void captureTiming(HCSR04SensorInfo * const sensor, HCSR04EchoTiming * const timing, uint32_t now);
+    void resolveEdges(HCSR04SensorInfo * const sensor, HCSR04EchoTiming * const timing, uint32_t until);
+    uint32_t getFixedStart(size_t idx, const HCSR04EchoTiming * const timing);
     boolean isReadyForStart(uint8_t sensorId);
-    void registerReadings();
-    static uint16_t medianMeasure(HCSR04SensorInfo* const sensor, uint16_t value);
-    static uint16_t median(uint16_t a, uint16_t b, uint16_t c);
+    boolean isReadyForTimerStart(uint8_t sensorId, uint32_t now);
+    boolean quietPeriodsPassed(uint8_t sensorId, uint32_t now);
+    void registerReadings(uint16_t millisTicks);
+    static bool isEchoComplete(const HCSR04EchoTiming &timing, uint32_t now);
+    static bool isBefore(uint32_t a, uint32_t b);
     static uint16_t correctSensorOffset(uint16_t dist, uint16_t offset);
     static uint32_t microsBetween(uint32_t a, uint32_t b);
-    static uint32_t microsSince(uint32_t a);
-    static uint16_t millisSince(uint16_t milliseconds);
+    static uint16_t millisBetween(uint16_t a, uint16_t b);
     static void updateStatistics(HCSR04SensorInfo * const sensor);
     uint32_t startReadingMilliseconds = 0;
+    uint16_t microSecToCmDividerCenti = SoundSpeed::DEFAULT_MICRO_SEC_TO_CM_DIVIDER_CENTI;
     uint8_t primarySensor = 1;
-    uint8_t lastSensor;
+    volatile uint8_t lastSensor;
+
+    // trigger timer state, written in the timer isr
+    hw_timer_t *triggerTimer = nullptr;
+    volatile int8_t triggerHighSensor = -1;
+    bool parallelTrigger = false;
+    volatile int8_t delayedTriggerSensor = -1;
+    volatile uint8_t delayedTriggerTicks = 0;
+    uint8_t triggerOffsetIndex = 0;
+    // held by the timer isr, guards the trigger counters in reset()
+    portMUX_TYPE triggerMux = portMUX_INITIALIZER_UNLOCKED;
+
+    // adaptive cadence, the mode is written in the main loop and read in the isr
+    MeasurementCadence cadence;
+    volatile CadenceMode cadenceMode = CadenceNormal;
+    uint8_t primaryCyclesSinceSecondary = 0;
+    HCSR04MeasurementCycle cycles[HCSR04_CYCLE_BUFFER_SIZE];
+    volatile uint8_t cycleWritePos = 0;
+    volatile uint8_t cycleReadPos = 0;
+    uint32_t numberOfLostCycles = 0;
+    EchoCapture * const echoCapture;
 };
 
 #endif
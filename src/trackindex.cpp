@@ -0,0 +1,326 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#include "trackindex.h"
+
+#include <algorithm>
+#include <SD.h>
+#include "writer.h"
+#include "utils/timeutils.h"
+
+const char * const TrackIndex::FILE_NAME = "/tracks.idx";
+const char * const TrackIndex::UPLOADED_DIRECTORY = "/uploaded";
+const char * const TrackIndex::TRACKS_DIRECTORY = "/tracks";
+const char * const TrackIndex::MIGRATED_FILE_NAME = "/tracks/.migrated";
+
+bool TrackIndex::load(std::vector<TrackSummary> &tracks) {
+  tracks.clear();
+  File file = SD.open(FILE_NAME, FILE_READ);
+  if (!file) {
+    return false;
+  }
+  uint16_t lines = 0;
+  String line;
+  uint8_t buffer[128];
+  size_t count;
+  while ((count = file.read(buffer, sizeof(buffer))) > 0) {
+    for (size_t i = 0; i < count; i++) {
+      if (buffer[i] == '\n') {
+        if (!apply(tracks, line)) {
+          log_w("Ignoring track index line '%s'.", line.c_str());
+        }
+        line.clear();
+        lines++;
+      } else {
+        line += (char) buffer[i];
+      }
+    }
+  }
+  file.close();
+  // an incomplete last line was cut by a power loss
+  if (lines > 2 * tracks.size() + 32 || !line.isEmpty()) {
+    save(tracks);
+  }
+  return true;
+}
+
+bool TrackIndex::apply(std::vector<TrackSummary> &tracks, const String &line) {
+  const int separator = line.indexOf(';');
+  if (line.length() < 3 || line[1] != ' ') {
+    return false;
+  }
+  const String name = line.substring(2, separator < 0 ? line.length() : separator);
+  auto track = std::find_if(tracks.begin(), tracks.end(),
+                            [&name](const TrackSummary &t) { return t.fileName == name; });
+  if (line[0] == '+' && separator > 0) {
+    TrackSummary summary;
+    summary.fileName = name;
+    long start;
+    unsigned uploaded;
+    if (sscanf(line.c_str() + separator, ";%ld;%u;%u;%u;%u", &start,
+               &summary.durationSeconds, &summary.records, &summary.overtakes, &uploaded) != 5) {
+      return false;
+    }
+    summary.start = start;
+    summary.uploaded = uploaded != 0;
+    if (track != tracks.end()) {
+      *track = summary;
+    } else {
+      tracks.push_back(summary);
+    }
+  } else if (line[0] == '>' && separator > 0) {
+    if (track != tracks.end()) {
+      track->fileName = line.substring(separator + 1);
+      track->uploaded = track->fileName.startsWith(String(UPLOADED_DIRECTORY) + "/");
+    }
+  } else if (line[0] == '-') {
+    if (track != tracks.end()) {
+      tracks.erase(track);
+    }
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void TrackIndex::add(const TrackSummary &track) {
+  append(toLine(track));
+}
+
+String TrackIndex::toLine(const TrackSummary &track) {
+  return "+ " + track.fileName + ";" + String((long) track.start)
+         + ";" + String(track.durationSeconds) + ";" + String(track.records)
+         + ";" + String(track.overtakes) + ";" + String(track.uploaded ? 1 : 0);
+}
+
+void TrackIndex::move(const String &from, const String &to) {
+  append("> " + from + ";" + to);
+}
+
+void TrackIndex::remove(const String &fileName) {
+  append("- " + fileName);
+}
+
+void TrackIndex::clear() {
+  SD.remove(FILE_NAME);
+}
+
+void TrackIndex::append(const String &line) {
+  if (!SD.exists(FILE_NAME)) {
+    // without an index all tracks are found by rebuild()
+    return;
+  }
+  File file = SD.open(FILE_NAME, FILE_APPEND);
+  if (!file) {
+    log_e("Failed to open %s.", FILE_NAME);
+    return;
+  }
+  file.print(line + "\n");
+  file.close();
+}
+
+void TrackIndex::save(const std::vector<TrackSummary> &tracks) {
+  const String tempName = String(FILE_NAME) + ".tmp";
+  File file = SD.open(tempName, FILE_WRITE);
+  if (!file) {
+    log_e("Failed to create %s.", tempName.c_str());
+    return;
+  }
+  String lines;
+  for (const TrackSummary &track : tracks) {
+    lines += toLine(track);
+    lines += '\n';
+    if (lines.length() > 1024) {
+      file.print(lines);
+      lines.clear();
+    }
+  }
+  file.print(lines);
+  file.close();
+  SD.remove(FILE_NAME);
+  SD.rename(tempName, FILE_NAME);
+}
+
+uint16_t TrackIndex::rebuild() {
+  std::vector<TrackSummary> tracks;
+  addTracksInDirectory("/", false, tracks);
+  addTracksInDirectory(TRACKS_DIRECTORY, true, tracks);
+  addTracksInDirectory(UPLOADED_DIRECTORY, true, tracks);
+  std::sort(tracks.begin(), tracks.end(),
+            [](const TrackSummary &a, const TrackSummary &b) { return a.start < b.start; });
+  save(tracks);
+  log_i("Track index rebuilt with %u tracks.", tracks.size());
+  return tracks.size();
+}
+
+void TrackIndex::addTracksInDirectory(const String &directory, bool recursive,
+                                      std::vector<TrackSummary> &tracks) {
+  File dir = SD.open(directory);
+  if (!dir || !dir.isDirectory()) {
+    return;
+  }
+  File file = dir.openNextFile();
+  while (file) {
+    const String fileName = file.path();
+    if (file.isDirectory()) {
+      if (recursive) {
+        addTracksInDirectory(fileName, true, tracks);
+      }
+    } else if (isTrack(fileName)) {
+      TrackSummary summary;
+      summary.fileName = fileName;
+      summary.uploaded = fileName.startsWith(String(UPLOADED_DIRECTORY) + "/");
+      if (fileName.endsWith(CSVFileWriter::EXTENSION)) {
+        CSVFileWriter::summarize(file, summary);
+      } else if (fileName.endsWith(BinaryFileWriter::EXTENSION)) {
+        BinaryFileWriter::summarize(file, summary);
+      }
+      if (summary.start == 0) {
+        summary.start = startOf(file);
+      }
+      tracks.push_back(summary);
+    }
+    file.close();
+    file = dir.openNextFile();
+  }
+  dir.close();
+}
+
+uint16_t TrackIndex::migrate() {
+  if (SD.exists(MIGRATED_FILE_NAME)) {
+    return 0;
+  }
+  uint16_t moved = 0;
+  // both run, a failed move in / does not keep /uploaded unmigrated
+  const bool rootMigrated = migrateDirectory("/", moved);
+  const bool uploadedMigrated = migrateDirectory(UPLOADED_DIRECTORY, moved);
+  log_i("Moved %u tracks to the monthly directories.", moved);
+  if (rootMigrated && uploadedMigrated) {
+    // only now, an interrupted migration is continued with the next start
+    createDirectories(MIGRATED_FILE_NAME);
+    File marker = SD.open(MIGRATED_FILE_NAME, FILE_WRITE);
+    marker.close();
+  }
+  return moved;
+}
+
+/* Returns false if a track could not be moved. */
+bool TrackIndex::migrateDirectory(const String &directory, uint16_t &moved) {
+  // collected first, renaming while reading the directory could skip files
+  std::vector<std::pair<String, time_t>> files;
+  File dir = SD.open(directory);
+  if (!dir || !dir.isDirectory()) {
+    return true;
+  }
+  File file = dir.openNextFile();
+  while (file) {
+    const String fileName = file.path();
+    if (!file.isDirectory() && isTrack(fileName)) {
+      files.emplace_back(fileName, startOf(file));
+    }
+    file.close();
+    file = dir.openNextFile();
+  }
+  dir.close();
+
+  bool migrated = true;
+  for (const auto &entry : files) {
+    const String &fileName = entry.first;
+    String newName = directoryFor(entry.second) + fileName.substring(fileName.lastIndexOf('/'));
+    if (fileName.startsWith(String(UPLOADED_DIRECTORY) + "/")) {
+      newName = uploadedName(newName);
+    }
+    createDirectories(newName);
+    if (SD.rename(fileName, newName)) {
+      move(fileName, newName);
+      moved++;
+    } else {
+      log_e("Failed to move %s to %s.", fileName.c_str(), newName.c_str());
+      migrated = false;
+    }
+  }
+  return migrated;
+}
+
+String TrackIndex::directoryFor(time_t start) {
+  if (start <= TimeUtils::PAST_TIME) {
+    return TRACKS_DIRECTORY;
+  }
+  tm time;
+  localtime_r(&start, &time);
+  char directory[16];
+  snprintf(directory, sizeof(directory), "/%04d/%02d", time.tm_year + 1900, time.tm_mon + 1);
+  return TRACKS_DIRECTORY + String(directory);
+}
+
+String TrackIndex::uploadedName(const String &fileName) {
+  const String tracks = String(TRACKS_DIRECTORY) + "/";
+  if (fileName.startsWith(tracks)) {
+    return UPLOADED_DIRECTORY + fileName.substring(tracks.length() - 1);
+  }
+  return UPLOADED_DIRECTORY + fileName;
+}
+
+String TrackIndex::pendingName(const String &fileName) {
+  const String uploaded = String(UPLOADED_DIRECTORY) + "/";
+  if (fileName.startsWith(uploaded)) {
+    return TRACKS_DIRECTORY + fileName.substring(uploaded.length() - 1);
+  }
+  return fileName;
+}
+
+void TrackIndex::createDirectories(const String &fileName) {
+  int end = 0;
+  while ((end = fileName.indexOf('/', end + 1)) > 0) {
+    const String directory = fileName.substring(0, end);
+    if (!SD.exists(directory)) {
+      SD.mkdir(directory);
+    }
+  }
+}
+
+/* From the name, else the last write if the clock was set. */
+time_t TrackIndex::startOf(File &file) {
+  time_t start = timeFromFileName(file.path());
+  if (start == 0 && file.getLastWrite() > TimeUtils::PAST_TIME) {
+    start = file.getLastWrite();
+  }
+  return start;
+}
+
+/* Tracks are named after their start time, "/2021-07-01T17.22.41-xxxx.obsdata.csv". */
+time_t TrackIndex::timeFromFileName(const String &fileName) {
+  const char *name = fileName.c_str() + fileName.lastIndexOf('/') + 1;
+  tm time = {};
+  if (sscanf(name, "%4d-%2d-%2dT%2d.%2d.%2d", &time.tm_year, &time.tm_mon, &time.tm_mday,
+             &time.tm_hour, &time.tm_min, &time.tm_sec) != 6) {
+    return 0;
+  }
+  time.tm_year -= 1900;
+  time.tm_mon -= 1;
+  return mktime(&time);
+}
+
+bool TrackIndex::isTrack(const String &fileName) {
+  return CSVFileWriter::isTrackFile(fileName) || fileName.endsWith(BinaryFileWriter::EXTENSION);
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OBS_TRACKINDEX_H
+#define OBS_TRACKINDEX_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include <vector>
+
+/* What the track index knows about a track. */
+struct TrackSummary {
+  // full path, tracks below /uploaded are already uploaded
+  String fileName;
+  time_t start = 0;
+  uint32_t durationSeconds = 0;
+  uint32_t records = 0;
+  uint32_t overtakes = 0;
+  bool uploaded = false;
+};
+
+/* Tracks are kept in a directory per month, /tracks/YYYY/MM, and moved
+ * to /uploaded/YYYY/MM once uploaded. This keeps the FAT directories
+ * small, each lookup in a directory reads all entries before the match.
+ *
+ * Index of the tracks on the SD card so listing and upload selection
+ * read one file instead of opening each track. The index is a text file
+ * that is only appended to, one line per change, later lines win:
+ *
+ *   + <name>;<start>;<duration>;<records>;<overtakes>;<uploaded>
+ *   > <from>;<to>
+ *   - <name>
+ *
+ * It is rewritten when loaded and much longer than the list of tracks.
+ */
+class TrackIndex {
+  public:
+    /* Reads the tracks in the order they were added, false if there is
+     * no index yet.
+     */
+    static bool load(std::vector<TrackSummary> &tracks);
+    /* Adds the track or replaces its summary. */
+    static void add(const TrackSummary &track);
+    /* The track was moved, into /uploaded it counts as uploaded. */
+    static void move(const String &from, const String &to);
+    static void remove(const String &fileName);
+    static void clear();
+    /* Creates the index from the track files in /tracks, /uploaded and
+     * directly in /, used for cards written by older firmware. Reads each
+     * track for its summary which takes a while. Returns the number of
+     * tracks found.
+     */
+    static uint16_t rebuild();
+    /* Moves the tracks that older firmware kept directly in / and
+     * /uploaded to the monthly directories. Done till all tracks are
+     * moved, MIGRATED_FILE_NAME marks the completion. Returns the number
+     * of tracks moved.
+     */
+    static uint16_t migrate();
+    /* The directory for tracks started at the given time, /tracks/YYYY/MM
+     * or /tracks if the time is not known.
+     */
+    static String directoryFor(time_t start);
+    /* Name of the track once uploaded. */
+    static String uploadedName(const String &fileName);
+    /* Name of an uploaded track to upload it again. */
+    static String pendingName(const String &fileName);
+    /* Creates the missing directories above the file. */
+    static void createDirectories(const String &fileName);
+    /* The files that are tracks, plain, compressed or binary. */
+    static bool isTrack(const String &fileName);
+    static const char * const FILE_NAME;
+    static const char * const UPLOADED_DIRECTORY;
+    static const char * const TRACKS_DIRECTORY;
+    static const char * const MIGRATED_FILE_NAME;
+
+  private:
+    static String toLine(const TrackSummary &track);
+    static void append(const String &line);
+    static bool apply(std::vector<TrackSummary> &tracks, const String &line);
+    static void save(const std::vector<TrackSummary> &tracks);
+    static void addTracksInDirectory(const String &directory, bool recursive,
+                                     std::vector<TrackSummary> &tracks);
+    static bool migrateDirectory(const String &directory, uint16_t &moved);
+    static time_t startOf(File &file);
+    static time_t timeFromFileName(const String &fileName);
+};
+
+#endif //OBS_TRACKINDEX_H
@@ -25,6 +25,7 @@
 
 #include "globals.h"
 #include "utils/multipart.h"
+#include "utils/streams.h"
 #include "utils/timeutils.h"
 #include "writer.h"
 
@@ -45,7 +46,7 @@ Uploader::Uploader(String portalUrl, String userToken) :
 bool Uploader::upload(const String& fileName) {
   bool success = false;
   if(fileName.substring(0,7) != "/sensor"
-      && !fileName.endsWith(CSVFileWriter::EXTENSION)) {
+      && !CSVFileWriter::isTrackFile(fileName)) {
     log_e("Not sending %s wrong extension.", fileName.c_str());
     mLastStatusMessage = "Not sending " + fileName + " wrong extension.";
   } else {
@@ -63,6 +64,27 @@ bool Uploader::upload(const String& fileName) {
 }
 
 bool Uploader::uploadFile(File &file) {
+  const String fileName = file.name();
+  if (!fileName.endsWith(CSVFileWriter::COMPRESSED_EXTENSION)) {
+    return uploadFile(fileName, &file, file.size());
+  }
+  // the portal gets the plain CSV, decompressed while it is sent
+  GzipFileStream csv(&file);
+  if (!csv.begin()) {
+    mLastStatusMessage = "File " + fileName + " is not a complete gzip file.";
+    log_e("%s", mLastStatusMessage.c_str());
+    return false;
+  }
+  const bool success = uploadFile(fileName.substring(0, fileName.length() - 3), &csv, csv.size());
+  if (csv.hasFailed()) {
+    mLastStatusMessage += " Broken gzip data in " + fileName + ".";
+    log_e("%s", mLastStatusMessage.c_str());
+    return false;
+  }
+  return success;
+}
+
+bool Uploader::uploadFile(const String &fileName, Stream *content, size_t length) {
   bool success = false;
   HTTPClient https;
   https.setTimeout(30 * 1000); // give the api some time
@@ -73,14 +95,13 @@ bool Uploader::uploadFile(File &file) {
   if (https.begin(mWiFiClient, mPortalUrl + "/api/tracks")) { // HTTPS
     https.addHeader("Authorization", "OBSUserId " + mPortalUserToken);
     https.addHeader("Content-Type", "application/json");
-    const String fileName = file.name();
     const String displayFileName = ObsUtils::stripCsvFileName(fileName);
     MultipartStream mp(&https);
     MultipartDataString title("title", "AutoUpload " + displayFileName);
     mp.add(title);
     MultipartDataString description("description", "Uploaded with OpenBikeSensor " + String(OBSVersion));
     mp.add(description);
-    MultipartDataStream data("body", fileName, &file, "text/csv");
+    MultipartDataStream data("body", fileName, content, length, "text/csv");
     mp.add(data);
     mp.last();
     const size_t contentLength = mp.predictSize();
@@ -46,5 +46,6 @@ class Uploader {
     String mLastStatusMessage = "NO UPLOAD";
 
     bool uploadFile(fs::File &file);
+    bool uploadFile(const String &fileName, Stream *content, size_t length);
 };
 #endif
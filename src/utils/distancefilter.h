@@ -0,0 +1,295 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OPENBIKESENSORFIRMWARE_DISTANCEFILTER_H
+#define OPENBIKESENSORFIRMWARE_DISTANCEFILTER_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "variant.h"
+#include "median.h"
+
+/* Window of the optional median stage, must be odd. */
+#ifndef DISTANCE_FILTER_MEDIAN_SIZE
+#define DISTANCE_FILTER_MEDIAN_SIZE 5
+#endif
+
+enum DistanceFilterOptions {
+  FilterRangeGate = 0x01,  // 1
+  FilterPhantomSuppression = 0x02, // 2
+  FilterMedian = 0x04, // 4
+  FilterTracker = 0x08 // 8
+};
+
+struct DistanceFilterConfig {
+  unsigned int options = FilterRangeGate | FilterPhantomSuppression;
+  uint16_t minDistanceCm = MIN_DISTANCE_MEASURED_CM;
+  uint16_t maxDistanceCm = MAX_DISTANCE_MEASURED_CM;
+  uint8_t trackerAlphaPercent = 50;
+  uint8_t trackerBetaPercent = 10;
+  uint16_t trackerGateCm = 50;
+};
+
+/* Drops distances (in cm as measured by the sensor) outside of the
+ * configured range. The HC-SR04 readings are checked against
+ * MIN/MAX_DURATION_MICRO_SEC, which use the fixed MICRO_SEC_TO_CM_DIVIDER.
+ * Their manager passes the temperature adjusted factor. A limit left at
+ * its MIN/MAX_DISTANCE_MEASURED_CM default stands for that duration and
+ * scales with the factor, so an echo that passed the duration check is
+ * not dropped here. A limit the user configured is in cm and stays.
+ */
+class RangeGateStage {
+  public:
+    /* True if the configured limits can be used, min below max and
+     * neither above MAX_SENSOR_VALUE.
+     */
+    static bool isValidRange(long minDistanceCm, long maxDistanceCm) {
+      return minDistanceCm >= 0 && minDistanceCm < maxDistanceCm
+        && maxDistanceCm <= MAX_SENSOR_VALUE;
+    };
+    void configure(const DistanceFilterConfig &config) {
+      enabled = config.options & FilterRangeGate;
+      if (isValidRange(config.minDistanceCm, config.maxDistanceCm)) {
+        minDistanceCm = config.minDistanceCm;
+        maxDistanceCm = config.maxDistanceCm;
+      } else {
+        minDistanceCm = MIN_DISTANCE_MEASURED_CM;
+        maxDistanceCm = MAX_DISTANCE_MEASURED_CM;
+      }
+      scaleRange();
+    };
+    void reset() {};
+    void setMicroSecToCmDividerCenti(uint16_t divider) {
+      dividerCenti = divider;
+      scaleRange();
+    };
+    uint16_t apply(uint16_t value) {
+      if (enabled && (value < minDistance || value > maxDistance)) {
+        return MAX_SENSOR_VALUE;
+      }
+      return value;
+    };
+
+  private:
+    void scaleRange() {
+      minDistance = minDistanceCm == MIN_DISTANCE_MEASURED_CM ? scale(minDistanceCm) : minDistanceCm;
+      maxDistance = maxDistanceCm == MAX_DISTANCE_MEASURED_CM ? scale(maxDistanceCm) : maxDistanceCm;
+    };
+    uint16_t scale(uint16_t distance) const {
+      return static_cast<uint16_t>(
+        (uint32_t) distance * MICRO_SEC_TO_CM_DIVIDER * 100 / dividerCenti);
+    };
+    bool enabled = true;
+    uint16_t minDistanceCm = MIN_DISTANCE_MEASURED_CM;
+    uint16_t maxDistanceCm = MAX_DISTANCE_MEASURED_CM;
+    uint16_t dividerCenti = MICRO_SEC_TO_CM_DIVIDER * 100;
+    uint16_t minDistance = MIN_DISTANCE_MEASURED_CM;
+    uint16_t maxDistance = MAX_DISTANCE_MEASURED_CM;
+};
+
+/* Median of the last 3 values, where "phantom" measures are removed. They
+ * are <= the current measure, so all older values smaller than the current
+ * measure are raised to it.
+ */
+class PhantomSuppressionStage {
+  public:
+    void configure(const DistanceFilterConfig &config) {
+      enabled = config.options & FilterPhantomSuppression;
+    };
+    void reset() {
+      for (uint16_t &distance : distances) {
+        distance = MAX_SENSOR_VALUE;
+      }
+      next = 0;
+    };
+    void setMicroSecToCmDividerCenti(uint16_t) {};
+    uint16_t apply(uint16_t value) {
+      if (!enabled) {
+        return value;
+      }
+      distances[next++] = value;
+      for (uint16_t &distance : distances) {
+        if (distance < value) {
+          distance = value;
+        }
+      }
+      if (next >= MEDIAN_DISTANCE_MEASURES) {
+        next = 0;
+      }
+      return median(distances[0], distances[1], distances[2]);
+    };
+
+    static uint16_t median(uint16_t a, uint16_t b, uint16_t c) {
+      if (a < b) {
+        if (a >= c) {
+          return a;
+        } else if (b < c) {
+          return b;
+        }
+      } else {
+        if (a < c) {
+          return a;
+        } else if (b >= c) {
+          return b;
+        }
+      }
+      return c;
+    };
+
+  private:
+    bool enabled = true;
+    uint16_t distances[MEDIAN_DISTANCE_MEASURES] = { MAX_SENSOR_VALUE, MAX_SENSOR_VALUE, MAX_SENSOR_VALUE };
+    uint8_t next = 0;
+};
+
+template<size_t SIZE> class MedianStage {
+  public:
+    void configure(const DistanceFilterConfig &config) {
+      enabled = config.options & FilterMedian;
+    };
+    void reset() {
+      median = Median<uint16_t, SIZE>(MAX_SENSOR_VALUE);
+    };
+    void setMicroSecToCmDividerCenti(uint16_t) {};
+    uint16_t apply(uint16_t value) {
+      if (!enabled) {
+        return value;
+      }
+      median.addValue(value);
+      return median.median();
+    };
+
+  private:
+    bool enabled = false;
+    Median<uint16_t, SIZE> median{MAX_SENSOR_VALUE};
+};
+
+/* Alpha-beta tracker of the distance of a single object, the velocity is
+ * per measurement. Position and velocity are kept as fixed point with 8
+ * fractional bits. A measurement that is more than the gate away from the
+ * prediction starts a new track, no object (MAX_SENSOR_VALUE) ends it.
+ */
+class AlphaBetaTrackerStage {
+  public:
+    void configure(const DistanceFilterConfig &config) {
+      enabled = config.options & FilterTracker;
+      alphaPercent = config.trackerAlphaPercent;
+      betaPercent = config.trackerBetaPercent;
+      gate = static_cast<int32_t>(config.trackerGateCm) << FRACTION_BITS;
+      reset();
+    };
+    void reset() {
+      tracking = false;
+    };
+    void setMicroSecToCmDividerCenti(uint16_t) {};
+    uint16_t apply(uint16_t value) {
+      if (!enabled) {
+        return value;
+      }
+      if (value >= MAX_SENSOR_VALUE) {
+        tracking = false;
+        return value;
+      }
+      const int32_t measured = static_cast<int32_t>(value) << FRACTION_BITS;
+      const int32_t predicted = position + velocity;
+      const int32_t residual = measured - predicted;
+      if (!tracking || abs(residual) > gate) {
+        tracking = true;
+        position = measured;
+        velocity = 0;
+        return value;
+      }
+      position = predicted + residual * alphaPercent / 100;
+      velocity += residual * betaPercent / 100;
+      int32_t result = (position + (1 << (FRACTION_BITS - 1))) >> FRACTION_BITS;
+      if (result < 0) {
+        result = 0;
+      } else if (result >= MAX_SENSOR_VALUE) {
+        result = MAX_SENSOR_VALUE - 1;
+      }
+      return static_cast<uint16_t>(result);
+    };
+
+  private:
+    static const uint8_t FRACTION_BITS = 8;
+    bool enabled = false;
+    bool tracking = false;
+    int32_t alphaPercent = 50;
+    int32_t betaPercent = 10;
+    int32_t gate = 0;
+    int32_t position = 0;
+    int32_t velocity = 0;
+};
+
+/* Chain of filter stages, each stage gets the output of the previous one.
+ * Stages are composed at compile time so there is no virtual dispatch per
+ * measurement, disabled stages pass values through. A stage provides
+ * configure(const DistanceFilterConfig &), reset(),
+ * setMicroSecToCmDividerCenti(uint16_t) and uint16_t apply(uint16_t).
+ */
+template<typename... Stages> class DistanceFilter;
+
+template<> class DistanceFilter<> {
+  public:
+    void configure(const DistanceFilterConfig &) {};
+    void reset() {};
+    void setMicroSecToCmDividerCenti(uint16_t) {};
+    uint16_t apply(uint16_t value) {
+      return value;
+    };
+};
+
+template<typename Stage, typename... Rest> class DistanceFilter<Stage, Rest...> {
+  public:
+    void configure(const DistanceFilterConfig &config) {
+      stage.configure(config);
+      rest.configure(config);
+    };
+    void reset() {
+      stage.reset();
+      rest.reset();
+    };
+    /* Conversion factor of the sensor, in 1/100 microseconds per cm. */
+    void setMicroSecToCmDividerCenti(uint16_t dividerCenti) {
+      stage.setMicroSecToCmDividerCenti(dividerCenti);
+      rest.setMicroSecToCmDividerCenti(dividerCenti);
+    };
+    uint16_t apply(uint16_t value) {
+      return rest.apply(stage.apply(value));
+    };
+
+  private:
+    Stage stage;
+    DistanceFilter<Rest...> rest;
+};
+
+/* The filter used by the sensor managers, with the default configuration
+ * it matches the former hard wired phantom suppression.
+ */
+typedef DistanceFilter<
+  RangeGateStage,
+  PhantomSuppressionStage,
+  MedianStage<DISTANCE_FILTER_MEDIAN_SIZE>,
+  AlphaBetaTrackerStage> SensorDistanceFilter;
+
+#endif //OPENBIKESENSORFIRMWARE_DISTANCEFILTER_H
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OPENBIKESENSORFIRMWARE_ECHOPROFILE_H
+#define OPENBIKESENSORFIRMWARE_ECHOPROFILE_H
+
+#include <Arduino.h>
+#include "variant.h"
+#include "linebuffer.h"
+
+#if ECHO_OBJECTS_PER_MEASUREMENT > 0
+
+/* One object as reported by the sensor. */
+struct EchoObject {
+  uint16_t tofMicroSeconds;
+  uint8_t widthMicroSeconds;
+  uint8_t peakAmplitude;
+};
+
+/* The objects seen by one sensor in one measurement, ordered by time of
+ * flight so the nearest object comes first.
+ */
+struct EchoProfile {
+  uint8_t count;
+  EchoObject objects[ECHO_OBJECTS_PER_MEASUREMENT];
+
+  /* Appends the objects as "tof:width:amplitude" separated by "|", e.g.
+   * "1234:255:120|2345:80:40", nothing if no object was seen.
+   */
+  void appendTo(LineBuffer &line) const {
+    for (uint8_t idx = 0; idx < count; ++idx) {
+      if (idx > 0) {
+        line.append('|');
+      }
+      const EchoObject &object = objects[idx];
+      line.appendUnsigned(object.tofMicroSeconds);
+      line.append(':');
+      line.appendUnsigned(object.widthMicroSeconds);
+      line.append(':');
+      line.appendUnsigned(object.peakAmplitude);
+    }
+  }
+};
+
+#endif
+
+#endif
@@ -0,0 +1,836 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include "gzip.h"
+
+static const uint16_t LENGTH_BASE[] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t LENGTH_EXTRA_BITS[] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t DISTANCE_BASE[] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+  257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t DISTANCE_EXTRA_BITS[] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+  7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+// order in which the lengths of the code length code are stored
+static const uint8_t LENGTH_CODE_ORDER[] = {
+  16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+static const uint8_t RUN_EXTRA_BITS[] = {2, 3, 7}; // for the symbols 16, 17 and 18
+static const uint16_t END_OF_BLOCK = 256;
+
+GzipEncoder::GzipEncoder() :
+  mWindow(new uint8_t[2 * WINDOW_SIZE]),
+  mHead(new uint16_t[1 << HASH_BITS]()),
+  mLiteralOrLength(new uint16_t[BLOCK_SYMBOLS]),
+  mDistance(new uint16_t[BLOCK_SYMBOLS]),
+  mLiteralFrequencies(),
+  mDistanceFrequencies() {
+}
+
+GzipEncoder::~GzipEncoder() {
+  delete[] mWindow;
+  delete[] mHead;
+  delete[] mLiteralOrLength;
+  delete[] mDistance;
+}
+
+void GzipEncoder::begin(String &out) {
+  // magic, deflate, no flags, no time, no extra flags, unknown OS
+  static const uint8_t header[HEADER_SIZE] = {0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 255};
+  for (const uint8_t byte : header) {
+    putBits(byte, 8, out);
+  }
+  flushOut(out);
+}
+
+void GzipEncoder::write(const uint8_t *data, size_t length, String &out) {
+  mCrc = updateCrc(mCrc, data, length);
+  mInputSize += length;
+  while (length > 0) {
+    if (mFill == 2 * WINDOW_SIZE) {
+      slideWindow();
+    }
+    const size_t count = std::min(length, 2 * WINDOW_SIZE - mFill);
+    memcpy(mWindow + mFill, data, count);
+    mFill += count;
+    data += count;
+    length -= count;
+    compress(out);
+  }
+  flushOut(out);
+}
+
+void GzipEncoder::sync(String &out) {
+  if (mSymbolCount > 0) {
+    writeBlock(false, out);
+  }
+  // empty stored block
+  putBits(0, 3, out);
+  alignToByte(out);
+  putBits(0x0000, 16, out);
+  putBits(0xffff, 16, out);
+  flushOut(out);
+}
+
+void GzipEncoder::finish(String &out) {
+  writeBlock(true, out);
+  alignToByte(out);
+  putBits(mCrc, 32, out);
+  putBits(mInputSize, 32, out);
+  flushOut(out);
+}
+
+uint32_t GzipEncoder::getCrc() const {
+  return mCrc;
+}
+
+uint32_t GzipEncoder::getInputSize() const {
+  return mInputSize;
+}
+
+void GzipEncoder::finishAfterSync(uint32_t crc, uint32_t inputSize, String &out) {
+  // empty final block with fixed codes, then the trailer
+  const char bytes[] = {
+    0x03, 0x00,
+    (char) crc, (char) (crc >> 8), (char) (crc >> 16), (char) (crc >> 24),
+    (char) inputSize, (char) (inputSize >> 8), (char) (inputSize >> 16), (char) (inputSize >> 24),
+    0 // String::concat() copies the terminating 0 as well
+  };
+  out.concat(bytes, sizeof(bytes) - 1);
+}
+
+/* Matches only reach to the end of the data written so far, a match
+ * crossing into the next write() is split.
+ */
+void GzipEncoder::compress(String &out) {
+  while (mPosition < mFill) {
+    const size_t available = mFill - mPosition;
+    uint16_t matchLength = 0;
+    size_t matchPosition = 0;
+    if (available >= MIN_MATCH) {
+      const uint16_t h = hash(mWindow + mPosition);
+      const uint16_t candidate = mHead[h];
+      mHead[h] = mPosition + 1;
+      if (candidate != 0) {
+        matchPosition = candidate - 1;
+        const size_t limit = std::min<size_t>(available, MAX_MATCH);
+        while (matchLength < limit
+               && mWindow[matchPosition + matchLength] == mWindow[mPosition + matchLength]) {
+          matchLength++;
+        }
+      }
+    }
+    if (matchLength >= MIN_MATCH) {
+      addSymbol(matchLength, mPosition - matchPosition, out);
+      // remember the positions inside the match for later matches
+      const size_t end = mPosition + matchLength;
+      for (mPosition++; mPosition < end; mPosition++) {
+        if (mFill - mPosition >= MIN_MATCH) {
+          mHead[hash(mWindow + mPosition)] = mPosition + 1;
+        }
+      }
+    } else {
+      addSymbol(mWindow[mPosition], 0, out);
+      mPosition++;
+    }
+  }
+}
+
+void GzipEncoder::slideWindow() {
+  memmove(mWindow, mWindow + WINDOW_SIZE, WINDOW_SIZE);
+  mFill -= WINDOW_SIZE;
+  mPosition -= WINDOW_SIZE;
+  for (size_t i = 0; i < (1 << HASH_BITS); i++) {
+    mHead[i] = mHead[i] > WINDOW_SIZE ? mHead[i] - WINDOW_SIZE : 0;
+  }
+}
+
+uint16_t GzipEncoder::hash(const uint8_t *data) {
+  const uint32_t value = data[0] | (data[1] << 8) | (data[2] << 16);
+  return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+void GzipEncoder::addSymbol(uint16_t literalOrLength, uint16_t distance, String &out) {
+  mLiteralOrLength[mSymbolCount] = literalOrLength;
+  mDistance[mSymbolCount] = distance;
+  mSymbolCount++;
+  if (distance == 0) {
+    mLiteralFrequencies[literalOrLength]++;
+  } else {
+    mLiteralFrequencies[257 + lengthCode(literalOrLength)]++;
+    mDistanceFrequencies[distanceCode(distance)]++;
+  }
+  if (mSymbolCount == BLOCK_SYMBOLS) {
+    writeBlock(false, out);
+  }
+}
+
+uint8_t GzipEncoder::lengthCode(uint16_t length) {
+  uint8_t code = sizeof(LENGTH_BASE) / sizeof(LENGTH_BASE[0]) - 1;
+  while (LENGTH_BASE[code] > length) {
+    code--;
+  }
+  return code;
+}
+
+uint8_t GzipEncoder::distanceCode(uint16_t distance) {
+  uint8_t code = sizeof(DISTANCE_BASE) / sizeof(DISTANCE_BASE[0]) - 1;
+  while (DISTANCE_BASE[code] > distance) {
+    code--;
+  }
+  return code;
+}
+
+/* Writes the collected symbols as one block, with codes built for the
+ * block or with the fixed codes if that is smaller.
+ */
+void GzipEncoder::writeBlock(bool last, String &out) {
+  mLiteralFrequencies[END_OF_BLOCK] = 1;
+
+  // a Huffman tree needs two symbols, unused symbols simply get a code
+  memcpy(mFrequencies, mLiteralFrequencies, sizeof(mLiteralFrequencies));
+  buildLengths(mFrequencies, LITERAL_CODES, 15, mLiteralLengths);
+  memcpy(mFrequencies, mDistanceFrequencies, sizeof(mDistanceFrequencies));
+  buildLengths(mFrequencies, DISTANCE_CODES, 15, mDistanceLengths);
+  const uint16_t literalCount = usedCodes(mLiteralLengths, LITERAL_CODES, 257);
+  const uint16_t distanceCount = usedCodes(mDistanceLengths, DISTANCE_CODES, 1);
+
+  memcpy(mAllLengths, mLiteralLengths, literalCount);
+  memcpy(mAllLengths + literalCount, mDistanceLengths, distanceCount);
+  const uint16_t runCount = runLengthEncode(
+    mAllLengths, literalCount + distanceCount, mRunSymbols, mRunExtra);
+  memset(mFrequencies, 0, LENGTH_CODES * sizeof(mFrequencies[0]));
+  for (uint16_t i = 0; i < runCount; i++) {
+    mFrequencies[mRunSymbols[i]]++;
+  }
+  buildLengths(mFrequencies, LENGTH_CODES, 7, mRunLengths);
+  uint8_t orderCount = LENGTH_CODES;
+  while (orderCount > 4 && mRunLengths[LENGTH_CODE_ORDER[orderCount - 1]] == 0) {
+    orderCount--;
+  }
+
+  uint32_t dynamicBits = 5 + 5 + 4 + 3 * orderCount
+    + codeBits(mLiteralFrequencies, mLiteralLengths, LITERAL_CODES)
+    + codeBits(mDistanceFrequencies, mDistanceLengths, DISTANCE_CODES);
+  for (uint16_t i = 0; i < runCount; i++) {
+    dynamicBits += mRunLengths[mRunSymbols[i]];
+    if (mRunSymbols[i] >= 16) {
+      dynamicBits += RUN_EXTRA_BITS[mRunSymbols[i] - 16];
+    }
+  }
+  uint8_t fixedLengths[FIXED_LITERAL_CODES];
+  memset(fixedLengths, 8, 144);
+  memset(fixedLengths + 144, 9, 256 - 144);
+  memset(fixedLengths + 256, 7, 280 - 256);
+  memset(fixedLengths + 280, 8, FIXED_LITERAL_CODES - 280);
+  uint32_t fixedBits = codeBits(mLiteralFrequencies, fixedLengths, LITERAL_CODES);
+  for (uint16_t i = 0; i < DISTANCE_CODES; i++) {
+    fixedBits += 5 * mDistanceFrequencies[i];
+  }
+
+  putBits(last ? 1 : 0, 1, out);
+  if (fixedBits <= dynamicBits) {
+    putBits(1, 2, out);
+    buildCodes(fixedLengths, FIXED_LITERAL_CODES, mLiteralCodes);
+    memset(mDistanceLengths, 5, DISTANCE_CODES);
+    buildCodes(mDistanceLengths, DISTANCE_CODES, mDistanceCodes);
+    writeSymbols(mLiteralCodes, fixedLengths, mDistanceCodes, mDistanceLengths, out);
+  } else {
+    putBits(2, 2, out);
+    putBits(literalCount - 257, 5, out);
+    putBits(distanceCount - 1, 5, out);
+    putBits(orderCount - 4, 4, out);
+    for (uint8_t i = 0; i < orderCount; i++) {
+      putBits(mRunLengths[LENGTH_CODE_ORDER[i]], 3, out);
+    }
+    buildCodes(mRunLengths, LENGTH_CODES, mRunCodes);
+    for (uint16_t i = 0; i < runCount; i++) {
+      const uint8_t symbol = mRunSymbols[i];
+      putBits(mRunCodes[symbol], mRunLengths[symbol], out);
+      if (symbol >= 16) {
+        putBits(mRunExtra[i], RUN_EXTRA_BITS[symbol - 16], out);
+      }
+    }
+    buildCodes(mLiteralLengths, LITERAL_CODES, mLiteralCodes);
+    buildCodes(mDistanceLengths, DISTANCE_CODES, mDistanceCodes);
+    writeSymbols(mLiteralCodes, mLiteralLengths, mDistanceCodes, mDistanceLengths, out);
+  }
+
+  mSymbolCount = 0;
+  memset(mLiteralFrequencies, 0, sizeof(mLiteralFrequencies));
+  memset(mDistanceFrequencies, 0, sizeof(mDistanceFrequencies));
+}
+
+void GzipEncoder::writeSymbols(const uint16_t *literalCodes, const uint8_t *literalLengths,
+                               const uint16_t *distanceCodes, const uint8_t *distanceLengths,
+                               String &out) {
+  for (size_t i = 0; i < mSymbolCount; i++) {
+    const uint16_t distance = mDistance[i];
+    if (distance == 0) {
+      const uint16_t literal = mLiteralOrLength[i];
+      putBits(literalCodes[literal], literalLengths[literal], out);
+    } else {
+      const uint16_t length = mLiteralOrLength[i];
+      uint8_t code = lengthCode(length);
+      putBits(literalCodes[257 + code], literalLengths[257 + code], out);
+      putBits(length - LENGTH_BASE[code], LENGTH_EXTRA_BITS[code], out);
+      code = distanceCode(distance);
+      putBits(distanceCodes[code], distanceLengths[code], out);
+      putBits(distance - DISTANCE_BASE[code], DISTANCE_EXTRA_BITS[code], out);
+    }
+  }
+  putBits(literalCodes[END_OF_BLOCK], literalLengths[END_OF_BLOCK], out);
+}
+
+/* Huffman code lengths of at most maxLength bits, symbols without
+ * frequency get no code unless needed to have at least two codes.
+ * Frequencies are halved till the longest code fits, which costs
+ * little compression for the rare case of very uneven frequencies.
+ */
+void GzipEncoder::buildLengths(uint16_t *frequencies, uint16_t count,
+                               uint8_t maxLength, uint8_t *lengths) {
+  uint16_t leaves = 0;
+  for (uint16_t i = 0; i < count && leaves < 2; i++) {
+    leaves += frequencies[i] > 0;
+  }
+  for (uint16_t i = 0; leaves < 2; i++) {
+    if (frequencies[i] == 0) {
+      frequencies[i] = 1;
+      leaves++;
+    }
+  }
+  while (true) {
+    leaves = 0;
+    for (uint16_t i = 0; i < count; i++) {
+      if (frequencies[i] > 0) {
+        mLeafSymbol[leaves++] = i;
+      }
+    }
+    std::sort(mLeafSymbol, mLeafSymbol + leaves, [frequencies](uint16_t a, uint16_t b) {
+      return frequencies[a] < frequencies[b] || (frequencies[a] == frequencies[b] && a < b);
+    });
+    for (uint16_t i = 0; i < leaves; i++) {
+      mNodeWeight[i] = frequencies[mLeafSymbol[i]];
+    }
+    // leaves and the combined nodes are both created in ascending weight,
+    // the two smallest nodes are always at the front of one of the queues
+    uint16_t nextLeaf = 0;
+    uint16_t nextNode = leaves;
+    uint16_t nodes = leaves;
+    while (nodes < 2 * leaves - 1) {
+      uint16_t smallest[2];
+      for (uint16_t &pick : smallest) {
+        if (nextLeaf < leaves && (nextNode == nodes || mNodeWeight[nextLeaf] <= mNodeWeight[nextNode])) {
+          pick = nextLeaf++;
+        } else {
+          pick = nextNode++;
+        }
+      }
+      mNodeWeight[nodes] = mNodeWeight[smallest[0]] + mNodeWeight[smallest[1]];
+      mNodeParent[smallest[0]] = nodes;
+      mNodeParent[smallest[1]] = nodes;
+      nodes++;
+    }
+    // reuse the weights as depth, parents always come after their children
+    mNodeWeight[nodes - 1] = 0;
+    uint8_t longest = 0;
+    for (int16_t node = nodes - 2; node >= 0; node--) {
+      mNodeWeight[node] = mNodeWeight[mNodeParent[node]] + 1;
+    }
+    memset(lengths, 0, count);
+    for (uint16_t i = 0; i < leaves; i++) {
+      lengths[mLeafSymbol[i]] = mNodeWeight[i];
+      longest = std::max<uint8_t>(longest, mNodeWeight[i]);
+    }
+    if (longest <= maxLength) {
+      return;
+    }
+    for (uint16_t i = 0; i < count; i++) {
+      if (frequencies[i] > 0) {
+        frequencies[i] = (frequencies[i] >> 1) | 1;
+      }
+    }
+  }
+}
+
+/* Canonical Huffman codes as in RFC 1951 3.2.2, bit reversed so they can
+ * be written with putBits().
+ */
+void GzipEncoder::buildCodes(const uint8_t *lengths, uint16_t count, uint16_t *codes) {
+  uint16_t lengthCount[16] = {};
+  for (uint16_t i = 0; i < count; i++) {
+    lengthCount[lengths[i]]++;
+  }
+  lengthCount[0] = 0;
+  uint16_t nextCode[16];
+  uint16_t code = 0;
+  for (uint8_t bits = 1; bits < 16; bits++) {
+    code = (code + lengthCount[bits - 1]) << 1;
+    nextCode[bits] = code;
+  }
+  for (uint16_t i = 0; i < count; i++) {
+    const uint8_t length = lengths[i];
+    if (length > 0) {
+      uint16_t value = nextCode[length]++;
+      uint16_t reversed = 0;
+      for (uint8_t bit = 0; bit < length; bit++) {
+        reversed = (reversed << 1) | (value & 1);
+        value >>= 1;
+      }
+      codes[i] = reversed;
+    }
+  }
+}
+
+/* Code lengths with runs replaced by the symbols 16 (repeat the previous
+ * length), 17 and 18 (repeat 0), returns the number of symbols.
+ */
+uint16_t GzipEncoder::runLengthEncode(const uint8_t *lengths, uint16_t count,
+                                      uint8_t *symbols, uint8_t *extra) {
+  uint16_t result = 0;
+  uint16_t i = 0;
+  while (i < count) {
+    const uint8_t length = lengths[i];
+    uint16_t run = 1;
+    while (i + run < count && lengths[i + run] == length) {
+      run++;
+    }
+    i += run;
+    if (length == 0) {
+      while (run >= 11) {
+        const uint16_t repeat = std::min<uint16_t>(run, 138);
+        symbols[result] = 18;
+        extra[result++] = repeat - 11;
+        run -= repeat;
+      }
+      if (run >= 3) {
+        symbols[result] = 17;
+        extra[result++] = run - 3;
+        run = 0;
+      }
+    } else {
+      symbols[result] = length;
+      extra[result++] = 0;
+      run--;
+      while (run >= 3) {
+        const uint16_t repeat = std::min<uint16_t>(run, 6);
+        symbols[result] = 16;
+        extra[result++] = repeat - 3;
+        run -= repeat;
+      }
+    }
+    while (run > 0) {
+      symbols[result] = length;
+      extra[result++] = 0;
+      run--;
+    }
+  }
+  return result;
+}
+
+/* Number of leading codes to store, the trailing unused ones are left out. */
+uint16_t GzipEncoder::usedCodes(const uint8_t *lengths, uint16_t count, uint16_t minimum) {
+  while (count > minimum && lengths[count - 1] == 0) {
+    count--;
+  }
+  return count;
+}
+
+uint32_t GzipEncoder::codeBits(const uint16_t *frequencies, const uint8_t *lengths, uint16_t count) {
+  uint32_t bits = 0;
+  for (uint16_t i = 0; i < count; i++) {
+    bits += (uint32_t) frequencies[i] * lengths[i];
+  }
+  return bits;
+}
+
+void GzipEncoder::putBits(uint32_t value, uint8_t count, String &out) {
+  while (count > 0) {
+    const uint8_t taken = std::min<uint8_t>(count, 16);
+    mBits |= (value & ((1u << taken) - 1)) << mBitCount;
+    mBitCount += taken;
+    value >>= taken;
+    count -= taken;
+    while (mBitCount >= 8) {
+      if (mOutLength == OUT_BUFFER_SIZE) {
+        flushOut(out);
+      }
+      mOut[mOutLength++] = (char) mBits;
+      mBits >>= 8;
+      mBitCount -= 8;
+    }
+  }
+}
+
+void GzipEncoder::alignToByte(String &out) {
+  if (mBitCount > 0) {
+    putBits(0, 8 - mBitCount, out);
+  }
+}
+
+void GzipEncoder::flushOut(String &out) {
+  if (mOutLength > 0) {
+    mOut[mOutLength] = 0;
+    out.concat(mOut, mOutLength);
+    mOutLength = 0;
+  }
+}
+
+uint32_t GzipEncoder::updateCrc(uint32_t crc, const uint8_t *data, size_t length) {
+  static const uint32_t TABLE[] = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+  };
+  crc = ~crc;
+  for (size_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    crc = (crc >> 4) ^ TABLE[crc & 0x0f];
+    crc = (crc >> 4) ^ TABLE[crc & 0x0f];
+  }
+  return ~crc;
+}
+
+GzipDecoder::GzipDecoder(File *in) :
+  mIn(in),
+  mHistory(new uint8_t[HISTORY_SIZE]) {
+}
+
+GzipDecoder::~GzipDecoder() {
+  delete[] mHistory;
+}
+
+bool GzipDecoder::begin() {
+  static const uint8_t TEXT_CRC = 0x02, EXTRA = 0x04, NAME = 0x08, COMMENT = 0x10;
+  if (getByte() != 0x1f || getByte() != 0x8b || getByte() != 8) {
+    fail("no gzip header");
+    return false;
+  }
+  const uint8_t flags = getByte();
+  if (flags & 0xe0) {
+    fail("reserved header flags");
+    return false;
+  }
+  // time, extra flags and OS
+  for (int i = 0; i < 6; i++) {
+    getByte();
+  }
+  if (flags & EXTRA) {
+    uint16_t length = getByte();
+    length |= getByte() << 8;
+    while (length-- > 0 && mState != FAILED) {
+      getByte();
+    }
+  }
+  for (const uint8_t text : {NAME, COMMENT}) {
+    if (flags & text) {
+      while (getByte() != 0 && mState != FAILED) {
+      }
+    }
+  }
+  if (flags & TEXT_CRC) {
+    getByte();
+    getByte();
+  }
+  return mState != FAILED;
+}
+
+size_t GzipDecoder::read(uint8_t *data, size_t length) {
+  size_t count = 0;
+  // data before this position is part of mCrc
+  size_t crcPosition = 0;
+  while (count < length && mState != FINISHED && mState != FAILED) {
+    uint8_t byte;
+    if (mCopyLength > 0) {
+      byte = mHistory[(mHistoryPosition - mCopyDistance) & (HISTORY_SIZE - 1)];
+      mCopyLength--;
+    } else if (mState == BLOCK_HEADER) {
+      if (mLastBlock) {
+        mCrc = GzipEncoder::updateCrc(mCrc, data + crcPosition, count - crcPosition);
+        crcPosition = count;
+        readTrailer();
+      } else {
+        readBlockHeader();
+      }
+      continue;
+    } else if (mState == STORED) {
+      if (mStoredLength == 0) {
+        mState = BLOCK_HEADER;
+        continue;
+      }
+      byte = getByte();
+      mStoredLength--;
+    } else {
+      const int symbol = decode(mLiteralCode);
+      if (symbol < 0) {
+        continue;
+      } else if (symbol < END_OF_BLOCK) {
+        byte = symbol;
+      } else if (symbol == END_OF_BLOCK) {
+        mState = BLOCK_HEADER;
+        continue;
+      } else {
+        const uint16_t lengthCode = symbol - END_OF_BLOCK - 1;
+        if (lengthCode >= sizeof(LENGTH_BASE) / sizeof(LENGTH_BASE[0])) {
+          fail("invalid length code");
+          continue;
+        }
+        const uint16_t copyLength = LENGTH_BASE[lengthCode] + getBits(LENGTH_EXTRA_BITS[lengthCode]);
+        const int distanceCode = decode(mDistanceCode);
+        if (distanceCode < 0) {
+          continue;
+        } else if (distanceCode >= DISTANCE_CODES) {
+          fail("invalid distance code");
+          continue;
+        }
+        const uint16_t distance = DISTANCE_BASE[distanceCode] + getBits(DISTANCE_EXTRA_BITS[distanceCode]);
+        if (distance > mOutputSize || distance > HISTORY_SIZE) {
+          fail("distance too far back");
+          continue;
+        }
+        mCopyLength = copyLength;
+        mCopyDistance = distance;
+        continue;
+      }
+    }
+    if (mState == FAILED) {
+      break;
+    }
+    data[count++] = byte;
+    mHistory[mHistoryPosition & (HISTORY_SIZE - 1)] = byte;
+    mHistoryPosition++;
+    mOutputSize++;
+  }
+  mCrc = GzipEncoder::updateCrc(mCrc, data + crcPosition, count - crcPosition);
+  return count;
+}
+
+bool GzipDecoder::isFinished() const {
+  return mState == FINISHED;
+}
+
+bool GzipDecoder::hasFailed() const {
+  return mState == FAILED;
+}
+
+void GzipDecoder::readBlockHeader() {
+  mLastBlock = getBits(1);
+  const uint8_t type = getBits(2);
+  if (type == 0) {
+    readStoredHeader();
+  } else if (type == 1) {
+    useFixedCodes();
+    mState = CODES;
+  } else if (type == 2) {
+    if (readDynamicCodes()) {
+      mState = CODES;
+    }
+  } else {
+    fail("invalid block type");
+  }
+}
+
+void GzipDecoder::readStoredHeader() {
+  // stored data starts at the next byte, getBits() keeps less than a byte
+  mBits = 0;
+  mBitCount = 0;
+  const uint16_t length = getBits(16);
+  const uint16_t complement = getBits(16);
+  if (length != (uint16_t) ~complement) {
+    fail("stored block length mismatch");
+    return;
+  }
+  mStoredLength = length;
+  mState = STORED;
+}
+
+bool GzipDecoder::readDynamicCodes() {
+  const uint16_t literals = getBits(5) + 257;
+  const uint16_t distances = getBits(5) + 1;
+  const uint8_t lengthCodes = getBits(4) + 4;
+  if (literals > 286 || distances > DISTANCE_CODES) {
+    fail("too many codes");
+    return false;
+  }
+  uint8_t lengthCodeLengths[LENGTH_CODES] = {};
+  for (uint8_t i = 0; i < lengthCodes; i++) {
+    lengthCodeLengths[LENGTH_CODE_ORDER[i]] = getBits(3);
+  }
+  // the literal code is built from these lengths right after
+  if (!buildCode(mLiteralCode, lengthCodeLengths, LENGTH_CODES)) {
+    return false;
+  }
+  uint16_t index = 0;
+  while (index < literals + distances && mState != FAILED) {
+    const int symbol = decode(mLiteralCode);
+    if (symbol < 0) {
+      return false;
+    } else if (symbol < 16) {
+      mLengths[index++] = symbol;
+      continue;
+    }
+    uint8_t length = 0;
+    if (symbol == 16) {
+      if (index == 0) {
+        fail("repeat without length");
+        return false;
+      }
+      length = mLengths[index - 1];
+    }
+    const uint16_t repeat = (symbol == 18 ? 11 : 3) + getBits(RUN_EXTRA_BITS[symbol - 16]);
+    if (index + repeat > literals + distances) {
+      fail("too many lengths");
+      return false;
+    }
+    for (uint16_t i = 0; i < repeat; i++) {
+      mLengths[index++] = length;
+    }
+  }
+  if (mState == FAILED) {
+    return false;
+  }
+  if (mLengths[END_OF_BLOCK] == 0) {
+    fail("no end of block code");
+    return false;
+  }
+  return buildCode(mLiteralCode, mLengths, literals)
+    && buildCode(mDistanceCode, mLengths + literals, distances);
+}
+
+void GzipDecoder::useFixedCodes() {
+  for (uint16_t symbol = 0; symbol < LITERAL_CODES; symbol++) {
+    mLengths[symbol] = symbol < 144 ? 8 : symbol < 256 ? 9 : symbol < 280 ? 7 : 8;
+  }
+  buildCode(mLiteralCode, mLengths, LITERAL_CODES);
+  for (uint16_t symbol = 0; symbol < DISTANCE_CODES; symbol++) {
+    mLengths[symbol] = 5;
+  }
+  buildCode(mDistanceCode, mLengths, DISTANCE_CODES);
+}
+
+void GzipDecoder::readTrailer() {
+  mBits = 0;
+  mBitCount = 0;
+  uint32_t crc = getBits(16);
+  crc |= getBits(16) << 16;
+  uint32_t size = getBits(16);
+  size |= getBits(16) << 16;
+  if (mState == FAILED) {
+    return;
+  }
+  if (crc != mCrc || size != mOutputSize) {
+    fail("CRC or size mismatch");
+    return;
+  }
+  mState = FINISHED;
+}
+
+/* Incomplete codes are accepted, a missing code fails in decode(). */
+bool GzipDecoder::buildCode(Code &code, const uint8_t *lengths, uint16_t count) {
+  memset(code.counts, 0, sizeof(code.counts));
+  for (uint16_t symbol = 0; symbol < count; symbol++) {
+    code.counts[lengths[symbol]]++;
+  }
+  code.counts[0] = 0;
+  int32_t left = 1;
+  uint16_t offsets[MAX_CODE_LENGTH + 2];
+  offsets[1] = 0;
+  for (uint8_t length = 1; length <= MAX_CODE_LENGTH; length++) {
+    left = (left << 1) - code.counts[length];
+    if (left < 0) {
+      fail("over-subscribed code");
+      return false;
+    }
+    offsets[length + 1] = offsets[length] + code.counts[length];
+  }
+  for (uint16_t symbol = 0; symbol < count; symbol++) {
+    if (lengths[symbol] != 0) {
+      code.symbols[offsets[lengths[symbol]]++] = symbol;
+    }
+  }
+  return true;
+}
+
+/* Reads the code bit by bit, codes of a length are consecutive numbers
+ * starting at first.
+ */
+int GzipDecoder::decode(const Code &code) {
+  int value = 0;
+  int first = 0;
+  int index = 0;
+  for (uint8_t length = 1; length <= MAX_CODE_LENGTH; length++) {
+    value |= getBits(1);
+    const int count = code.counts[length];
+    if (value - first < count) {
+      return code.symbols[index + value - first];
+    }
+    index += count;
+    first = (first + count) << 1;
+    value <<= 1;
+  }
+  fail("invalid code");
+  return -1;
+}
+
+/* At most 16 bits at a time. */
+uint32_t GzipDecoder::getBits(uint8_t count) {
+  while (mBitCount < count) {
+    mBits |= (uint32_t) getByte() << mBitCount;
+    mBitCount += 8;
+  }
+  const uint32_t value = mBits & ((1u << count) - 1);
+  mBits >>= count;
+  mBitCount -= count;
+  return value;
+}
+
+uint8_t GzipDecoder::getByte() {
+  if (mInPosition == mInLength) {
+    if (mState == FAILED) {
+      return 0;
+    }
+    mInLength = mIn->read(mInBuffer, IN_BUFFER_SIZE);
+    mInPosition = 0;
+    if (mInLength == 0) {
+      fail("unexpected end of data");
+      return 0;
+    }
+  }
+  return mInBuffer[mInPosition++];
+}
+
+void GzipDecoder::fail(const char *reason) {
+  if (mState != FAILED) {
+    log_e("Broken gzip data: %s", reason);
+  }
+  mState = FAILED;
+  mCopyLength = 0;
+}
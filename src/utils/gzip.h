@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OPENBIKESENSORFIRMWARE_GZIP_H
+#define OPENBIKESENSORFIRMWARE_GZIP_H
+
+#include <Arduino.h>
+#include <FS.h>
+
+/* Bytes of history used to find repeated data, at most 16k. */
+#ifndef GZIP_WINDOW_SIZE
+#define GZIP_WINDOW_SIZE 4096
+#endif
+
+/* Literals and matches collected before a deflate block is written, 4
+ * bytes each.
+ */
+#ifndef GZIP_BLOCK_SYMBOLS
+#define GZIP_BLOCK_SYMBOLS 2048
+#endif
+
+/* Incremental gzip (RFC 1952) compressor with bounded memory, about
+ * 2 * GZIP_WINDOW_SIZE + 4 * GZIP_BLOCK_SYMBOLS + 14k bytes. Uses greedy
+ * LZ77 matching with a single hash probe, each block is written with
+ * Huffman codes built for the block or the fixed codes, whichever is
+ * smaller. Compressed bytes are appended to the String passed in.
+ */
+class GzipEncoder {
+  public:
+    GzipEncoder();
+    ~GzipEncoder();
+    /* Appends the gzip header, call once before anything else. */
+    void begin(String &out);
+    void write(const uint8_t *data, size_t length, String &out);
+    /* Byte aligns the output so everything written so far can be
+     * decompressed, like Z_SYNC_FLUSH.
+     */
+    void sync(String &out);
+    /* Ends the deflate stream and appends the gzip trailer. */
+    void finish(String &out);
+    /* CRC and size of all data written so far, as needed for the trailer. */
+    uint32_t getCrc() const;
+    uint32_t getInputSize() const;
+    /* What finish() appends right after a sync(), lets a file cut at a
+     * sync point be completed with the CRC and size known at that point.
+     */
+    static void finishAfterSync(uint32_t crc, uint32_t inputSize, String &out);
+    /* CRC-32 of gzip, continues crc with the data. */
+    static uint32_t updateCrc(uint32_t crc, const uint8_t *data, size_t length);
+    static const size_t HEADER_SIZE = 10;
+
+  private:
+    static const size_t WINDOW_SIZE = GZIP_WINDOW_SIZE;
+    static const size_t BLOCK_SYMBOLS = GZIP_BLOCK_SYMBOLS;
+    static const uint8_t HASH_BITS = 12;
+    static const uint16_t MIN_MATCH = 3;
+    static const uint16_t MAX_MATCH = 258;
+    static const uint16_t LITERAL_CODES = 286;
+    // the fixed code defines two more, which shifts the 9 bit codes
+    static const uint16_t FIXED_LITERAL_CODES = 288;
+    static const uint16_t DISTANCE_CODES = 30;
+    static const uint16_t LENGTH_CODES = 19;
+    static const size_t OUT_BUFFER_SIZE = 64;
+    static_assert(WINDOW_SIZE <= 16384, "window must fit uint16_t positions");
+
+    void compress(String &out);
+    void slideWindow();
+    void addSymbol(uint16_t literalOrLength, uint16_t distance, String &out);
+    void writeBlock(bool last, String &out);
+    void writeSymbols(const uint16_t *literalCodes, const uint8_t *literalLengths,
+                      const uint16_t *distanceCodes, const uint8_t *distanceLengths, String &out);
+    void putBits(uint32_t value, uint8_t count, String &out);
+    void alignToByte(String &out);
+    void flushOut(String &out);
+    void buildLengths(uint16_t *frequencies, uint16_t count,
+                      uint8_t maxLength, uint8_t *lengths);
+    static uint16_t hash(const uint8_t *data);
+    static uint8_t lengthCode(uint16_t length);
+    static uint8_t distanceCode(uint16_t distance);
+    static void buildCodes(const uint8_t *lengths, uint16_t count, uint16_t *codes);
+    static uint16_t runLengthEncode(const uint8_t *lengths, uint16_t count,
+                                    uint8_t *symbols, uint8_t *extra);
+    static uint16_t usedCodes(const uint8_t *lengths, uint16_t count, uint16_t minimum);
+    static uint32_t codeBits(const uint16_t *frequencies, const uint8_t *lengths, uint16_t count);
+
+    // input of the last 2 * WINDOW_SIZE bytes, compressed up to mPosition
+    uint8_t *mWindow;
+    // position + 1 of the last occurrence of each hash, 0 for none
+    uint16_t *mHead;
+    size_t mFill = 0;
+    size_t mPosition = 0;
+    // symbols of the current block, literals have distance 0
+    uint16_t *mLiteralOrLength;
+    uint16_t *mDistance;
+    size_t mSymbolCount = 0;
+    uint16_t mLiteralFrequencies[LITERAL_CODES];
+    uint16_t mDistanceFrequencies[DISTANCE_CODES];
+    // scratch space for writing a block, too large for the writer task stack
+    uint16_t mFrequencies[LITERAL_CODES];
+    uint8_t mLiteralLengths[LITERAL_CODES];
+    uint16_t mLiteralCodes[FIXED_LITERAL_CODES];
+    uint8_t mDistanceLengths[DISTANCE_CODES];
+    uint16_t mDistanceCodes[DISTANCE_CODES];
+    uint8_t mAllLengths[LITERAL_CODES + DISTANCE_CODES];
+    uint8_t mRunSymbols[LITERAL_CODES + DISTANCE_CODES];
+    uint8_t mRunExtra[LITERAL_CODES + DISTANCE_CODES];
+    uint8_t mRunLengths[LENGTH_CODES];
+    uint16_t mRunCodes[LENGTH_CODES];
+    uint32_t mNodeWeight[2 * LITERAL_CODES];
+    uint16_t mNodeParent[2 * LITERAL_CODES];
+    uint16_t mLeafSymbol[LITERAL_CODES];
+    uint32_t mBits = 0;
+    uint8_t mBitCount = 0;
+    uint32_t mCrc = 0;
+    uint32_t mInputSize = 0;
+    // one extra byte, String::concat() copies the terminating 0 as well
+    char mOut[OUT_BUFFER_SIZE + 1];
+    size_t mOutLength = 0;
+};
+
+/* Incremental gzip decompressor reading from a file, with bounded memory
+ * of about 17k bytes. Keeps 16k bytes of history, enough for any window
+ * GzipEncoder can be built with. Handles a single gzip member, the CRC
+ * and size of the trailer are checked at its end.
+ */
+class GzipDecoder {
+  public:
+    explicit GzipDecoder(File *in);
+    ~GzipDecoder();
+    /* Reads the gzip header, false if the file does not start with one. */
+    bool begin();
+    /* Decompresses up to length bytes into data. Returns less only at the
+     * end of the data or if it is broken, see isFinished() and hasFailed().
+     */
+    size_t read(uint8_t *data, size_t length);
+    /* All data was read and matched the trailer. */
+    bool isFinished() const;
+    bool hasFailed() const;
+
+  private:
+    static const size_t HISTORY_SIZE = 16384;
+    static const uint8_t MAX_CODE_LENGTH = 15;
+    static const uint16_t LITERAL_CODES = 288;
+    static const uint16_t DISTANCE_CODES = 30;
+    static const uint16_t LENGTH_CODES = 19;
+    static const size_t IN_BUFFER_SIZE = 64;
+    enum State {
+      BLOCK_HEADER, STORED, CODES, FINISHED, FAILED
+    };
+    // canonical Huffman code, the symbols sorted by code
+    struct Code {
+      uint16_t counts[MAX_CODE_LENGTH + 1];
+      uint16_t symbols[LITERAL_CODES];
+    };
+
+    void readBlockHeader();
+    void readStoredHeader();
+    bool readDynamicCodes();
+    void useFixedCodes();
+    void readTrailer();
+    bool buildCode(Code &code, const uint8_t *lengths, uint16_t count);
+    int decode(const Code &code);
+    uint32_t getBits(uint8_t count);
+    uint8_t getByte();
+    void fail(const char *reason);
+
+    File * const mIn;
+    uint8_t *mHistory;
+    size_t mHistoryPosition = 0;
+    State mState = BLOCK_HEADER;
+    bool mLastBlock = false;
+    uint16_t mStoredLength = 0;
+    uint16_t mCopyLength = 0;
+    uint16_t mCopyDistance = 0;
+    Code mLiteralCode;
+    Code mDistanceCode;
+    uint8_t mLengths[LITERAL_CODES + DISTANCE_CODES];
+    uint32_t mBits = 0;
+    uint8_t mBitCount = 0;
+    uint8_t mInBuffer[IN_BUFFER_SIZE];
+    size_t mInLength = 0;
+    size_t mInPosition = 0;
+    uint32_t mCrc = 0;
+    uint32_t mOutputSize = 0;
+};
+
+#endif //OPENBIKESENSORFIRMWARE_GZIP_H
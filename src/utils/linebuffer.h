@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OPENBIKESENSORFIRMWARE_LINEBUFFER_H
+#define OPENBIKESENSORFIRMWARE_LINEBUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Builds a line of text in a caller supplied char buffer, numbers are
+ * formatted by hand instead of with snprintf() and nothing is allocated.
+ * The content is always 0 terminated. If the buffer is too small the
+ * content is truncated, overflowed() is set and requiredSize() tells the
+ * size of the buffer that would have been needed.
+ */
+class LineBuffer {
+  public:
+    LineBuffer(char *buffer, size_t size) : mBuffer(buffer), mSize(size) {
+      mBuffer[0] = 0;
+    };
+    const char *c_str() const {
+      return mBuffer;
+    };
+    size_t length() const {
+      return mLength < mSize ? mLength : mSize - 1;
+    };
+    bool overflowed() const {
+      return mLength >= mSize;
+    };
+    size_t requiredSize() const {
+      return mLength + 1;
+    };
+    void append(char c) {
+      if (mLength + 1 < mSize) {
+        mBuffer[mLength] = c;
+        mBuffer[mLength + 1] = 0;
+      }
+      mLength++;
+    };
+    void append(const char *data, size_t length) {
+      if (mLength + length < mSize) {
+        memcpy(mBuffer + mLength, data, length);
+        mBuffer[mLength + length] = 0;
+      } else if (mLength + 1 < mSize) {
+        memcpy(mBuffer + mLength, data, mSize - 1 - mLength);
+        mBuffer[mSize - 1] = 0;
+      }
+      mLength += length;
+    };
+    void append(const char *data) {
+      append(data, strlen(data));
+    };
+    /* Like String(value) */
+    void appendUnsigned(uint32_t value) {
+      appendZeroPadded(value, 1);
+    };
+    /* Like String(value) */
+    void appendSigned(int32_t value) {
+      if (value < 0) {
+        append('-');
+        appendUnsigned(0u - (uint32_t) value);
+      } else {
+        appendUnsigned(value);
+      }
+    };
+    /* Like snprintf("%0*u", width, value) */
+    void appendZeroPadded(uint32_t value, uint8_t width) {
+      char digits[10];
+      uint8_t count = 0;
+      do {
+        digits[count++] = (char) ('0' + value % 10);
+        value /= 10;
+      } while (value > 0);
+      while (width > count) {
+        append('0');
+        width--;
+      }
+      while (count > 0) {
+        append(digits[--count]);
+      }
+    };
+    /* value / 100 with 2 decimals, like String(value / 100.0, 2) */
+    void appendCenti(int32_t value) {
+      uint32_t absolute = (uint32_t) value;
+      if (value < 0) {
+        append('-');
+        absolute = 0u - absolute;
+      }
+      appendUnsigned(absolute / 100);
+      append('.');
+      appendZeroPadded(absolute % 100, 2);
+    };
+    /* Same output as GpsRecord::toScaledString(): empty for 0, otherwise
+     * snprintf("%d.%0*d", value / 10^scale, scale, abs(value % 10^scale)),
+     * so like the original the sign is lost for values between -1 and 0.
+     */
+    void appendScaled(int32_t value, uint8_t scale) {
+      if (value == 0) {
+        return;
+      }
+      int32_t scl = 1;
+      for (uint8_t i = 0; i < scale; i++) {
+        scl *= 10;
+      }
+      const int32_t fraction = value % scl;
+      appendSigned(value / scl);
+      append('.');
+      appendZeroPadded(fraction < 0 ? -fraction : fraction, scale);
+    };
+
+  private:
+    char * const mBuffer;
+    const size_t mSize;
+    size_t mLength = 0;
+};
+
+#endif //OPENBIKESENSORFIRMWARE_LINEBUFFER_H
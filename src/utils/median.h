@@ -24,50 +24,68 @@
 #ifndef OPENBIKESENSORFIRMWARE_MEDIAN_H
 #define OPENBIKESENSORFIRMWARE_MEDIAN_H
 
-#include <algorithm>
+#include <stddef.h>
 
-template<typename T> class Median {
+/* Running median over the last SIZE values, SIZE must be odd.
+ * Keeps the values in insertion order and sorted, addValue() binary
+ * searches the position of the dropped and of the new value and only moves
+ * the values ranked between them, median() is a plain lookup. No heap
+ * allocation, the window size is fixed at compile time.
+ */
+template<typename T, size_t SIZE> class Median {
+  static_assert(SIZE % 2 == 1, "median window size must be odd");
 
   public:
-    /* Simple implementation, size must be odd! */
-    Median(size_t size, T initialValue):
-      size{size},
-      mid{size/2},
-      data{new T[size]},
-      temp{new T[size]},
-      pos{0} {
-      for(size_t i = 0; i < size; i++) {
+    explicit Median(T initialValue) {
+      for (size_t i = 0; i < SIZE; i++) {
         data[i] = initialValue;
+        sorted[i] = initialValue;
       }
     };
-    ~Median() {
-      log_i("Will free Median(%d/%d) -> 0x%lx", size, mid, data);
-      delete[] data;
-      delete[] temp;
-    };
     void addValue(T value) {
-      sorted = false;
+      const T dropped = data[pos];
       data[pos++] = value;
-      if (pos >= size) {
+      if (pos >= SIZE) {
         pos = 0;
       }
-    };
-    T median() {
-      if (!sorted) {
-        memcpy(temp, data, sizeof(T) * size); // std:copy needs to much mem
-        std::sort(&temp[0], &temp[size]);
-        sorted = true;
+      size_t idx = lowerBound(dropped);
+      if (value > dropped) {
+        // move the smaller values one down, until the slot for value
+        while (idx + 1 < SIZE && sorted[idx + 1] < value) {
+          sorted[idx] = sorted[idx + 1];
+          idx++;
+        }
+      } else {
+        // move the larger values one up, until the slot for value
+        while (idx > 0 && sorted[idx - 1] > value) {
+          sorted[idx] = sorted[idx - 1];
+          idx--;
+        }
       }
-      return temp[mid];
+      sorted[idx] = value;
+    };
+    T median() const {
+      return sorted[SIZE / 2];
     };
 
   private:
-    const size_t size;
-    const size_t mid;
-    T *data;
-    T *temp;
+    /* Index of the first sorted value that is not less than value. */
+    size_t lowerBound(T value) const {
+      size_t low = 0;
+      size_t high = SIZE;
+      while (low < high) {
+        const size_t mid = (low + high) / 2;
+        if (sorted[mid] < value) {
+          low = mid + 1;
+        } else {
+          high = mid;
+        }
+      }
+      return low;
+    };
+    T data[SIZE];
+    T sorted[SIZE];
     size_t pos = 0;
-    boolean sorted = false;
 };
 
 #endif //OPENBIKESENSORFIRMWARE_MEDIAN_H
@@ -69,13 +69,20 @@ Stream *MultipartDataStream::asStream() {
 }
 
 size_t MultipartDataStream::length() {
-  return content->size();
+  return contentLength;
 }
 
 MultipartDataStream::MultipartDataStream(String name, String fileName, File *content, String contentType)
+  : MultipartDataStream(std::move(name), std::move(fileName), content, content->size(),
+                        std::move(contentType)) {
+}
+
+MultipartDataStream::MultipartDataStream(String name, String fileName, Stream *content, size_t length,
+                                         String contentType)
   : MultipartData(std::move(name), std::move(contentType)) {
   this->fileName = std::move(fileName);
   this->content = content;
+  this->contentLength = length;
 }
 
 
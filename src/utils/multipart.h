@@ -71,9 +71,14 @@ class MultipartDataStream : public MultipartData {
 
     MultipartDataStream(String name, String fileName, File *content, String contentType = "");
 
+    /* For content that is not read from a file as is, length bytes. */
+    MultipartDataStream(String name, String fileName, Stream *content, size_t length,
+                        String contentType = "");
+
   private:
     String fileName;
-    File *content;
+    Stream *content;
+    size_t contentLength;
 };
 
 
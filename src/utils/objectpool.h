@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OPENBIKESENSORFIRMWARE_OBJECTPOOL_H
+#define OPENBIKESENSORFIRMWARE_OBJECTPOOL_H
+
+#include <stddef.h>
+
+/* SIZE preallocated objects handed out and taken back without touching
+ * the heap. Objects are not reinitialized, acquire() returns nullptr if
+ * all objects are in use. Not thread safe.
+ */
+template<typename T, size_t SIZE> class ObjectPool {
+  public:
+    ObjectPool() {
+      for (size_t i = 0; i < SIZE; i++) {
+        freeObjects[i] = &objects[i];
+      }
+    };
+    T *acquire() {
+      if (freeCount == 0) {
+        return nullptr;
+      }
+      return freeObjects[--freeCount];
+    };
+    void release(T *object) {
+      if (object != nullptr && freeCount < SIZE) {
+        freeObjects[freeCount++] = object;
+      }
+    };
+    size_t available() const {
+      return freeCount;
+    };
+
+  private:
+    T objects[SIZE];
+    T *freeObjects[SIZE];
+    size_t freeCount = SIZE;
+};
+
+#endif //OPENBIKESENSORFIRMWARE_OBJECTPOOL_H
@@ -38,10 +38,12 @@ String ObsUtils::createTrackUuid() {
 
 String ObsUtils::stripCsvFileName(const String &fileName) {
   String userPrintableFilename = fileName.substring(fileName.lastIndexOf("/") + 1);
-  if (userPrintableFilename.endsWith(CSVFileWriter::EXTENSION)) {
-    userPrintableFilename
-      = userPrintableFilename.substring(
-      0, userPrintableFilename.length() - CSVFileWriter::EXTENSION.length());
+  for (const String &extension : {CSVFileWriter::EXTENSION, CSVFileWriter::COMPRESSED_EXTENSION}) {
+    if (userPrintableFilename.endsWith(extension)) {
+      userPrintableFilename
+        = userPrintableFilename.substring(
+        0, userPrintableFilename.length() - extension.length());
+    }
   }
   return userPrintableFilename;
 }
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#include "soundspeed.h"
+
+/* Speed of sound in dry air is 331.5 + 0.6 * t m/s, the round trip takes
+ * 2000000 / speed 1/100 microseconds per centimeter.
+ */
+static constexpr uint16_t dividerCenti(int celsius) {
+  return static_cast<uint16_t>(2000000.0 / (331.5 + 0.6 * celsius) + 0.5);
+}
+
+static constexpr uint16_t MICRO_SEC_TO_CM_DIVIDER_CENTI[] = {
+  6260, 6248, 6236, 6225, 6213, 6202, 6190, 6179, 6167, 6156, // -20..-11
+  6144, 6133, 6122, 6111, 6099, 6088, 6077, 6066, 6055, 6044, // -10..-1
+  6033, 6022, 6011, 6001, 5990, 5979, 5968, 5958, 5947, 5936, //   0..9
+  5926, 5915, 5905, 5894, 5884, 5874, 5863, 5853, 5843, 5833, //  10..19
+  5822, 5812, 5802, 5792, 5782, 5772, 5762, 5752, 5742, 5732, //  20..29
+  5722, 5713, 5703, 5693, 5683, 5674, 5664, 5655, 5645, 5635, //  30..39
+  5626, 5616, 5607, 5598, 5588, 5579, 5569, 5560, 5551, 5542, //  40..49
+  5533                                                        //  50
+};
+
+static_assert(sizeof(MICRO_SEC_TO_CM_DIVIDER_CENTI) / sizeof(MICRO_SEC_TO_CM_DIVIDER_CENTI[0])
+  == SoundSpeed::MAX_CELSIUS - SoundSpeed::MIN_CELSIUS + 1, "one entry per degree");
+static_assert(MICRO_SEC_TO_CM_DIVIDER_CENTI[0] == dividerCenti(SoundSpeed::MIN_CELSIUS), "table start");
+static_assert(MICRO_SEC_TO_CM_DIVIDER_CENTI[20 - SoundSpeed::MIN_CELSIUS] == dividerCenti(20), "table at 20C");
+static_assert(MICRO_SEC_TO_CM_DIVIDER_CENTI[SoundSpeed::MAX_CELSIUS - SoundSpeed::MIN_CELSIUS]
+  == dividerCenti(SoundSpeed::MAX_CELSIUS), "table end");
+
+uint16_t SoundSpeed::microSecToCmDividerCenti(float celsius) {
+  int16_t index;
+  if (isnan(celsius) || celsius < MIN_CELSIUS) {
+    index = 0;
+  } else if (celsius > MAX_CELSIUS) {
+    index = MAX_CELSIUS - MIN_CELSIUS;
+  } else {
+    index = static_cast<int16_t>(lroundf(celsius)) - MIN_CELSIUS;
+  }
+  return MICRO_SEC_TO_CM_DIVIDER_CENTI[index];
+}
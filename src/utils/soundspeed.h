@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OPENBIKESENSORFIRMWARE_SOUNDSPEED_H
+#define OPENBIKESENSORFIRMWARE_SOUNDSPEED_H
+
+#include <Arduino.h>
+
+/* Converts ultrasonic time of flight into distance depending on the air
+ * temperature. The factor is the round trip time in 1/100 microseconds
+ * per centimeter (5800 is the former fixed MICRO_SEC_TO_CM_DIVIDER of 58),
+ * taken from a precomputed table so converting a reading stays a plain
+ * integer division.
+ */
+class SoundSpeed {
+  public:
+    static const int8_t MIN_CELSIUS = -20;
+    static const int8_t MAX_CELSIUS = 50;
+    /* Matches the former fixed factor of 58, used without temperature. */
+    static const uint16_t DEFAULT_MICRO_SEC_TO_CM_DIVIDER_CENTI = 5800;
+
+    /* Factor for the given temperature, clamped to the table range. */
+    static uint16_t microSecToCmDividerCenti(float celsius);
+
+    static uint16_t toCentimeter(uint32_t microseconds, uint16_t dividerCenti) {
+      return static_cast<uint16_t>(microseconds * 100 / dividerCenti);
+    }
+};
+
+#endif //OPENBIKESENSORFIRMWARE_SOUNDSPEED_H
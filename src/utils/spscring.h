@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OPENBIKESENSORFIRMWARE_SPSCRING_H
+#define OPENBIKESENSORFIRMWARE_SPSCRING_H
+
+#include <stdint.h>
+#ifdef ARDUINO
+#include <esp_attr.h>
+#endif
+#ifndef IRAM_ATTR // host builds
+#define IRAM_ATTR
+#endif
+
+/* Lock free ring buffer for exactly one producer and one consumer, the
+ * producer is typically an interrupt service routine. Only the producer
+ * writes mHead and only the consumer writes mTail, so no locking is
+ * needed. SIZE must be a power of 2 and at most 128.
+ */
+template<typename T, uint8_t SIZE> class SpscRing {
+  static_assert(SIZE > 0 && SIZE <= 128 && (SIZE & (SIZE - 1)) == 0,
+    "SIZE must be a power of 2 and at most 128");
+
+  public:
+    /* Producer only, returns false and drops the value if the ring is full. */
+    bool IRAM_ATTR push(const T &value) {
+      const uint8_t head = mHead;
+      if ((uint8_t) (head - mTail) >= SIZE) {
+        return false;
+      }
+      mData[head & (SIZE - 1)] = value;
+      __sync_synchronize(); // data must be visible before the new head
+      mHead = head + 1;
+      return true;
+    }
+
+    /* Consumer only, reads the oldest value without removing it. */
+    bool peek(T &value) const {
+      const uint8_t tail = mTail;
+      if (tail == mHead) {
+        return false;
+      }
+      __sync_synchronize();
+      value = mData[tail & (SIZE - 1)];
+      return true;
+    }
+
+    /* Consumer only, removes the oldest value. */
+    bool pop(T &value) {
+      if (!peek(value)) {
+        return false;
+      }
+      mTail = mTail + 1;
+      return true;
+    }
+
+    /* Consumer only, removes all values. */
+    void clear() {
+      mTail = mHead;
+    }
+
+    uint8_t size() const {
+      return mHead - mTail;
+    }
+
+    bool isEmpty() const {
+      return mHead == mTail;
+    }
+
+  private:
+    T mData[SIZE];
+    volatile uint8_t mHead = 0;
+    volatile uint8_t mTail = 0;
+};
+
+#endif //OPENBIKESENSORFIRMWARE_SPSCRING_H
@@ -21,6 +21,7 @@
  * see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include "streams.h"
 
 // StringStream
@@ -135,3 +136,92 @@ Stream *StreamOfStreams::getNext() {
   return current;
 }
 
+
+// GzipFileStream
+
+GzipFileStream::GzipFileStream(File *file) : file(file), decoder(new GzipDecoder(file)) {
+}
+
+bool GzipFileStream::begin() {
+  // the trailer ends with the size, modulo 4G which a track never reaches
+  const size_t fileSize = file->size();
+  uint8_t trailer[4];
+  if (fileSize < GzipEncoder::HEADER_SIZE + 8 || !file->seek(fileSize - 4)
+      || file->read(trailer, 4) != 4 || !file->seek(0)) {
+    failed = true;
+    return false;
+  }
+  length = trailer[0] | (trailer[1] << 8) | (trailer[2] << 16) | ((uint32_t) trailer[3] << 24);
+  failed = !decoder->begin();
+  return !failed;
+}
+
+size_t GzipFileStream::size() const {
+  return length;
+}
+
+bool GzipFileStream::hasFailed() const {
+  return failed;
+}
+
+int GzipFileStream::available() {
+  // after an error only what was decompressed before is left
+  return failed ? bufferLength - bufferPos : length - pos;
+}
+
+int GzipFileStream::read() {
+  const int result = peek();
+  if (result != -1) {
+    bufferPos++;
+    pos++;
+  }
+  return result;
+}
+
+int GzipFileStream::peek() {
+  if (bufferPos == bufferLength && !fill()) {
+    return -1;
+  }
+  return buffer[bufferPos];
+}
+
+void GzipFileStream::flush() {
+}
+
+size_t GzipFileStream::write(uint8_t) {
+  return 0;
+}
+
+size_t GzipFileStream::readBytes(char *target, size_t targetLength) {
+  size_t count = 0;
+  while (count < targetLength && (bufferPos < bufferLength || fill())) {
+    const size_t chunk = std::min(targetLength - count, bufferLength - bufferPos);
+    memcpy(target + count, buffer + bufferPos, chunk);
+    bufferPos += chunk;
+    pos += chunk;
+    count += chunk;
+  }
+  return count;
+}
+
+/* Decompresses the next part into buffer, false at the end or on errors. */
+bool GzipFileStream::fill() {
+  if (failed || pos >= length) {
+    return false;
+  }
+  bufferPos = 0;
+  bufferLength = decoder->read(buffer, std::min(sizeof(buffer), length - pos));
+  if (bufferLength == 0) {
+    // shorter than the trailer claims
+    failed = true;
+    return false;
+  }
+  if (pos + bufferLength == length) {
+    // the trailer must follow now, and the CRC match
+    uint8_t more;
+    if (decoder->read(&more, 1) != 0 || !decoder->isFinished()) {
+      failed = true;
+    }
+  }
+  return true;
+}
@@ -28,6 +28,8 @@
 #include <vector>
 #include <FS.h>
 #include <functional>
+#include <memory>
+#include "gzip.h"
 
 
 class StringStream : public Stream {
@@ -84,5 +86,45 @@ class StreamOfStreams : public Stream {
     Stream *getNext();
 };
 
+/* The content of a gzip file, decompressed while it is read. The size is
+ * known upfront from the gzip trailer. If the data turns out to be broken
+ * the stream ends early and hasFailed() is set.
+ */
+class GzipFileStream : public Stream {
+  public:
+    explicit GzipFileStream(File *file);
+
+    /* Reads the size and the header, false if it is no complete gzip file. */
+    bool begin();
+
+    size_t size() const;
+
+    bool hasFailed() const;
+
+    int available() override;
+
+    int read() override;
+
+    int peek() override;
+
+    void flush() override;
+
+    size_t write(uint8_t) override;
+
+    size_t readBytes(char *buffer, size_t length) override;
+
+  private:
+    bool fill();
+
+    File *file;
+    std::unique_ptr<GzipDecoder> decoder;
+    uint8_t buffer[256];
+    size_t bufferLength = 0;
+    size_t bufferPos = 0;
+    // uncompressed size and bytes read so far
+    size_t length = 0;
+    size_t pos = 0;
+    bool failed = false;
+};
 
 #endif //OPENBIKESENSORFIRMWARE_STREAMS_H
@@ -59,6 +59,21 @@
 #define MAX_SENSOR_VALUE 999
 #define MAX_NUMBER_MEASUREMENTS_PER_INTERVAL 30 //  is 1000/SENSOR_QUIET_PERIOD_AFTER_START_MICRO_SEC/2
 #define MEDIAN_DISTANCE_MEASURES 3
+#define RAW_MEDIAN_DISTANCE_MEASURES 5 // window of the raw median reported via Bluetooth, must be odd
+
+// Echoes (objects) recorded per sensor and measurement in the Lecho/Recho
+// CSV columns, 0 disables the columns. Only the PGA460 reports more than
+// the nearest echo, up to 8.
+#ifndef ECHO_OBJECTS_PER_MEASUREMENT
+#ifdef OBSPRO
+#define ECHO_OBJECTS_PER_MEASUREMENT 3
+#else
+#define ECHO_OBJECTS_PER_MEASUREMENT 0
+#endif
+#endif
+#if defined(OBSCLASSIC) && ECHO_OBJECTS_PER_MEASUREMENT > 0
+#error "HC-SR04 sensors report the nearest echo only"
+#endif
 
 #define MIN_DISTANCE_MEASURED_CM 2
 #ifdef OBSPRO
@@ -67,7 +82,7 @@
   #define MAX_DISTANCE_MEASURED_CM 320 // candidate to check I could not get good readings above 300
 #endif
 
-#define MICRO_SEC_TO_CM_DIVIDER 58 // sound speed 340M/S, 2 times back and forward
+#define MICRO_SEC_TO_CM_DIVIDER 58 // sound speed 340M/S, 2 times back and forward, only for the limits see SoundSpeed
 
 #define MIN_DURATION_MICRO_SEC (MIN_DISTANCE_MEASURED_CM * MICRO_SEC_TO_CM_DIVIDER)
 #define MAX_DURATION_MICRO_SEC (MAX_DISTANCE_MEASURED_CM * MICRO_SEC_TO_CM_DIVIDER)
@@ -21,11 +21,27 @@
  * see <http://www.gnu.org/licenses/>.
  */
 
+#include <memory>
+#include <unistd.h>
+#include <Preferences.h>
 #include <utils/timeutils.h>
 #include "writer.h"
-#include "utils/file.h"
 
 const String CSVFileWriter::EXTENSION = ".obsdata.csv";
+const String CSVFileWriter::COMPRESSED_EXTENSION = ".obsdata.csv.gz";
+const String BinaryFileWriter::EXTENSION = ".obsdata.bin";
+const char * const FileWriter::JOURNAL_FILE_NAME = "/track.journal";
+static const char * const PREFERENCES_NAMESPACE = "writer";
+static const char * const TRACK_NUMBER_KEY = "trackNumber";
+const uint16_t FileWriter::WRITE_TIME_BUCKET_LIMITS_MS[] = {10, 20, 50, 100, 200, 500};
+
+FileWriter::FileWriter(String ext, bool compressed) :
+  mFileExtension(std::move(ext)) {
+  if (compressed) {
+    mGzip = new GzipEncoder;
+    mGzip->begin(mPendingData);
+  }
+}
 
 int FileWriter::getTrackNumber() {
   File numberFile = SD.open("/tracknumber.txt","r");
@@ -40,88 +56,423 @@ void FileWriter::storeTrackNumber(int trackNumber) {
   numberFile.close();
 }
 
-void FileWriter::setFileName() {
-  int number = getTrackNumber();
-  String base_filename = "/sensorData";
-  mFileName = base_filename + String(number) + mFileExtension;
-  while (SD.exists(mFileName)) {
-    number++;
-    mFileName = base_filename + String(number) + mFileExtension;
+/* The track number is kept in NVS, older firmware kept it in
+ * /tracknumber.txt where it is only read once to continue the numbers.
+ */
+uint32_t FileWriter::nextTrackNumber() {
+  Preferences preferences;
+  if (!preferences.begin(PREFERENCES_NAMESPACE, false)) {
+    log_e("Failed to open NVS, using the track number on the SD card.");
+    const int number = getTrackNumber() + 1;
+    storeTrackNumber(number);
+    return number;
   }
-  storeTrackNumber(number);
+  uint32_t number = preferences.isKey(TRACK_NUMBER_KEY)
+    ? preferences.getUInt(TRACK_NUMBER_KEY) : getTrackNumber();
+  number++;
+  preferences.putUInt(TRACK_NUMBER_KEY, number);
+  preferences.end();
+  return number;
+}
+
+void FileWriter::setFileName() {
+  mTrackNumber = nextTrackNumber();
 }
 
-void FileWriter::correctFilename() {
+/* Names the track after its start time, without the time yet only if
+ * forced, then the track number and device id are used. The name is not
+ * changed later so the file is never renamed. See TrackIndex for the
+ * directories.
+ */
+bool FileWriter::chooseFileName(bool force) {
+  const time_t start = time(nullptr) - (time_t) ((millis() - mStartedMillis) / 1000L);
   tm startTm;
-  auto start = time(nullptr);
-  unsigned long passedSeconds = (millis() - mStartedMillis) / 1000L;
-  start -= passedSeconds;
   localtime_r(&start, &startTm);
-  if (startTm.tm_year + 1900 > 2022) {
-    char name[32];
+  const uint16_t deviceId = (uint16_t)(ESP.getEfuseMac() >> 32);
+  const bool timeKnown = start > TimeUtils::PAST_TIME;
+  char name[40];
+  if (timeKnown) {
     snprintf(name, sizeof (name), "/%04d-%02d-%02dT%02d.%02d.%02d-%4x",
              startTm.tm_year + 1900, startTm.tm_mon + 1, startTm.tm_mday,
-             startTm.tm_hour, startTm.tm_min, startTm.tm_sec,
-             (uint16_t)(ESP.getEfuseMac() >> 32));
-    const String newName = name + mFileExtension;
-    if(!SD.exists(mFileName.c_str()) || // already written
-      SD.rename(mFileName.c_str(), newName.c_str())) {
-      mFileName = newName;
-      mFinalFileName = true;
+             startTm.tm_hour, startTm.tm_min, startTm.tm_sec, deviceId);
+  } else if (force) {
+    snprintf(name, sizeof (name), "/sensorData%u-%04x", mTrackNumber, deviceId);
+  } else {
+    return false;
+  }
+  mFileName = TrackIndex::directoryFor(timeKnown ? start : 0) + name + mFileExtension;
+  mJournal = SD.open(JOURNAL_FILE_NAME, FILE_WRITE);
+  journal("track " + mFileName);
+  return true;
+}
+
+/* Journal lines are "<sequence> <entry>", a line is only valid if it is
+ * complete and follows the previous sequence number.
+ */
+void FileWriter::journal(const String &entry) {
+  if (mJournal) {
+    mJournal.print(String(++mJournalSequence) + " " + entry + "\n");
+    mJournal.flush();
+  }
+}
+
+String FileWriter::recoverTrack() {
+  if (!SD.exists(JOURNAL_FILE_NAME)) {
+    return "";
+  }
+  File journalFile = SD.open(JOURNAL_FILE_NAME, FILE_READ);
+  const String content = journalFile.readString();
+  journalFile.close();
+
+  String fileName;
+  bool synced = false;
+  unsigned syncedSize = 0, crc = 0, inputSize = 0;
+  TrackSummary summary;
+  long startTime = 0;
+  unsigned lastSequence = 0;
+  int start = 0;
+  int end;
+  while ((end = content.indexOf('\n', start)) >= 0) {
+    const String line = content.substring(start, end);
+    start = end + 1;
+    unsigned sequence;
+    char name[64];
+    if (sscanf(line.c_str(), "%u", &sequence) != 1 || sequence != lastSequence + 1) {
+      break;
+    }
+    lastSequence = sequence;
+    if (sscanf(line.c_str(), "%*u track %63s", name) == 1) {
+      fileName = name;
+    } else if (sscanf(line.c_str(), "%*u sync %u %u %u %u %u %ld %u", &syncedSize, &crc, &inputSize,
+                      &summary.records, &summary.overtakes, &startTime, &summary.durationSeconds) == 7) {
+      synced = true;
+    } else if (line.indexOf(" failed ") > 0) {
+      // written till the SD card failed, the syncs before are still valid
+      log_w("Track %s was given up after SD card errors.", fileName.c_str());
+    }
+  }
+
+  File file = fileName.isEmpty() ? File() : SD.open(fileName, FILE_READ);
+  if (file) {
+    const size_t size = file.size();
+    // the card only shows data up to the last sync anyway, unless the
+    // file system was flushed in between
+    size_t length = synced ? std::min<size_t>(size, syncedSize) : size;
+    if (fileName.endsWith(CSVFileWriter::COMPRESSED_EXTENSION)) {
+      file.close();
+      if (!synced) {
+        length = GzipEncoder::HEADER_SIZE;
+        crc = inputSize = 0;
+      }
+      String trailer;
+      GzipEncoder::finishAfterSync(crc, inputSize, trailer);
+      if (size >= length && truncateFile(fileName, length)) {
+        file = SD.open(fileName, FILE_APPEND);
+        file.write(reinterpret_cast<const uint8_t *>(trailer.c_str()), trailer.length());
+        file.close();
+      } else {
+        log_e("Can not complete %s, %u bytes of %u.", fileName.c_str(), size, length);
+      }
+    } else {
+      if (fileName.endsWith(BinaryFileWriter::EXTENSION)) {
+        length = BinaryFileWriter::completeLength(file, length);
+      } else {
+        length = CSVFileWriter::completeLength(file, length);
+      }
+      file.close();
+      if (length < size) {
+        truncateFile(fileName, length);
+      }
     }
+    log_i("Recovered track %s, %u of %u bytes.", fileName.c_str(), length, size);
+    summary.fileName = fileName;
+    summary.start = startTime;
+    TrackIndex::add(summary);
   }
+  SD.remove(JOURNAL_FILE_NAME);
+  return fileName;
+}
+
+bool FileWriter::truncateFile(const String &fileName, size_t length) {
+  // not part of the Arduino File API, the SD card is mounted at /sd
+  const String path = "/sd" + fileName;
+  if (truncate(path.c_str(), length) != 0) {
+    log_e("Failed to truncate %s to %u bytes.", fileName.c_str(), length);
+    return false;
+  }
+  return true;
 }
 
 uint16_t FileWriter::getBufferLength() const {
-  return mBuffer.length();
+  return mFillBuffer->length();
 }
 
 bool FileWriter::appendString(const String &s) {
-  bool stored = false;
-  if (getBufferLength() < 11000) { // do not add data if our buffer is full already. We loose data here!
-    mBuffer.concat(s);
-    stored = true;
-  }
-  if (getBufferLength() > 10000 && !button.read()) {
-    flush();
+  return appendData(s.c_str(), s.length());
+}
+
+bool FileWriter::appendData(const char *data, size_t length) {
+  if (getBufferLength() >= BUFFER_MAX_SIZE) {
+    flush(); // make room if the writer task is idle again
   }
-  if (!stored && getBufferLength() < 11000) { // do not add data if our buffer is full already. We loose data here!
-    mBuffer.concat(s);
+  bool stored = false;
+  if (getBufferLength() < BUFFER_MAX_SIZE) {
+    // data needs to be 0 terminated, concat() copies the terminator too
+    mFillBuffer->concat(data, length);
     stored = true;
-  }
+  } else {
+    // the SD card did not keep up, we loose data here!
+    mDroppedBytes += length;
 #ifdef DEVELOP
-  if (!stored) {
     Serial.printf("File buffer overflow, not allowed to write - "
                   "will skip, memory is at %dk, buffer at %u.\n",
                   ESP.getFreeHeap() / 1024, getBufferLength());
-  }
 #endif
+  }
+  if (getBufferLength() > BUFFER_FLUSH_SIZE || mSyncPending) {
+    flush();
+  }
   return stored;
 }
 
-bool FileWriter::flush() {
-  bool result;
-  if (mBuffer.isEmpty()) {
+bool FileWriter::flush(bool sync) {
+  mSyncPending |= sync;
+  if (mFillBuffer->isEmpty() && !mSyncPending) {
     return true;
   }
+  if (!mWriterTask && !startWriterTask()) {
+    // no task, write in the foreground as a last resort
+    std::swap(mFillBuffer, mWriteBuffer);
+    mHandOverMillis = millis();
+    writeBuffer(mSyncPending);
+    mSyncPending = false;
+    return mLastWriteResult;
+  }
+  if (xSemaphoreTake(mWriterIdle, 0) != pdTRUE) {
+    // keep filling the current buffer till the writer is done
+    mBackPressureCount++;
+    return false;
+  }
+  std::swap(mFillBuffer, mWriteBuffer);
+  mHandOverMillis = millis();
+  xTaskNotify(mWriterTask, mSyncPending, eSetValueWithOverwrite);
+  mSyncPending = false;
+  return mLastWriteResult;
+}
+
+bool FileWriter::startWriterTask() {
+  mWriterIdle = xSemaphoreCreateBinary();
+  if (!mWriterIdle) {
+    log_e("Failed to create writer semaphore.");
+    return false;
+  }
+  xSemaphoreGive(mWriterIdle);
+  // The Arduino loop() runs on core 1, SD card writes should not stall it.
+  if (xTaskCreatePinnedToCore(writerTask, "writer", 4 * 1024, this, 1,
+                              &mWriterTask, 0) != pdPASS) {
+    log_e("Failed to create writer task.");
+    vSemaphoreDelete(mWriterIdle);
+    mWriterIdle = nullptr;
+    mWriterTask = nullptr;
+    return false;
+  }
+  return true;
+}
+
+void FileWriter::writerTask(void *param) {
+  auto * const writer = static_cast<FileWriter *>(param);
+  while (true) {
+    uint32_t sync = 0;
+    xTaskNotifyWait(0, 0, &sync, portMAX_DELAY);
+    writer->writeBuffer(sync != 0);
+    xSemaphoreGive(writer->mWriterIdle);
+  }
+}
+
+// Runs in the writer task, mWriteBuffer is not touched by appendString().
+// The track file is kept open, each write ends at a FILE_WRITE_CHUNK_SIZE
+// boundary of the file unless the file is synced.
+void FileWriter::writeBuffer(bool sync, bool last) {
   log_v("Writing to concrete file.");
   const auto start = millis();
-  result = FileUtil::appendFile(SD, mFileName.c_str(), mBuffer.c_str() );
-  const unsigned int fileAppendSize = mBuffer.length();
-  mBuffer.clear();
-  mWriteTimeMillis = millis() - start;
-  if (!mFinalFileName) {
-    correctFilename();
+  if (mTrackFailed) {
+    mWriteBuffer->clear();
+    mLastWriteResult = false;
+    mWriteTimeMillis = millis() - mHandOverMillis;
+    return;
+  }
+  // nothing is written before the track has its name
+  bool named = !mFileName.isEmpty();
+  if (!named && chooseFileName(
+      last || mPendingData.length() + mWriteBuffer->length() >= TRACK_NAME_MAX_PENDING)) {
+    named = true;
+    sync = true; // first sync point for the journal
+  }
+  sync = named && (sync || last || start - mLastSyncMillis >= FILE_SYNC_INTERVAL_MS);
+  if (mGzip) {
+    mGzip->write(reinterpret_cast<const uint8_t *>(mWriteBuffer->c_str()),
+                 mWriteBuffer->length(), mPendingData);
+    if (last) {
+      mGzip->finish(mPendingData);
+    } else if (sync) {
+      mGzip->sync(mPendingData);
+    }
+  } else {
+    mPendingData.concat(*mWriteBuffer);
+  }
+  mWriteBuffer->clear();
+
+  size_t length = named ? mPendingData.length() : 0;
+  if (!sync) {
+    const size_t end = mFilePosition + length;
+    const size_t chunkEnd = end - end % FILE_WRITE_CHUNK_SIZE;
+    length = chunkEnd > mFilePosition ? chunkEnd - mFilePosition : 0;
+  }
+  bool result = true;
+  if (length > 0) {
+    const size_t written = writeToFile(mPendingData.c_str(), length);
+    // what did not reach the card is written with the next hand over,
+    // dropping it would tear a line or break the gzip stream
+    mPendingData.remove(0, written);
+    result = written == length;
+    if (!result && mPendingData.length() > FILE_MAX_PENDING) {
+      failTrack();
+    }
   }
-  log_e("Writing %u bytes to concrete file done took %lums.", fileAppendSize, mWriteTimeMillis);
-  return result;
+  if (sync && mFile && result) {
+    mFile.flush();
+    mLastSyncMillis = millis();
+    journal("sync " + String(mFilePosition)
+            + " " + String(mGzip ? mGzip->getCrc() : 0)
+            + " " + String(mGzip ? mGzip->getInputSize() : 0)
+            + " " + String(mSummary.records) + " " + String(mSummary.overtakes)
+            + " " + String((long) mSummary.start) + " " + String(mSummary.durationSeconds));
+  }
+  mLastWriteResult = result;
+  const unsigned long writeMillis = millis() - start;
+  if (length > 0 || sync) {
+    countWriteTime(writeMillis);
+  }
+  mWriteTimeMillis = millis() - mHandOverMillis;
+  log_d("Writing %u bytes to concrete file done took %lums, %lums after hand over%s.",
+        length, writeMillis, mWriteTimeMillis, sync ? ", synced" : "");
+}
+
+/* Returns the number of bytes written, less than length if the write
+ * failed.
+ */
+size_t FileWriter::writeToFile(const char *data, size_t length) {
+  if (!mFile) {
+    if (!mFileCreated) {
+      TrackIndex::createDirectories(mFileName);
+    }
+    mFile = SD.open(mFileName, FILE_APPEND);
+    if (!mFile) {
+      log_e("Failed to open file %s for appending", mFileName.c_str());
+      return 0;
+    }
+    mFilePosition = mFile.size();
+    if (mFilePosition > 0 && !mFileCreated) {
+      // the clock or the track number was reset, never continue another track
+      log_e("Track %s exists already.", mFileName.c_str());
+      mFile.close();
+      mFileName = mFileName.substring(0, mFileName.lastIndexOf('/'))
+        + "/sensorData" + String(mTrackNumber) + "-" + String(millis()) + mFileExtension;
+      journal("track " + mFileName);
+      return writeToFile(data, length);
+    }
+    mFileCreated = true;
+  }
+  const size_t written = mFile.write(reinterpret_cast<const uint8_t *>(data), length);
+  mFilePosition += written;
+  if (written != length) {
+    log_e("Append failed");
+    mFile.close(); // try again with the next write
+  }
+  return written;
+}
+
+/* Gives up on a track the SD card does not take anymore, the file keeps
+ * what was written so far. The journal ends here, so recoverTrack() cuts
+ * the file at the last sync with the next start.
+ */
+void FileWriter::failTrack() {
+  log_e("Giving up on track %s, dropping %u bytes.", mFileName.c_str(), mPendingData.length());
+  mTrackFailed = true;
+  mPendingData.clear();
+  mFile.close();
+  journal("failed " + String(mFilePosition));
+  mJournal.close();
+}
+
+void FileWriter::countWriteTime(unsigned long millis) {
+  uint8_t bucket = 0;
+  while (bucket < WRITE_TIME_BUCKETS - 1 && millis >= WRITE_TIME_BUCKET_LIMITS_MS[bucket]) {
+    bucket++;
+  }
+  mWriteTimeHistogram[bucket]++;
+}
+
+String FileWriter::getWriteTimeHistogram() const {
+  char buffer[WRITE_TIME_HISTOGRAM_SIZE];
+  LineBuffer histogram(buffer, sizeof(buffer));
+  appendWriteTimeHistogram(histogram);
+  return String(histogram.c_str());
+}
+
+void FileWriter::appendWriteTimeHistogram(LineBuffer &line) const {
+  for (uint8_t bucket = 0; bucket < WRITE_TIME_BUCKETS; bucket++) {
+    if (bucket < WRITE_TIME_BUCKETS - 1) {
+      line.append('<');
+      line.appendUnsigned(WRITE_TIME_BUCKET_LIMITS_MS[bucket]);
+    } else {
+      line.append(">=");
+      line.appendUnsigned(WRITE_TIME_BUCKET_LIMITS_MS[bucket - 1]);
+    }
+    line.append("ms:");
+    line.appendUnsigned(mWriteTimeHistogram[bucket]);
+    if (bucket < WRITE_TIME_BUCKETS - 1) {
+      line.append(' ');
+    }
+  }
+}
+
+FileWriter::~FileWriter() {
+  if (mWriterTask) {
+    // wait for a pending write
+    xSemaphoreTake(mWriterIdle, portMAX_DELAY);
+    vTaskDelete(mWriterTask);
+    vSemaphoreDelete(mWriterIdle);
+  }
+  std::swap(mFillBuffer, mWriteBuffer);
+  writeBuffer(true, true);
+  mFile.close();
+  delete mGzip;
+  mJournal.close();
+  if (mTrackFailed || !mLastWriteResult) {
+    log_e("Track %s is incomplete, it is recovered with the next start.", mFileName.c_str());
+  } else {
+    // completely written, nothing to recover
+    SD.remove(JOURNAL_FILE_NAME);
+  }
+  mSummary.fileName = mFileName;
+  TrackIndex::add(mSummary);
 }
 
 unsigned long FileWriter::getWriteTimeMillis() const {
   return mWriteTimeMillis;
 }
 
-bool CSVFileWriter::writeHeader(String trackId) {
+uint32_t FileWriter::getDroppedBytes() const {
+  return mDroppedBytes;
+}
+
+uint32_t FileWriter::getBackPressureCount() const {
+  return mBackPressureCount;
+}
+
+/* First line of the CSV with the metadata as URL encoded parameters. */
+String FileWriter::getMetadata(const String &trackId) {
   String header;
   header += "OBSDataFormat=2&";
   header += "OBSFirmwareVersion=" + String(OBSVersion) + "&";
@@ -134,7 +485,11 @@ bool CSVFileWriter::writeHeader(String trackId) {
   //header += "HardwareRev=?"  // TODO: Auto detect hardware revision not available in OBSClassic
 #endif
   header += "DeviceId=" + String((uint16_t)(ESP.getEfuseMac() >> 32), 16) + "&";
+#if ECHO_OBJECTS_PER_MEASUREMENT > 0
+  header += "DataPerMeasurement=5&";
+#else
   header += "DataPerMeasurement=3&";
+#endif
   header += "MaximumMeasurementsPerLine=" + String(MAX_NUMBER_MEASUREMENTS_PER_INTERVAL) + "&";
   header += "OffsetLeft=" + String(config.sensorOffsets[LEFT_SENSOR_ID]) + "&";
   header += "OffsetRight=" + String(config.sensorOffsets[RIGHT_SENSOR_ID]) + "&";
@@ -172,8 +527,84 @@ bool CSVFileWriter::writeHeader(String trackId) {
   header += "BluetoothEnabled=" + String(config.bluetooth) + "&";
   header += "PresetId=default&";
   header += "TimeZone=GPS&";
-  header += "DistanceSensorsUsed=HC-SR04/JSN-SR04T\n";
+  header += "DistanceSensorsUsed=HC-SR04/JSN-SR04T";
+  return header;
+}
+
+bool CSVFileWriter::isTrackFile(const String &fileName) {
+  return fileName.endsWith(EXTENSION) || fileName.endsWith(COMPRESSED_EXTENSION);
+}
+
+size_t CSVFileWriter::completeLength(File &file, size_t length) {
+  uint8_t buffer[256];
+  while (length > 0) {
+    const size_t count = std::min(length, sizeof(buffer));
+    file.seek(length - count);
+    if (file.read(buffer, count) != count) {
+      return 0;
+    }
+    for (size_t i = count; i > 0; i--) {
+      if (buffer[i - 1] == '\n') {
+        return length - count + i;
+      }
+    }
+    length -= count;
+  }
+  return 0;
+}
+
+/* Counts the lines after the metadata and the header, start and duration
+ * come from Date and Time of the records.
+ */
+void CSVFileWriter::summarize(File &file, TrackSummary &summary) {
+  uint8_t buffer[256];
+  char field[24];
+  size_t fieldLength = 0;
+  int column = 0;
+  int confirmedColumn = -1;
+  uint32_t lineNumber = 0;
+  tm time = {};
+  uint16_t confirmed = 0;
+  size_t count;
+  file.seek(0);
+  while ((count = file.read(buffer, sizeof(buffer))) > 0) {
+    for (size_t i = 0; i < count; i++) {
+      const char c = (char) buffer[i];
+      if (c != ';' && c != '\n') {
+        if (fieldLength < sizeof(field) - 1) {
+          field[fieldLength++] = c;
+        }
+        continue;
+      }
+      field[fieldLength] = 0;
+      if (lineNumber == 1 && strcmp(field, "Confirmed") == 0) {
+        confirmedColumn = column;
+      } else if (lineNumber > 1 && column == 0) {
+        sscanf(field, "%d.%d.%d", &time.tm_mday, &time.tm_mon, &time.tm_year);
+      } else if (lineNumber > 1 && column == 1) {
+        sscanf(field, "%d:%d:%d", &time.tm_hour, &time.tm_min, &time.tm_sec);
+      } else if (lineNumber > 1 && column == confirmedColumn) {
+        confirmed = atoi(field);
+      }
+      fieldLength = 0;
+      column++;
+      if (c == '\n') {
+        if (lineNumber > 1) {
+          time.tm_year -= 1900;
+          time.tm_mon -= 1;
+          countRecord(summary, mktime(&time), confirmed);
+        }
+        lineNumber++;
+        column = 0;
+        time = {};
+        confirmed = 0;
+      }
+    }
+  }
+}
 
+bool CSVFileWriter::writeHeader(String trackId) {
+  String header = getMetadata(trackId) + "\n";
   header += "Date;Time;Millis;Comment;Latitude;Longitude;Altitude;"
     "Course;Speed;HDOP;Satellites;BatteryLevel;Left;Right;Confirmed;Marked;Invalid;"
     "InsidePrivacyArea;Factor;Measurements";
@@ -182,153 +613,460 @@ bool CSVFileWriter::writeHeader(String trackId) {
     header += ";Tms" + number;
     header += ";Lus" + number;
     header += ";Rus" + number;
+#if ECHO_OBJECTS_PER_MEASUREMENT > 0
+    header += ";Lecho" + number;
+    header += ";Recho" + number;
+#endif
   }
-  header += "\n";
+  // behind the padded measurements, keeps the OBSDataFormat=2 columns in place
+  header += ";Cadence\n";
   return appendString(header);
 }
 
-bool CSVFileWriter::append(DataSet &set) {
-  String csv;
-  /*
-    AbsolutePrivacy : When inside privacy area, the writer does noting, unless overriding is selected and the current set is confirmed
-    NoPosition : When inside privacy area, the writer will replace latitude and longitude with NaNs
-    NoPrivacy : Privacy areas are ignored, but the value "insidePrivacyArea" will be 1 inside
-    OverridePrivacy : When selected, a full set is written, when a value was confirmed, even inside the privacy area
-  */
-  if (set.isInsidePrivacyArea
-    && ((config.privacyConfig & AbsolutePrivacy) || ((config.privacyConfig & OverridePrivacy) && !set.confirmed))) {
-    return true;
+/*
+  AbsolutePrivacy : When inside privacy area, the writer does noting, unless overriding is selected and the current set is confirmed
+  NoPosition : When inside privacy area, the writer will replace latitude and longitude with NaNs
+  NoPrivacy : Privacy areas are ignored, but the value "insidePrivacyArea" will be 1 inside
+  OverridePrivacy : When selected, a full set is written, when a value was confirmed, even inside the privacy area
+*/
+bool FileWriter::isSkipped(const DataSet &set) {
+  return set.isInsidePrivacyArea
+    && ((config.privacyConfig & AbsolutePrivacy) || ((config.privacyConfig & OverridePrivacy) && !set.confirmed));
+}
+
+void FileWriter::countRecord(const DataSet &set) {
+  countRecord(mSummary, set.time, set.confirmed);
+}
+
+/* Sets written before the time was known do not count for the start. */
+void FileWriter::countRecord(TrackSummary &summary, time_t time, uint16_t confirmed) {
+  summary.records++;
+  if (confirmed) {
+    summary.overtakes++;
+  }
+  if (time > TimeUtils::PAST_TIME) {
+    if (summary.start == 0) {
+      summary.start = time;
+    }
+    summary.durationSeconds = time - summary.start;
   }
+}
 
-  tm time;
-  localtime_r(&(set.time), &time);
-  // localtime_r(&(set.time), &time);
-  char date[32];
-  snprintf(date, sizeof(date),
-    "%02d.%02d.%04d;%02d:%02d:%02d;%u;",
-    time.tm_mday, time.tm_mon + 1, time.tm_year + 1900,
-    time.tm_hour, time.tm_min, time.tm_sec, set.millis);
+bool FileWriter::isPositionWritten(const DataSet &set) {
+  return set.gpsRecord.hasValidFix() &&
+    !((config.privacyConfig & NoPosition) && set.isInsidePrivacyArea
+      && !((config.privacyConfig & OverridePrivacy) && set.confirmed));
+}
 
-  csv += date;
-  csv += set.comment;
+/* Development information for some seconds of each minute, it is
+ * appended to the comment of the set. Formatted into mDevComment so only
+ * GPS text messages allocate, they are cut at the end of the buffer.
+ */
+LineBuffer FileWriter::getDevComment(const tm &time) {
+  LineBuffer comment(mDevComment, sizeof(mDevComment));
+  // stays constant once the track is recorded without heap allocations
+  const uint32_t minFreeHeap = ESP.getMinFreeHeap();
+  if (minFreeHeap < mMinFreeHeap) {
+    if (mMinFreeHeap != UINT32_MAX) {
+      mMinFreeHeapDrops++;
+    }
+    mMinFreeHeap = minFreeHeap;
+  }
 
 // FIXME #ifdef DEVELOP
   if (time.tm_sec == 0) {
-    csv += "DEV: GPSMessages: " + String(gps.getValidMessageCount())
-           + " GPS crc errors: " + String(gps.getMessagesWithFailedCrcCount());
+    comment.append("DEV: GPSMessages: ");
+    comment.appendSigned(gps.getValidMessageCount());
+    comment.append(" GPS crc errors: ");
+    comment.appendSigned(gps.getMessagesWithFailedCrcCount());
   } else if (time.tm_sec == 1) {
-    csv += "DEV: Mem: "
-           + String(ESP.getFreeHeap() / 1024) + "k Buffer: "
-           + String(getBufferLength() / 1024) + "k last write time: "
-           + String(getWriteTimeMillis());
+    comment.append("DEV: Mem: ");
+    comment.appendUnsigned(ESP.getFreeHeap() / 1024);
+    comment.append("k Buffer: ");
+    comment.appendUnsigned(getBufferLength() / 1024);
+    comment.append("k last write time: ");
+    comment.appendUnsigned(getWriteTimeMillis());
   } else if (time.tm_sec == 2) {
-    csv += "DEV: Mem min free: "
-           + String(ESP.getMinFreeHeap() / 1024) + "k";
+    comment.append("DEV: Mem min free: ");
+    comment.appendUnsigned(minFreeHeap / 1024);
+    comment.append("k lowered: ");
+    comment.appendUnsigned(mMinFreeHeapDrops);
   } else if (time.tm_sec == 3) {
-    csv += "DEV: GPS lastNoiseLevel: ";
-    csv += gps.getLastNoiseLevel();
+    comment.append("DEV: GPS lastNoiseLevel: ");
+    comment.appendUnsigned(gps.getLastNoiseLevel());
   } else if (time.tm_sec == 4) {
-    csv += "DEV: GPS baud: ";
-    csv += gps.getBaudRate();
+    comment.append("DEV: GPS baud: ");
+    comment.appendUnsigned(gps.getBaudRate());
   } else if (time.tm_sec == 5) {
-    csv += "DEV: GPS alp bytes: ";
-    csv += gps.getNumberOfAlpBytesSent();
+    comment.append("DEV: GPS alp bytes: ");
+    comment.appendUnsigned(gps.getNumberOfAlpBytesSent());
   } else if (time.tm_sec == 6) {
-    csv += "DEV: Left Sensor no : ";
-    csv += sensorManager->getNoSignalReadings(LEFT_SENSOR_ID);
+    comment.append("DEV: Left Sensor no : ");
+    comment.appendUnsigned(sensorManager->getNoSignalReadings(LEFT_SENSOR_ID));
   } else if (time.tm_sec == 7) {
-    csv += "DEV: Right Sensor no : ";
-    csv += sensorManager->getNoSignalReadings(RIGHT_SENSOR_ID);
+    comment.append("DEV: Right Sensor no : ");
+    comment.appendUnsigned(sensorManager->getNoSignalReadings(RIGHT_SENSOR_ID));
   } else if (time.tm_sec == 8) {
-    csv += "DEV: Left last delay till start : ";
-    csv += sensorManager->getLastDelayTillStartUs(LEFT_SENSOR_ID);
+    comment.append("DEV: Left last delay till start : ");
+    comment.appendUnsigned(sensorManager->getLastDelayTillStartUs(LEFT_SENSOR_ID));
   } else if (time.tm_sec == 9) {
-    csv += "DEV: Right last delay till start : ";
-    csv += sensorManager->getLastDelayTillStartUs(RIGHT_SENSOR_ID);
+    comment.append("DEV: Right last delay till start : ");
+    comment.appendUnsigned(sensorManager->getLastDelayTillStartUs(RIGHT_SENSOR_ID));
   } else if (time.tm_sec == 10) {
-    csv += "DEV: Left min echo : ";
-    csv += sensorManager->getMinDurationUs(LEFT_SENSOR_ID);
+    comment.append("DEV: Left min echo : ");
+    comment.appendUnsigned(sensorManager->getMinDurationUs(LEFT_SENSOR_ID));
   } else if (time.tm_sec == 11) {
-    csv += "DEV: Right min echo : ";
-    csv += sensorManager->getMinDurationUs(RIGHT_SENSOR_ID);
+    comment.append("DEV: Right min echo : ");
+    comment.appendUnsigned(sensorManager->getMinDurationUs(RIGHT_SENSOR_ID));
   } else if (time.tm_sec == 12) {
-    csv += "DEV: Left max echo : ";
-    csv += sensorManager->getMaxDurationUs(LEFT_SENSOR_ID);
+    comment.append("DEV: Left max echo : ");
+    comment.appendUnsigned(sensorManager->getMaxDurationUs(LEFT_SENSOR_ID));
   } else if (time.tm_sec == 13) {
-    csv += "DEV: Right max echo : ";
-    csv += sensorManager->getMaxDurationUs(RIGHT_SENSOR_ID);
+    comment.append("DEV: Right max echo : ");
+    comment.appendUnsigned(sensorManager->getMaxDurationUs(RIGHT_SENSOR_ID));
   } else if (time.tm_sec == 14) {
-    csv += "DEV: Left low after measure: ";
-    csv += sensorManager->getNumberOfLowAfterMeasurement(LEFT_SENSOR_ID);
+    comment.append("DEV: Left low after measure: ");
+    comment.appendUnsigned(sensorManager->getNumberOfLowAfterMeasurement(LEFT_SENSOR_ID));
   } else if (time.tm_sec == 15) {
-    csv += "DEV: Right low after measure : ";
-    csv += sensorManager->getNumberOfLowAfterMeasurement(RIGHT_SENSOR_ID);
+    comment.append("DEV: Right low after measure : ");
+    comment.appendUnsigned(sensorManager->getNumberOfLowAfterMeasurement(RIGHT_SENSOR_ID));
   } else if (time.tm_sec == 16) {
-    csv += "DEV: Left long measurement : ";
-    csv += sensorManager->getNumberOfToLongMeasurement(LEFT_SENSOR_ID);
+    comment.append("DEV: Left long measurement : ");
+    comment.appendUnsigned(sensorManager->getNumberOfToLongMeasurement(LEFT_SENSOR_ID));
   } else if (time.tm_sec == 17) {
-    csv += "DEV: Right long measurement : ";
-    csv += sensorManager->getNumberOfToLongMeasurement(RIGHT_SENSOR_ID);
+    comment.append("DEV: Right long measurement : ");
+    comment.appendUnsigned(sensorManager->getNumberOfToLongMeasurement(RIGHT_SENSOR_ID));
   } else if (time.tm_sec == 18) {
-    csv += "DEV: Left interrupt adjusted : ";
-    csv += sensorManager->getNumberOfInterruptAdjustments(LEFT_SENSOR_ID);
+    comment.append("DEV: Left interrupt adjusted : ");
+    comment.appendUnsigned(sensorManager->getNumberOfInterruptAdjustments(LEFT_SENSOR_ID));
   } else if (time.tm_sec == 19) {
-    csv += "DEV: Right interrupt adjusted : ";
-    csv += sensorManager->getNumberOfInterruptAdjustments(RIGHT_SENSOR_ID);
+    comment.append("DEV: Right interrupt adjusted : ");
+    comment.appendUnsigned(sensorManager->getNumberOfInterruptAdjustments(RIGHT_SENSOR_ID));
+  } else if (time.tm_sec == 40) {
+    comment.append("DEV: Left cross-talk dropped : ");
+    comment.appendUnsigned(sensorManager->getNumberOfCrossTalkRejections(LEFT_SENSOR_ID));
+  } else if (time.tm_sec == 41) {
+    comment.append("DEV: Right cross-talk dropped : ");
+    comment.appendUnsigned(sensorManager->getNumberOfCrossTalkRejections(RIGHT_SENSOR_ID));
+  } else if (time.tm_sec == 42) {
+    comment.append("DEV: Writer dropped bytes: ");
+    comment.appendUnsigned(getDroppedBytes());
+    comment.append(" busy: ");
+    comment.appendUnsigned(getBackPressureCount());
+  } else if (time.tm_sec == 43) {
+    comment.append("DEV: Writer times: ");
+    appendWriteTimeHistogram(comment);
+  } else if (time.tm_sec == 44) {
+    comment.append("DEV: GPS dropped bytes: ");
+    comment.appendUnsigned(gps.getDroppedBytes());
+    comment.append(" overflows: ");
+    comment.appendUnsigned(gps.getRxOverflowCount());
+    comment.append(" latency avg: ");
+    comment.appendUnsigned(gps.getAverageParseLatencyMillis());
+    comment.append("ms max: ");
+    comment.appendUnsigned(gps.getMaxParseLatencyMillis());
+    comment.append("ms");
   } else if (time.tm_sec >= 20 && time.tm_sec < 40) {
-    String msg = gps.popMessage();
+    const String msg = gps.popMessage();
     if (!msg.isEmpty()) {
-      csv += "DEV: GPS: ";
-      csv += ObsUtils::encodeForCsvField(msg);
+      comment.append("DEV: GPS: ");
+      // like ObsUtils::encodeForCsvField()
+      for (size_t i = 0; i < msg.length(); i++) {
+        const char c = msg[i];
+        comment.append(c == ';' ? '_' : (c == '\n' || c == '\r') ? ' ' : c);
+      }
     }
   }
 // #endif
-  csv += ";";
+  return comment;
+}
 
-  if ((!set.gpsRecord.hasValidFix()) ||
-      ((config.privacyConfig & NoPosition) && set.isInsidePrivacyArea
-    && !((config.privacyConfig & OverridePrivacy) && set.confirmed))) {
-    csv += ";;;;;";
-  } else {
-    csv += set.gpsRecord.getLatString() + ";";
-    csv += set.gpsRecord.getLongString() + ";";
-    csv += set.gpsRecord.getAltitudeMetersString() + ";";
-    csv += set.gpsRecord.getCourseString() + ";";
-    csv += set.gpsRecord.getSpeedKmHString() + ";";
+bool CSVFileWriter::append(DataSet &set) {
+  if (isSkipped(set)) {
+    return true;
   }
-  csv += set.gpsRecord.getHdopString() + ";";
+  countRecord(set);
 
-  csv += String(set.gpsRecord.getSatellitesUsed()) + ";";
-  csv += String(set.batteryLevel, 2) + ";";
+  tm time;
+  localtime_r(&(set.time), &time);
+  const LineBuffer devComment = getDevComment(time);
+  LineBuffer line(mLine, sizeof(mLine));
+  formatLine(line, set, time, devComment);
+  if (!line.overflowed()) {
+    return appendData(line.c_str(), line.length());
+  }
+  // very long comment, rare enough to allocate
+  const size_t size = line.requiredSize();
+  std::unique_ptr<char[]> buffer(new char[size]);
+  LineBuffer longLine(buffer.get(), size);
+  formatLine(longLine, set, time, devComment);
+  return appendData(longLine.c_str(), longLine.length());
+}
+
+void CSVFileWriter::formatLine(LineBuffer &line, const DataSet &set, const tm &time,
+                               const LineBuffer &devComment) {
+  line.appendZeroPadded(time.tm_mday, 2);
+  line.append('.');
+  line.appendZeroPadded(time.tm_mon + 1, 2);
+  line.append('.');
+  line.appendZeroPadded(time.tm_year + 1900, 4);
+  line.append(';');
+  line.appendZeroPadded(time.tm_hour, 2);
+  line.append(':');
+  line.appendZeroPadded(time.tm_min, 2);
+  line.append(':');
+  line.appendZeroPadded(time.tm_sec, 2);
+  line.append(';');
+  line.appendUnsigned(set.millis);
+  line.append(';');
+  line.append(set.comment.c_str(), set.comment.length());
+  line.append(devComment.c_str(), devComment.length());
+  line.append(';');
+
+  set.gpsRecord.appendCsvFields(line, isPositionWritten(set));
+  line.append(';');
+  line.appendUnsigned(set.gpsRecord.getSatellitesUsed());
+  line.append(';');
+  line.appendCenti(set.batteryLevelCenti);
+  line.append(';');
   if (set.sensorValues[LEFT_SENSOR_ID] < MAX_SENSOR_VALUE) {
-    csv += String(set.sensorValues[LEFT_SENSOR_ID]);
+    line.appendUnsigned(set.sensorValues[LEFT_SENSOR_ID]);
   }
-  csv += ";";
+  line.append(';');
   if (set.sensorValues[RIGHT_SENSOR_ID] < MAX_SENSOR_VALUE) {
-    csv += String(set.sensorValues[RIGHT_SENSOR_ID]);
+    line.appendUnsigned(set.sensorValues[RIGHT_SENSOR_ID]);
   }
-  csv += ";";
-  csv += String(set.confirmed) + ";";
-  csv += String(set.marked) + ";";
-  csv += String(set.invalidMeasurement) + ";";
-  csv += String(set.isInsidePrivacyArea) + ";";
-  csv += String(set.factor) + ";";
-  csv += String(set.measurements);
+  line.append(';');
+  line.appendUnsigned(set.confirmed);
+  line.append(';');
+  line.append(set.marked.c_str(), set.marked.length());
+  line.append(';');
+  line.append(set.invalidMeasurement ? '1' : '0');
+  line.append(';');
+  line.append(set.isInsidePrivacyArea ? '1' : '0');
+  line.append(';');
+  if (set.factorCenti % 100 == 0) {
+    // like the former fixed factor, e.g. without temperature sensor
+    line.appendUnsigned(set.factorCenti / 100);
+  } else {
+    line.appendCenti(set.factorCenti);
+  }
+  line.append(';');
+  line.appendUnsigned(set.measurements);
 
   for (size_t idx = 0; idx < set.measurements; ++idx) {
-    csv += ";" + String(set.startOffsetMilliseconds[idx]) + ";";
+    line.append(';');
+    line.appendUnsigned(set.startOffsetMilliseconds[idx]);
+    line.append(';');
     if (set.readDurationsLeftInMicroseconds[idx] > 0) {
-      csv += String(set.readDurationsLeftInMicroseconds[idx]) + ";";
-    } else {
-      csv += ";";
+      line.appendUnsigned(set.readDurationsLeftInMicroseconds[idx]);
     }
+    line.append(';');
     if (set.readDurationsRightInMicroseconds[idx] > 0) {
-      csv += String(set.readDurationsRightInMicroseconds[idx]);
+      line.appendUnsigned(set.readDurationsRightInMicroseconds[idx]);
     }
+#if ECHO_OBJECTS_PER_MEASUREMENT > 0
+    line.append(';');
+    set.echoesLeft[idx].appendTo(line);
+    line.append(';');
+    set.echoesRight[idx].appendTo(line);
+#endif
   }
   for (size_t idx = set.measurements; idx < MAX_NUMBER_MEASUREMENTS_PER_INTERVAL; ++idx) {
-    csv += ";;;";
+#if ECHO_OBJECTS_PER_MEASUREMENT > 0
+    line.append(";;;;;");
+#else
+    line.append(";;;");
+#endif
+  }
+  line.append(';');
+  line.appendUnsigned(set.cadenceMode);
+  line.append('\n');
+}
+
+bool BinaryFileWriter::writeHeader(String trackId) {
+  const String metadata = getMetadata(trackId);
+  // "OBSB", version and the length prefixed metadata, once per track
+  const size_t size = 4 + 1 + 2 + metadata.length() + 1;
+  std::unique_ptr<char[]> buffer(new char[size]);
+  LineBuffer header(buffer.get(), size);
+  header.append("OBSB");
+  put8(header, FORMAT_VERSION);
+  putString(header, metadata);
+  return appendData(header.c_str(), header.length());
+}
+
+size_t BinaryFileWriter::completeLength(File &file, size_t length) {
+  // "OBSB", version, then the metadata and each record length prefixed
+  size_t position = 5;
+  while (position + 2 <= length) {
+    uint8_t prefix[2];
+    file.seek(position);
+    if (file.read(prefix, 2) != 2) {
+      break;
+    }
+    const size_t next = position + 2 + (prefix[0] | (prefix[1] << 8));
+    if (next > length) {
+      break;
+    }
+    position = next;
+  }
+  return std::min(position, length);
+}
+
+void BinaryFileWriter::summarize(File &file, TrackSummary &summary) {
+  // record type, time, millis, flags, position, hdop, satellites,
+  // battery, left, right and confirmed
+  uint8_t record[2 + 1 + 4 + 4 + 1 + 20 + 2 + 1 + 2 + 2 + 2 + 2];
+  const size_t size = file.size();
+  // "OBSB", version, then the metadata is the first length prefixed entry
+  size_t position = 5;
+  bool metadata = true;
+  while (position + 2 <= size) {
+    file.seek(position);
+    const size_t count = file.read(record, sizeof(record));
+    if (count < 2) {
+      break;
+    }
+    const size_t next = position + 2 + (record[0] | (record[1] << 8));
+    if (next > size) {
+      break;
+    }
+    if (!metadata && count >= 12 && record[2] == RECORD_DATA_SET) {
+      const time_t time = record[3] | (record[4] << 8) | (record[5] << 16) | ((uint32_t) record[6] << 24);
+      const size_t confirmedOffset = 12 + ((record[11] & 0x01) ? 20 : 0) + 9;
+      const uint16_t confirmed = confirmedOffset + 2 <= count
+        ? record[confirmedOffset] | (record[confirmedOffset + 1] << 8) : 0;
+      countRecord(summary, time, confirmed);
+    }
+    metadata = false;
+    position = next;
   }
-  csv += "\n";
-  return appendString(csv);
+}
+
+bool BinaryFileWriter::append(DataSet &set) {
+  if (isSkipped(set)) {
+    return true;
+  }
+  countRecord(set);
+  tm time;
+  localtime_r(&(set.time), &time);
+  const LineBuffer devComment = getDevComment(time);
+  const size_t size = formatRecords(mRecord, sizeof(mRecord), set, devComment);
+  if (size <= sizeof(mRecord)) {
+    return appendData(mRecord, size - 1);
+  }
+  // very long comment, rare enough to allocate
+  std::unique_ptr<char[]> buffer(new char[size]);
+  formatRecords(buffer.get(), size, set, devComment);
+  return appendData(buffer.get(), size - 1);
+}
+
+size_t BinaryFileWriter::formatRecords(char *buffer, size_t size, const DataSet &set,
+                                       const LineBuffer &devComment) {
+  const bool positionWritten = isPositionWritten(set);
+  const GpsRecord &gpsRecord = set.gpsRecord;
+
+  LineBuffer record(buffer, size);
+  put16(record, 0); // set once the length is known
+  put8(record, RECORD_DATA_SET);
+  put32(record, set.time);
+  put32(record, set.millis);
+  put8(record, (positionWritten ? 0x01 : 0)
+    | (set.invalidMeasurement ? 0x02 : 0)
+    | (set.isInsidePrivacyArea ? 0x04 : 0));
+  if (positionWritten) {
+    put32(record, gpsRecord.mLatitude);
+    put32(record, gpsRecord.mLongitude);
+    put32(record, gpsRecord.mHeight);
+    put32(record, gpsRecord.mSpeed);
+    put32(record, gpsRecord.mCourseOverGround);
+  }
+  put16(record, gpsRecord.mHdop);
+  put8(record, gpsRecord.mSatellitesUsed);
+  put16(record, set.batteryLevelCenti);
+  put16(record, set.sensorValues[LEFT_SENSOR_ID]);
+  put16(record, set.sensorValues[RIGHT_SENSOR_ID]);
+  put16(record, set.confirmed);
+  put16(record, set.factorCenti);
+  put8(record, set.cadenceMode);
+  put16(record, set.comment.length() + devComment.length());
+  record.append(set.comment.c_str(), set.comment.length());
+  record.append(devComment.c_str(), devComment.length());
+  putString(record, set.marked);
+  put8(record, set.measurements);
+  for (size_t idx = 0; idx < set.measurements; ++idx) {
+    put16(record, set.startOffsetMilliseconds[idx]);
+    put32(record, set.readDurationsLeftInMicroseconds[idx]);
+    put32(record, set.readDurationsRightInMicroseconds[idx]);
+  }
+#if ECHO_OBJECTS_PER_MEASUREMENT > 0
+  for (size_t idx = 0; idx < set.measurements; ++idx) {
+    for (const EchoProfile *profile : {&set.echoesLeft[idx], &set.echoesRight[idx]}) {
+      put8(record, profile->count);
+      for (uint8_t obj = 0; obj < profile->count; ++obj) {
+        put16(record, profile->objects[obj].tofMicroSeconds);
+        put8(record, profile->objects[obj].widthMicroSeconds);
+        put8(record, profile->objects[obj].peakAmplitude);
+      }
+    }
+  }
+#endif
+  setLength(buffer, 0, record);
+
+  if (positionWritten) {
+    const size_t positions = record.length();
+    putMeasurementPositions(record, set);
+    setLength(buffer, positions, record);
+  }
+  return record.requiredSize();
+}
+
+void BinaryFileWriter::putMeasurementPositions(LineBuffer &record, const DataSet &set) {
+  const GpsEpochs &epochs = set.gpsEpochs;
+  if (set.measurements == 0 || epochs.getCount() == 0
+      || epochs.getTow() != set.gpsRecord.getTow()) {
+    return;
+  }
+  put16(record, 0); // set once the length is known
+  put8(record, RECORD_MEASUREMENT_POSITIONS);
+  put8(record, epochs.getCount());
+  put8(record, set.measurements);
+  for (size_t idx = 0; idx < set.measurements; ++idx) {
+    int32_t latitude, longitude;
+    epochs.positionAt(set.startOffsetMilliseconds[idx], latitude, longitude);
+    put32(record, latitude);
+    put32(record, longitude);
+  }
+}
+
+void BinaryFileWriter::setLength(char *buffer, size_t position, const LineBuffer &record) {
+  if (record.overflowed() || record.length() == position) {
+    return;
+  }
+  const size_t length = record.length() - position - 2;
+  buffer[position] = (char) length;
+  buffer[position + 1] = (char) (length >> 8);
+}
+
+void BinaryFileWriter::put8(LineBuffer &record, uint8_t value) {
+  record.append((char) value);
+}
+
+void BinaryFileWriter::put16(LineBuffer &record, uint16_t value) {
+  record.append((char) value);
+  record.append((char) (value >> 8));
+}
+
+void BinaryFileWriter::put32(LineBuffer &record, uint32_t value) {
+  record.append((char) value);
+  record.append((char) (value >> 8));
+  record.append((char) (value >> 16));
+  record.append((char) (value >> 24));
+}
+
+/* Length prefixed, without terminating 0. */
+void BinaryFileWriter::putString(LineBuffer &record, const String &value) {
+  put16(record, value.length());
+  record.append(value.c_str(), value.length());
 }
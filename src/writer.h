@@ -27,69 +27,305 @@
 #include <Arduino.h>
 #include <SD.h>
 #include <utility>
-#include <vector>
 #include "gps.h"
 #include "globals.h"
+#include "utils/soundspeed.h"
+#include "cadence.h"
+#include "utils/echoprofile.h"
+#include "utils/linebuffer.h"
+#include "utils/gzip.h"
+#include "trackindex.h"
 
 
+/* The track file is synced at least this often and on confirmed
+ * overtakes, this bounds the data lost if the power is cut.
+ */
+#ifndef FILE_SYNC_INTERVAL_MS
+#define FILE_SYNC_INTERVAL_MS 30000
+#endif
+
+/* Writes to the track file end at multiples of this size, so the SD card
+ * gets complete sectors and FAT clusters of up to this size.
+ */
+#ifndef FILE_WRITE_CHUNK_SIZE
+#define FILE_WRITE_CHUNK_SIZE 4096
+#endif
+
+/* The track file is created once the GPS time is known and named after
+ * the start of the track. Until then the data is kept in RAM, with more
+ * than this the track number is used for the name instead.
+ */
+#ifndef TRACK_NAME_MAX_PENDING
+#define TRACK_NAME_MAX_PENDING (4 * FILE_WRITE_CHUNK_SIZE)
+#endif
+
+/* Data that failed to be written is kept and written with the next hand
+ * over. With more than this pending the track is closed as failed, the
+ * rest of the track is dropped.
+ */
+#ifndef FILE_MAX_PENDING
+#define FILE_MAX_PENDING (8 * FILE_WRITE_CHUNK_SIZE)
+#endif
+
+/* Record the track in the binary format (.obsdata.bin) instead of CSV,
+ * tools/obsbin2csv.py converts it to the CSV format. The portal only
+ * accepts CSV so binary tracks are not uploaded.
+ */
+#ifndef BINARY_TRACK_FORMAT
+#define BINARY_TRACK_FORMAT 0
+#endif
+
+/* Write CSV tracks gzip compressed (.obsdata.csv.gz), this saves SD card
+ * writes for some CPU time in the writer task. The upload decompresses
+ * them again, the portal gets the plain CSV.
+ */
+#ifndef COMPRESS_TRACK_FILES
+#define COMPRESS_TRACK_FILES 0
+#endif
+
+/* Overtakes that can be confirmed in the same set, further button presses
+ * within the second are dropped.
+ */
+#ifndef MAX_CONFIRMATIONS_PER_SET
+#define MAX_CONFIRMATIONS_PER_SET 8
+#endif
+
 struct DataSet {
   time_t time;
   uint32_t  millis;
+  // comment and marked are not set by the firmware itself, reset() keeps
+  // their capacity so reused sets do not allocate
   String comment;
   GpsRecord gpsRecord;
-  double batteryLevel;
-  std::vector<uint16_t> sensorValues;
-  std::vector<uint16_t> confirmedDistances;
-  std::vector<uint16_t> confirmedDistancesIndex;
+  // positions within the second of gpsRecord, for a position per measurement
+  GpsEpochs gpsEpochs;
+  // battery voltage in 1/100 V
+  int16_t batteryLevelCenti;
+  uint16_t sensorValues[NUMBER_OF_TOF_SENSORS];
+  uint16_t confirmedDistances[MAX_CONFIRMATIONS_PER_SET];
+  uint16_t confirmedDistancesIndex[MAX_CONFIRMATIONS_PER_SET];
+  uint8_t confirmedCount = 0;
   uint16_t confirmed = 0;
   String marked;
   bool invalidMeasurement = false;
   bool isInsidePrivacyArea = false;
-  uint8_t factor = MICRO_SEC_TO_CM_DIVIDER;
+  // time of flight to cm divider in 1/100, depends on the temperature
+  uint16_t factorCenti = SoundSpeed::DEFAULT_MICRO_SEC_TO_CM_DIVIDER_CENTI;
+  // highest measurement cadence during this set
+  CadenceMode cadenceMode = CadenceNormal;
   uint8_t measurements;
 
   uint16_t position = 0; // fixme: num sensors?
   uint16_t startOffsetMilliseconds[MAX_NUMBER_MEASUREMENTS_PER_INTERVAL + 1];
   int32_t readDurationsLeftInMicroseconds[MAX_NUMBER_MEASUREMENTS_PER_INTERVAL + 1];
   int32_t readDurationsRightInMicroseconds[MAX_NUMBER_MEASUREMENTS_PER_INTERVAL + 1];
+#if ECHO_OBJECTS_PER_MEASUREMENT > 0
+  EchoProfile echoesLeft[MAX_NUMBER_MEASUREMENTS_PER_INTERVAL + 1];
+  EchoProfile echoesRight[MAX_NUMBER_MEASUREMENTS_PER_INTERVAL + 1];
+#endif
+
+  /* Prepares a reused set for the next second. The measurement arrays
+   * are only valid up to measurements and gpsRecord is assigned when the
+   * set is complete, both are not cleared.
+   */
+  void reset() {
+    comment.clear();
+    confirmedCount = 0;
+    confirmed = 0;
+    marked.clear();
+    invalidMeasurement = false;
+    isInsidePrivacyArea = false;
+    factorCenti = SoundSpeed::DEFAULT_MICRO_SEC_TO_CM_DIVIDER_CENTI;
+    cadenceMode = CadenceNormal;
+    measurements = 0;
+    position = 0;
+  }
+
+  /* Returns false if the set has no room for another confirmation. */
+  bool addConfirmation(uint16_t distance, uint16_t measureIndex) {
+    if (confirmedCount >= MAX_CONFIRMATIONS_PER_SET) {
+      return false;
+    }
+    confirmedDistances[confirmedCount] = distance;
+    confirmedDistancesIndex[confirmedCount] = measureIndex;
+    confirmedCount++;
+    return true;
+  }
 };
 
 class FileWriter {
   public:
     FileWriter() = default;;
-    explicit FileWriter(String ext) :
-      mFileExtension(std::move(ext)) {};
-    virtual ~FileWriter() = default;
+    explicit FileWriter(String ext, bool compressed = false);
+    virtual ~FileWriter();
+    /* Reserves the next track number, the file itself is created and
+     * named with the first write that knows the time.
+     */
     void setFileName();
+    /* Completes the track of a previous run that was not closed, usually
+     * because the power was switched off. Uses the journal to cut the
+     * file after the last complete record and finishes compressed files.
+     * Returns the name of the track, empty if there was nothing to
+     * recover.
+     */
+    static String recoverTrack();
     virtual bool writeHeader(String trackId) = 0;
     virtual bool append(DataSet &) = 0;
     bool appendString(const String &s);
-    bool flush();
+    bool appendData(const char *data, size_t length);
+    /* Hands the buffered data over to the writer task, does not wait for
+     * the SD card. Returns false if the task is still busy with the
+     * previous buffer or the last write failed. With sync all data
+     * including a partial chunk is written and the file is synced, if
+     * the task is busy this is done with the next hand over.
+     */
+    bool flush(bool sync = false);
+    /* Time from handing a buffer over till it was written to the SD card. */
     unsigned long getWriteTimeMillis() const;
+    /* Number of SD card writes per duration range, for the DEV output. */
+    String getWriteTimeHistogram() const;
+    void appendWriteTimeHistogram(LineBuffer &line) const;
+    /* Bytes lost because the buffer was full. */
+    uint32_t getDroppedBytes() const;
+    /* Number of flushes delayed because the writer task was still busy. */
+    uint32_t getBackPressureCount() const;
 
   protected:
     uint16_t getBufferLength() const;
+    String getMetadata(const String &trackId);
+    LineBuffer getDevComment(const tm &time);
+    static bool isSkipped(const DataSet &set);
+    static bool isPositionWritten(const DataSet &set);
+    /* Counts a written set for the track index summary. */
+    void countRecord(const DataSet &set);
+    static void countRecord(TrackSummary &summary, time_t time, uint16_t confirmed);
 
   private:
+    static const uint16_t BUFFER_FLUSH_SIZE = 10000;
+    static const uint16_t BUFFER_MAX_SIZE = 11000;
     static void storeTrackNumber(int trackNumber);
     static int getTrackNumber();
-    void correctFilename();
-    String mBuffer;
+    static uint32_t nextTrackNumber();
+    static const uint8_t WRITE_TIME_BUCKETS = 7;
+    static const uint16_t WRITE_TIME_BUCKET_LIMITS_MS[WRITE_TIME_BUCKETS - 1];
+    static const size_t WRITE_TIME_HISTOGRAM_SIZE = 160;
+    static const size_t DEV_COMMENT_SIZE = 256;
+    static void writerTask(void *param);
+    bool startWriterTask();
+    void writeBuffer(bool sync, bool last = false);
+    size_t writeToFile(const char *data, size_t length);
+    void failTrack();
+    void countWriteTime(unsigned long millis);
+    bool chooseFileName(bool force);
+    void journal(const String &entry);
+    static bool truncateFile(const String &fileName, size_t length);
+    static const char * const JOURNAL_FILE_NAME;
+    // appendString() fills one buffer while the writer task writes the other
+    String mBuffers[2];
+    String *mFillBuffer = &mBuffers[0];
+    String *mWriteBuffer = &mBuffers[1];
+    TaskHandle_t mWriterTask = nullptr;
+    SemaphoreHandle_t mWriterIdle = nullptr;
+    bool mSyncPending = false;
+    // owned by the writer task: the open track file and data that did not
+    // fill a complete chunk yet
+    File mFile;
+    size_t mFilePosition = 0;
+    String mPendingData;
+    GzipEncoder *mGzip = nullptr;
+    // one line per track start and sync so a track can be
+    // recovered after a power loss, see recoverTrack()
+    File mJournal;
+    uint32_t mJournalSequence = 0;
+    unsigned long mLastSyncMillis = 0;
+    uint32_t mWriteTimeHistogram[WRITE_TIME_BUCKETS] = {};
     String mFileExtension;
     String mFileName;
+    uint32_t mTrackNumber = 0;
+    bool mFileCreated = false;
+    // the SD card failed too long, nothing more is written
+    bool mTrackFailed = false;
     const unsigned long mStartedMillis = millis();
-    bool mFinalFileName = false;
-    unsigned long mWriteTimeMillis = 0;
-
+    unsigned long mHandOverMillis = 0;
+    volatile unsigned long mWriteTimeMillis = 0;
+    volatile bool mLastWriteResult = true;
+    uint32_t mDroppedBytes = 0;
+    uint32_t mBackPressureCount = 0;
+    // heap low watermark and how often it went down while recording
+    uint32_t mMinFreeHeap = UINT32_MAX;
+    uint32_t mMinFreeHeapDrops = 0;
+    char mDevComment[DEV_COMMENT_SIZE];
+    // summary for the track index, journaled with each sync
+    TrackSummary mSummary;
 };
 
 class CSVFileWriter : public FileWriter {
   public:
-    CSVFileWriter() : FileWriter(EXTENSION) {}
+    CSVFileWriter() : FileWriter(COMPRESS_TRACK_FILES ? COMPRESSED_EXTENSION : EXTENSION,
+                                 COMPRESS_TRACK_FILES) {}
     ~CSVFileWriter() override = default;
     bool writeHeader(String trackId) override;
     bool append(DataSet&) override;
+    /* Plain or compressed CSV track. */
+    static bool isTrackFile(const String &fileName);
+    /* Length of the file up to the end of the last complete line. */
+    static size_t completeLength(File &file, size_t length);
+    /* Reads a plain CSV track for its summary in the track index. */
+    static void summarize(File &file, TrackSummary &summary);
+    static const String EXTENSION;
+    static const String COMPRESSED_EXTENSION;
+
+  private:
+    /* Room for a line with all measurements and a short comment, longer
+     * lines are formatted in a heap buffer.
+     */
+    static const size_t LINE_BUFFER_SIZE = 256 + MAX_NUMBER_MEASUREMENTS_PER_INTERVAL
+      * (28 + 2 * (1 + ECHO_OBJECTS_PER_MEASUREMENT * 14));
+    static void formatLine(LineBuffer &line, const DataSet &set, const tm &time,
+                           const LineBuffer &devComment);
+    char mLine[LINE_BUFFER_SIZE];
+};
+
+/* Length prefixed little endian records, see docs/software/firmware/binary_format.md.
+ * Stores the raw values that CSVFileWriter would format, so the records
+ * are much smaller and cheaper to create.
+ */
+class BinaryFileWriter : public FileWriter {
+  public:
+    BinaryFileWriter() : FileWriter(EXTENSION) {}
+    ~BinaryFileWriter() override = default;
+    bool writeHeader(String trackId) override;
+    bool append(DataSet&) override;
     static const String EXTENSION;
+    static const uint8_t FORMAT_VERSION = 1;
+    static const uint8_t RECORD_DATA_SET = 1;
+    static const uint8_t RECORD_MEASUREMENT_POSITIONS = 2;
+    /* Length of the file up to the end of the last complete record. */
+    static size_t completeLength(File &file, size_t length);
+    /* Reads a track for its summary in the track index. */
+    static void summarize(File &file, TrackSummary &summary);
+
+  private:
+    /* Room for a record with all measurements and a short comment, longer
+     * ones are formatted in a heap buffer.
+     */
+    static const size_t RECORD_BUFFER_SIZE = 128 + MAX_NUMBER_MEASUREMENTS_PER_INTERVAL
+      * (18 + 2 * (1 + ECHO_OBJECTS_PER_MEASUREMENT * 4));
+    /* The data set record and its measurement positions, each length
+     * prefixed. Returns the size needed, as LineBuffer::requiredSize(), the
+     * records are only complete if it is not larger than size.
+     */
+    static size_t formatRecords(char *buffer, size_t size, const DataSet &set,
+                                const LineBuffer &devComment);
+    static void put8(LineBuffer &record, uint8_t value);
+    static void put16(LineBuffer &record, uint16_t value);
+    static void put32(LineBuffer &record, uint32_t value);
+    static void putString(LineBuffer &record, const String &value);
+    /* Sets the length prefix at position to the bytes that follow it. */
+    static void setLength(char *buffer, size_t position, const LineBuffer &record);
+    /* The position of each measurement, nothing if it is not known. */
+    static void putMeasurementPositions(LineBuffer &record, const DataSet &set);
+    char mRecord[RECORD_BUFFER_SIZE];
 };
 
 #endif
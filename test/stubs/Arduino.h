@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OBS_TEST_ARDUINO_H
+#define OBS_TEST_ARDUINO_H
+
+/* Host replacement of the parts of the ESP32 Arduino core used by the
+ * firmware sources under test. Time, pins and the hardware timer are only
+ * declared, each test defines them as its simulation requires.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sys/types.h>
+#include <algorithm>
+#include <string>
+
+#define IRAM_ATTR
+#define PI 3.1415926535897932384626433832795
+
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x01
+#define OUTPUT 0x02
+#define INPUT_PULLUP 0x05
+#define CHANGE 0x03
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+unsigned long micros();
+unsigned long millis();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+uint16_t analogRead(uint8_t pin);
+void attachInterrupt(uint8_t pin, void (*isr)(), int mode);
+void detachInterrupt(uint8_t pin);
+
+struct hw_timer_t;
+hw_timer_t *timerBegin(uint8_t num, uint16_t divider, bool countUp);
+void timerAttachInterrupt(hw_timer_t *timer, void (*fn)(), bool edge);
+void timerDetachInterrupt(hw_timer_t *timer);
+void timerAlarmWrite(hw_timer_t *timer, uint64_t alarmValue, bool autoreload);
+void timerAlarmEnable(hw_timer_t *timer);
+void timerAlarmDisable(hw_timer_t *timer);
+void timerEnd(hw_timer_t *timer);
+
+inline void configTime(long gmtOffsetSec, int daylightOffsetSec, const char *server1,
+                       const char *server2 = nullptr, const char *server3 = nullptr) {}
+
+inline long random(long howsmall, long howbig) {
+  return howsmall >= howbig ? howsmall : howsmall + rand() % (howbig - howsmall);
+}
+inline long random(long howbig) {
+  return random(0, howbig);
+}
+inline void randomSeed(unsigned long seed) {
+  srand(seed);
+}
+
+#define log_e(format, ...) fprintf(stderr, "[E] " format "\n", ##__VA_ARGS__)
+#define log_w(format, ...) fprintf(stderr, "[W] " format "\n", ##__VA_ARGS__)
+#define log_i(format, ...) do {} while (0)
+#define log_d(format, ...) do {} while (0)
+#define log_v(format, ...) do {} while (0)
+
+class String {
+  public:
+    String() = default;
+    String(const char *cstr) : s(cstr ? cstr : "") {}
+    String(const std::string &str) : s(str) {}
+    explicit String(char c) : s(1, c) {}
+    explicit String(int value, unsigned char base = 10) : String((long) value, base) {}
+    explicit String(unsigned int value, unsigned char base = 10) : String((unsigned long) value, base) {}
+    explicit String(long value, unsigned char base = 10) {
+      char buffer[24];
+      snprintf(buffer, sizeof(buffer), base == 16 ? "%lx" : "%ld", value);
+      s = buffer;
+    }
+    explicit String(unsigned long value, unsigned char base = 10) {
+      char buffer[24];
+      snprintf(buffer, sizeof(buffer), base == 16 ? "%lx" : "%lu", value);
+      s = buffer;
+    }
+    explicit String(unsigned long long value) : s(std::to_string(value)) {}
+    explicit String(double value, unsigned int decimalPlaces = 2) {
+      char buffer[48];
+      snprintf(buffer, sizeof(buffer), "%.*f", decimalPlaces, value);
+      s = buffer;
+    }
+    explicit String(float value, unsigned int decimalPlaces = 2) : String((double) value, decimalPlaces) {}
+
+    unsigned int length() const { return s.length(); }
+    bool isEmpty() const { return s.empty(); }
+    const char *c_str() const { return s.c_str(); }
+    void clear() { s.clear(); }
+    bool reserve(unsigned int size) { s.reserve(size); return true; }
+    void replace(char find, char replace) { std::replace(s.begin(), s.end(), find, replace); }
+    void remove(unsigned int index) { if (index < s.size()) s.erase(index); }
+    void remove(unsigned int index, unsigned int count) { if (index < s.size()) s.erase(index, count); }
+    bool concat(const String &str) { s += str.s; return true; }
+    bool concat(const char *cstr) { s += cstr; return true; }
+    bool concat(const char *cstr, unsigned int length) { s.append(cstr, length); return true; }
+    bool concat(char c) { s += c; return true; }
+    bool equals(const String &str) const { return s == str.s; }
+    bool startsWith(const String &prefix) const { return s.compare(0, prefix.s.size(), prefix.s) == 0; }
+    bool endsWith(const String &suffix) const {
+      return s.size() >= suffix.s.size()
+        && s.compare(s.size() - suffix.s.size(), suffix.s.size(), suffix.s) == 0;
+    }
+    int indexOf(char c, unsigned int from = 0) const { return toIndex(s.find(c, from)); }
+    int indexOf(const String &str, unsigned int from = 0) const { return toIndex(s.find(str.s, from)); }
+    int lastIndexOf(char c) const { return toIndex(s.rfind(c)); }
+    String substring(unsigned int from) const { return from > s.size() ? String() : String(s.substr(from)); }
+    String substring(unsigned int from, unsigned int to) const {
+      return from > s.size() || to < from ? String() : String(s.substr(from, to - from));
+    }
+    long toInt() const { return atol(s.c_str()); }
+    char operator[](unsigned int index) const { return index < s.size() ? s[index] : 0; }
+    char charAt(unsigned int index) const { return (*this)[index]; }
+    char &operator[](unsigned int index) { return s[index]; }
+
+    String &operator+=(const String &str) { s += str.s; return *this; }
+    String &operator+=(const char *cstr) { s += cstr; return *this; }
+    String &operator+=(char c) { s += c; return *this; }
+    String &operator+=(int value) { s += std::to_string(value); return *this; }
+    String &operator+=(unsigned int value) { s += std::to_string(value); return *this; }
+    String &operator+=(long value) { s += std::to_string(value); return *this; }
+    String &operator+=(unsigned long value) { s += std::to_string(value); return *this; }
+    bool operator==(const String &str) const { return s == str.s; }
+    bool operator==(const char *cstr) const { return s == cstr; }
+    bool operator!=(const String &str) const { return s != str.s; }
+    bool operator!=(const char *cstr) const { return s != cstr; }
+    bool operator<(const String &str) const { return s < str.s; }
+
+    // host only, access to the content for the tests
+    const std::string &str() const { return s; }
+
+  private:
+    static int toIndex(size_t pos) { return pos == std::string::npos ? -1 : (int) pos; }
+    std::string s;
+};
+
+inline String operator+(const String &a, const String &b) { String r(a); r += b; return r; }
+inline String operator+(const String &a, const char *b) { String r(a); r += b; return r; }
+inline String operator+(const char *a, const String &b) { String r(a); r += b; return r; }
+inline String operator+(const String &a, char b) { String r(a); r += b; return r; }
+inline String operator+(const String &a, int b) { String r(a); r += b; return r; }
+inline String operator+(const String &a, unsigned int b) { String r(a); r += b; return r; }
+inline String operator+(const String &a, long b) { String r(a); r += b; return r; }
+inline String operator+(const String &a, unsigned long b) { String r(a); r += b; return r; }
+
+class EspClass {
+  public:
+    uint64_t getEfuseMac() { return 0xecec00000000ULL; }
+    uint32_t getFreeHeap() { return 100000; }
+    uint32_t getMinFreeHeap() { return minFreeHeap; }
+    // tests lower it to simulate allocations
+    uint32_t minFreeHeap = 90000;
+};
+static EspClass ESP;
+
+#include "HardwareSerial.h"
+static HardwareSerial Serial(0);
+
+#include "freertos_host.h"
+
+#endif
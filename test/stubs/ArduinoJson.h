@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OBS_TEST_ARDUINOJSON_H
+#define OBS_TEST_ARDUINOJSON_H
+
+/* Only the types config.h declares, the host tests do not parse JSON. */
+
+#include <stddef.h>
+
+class JsonObject {};
+class JsonObjectConst {};
+class JsonArray {};
+
+class JsonDocument {};
+
+class DynamicJsonDocument : public JsonDocument {
+  public:
+    explicit DynamicJsonDocument(size_t capacity) {}
+};
+
+#endif
@@ -0,0 +1,378 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OBS_TEST_FS_H
+#define OBS_TEST_FS_H
+
+/* In memory file system of the host tests, with the FAT rules the
+ * firmware relies on: directories are not created on the fly and a rename
+ * does not replace an existing file.
+ *
+ * Data written is only safe on the card after a flush or close, powerCut()
+ * keeps a random part of the rest like an SD card losing its power.
+ */
+
+#include <Arduino.h>
+#include <map>
+#include <memory>
+#include <random>
+#include <set>
+#include <vector>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+struct HostFileData {
+  std::string content;
+  // bytes that survive a power cut
+  size_t persisted = 0;
+  time_t lastWrite = 0;
+};
+
+/* Time the card takes, in microseconds, like FatFs on an SD card in SPI
+ * mode: an open reads the directory till it finds the file, a file keeps
+ * one sector buffered, whole sectors are written directly. Appending to a
+ * sector that is not buffered reads it first, a sync writes the buffered
+ * sector, the directory entry and the FAT. Zero by default, the card is
+ * busy for HostCard::busyMicros in total.
+ */
+struct HostLatency {
+  unsigned long open = 0;
+  unsigned long sectorRead = 0;
+  unsigned long sectorWrite = 0;
+  unsigned long sync = 0;
+};
+
+static const size_t HOST_SECTOR_SIZE = 512;
+// a track name takes 4 long file name entries and the short one
+static const size_t HOST_FILES_PER_DIRECTORY_SECTOR = HOST_SECTOR_SIZE / 32 / 5;
+
+/* Thrown by a write when the power is cut, see HostCard::cutPowerAfter(). */
+struct PowerCut {};
+
+class HostCard {
+  public:
+    std::map<std::string, std::shared_ptr<HostFileData>> files;
+    std::set<std::string> directories{"/"};
+    // number of writes till the power is cut, negative for never
+    long writesTillPowerCut = -1;
+    uint32_t writes = 0;
+    // writes fail, see File::write()
+    bool failWrites = false;
+    bool droppedOut = false;
+    // decides how much unflushed data survives a power cut
+    std::minstd_rand random;
+    HostLatency latency;
+    unsigned long busyMicros = 0;
+
+    static std::string parentOf(const std::string &path) {
+      const size_t slash = path.rfind('/');
+      return slash == 0 ? "/" : path.substr(0, slash);
+    }
+    bool isDirectory(const std::string &path) const { return directories.count(path) > 0; }
+
+    void cutPowerAfter(long writes) { writesTillPowerCut = writes; }
+
+    /* Drops the data not flushed, up to a random part of it was written
+     * to the card already.
+     */
+    void powerCut() {
+      for (auto &file : files) {
+        HostFileData &data = *file.second;
+        if (data.content.size() > data.persisted) {
+          data.content.resize(data.persisted + random() % (data.content.size() - data.persisted + 1));
+        }
+        data.persisted = data.content.size();
+      }
+      writesTillPowerCut = -1;
+    }
+
+    void clear() {
+      files.clear();
+      directories = {"/"};
+      writesTillPowerCut = -1;
+      writes = 0;
+      failWrites = false;
+      droppedOut = false;
+      latency = HostLatency();
+      busyMicros = 0;
+    }
+
+    /* Content of a file, empty if it does not exist. */
+    std::string read(const std::string &path) const {
+      auto file = files.find(path);
+      return file == files.end() ? std::string() : file->second->content;
+    }
+};
+
+static HostCard hostCard;
+
+class File {
+  public:
+    File() = default;
+    File(const std::string &path, std::shared_ptr<HostFileData> data, bool writable)
+      : mPath(path), mData(data), mWritable(writable) {}
+    File(const std::string &path, const std::vector<std::string> &entries)
+      : mPath(path), mDirectory(true), mEntries(entries) {}
+
+    explicit operator bool() const { return mData != nullptr || mDirectory; }
+    bool isDirectory() const { return mDirectory; }
+    const char *path() const { return mPath.c_str(); }
+    const char *name() const { return mPath.c_str() + mPath.rfind('/') + 1; }
+    size_t size() const { return mData ? mData->content.size() : 0; }
+    size_t position() const { return mPosition; }
+    int available() const { return mData ? (int) (mData->content.size() - mPosition) : 0; }
+    time_t getLastWrite() const { return mData ? mData->lastWrite : 0; }
+
+    size_t write(const uint8_t *buffer, size_t size) {
+      if (!mData || !mWritable) {
+        return 0;
+      }
+      if (hostCard.writesTillPowerCut == 0) {
+        throw PowerCut();
+      }
+      if (hostCard.writesTillPowerCut > 0 && --hostCard.writesTillPowerCut == 0) {
+        // this write reaches the card partially at most
+        mData->content.append(reinterpret_cast<const char *>(buffer), size);
+        hostCard.powerCut();
+        throw PowerCut();
+      }
+      hostCard.writes++;
+      if (hostCard.failWrites) {
+        // the card drops out in the middle of the first failing write
+        size = hostCard.droppedOut ? 0 : size / 2;
+        hostCard.droppedOut = true;
+      } else {
+        hostCard.droppedOut = false;
+      }
+      chargeWrite(mData->content.size(), size);
+      mData->content.append(reinterpret_cast<const char *>(buffer), size);
+      mData->lastWrite = time(nullptr);
+      mModified = true;
+      return size;
+    }
+    size_t write(uint8_t c) { return write(&c, 1); }
+    size_t print(const String &s) { return write(reinterpret_cast<const uint8_t *>(s.c_str()), s.length()); }
+    size_t print(const char *s) { return write(reinterpret_cast<const uint8_t *>(s), strlen(s)); }
+    size_t println(int value) { return print(String(value) + "\n"); }
+
+    size_t read(uint8_t *buffer, size_t size) {
+      if (!mData) {
+        return 0;
+      }
+      const size_t count = std::min(size, mData->content.size() - mPosition);
+      memcpy(buffer, mData->content.data() + mPosition, count);
+      mPosition += count;
+      return count;
+    }
+    int read() {
+      uint8_t c;
+      return read(&c, 1) == 1 ? c : -1;
+    }
+    String readString() {
+      if (!mData) {
+        return String();
+      }
+      const String rest(mData->content.substr(mPosition));
+      mPosition = mData->content.size();
+      return rest;
+    }
+    bool seek(size_t position) {
+      if (!mData || position > mData->content.size()) {
+        return false;
+      }
+      mPosition = position;
+      return true;
+    }
+
+    void flush() {
+      if (mData && mWritable) {
+        mData->persisted = mData->content.size();
+        if (mModified) {
+          hostCard.busyMicros += (mDirty ? hostCard.latency.sectorWrite : 0) + hostCard.latency.sync;
+          mDirty = false;
+          mModified = false;
+        }
+      }
+    }
+    void close() {
+      flush();
+      mData.reset();
+      mDirectory = false;
+    }
+
+    File openNextFile();
+
+  private:
+    void chargeWrite(size_t position, size_t size) {
+      const size_t end = position + size;
+      for (size_t sector = position / HOST_SECTOR_SIZE; sector * HOST_SECTOR_SIZE < end; sector++) {
+        const size_t sectorStart = sector * HOST_SECTOR_SIZE;
+        if (position <= sectorStart && end >= sectorStart + HOST_SECTOR_SIZE) {
+          hostCard.busyMicros += hostCard.latency.sectorWrite;
+          continue;
+        }
+        if ((long) sector != mBufferedSector) {
+          if (mDirty) {
+            hostCard.busyMicros += hostCard.latency.sectorWrite;
+          }
+          if (sectorStart < position) {
+            hostCard.busyMicros += hostCard.latency.sectorRead;
+          }
+          mBufferedSector = sector;
+        }
+        mDirty = true;
+      }
+    }
+
+    std::string mPath;
+    std::shared_ptr<HostFileData> mData;
+    bool mWritable = false;
+    size_t mPosition = 0;
+    bool mDirectory = false;
+    std::vector<std::string> mEntries;
+    size_t mNextEntry = 0;
+    long mBufferedSector = -1;
+    bool mDirty = false;
+    bool mModified = false;
+};
+
+class FS {
+  public:
+    File open(const String &path, const char *mode = FILE_READ, bool create = false) {
+      const std::string name = path.str();
+      chargeOpen(name);
+      if (hostCard.isDirectory(name)) {
+        std::vector<std::string> entries;
+        const std::string prefix = name == "/" ? "/" : name + "/";
+        for (const std::string &directory : hostCard.directories) {
+          if (isChild(prefix, directory)) {
+            entries.push_back(directory);
+          }
+        }
+        for (const auto &file : hostCard.files) {
+          if (isChild(prefix, file.first)) {
+            entries.push_back(file.first);
+          }
+        }
+        return File(name, entries);
+      }
+      auto file = hostCard.files.find(name);
+      if (mode[0] == 'r') {
+        return file == hostCard.files.end() ? File() : File(name, file->second, false);
+      }
+      if (!hostCard.isDirectory(HostCard::parentOf(name))) {
+        return File();
+      }
+      if (file == hostCard.files.end()) {
+        file = hostCard.files.emplace(name, std::make_shared<HostFileData>()).first;
+        file->second->lastWrite = time(nullptr);
+      } else if (mode[0] == 'w') {
+        file->second->content.clear();
+        file->second->persisted = 0;
+      }
+      return File(name, file->second, true);
+    }
+    File open(const char *path, const char *mode = FILE_READ, bool create = false) {
+      return open(String(path), mode, create);
+    }
+    bool exists(const String &path) {
+      return hostCard.isDirectory(path.str()) || hostCard.files.count(path.str()) > 0;
+    }
+    bool exists(const char *path) { return exists(String(path)); }
+    bool remove(const String &path) { return hostCard.files.erase(path.str()) > 0; }
+    bool remove(const char *path) { return remove(String(path)); }
+    bool rename(const String &from, const String &to) {
+      auto file = hostCard.files.find(from.str());
+      if (file == hostCard.files.end() || exists(to)
+          || !hostCard.isDirectory(HostCard::parentOf(to.str()))) {
+        return false;
+      }
+      auto data = file->second;
+      hostCard.files.erase(file);
+      hostCard.files[to.str()] = data;
+      return true;
+    }
+    bool rename(const char *from, const char *to) { return rename(String(from), String(to)); }
+    bool mkdir(const String &path) {
+      if (exists(path) || !hostCard.isDirectory(HostCard::parentOf(path.str()))) {
+        return false;
+      }
+      hostCard.directories.insert(path.str());
+      return true;
+    }
+    bool mkdir(const char *path) { return mkdir(String(path)); }
+    bool rmdir(const String &path) {
+      const std::string prefix = path.str() + "/";
+      for (const auto &file : hostCard.files) {
+        if (file.first.compare(0, prefix.size(), prefix) == 0) {
+          return false;
+        }
+      }
+      return hostCard.directories.erase(path.str()) > 0;
+    }
+
+  private:
+    static void chargeOpen(const std::string &name) {
+      if (hostCard.latency.open == 0 && hostCard.latency.sectorRead == 0) {
+        return;
+      }
+      const std::string parent = HostCard::parentOf(name);
+      const std::string prefix = parent == "/" ? "/" : parent + "/";
+      size_t entries = 0;
+      for (const auto &file : hostCard.files) {
+        if (file.first == name) {
+          break;
+        }
+        entries += isChild(prefix, file.first);
+      }
+      hostCard.busyMicros += hostCard.latency.open
+        + entries / HOST_FILES_PER_DIRECTORY_SECTOR * hostCard.latency.sectorRead;
+    }
+
+    static bool isChild(const std::string &prefix, const std::string &path) {
+      return path.size() > prefix.size() && path.compare(0, prefix.size(), prefix) == 0
+        && path.find('/', prefix.size()) == std::string::npos;
+    }
+};
+
+inline File File::openNextFile() {
+  while (mNextEntry < mEntries.size()) {
+    const String entry(mEntries[mNextEntry++]);
+    File file = FS().open(entry);
+    if (file) {
+      return file;
+    }
+  }
+  return File();
+}
+
+}  // namespace fs
+
+using fs::FS;
+using fs::File;
+
+#endif
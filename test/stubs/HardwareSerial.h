@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OBS_TEST_HARDWARESERIAL_H
+#define OBS_TEST_HARDWARESERIAL_H
+
+#include <stdarg.h>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+
+#define SERIAL_8N1 0x800001c
+
+typedef enum {
+  UART_NO_ERROR,
+  UART_BREAK_ERROR,
+  UART_BUFFER_FULL_ERROR,
+  UART_FIFO_OVF_ERROR,
+  UART_FRAME_ERROR,
+  UART_PARITY_ERROR
+} hardwareSerial_error_t;
+
+/* Serial port of the host tests, everything written is kept in output.
+ * Received data is passed in with feed(), which calls the receive
+ * callbacks like the UART driver's event task.
+ */
+class HardwareSerial {
+  public:
+    explicit HardwareSerial(int uartNr) {}
+    // for "HardwareSerial port = HardwareSerial(n)", nothing is shared
+    HardwareSerial(HardwareSerial &&other) : mRxBufferSize(other.mRxBufferSize) {}
+    void begin(unsigned long baud, uint32_t config = SERIAL_8N1, int8_t rxPin = -1, int8_t txPin = -1) {
+      mBaudRate = baud;
+    }
+    void end() {}
+    void flush() {}
+    void updateBaudRate(unsigned long baud) { mBaudRate = baud; }
+    uint32_t baudRate() { return mBaudRate; }
+    size_t setRxBufferSize(size_t size) { mRxBufferSize = size; return size; }
+    void onReceive(std::function<void(void)> function, bool onlyOnTimeout = false) {
+      mOnReceive = function;
+    }
+    void onReceiveError(std::function<void(hardwareSerial_error_t)> function) {
+      mOnReceiveError = function;
+    }
+    int available() {
+      std::lock_guard<std::mutex> lock(mRxMutex);
+      return (int) mRx.size();
+    }
+    int read() {
+      std::lock_guard<std::mutex> lock(mRxMutex);
+      if (mRx.empty()) {
+        return -1;
+      }
+      const uint8_t data = mRx.front();
+      mRx.pop_front();
+      return data;
+    }
+    size_t write(uint8_t c) { output += (char) c; return 1; }
+    size_t write(const uint8_t *buffer, size_t size) {
+      output.append((const char *) buffer, size);
+      return size;
+    }
+    size_t print(const char *str) { output += str; return strlen(str); }
+    size_t println(const char *str = "") { return print(str) + print("\r\n"); }
+    size_t printf(const char *format, ...) __attribute__ ((format (printf, 2, 3))) {
+      char buffer[256];
+      va_list args;
+      va_start(args, format);
+      const int length = vsnprintf(buffer, sizeof(buffer), format, args);
+      va_end(args);
+      output += buffer;
+      return length;
+    }
+
+    // host only
+    std::string output;
+
+    /* Data received, what does not fit the receive buffer is lost. */
+    void feed(const uint8_t *data, size_t length) {
+      bool overflow = false;
+      {
+        std::lock_guard<std::mutex> lock(mRxMutex);
+        for (size_t i = 0; i < length; i++) {
+          if (mRx.size() >= mRxBufferSize) {
+            overflow = true;
+          } else {
+            mRx.push_back(data[i]);
+          }
+        }
+      }
+      if (overflow && mOnReceiveError) {
+        mOnReceiveError(UART_BUFFER_FULL_ERROR);
+      }
+      if (mOnReceive) {
+        mOnReceive();
+      }
+    }
+
+  private:
+    uint32_t mBaudRate = 115200;
+    size_t mRxBufferSize = 256;
+    std::mutex mRxMutex;
+    std::deque<uint8_t> mRx;
+    std::function<void(void)> mOnReceive;
+    std::function<void(hardwareSerial_error_t)> mOnReceiveError;
+};
+
+#endif
@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OBS_TEST_PREFERENCES_H
+#define OBS_TEST_PREFERENCES_H
+
+#include <Arduino.h>
+#include <map>
+
+/* Non volatile storage of the host tests, survives like the NVS. */
+static std::map<std::string, uint32_t> hostNvs;
+
+class Preferences {
+  public:
+    bool begin(const char *name, bool readOnly = false) { return true; }
+    void end() {}
+    bool isKey(const char *key) { return hostNvs.count(key) > 0; }
+    uint32_t getUInt(const char *key, uint32_t defaultValue = 0) {
+      return hostNvs.count(key) ? hostNvs[key] : defaultValue;
+    }
+    size_t putUInt(const char *key, uint32_t value) {
+      hostNvs[key] = value;
+      return sizeof(value);
+    }
+    bool remove(const char *key) { return hostNvs.erase(key) > 0; }
+};
+
+#endif
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OBS_TEST_SD_H
+#define OBS_TEST_SD_H
+
+#include <FS.h>
+#include <sys/types.h>
+
+namespace fs {
+
+class SDFS : public FS {
+  public:
+    bool begin() { return true; }
+    void end() {}
+    uint64_t cardSize() { return 16ULL << 30; }
+    uint64_t totalBytes() { return 16ULL << 30; }
+    uint64_t usedBytes() {
+      uint64_t used = 0;
+      for (const auto &file : hostCard.files) {
+        used += file.second->content.size();
+      }
+      return used;
+    }
+};
+
+}  // namespace fs
+
+static fs::SDFS SD;
+
+/* The firmware truncates files through the VFS path of the card mounted
+ * at /sd, see FileWriter::truncateFile(). Picked instead of the POSIX
+ * truncate() for a size_t length.
+ */
+inline int truncate(const char *path, size_t length) {
+  const std::string name(path);
+  auto file = fs::hostCard.files.find(name.compare(0, 3, "/sd") == 0 ? name.substr(3) : name);
+  if (file == fs::hostCard.files.end() || length > file->second->content.size()) {
+    return -1;
+  }
+  file->second->content.resize(length);
+  file->second->persisted = std::min(file->second->persisted, length);
+  return 0;
+}
+
+#endif
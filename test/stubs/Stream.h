@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OBS_TEST_STREAM_H
+#define OBS_TEST_STREAM_H
+
+/* The reading part of the Arduino Stream. */
+
+#include <Arduino.h>
+
+class Stream {
+  public:
+    virtual ~Stream() = default;
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    virtual void flush() = 0;
+    virtual size_t write(uint8_t) = 0;
+    virtual size_t readBytes(char *buffer, size_t length) {
+      size_t count = 0;
+      while (count < length) {
+        const int c = read();
+        if (c < 0) {
+          break;
+        }
+        buffer[count++] = (char) c;
+      }
+      return count;
+    }
+};
+
+#endif
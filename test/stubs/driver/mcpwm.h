@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OBS_TEST_DRIVER_MCPWM_H
+#define OBS_TEST_DRIVER_MCPWM_H
+
+/* Declarations only, the tests use the gpio interrupt echo capture. */
+
+#include <stdint.h>
+#include "gpio.h"
+
+#define APB_CLK_FREQ 80000000
+
+typedef enum { MCPWM_UNIT_0 } mcpwm_unit_t;
+typedef enum { MCPWM_SELECT_CAP0, MCPWM_SELECT_CAP1 } mcpwm_capture_channel_id_t;
+typedef enum { MCPWM_CAP_0 = 20, MCPWM_CAP_1 } mcpwm_io_signals_t;
+typedef enum { MCPWM_NEG_EDGE = 1, MCPWM_POS_EDGE = 2, MCPWM_BOTH_EDGE = 3 } mcpwm_capture_on_edge_t;
+
+typedef struct {
+  mcpwm_capture_on_edge_t cap_edge;
+  uint32_t cap_value;
+} cap_event_data_t;
+
+typedef bool (*cap_isr_cb_t)(mcpwm_unit_t, mcpwm_capture_channel_id_t, const cap_event_data_t *, void *);
+
+typedef struct {
+  mcpwm_capture_on_edge_t cap_edge;
+  uint32_t cap_prescale;
+  cap_isr_cb_t capture_cb;
+  void *user_data;
+} mcpwm_capture_config_t;
+
+inline const char *esp_err_to_name(esp_err_t) {
+  return "ESP_FAIL";
+}
+inline esp_err_t mcpwm_gpio_init(mcpwm_unit_t, mcpwm_io_signals_t, int) {
+  return -1;
+}
+inline esp_err_t mcpwm_capture_enable_channel(mcpwm_unit_t, mcpwm_capture_channel_id_t, const mcpwm_capture_config_t *) {
+  return -1;
+}
+inline esp_err_t mcpwm_capture_disable_channel(mcpwm_unit_t, mcpwm_capture_channel_id_t) {
+  return -1;
+}
+
+#endif
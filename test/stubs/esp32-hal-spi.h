@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OBS_TEST_ESP32_HAL_SPI_H
+#define OBS_TEST_ESP32_HAL_SPI_H
+
+/* The SPI driver of the Arduino core without the peripheral. The bus
+ * clocks each bit through hostSpiClock(), called with the attached pins
+ * and the level driven on MOSI, it returns the level of MISO. A test sets
+ * it to the device it simulates.
+ */
+
+#include <stdint.h>
+#include <functional>
+
+#define FSPI 1
+#define HSPI 2
+#define VSPI 3
+
+#define SPI_MODE0 0
+#define SPI_MODE1 1
+#define SPI_MODE2 2
+#define SPI_MODE3 3
+
+#define SPI_LSBFIRST 0
+#define SPI_MSBFIRST 1
+
+struct spi_struct_t {
+  uint8_t num;
+  uint32_t clockDiv;
+  uint8_t dataMode;
+  uint8_t bitOrder;
+  int8_t sck = -1;
+  int8_t mosi = -1;
+  int8_t miso = -1;
+};
+typedef struct spi_struct_t spi_t;
+
+inline std::function<uint8_t(int8_t sck, int8_t mosi, int8_t miso, uint8_t level)> &hostSpiClock() {
+  static std::function<uint8_t(int8_t, int8_t, int8_t, uint8_t)> clock;
+  return clock;
+}
+
+inline spi_t *hostSpiBus(uint8_t spi_num) {
+  static spi_t bus[4];
+  return &bus[spi_num & 3];
+}
+
+inline uint32_t spiFrequencyToClockDiv(uint32_t freq) {
+  return 80000000 / freq;
+}
+
+inline spi_t *spiStartBus(uint8_t spi_num, uint32_t clockDiv, uint8_t dataMode, uint8_t bitOrder) {
+  spi_t *spi = hostSpiBus(spi_num);
+  *spi = spi_t();
+  spi->num = spi_num;
+  spi->clockDiv = clockDiv;
+  spi->dataMode = dataMode;
+  spi->bitOrder = bitOrder;
+  return spi;
+}
+
+inline void spiAttachSCK(spi_t *spi, int8_t sck) { spi->sck = sck; }
+inline void spiAttachMOSI(spi_t *spi, int8_t mosi) { spi->mosi = mosi; }
+inline void spiAttachMISO(spi_t *spi, int8_t miso) { spi->miso = miso; }
+inline void spiDetachSCK(spi_t *spi, int8_t) { spi->sck = -1; }
+inline void spiDetachMOSI(spi_t *spi, int8_t) { spi->mosi = -1; }
+inline void spiDetachMISO(spi_t *spi, int8_t) { spi->miso = -1; }
+
+/* data can be nullptr to send 0xff, out can be nullptr. */
+inline void spiTransferBytes(spi_t *spi, const uint8_t *data, uint8_t *out, uint32_t size) {
+  for (uint32_t pos = 0; pos < size; pos++) {
+    const uint8_t dataOut = data ? data[pos] : 0xff;
+    uint8_t dataIn = 0;
+    for (uint8_t i = 0; i < 8; i++) {
+      const uint8_t bit = spi->bitOrder == SPI_LSBFIRST ? i : 7 - i;
+      const uint8_t level = hostSpiClock()(spi->sck, spi->mosi, spi->miso, (dataOut >> bit) & 1);
+      dataIn |= (level & 1) << bit;
+    }
+    if (out) {
+      out[pos] = dataIn;
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OBS_TEST_FREERTOS_HOST_H
+#define OBS_TEST_FREERTOS_HOST_H
+
+/* The FreeRTOS calls used by the firmware mapped to std::thread, tasks
+ * and semaphores behave like on the device apart from priorities and
+ * core affinity. Ticks are milliseconds.
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdFAIL pdFALSE
+#define pdPASS pdTRUE
+#define portMAX_DELAY 0xffffffffUL
+#define pdMS_TO_TICKS(ms) ((uint32_t) (ms))
+
+typedef int BaseType_t;
+typedef uint32_t TickType_t;
+typedef void (*TaskFunction_t)(void *);
+
+enum eNotifyAction {
+  eNoAction,
+  eSetBits,
+  eIncrement,
+  eSetValueWithOverwrite,
+  eSetValueWithoutOverwrite
+};
+
+struct HostTask {
+  std::mutex mutex;
+  std::condition_variable changed;
+  uint32_t value = 0;
+  bool notified = false;
+  bool deleted = false;
+};
+typedef HostTask *TaskHandle_t;
+
+struct HostSemaphore {
+  std::mutex mutex;
+  std::condition_variable changed;
+  uint32_t count;
+  explicit HostSemaphore(uint32_t initial) : count(initial) {}
+};
+typedef HostSemaphore *SemaphoreHandle_t;
+
+/* Lets xTaskCreate fail so the firmware takes its fallback path. */
+inline bool &hostTaskCreationFails() {
+  static bool fails = false;
+  return fails;
+}
+
+inline HostTask *&hostCurrentTask() {
+  static thread_local HostTask *task = nullptr;
+  return task;
+}
+
+/* Waits with the lock held until the predicate holds or the ticks passed. */
+template<typename Predicate>
+bool hostWait(std::unique_lock<std::mutex> &lock, std::condition_variable &cv,
+              TickType_t ticks, Predicate predicate) {
+  if (ticks == portMAX_DELAY) {
+    cv.wait(lock, predicate);
+    return true;
+  }
+  return cv.wait_for(lock, std::chrono::milliseconds(ticks), predicate);
+}
+
+inline BaseType_t xTaskCreatePinnedToCore(
+  TaskFunction_t code, const char *, uint32_t, void *param, int, TaskHandle_t *handle, int) {
+  if (hostTaskCreationFails()) {
+    return pdFAIL;
+  }
+  HostTask * const task = new HostTask; // leaked, the thread may outlive everything
+  if (handle) {
+    *handle = task;
+  }
+  std::thread([code, param, task]() {
+    hostCurrentTask() = task;
+    code(param);
+  }).detach();
+  return pdPASS;
+}
+
+inline BaseType_t xTaskCreate(
+  TaskFunction_t code, const char *name, uint32_t stack, void *param, int priority, TaskHandle_t *handle) {
+  return xTaskCreatePinnedToCore(code, name, stack, param, priority, handle, 0);
+}
+
+/* A deleted task blocks forever in its next wait, the thread can not be stopped. */
+inline void hostBlockIfDeleted(HostTask *task, std::unique_lock<std::mutex> &lock) {
+  while (task->deleted) {
+    task->changed.wait(lock);
+  }
+}
+
+inline void vTaskDelete(TaskHandle_t task) {
+  if (!task) {
+    task = hostCurrentTask();
+  }
+  std::lock_guard<std::mutex> lock(task->mutex);
+  task->deleted = true;
+}
+
+inline BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action) {
+  {
+    std::lock_guard<std::mutex> lock(task->mutex);
+    switch (action) {
+      case eSetBits: task->value |= value; break;
+      case eIncrement: task->value++; break;
+      case eSetValueWithOverwrite: task->value = value; break;
+      case eSetValueWithoutOverwrite: if (!task->notified) task->value = value; break;
+      case eNoAction: break;
+    }
+    task->notified = true;
+  }
+  task->changed.notify_all();
+  return pdPASS;
+}
+
+inline void xTaskNotifyGive(TaskHandle_t task) {
+  xTaskNotify(task, 0, eIncrement);
+}
+
+inline BaseType_t xTaskNotifyWait(uint32_t clearOnEntry, uint32_t clearOnExit, uint32_t *value, TickType_t ticks) {
+  HostTask * const task = hostCurrentTask();
+  std::unique_lock<std::mutex> lock(task->mutex);
+  if (!task->notified) {
+    task->value &= ~clearOnEntry;
+  }
+  hostWait(lock, task->changed, ticks, [task]() { return task->notified || task->deleted; });
+  hostBlockIfDeleted(task, lock);
+  if (!task->notified) {
+    return pdFALSE;
+  }
+  if (value) {
+    *value = task->value;
+  }
+  task->value &= ~clearOnExit;
+  task->notified = false;
+  return pdTRUE;
+}
+
+inline uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) {
+  HostTask * const task = hostCurrentTask();
+  std::unique_lock<std::mutex> lock(task->mutex);
+  hostWait(lock, task->changed, ticks, [task]() { return task->value > 0 || task->deleted; });
+  hostBlockIfDeleted(task, lock);
+  const uint32_t value = task->value;
+  if (value > 0) {
+    task->value = clearOnExit ? 0 : value - 1;
+  }
+  task->notified = false;
+  return value;
+}
+
+inline void vTaskDelay(TickType_t ticks) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+inline SemaphoreHandle_t xSemaphoreCreateBinary() {
+  return new HostSemaphore(0);
+}
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() {
+  return new HostSemaphore(1);
+}
+
+inline void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+  delete semaphore;
+}
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks) {
+  std::unique_lock<std::mutex> lock(semaphore->mutex);
+  if (!hostWait(lock, semaphore->changed, ticks, [semaphore]() { return semaphore->count > 0; })) {
+    return pdFALSE;
+  }
+  semaphore->count--;
+  return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+  {
+    std::lock_guard<std::mutex> lock(semaphore->mutex);
+    if (semaphore->count > 0) {
+      return pdFALSE;
+    }
+    semaphore->count++;
+  }
+  semaphore->changed.notify_all();
+  return pdTRUE;
+}
+
+/* Interrupts are simulated by the tests from a single thread, critical
+ * sections have nothing to lock.
+ */
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(mux) ((void) (mux))
+#define portEXIT_CRITICAL(mux) ((void) (mux))
+#define portENTER_CRITICAL_ISR(mux) ((void) (mux))
+#define portEXIT_CRITICAL_ISR(mux) ((void) (mux))
+
+#endif
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OBS_TEST_HOSTDATASETS_H
+#define OBS_TEST_HOSTDATASETS_H
+
+/* Random data sets covering the CSV fields, include after writer.h. */
+
+inline void randomDataSet(DataSet &set, time_t time) {
+  set.reset();
+  set.time = time;
+  set.millis = rand();
+  const int comment = rand() % 50;
+  set.comment = comment < 10 ? "Hello World" : comment == 10 ? String(std::string(rand() % 5000, 'x')) : "";
+  const int32_t latitude = rand() % 4 ? rand() % 1800000000 - 900000000 : rand() % 20000000 - 10000000;
+  Gps::fill(set.gpsRecord, latitude, rand() % 2000000000 - 1000000000, rand() % 20000000 - 10000000,
+            rand() % 15000, rand() % 36000000, rand() % 3 ? rand() % 500 : 9999, rand() % 30, rand() % 6);
+  set.batteryLevelCenti = rand() % 10 ? rand() % 500 : rand() % 400 - 200;
+  set.sensorValues[LEFT_SENSOR_ID] = rand() % 1000;
+  set.sensorValues[RIGHT_SENSOR_ID] = rand() % 1000;
+  set.confirmed = rand() % 4 == 0 ? rand() % 30 : 0;
+  set.marked = rand() % 7 == 0 ? "OVERTAKING" : "";
+  set.invalidMeasurement = rand() % 9 == 0;
+  set.isInsidePrivacyArea = rand() % 5 == 0;
+  set.factorCenti = rand() % 4 ? 5500 + rand() % 600 : 5800;
+  set.cadenceMode = (CadenceMode) (rand() % 3);
+  set.measurements = rand() % (MAX_NUMBER_MEASUREMENTS_PER_INTERVAL + 1);
+  for (int idx = 0; idx < set.measurements; idx++) {
+    set.startOffsetMilliseconds[idx] = rand() % 1000;
+    set.readDurationsLeftInMicroseconds[idx] = rand() % 4 ? rand() % 40000 : -1;
+    set.readDurationsRightInMicroseconds[idx] = rand() % 4 ? rand() % 40000 : 0;
+  }
+}
+
+#endif
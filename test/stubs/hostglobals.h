@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OBS_TEST_HOSTGLOBALS_H
+#define OBS_TEST_HOSTGLOBALS_H
+
+/* Include before any firmware source. Takes the place of src/globals.h,
+ * which pulls in the display, the configuration and all drivers, so each
+ * test only compiles the modules it covers. Select the hardware variant
+ * with OBSCLASSIC or OBSPRO before including this file.
+ */
+
+#define OBS_GLOBALS_H
+
+#include <Arduino.h>
+#include "variant.h"
+
+class HCSR04SensorManager;
+class DisplayDevice;
+
+#endif
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OBS_TEST_HOSTGPS_H
+#define OBS_TEST_HOSTGPS_H
+
+/* Include before gps.cpp. Takes the place of the display and the ALP
+ * download so the GPS code compiles without the other drivers. GpsTest
+ * is the friend of Gps that gets the tests at its internals.
+ */
+
+#include "hostglobals.h"
+#include <sys/time.h>
+
+/* NAV-TIMEGPS sets the clock, the host keeps its own. */
+static int hostSetTimeOfDay(const struct timeval *tv, const void *tz) {
+  return 0;
+}
+#define settimeofday hostSetTimeOfDay
+
+#define OBS_DISPLAYS_H
+
+class DisplayDevice {
+  public:
+    void showTextOnGrid(int16_t x, int16_t y, String text, const uint8_t *font = nullptr,
+                        int8_t offsetX = 0, int8_t offsetY = 0) {}
+    void clear() {}
+    uint8_t currentLine() const { return 0; }
+    uint8_t newLine() { return 0; }
+};
+
+#include "config.h"
+#include "utils/alpdata.h"
+#include "utils/obsutils.h"
+
+static DisplayDevice hostDisplay;
+static DisplayDevice *obsDisplay = &hostDisplay;
+static Config config;
+static const char *OBSVersion = "v0.0.0-host";
+
+String ObsUtils::encodeForXmlText(const String &text) {
+  return text;
+}
+
+bool AlpData::available() {
+  return false;
+}
+
+void AlpData::saveMessage(const uint8_t *data, size_t size) {
+}
+
+size_t AlpData::loadMessage(uint8_t *data, size_t size) {
+  return 0;
+}
+
+uint16_t AlpData::fill(uint8_t *data, size_t ofs, uint16_t dataSize) {
+  return 0;
+}
+
+void AlpData::save(const uint8_t *data, size_t offset, int length) {
+}
+
+#include "gps.h"
+
+/* A UBX frame with sync chars and checksum around the payload. */
+inline std::vector<uint8_t> ubxFrame(uint16_t ubxMsgId, const std::vector<uint8_t> &payload) {
+  std::vector<uint8_t> frame = {0xb5, 0x62, (uint8_t) ubxMsgId, (uint8_t) (ubxMsgId >> 8),
+                                (uint8_t) payload.size(), (uint8_t) (payload.size() >> 8)};
+  frame.insert(frame.end(), payload.begin(), payload.end());
+  uint8_t chA = 0, chB = 0;
+  for (size_t i = 2; i < frame.size(); i++) {
+    chA += frame[i];
+    chB += chA;
+  }
+  frame.push_back(chA);
+  frame.push_back(chB);
+  return frame;
+}
+
+inline void putU16(std::vector<uint8_t> &payload, size_t offset, uint16_t value) {
+  payload[offset] = value;
+  payload[offset + 1] = value >> 8;
+}
+
+inline void putU32(std::vector<uint8_t> &payload, size_t offset, uint32_t value) {
+  for (int i = 0; i < 4; i++) {
+    payload[offset + i] = value >> (8 * i);
+  }
+}
+
+class GpsTest {
+  public:
+    static HardwareSerial &serial(Gps &gps) { return gps.mSerial; }
+    static TaskHandle_t readerTask(Gps &gps) { return gps.mReaderTask; }
+    static bool startReaderTask(Gps &gps) { return gps.startReaderTask(); }
+    static bool encode(Gps &gps, uint8_t data) { return gps.encode(data); }
+    static uint16_t bufferBytePos(Gps &gps) { return gps.mGpsBufferBytePos; }
+    static int maxMessageLength() { return Gps::MAX_MESSAGE_LENGTH; }
+    /* Message id and minimum payload length of UBX_HANDLERS. */
+    static std::vector<std::pair<uint16_t, uint16_t>> ubxHandlers() {
+      std::vector<std::pair<uint16_t, uint16_t>> handlers;
+      for (size_t i = 0; i < Gps::UBX_HANDLER_COUNT; i++) {
+        handlers.emplace_back(Gps::UBX_HANDLERS[i].ubxMsgId, Gps::UBX_HANDLERS[i].minPayloadLength);
+      }
+      return handlers;
+    }
+    static void encode(Gps &gps, const std::vector<uint8_t> &data) {
+      for (uint8_t byte : data) {
+        gps.encode(byte);
+      }
+    }
+    static uint8_t solutions(Gps &gps, uint16_t seconds) { return gps.solutions(seconds); }
+    static void setNavigationRateHz(Gps &gps, uint8_t hz) { gps.mNavigationRateHz = hz; }
+};
+
+#endif
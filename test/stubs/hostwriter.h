@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OBS_TEST_HOSTWRITER_H
+#define OBS_TEST_HOSTWRITER_H
+
+/* Include before the writer sources. The writer reads counters of the GPS
+ * and the sensors for the DEV comments only, both are replaced by fakes
+ * and gps.h and sensor.h are skipped. Select the hardware variant with
+ * OBSCLASSIC or OBSPRO before including this file.
+ */
+
+#include "hostglobals.h"
+
+#define OBS_GPS_H
+#define OBS_SENSOR_H
+#define OBS_PGASENSOR_H
+
+#include "utils/obsutils.h"
+#include "config.h"
+#include "gpsepochs.h"
+#include "gpsrecord.h"
+
+// obsutils.cpp needs the WiFi and BLE stack, the writer only uses this one
+inline String ObsUtils::encodeForCsvField(const String &field) {
+  String result(field);
+  result.replace(';', '_');
+  result.replace('\n', ' ');
+  result.replace('\r', ' ');
+  return result;
+}
+
+class Gps {
+  public:
+    uint32_t getValidMessageCount() const { return 0; }
+    uint32_t getMessagesWithFailedCrcCount() const { return 0; }
+    int getLastNoiseLevel() const { return 0; }
+    uint32_t getBaudRate() const { return 115200; }
+    uint32_t getNumberOfAlpBytesSent() const { return 0; }
+    uint32_t getDroppedBytes() const { return 0; }
+    uint32_t getRxOverflowCount() const { return 0; }
+    uint32_t getAverageParseLatencyMillis() const { return 0; }
+    uint32_t getMaxParseLatencyMillis() const { return 0; }
+    String popMessage() { return String(); }
+
+    /* Sets the record like a complete NAV-PVT/NAV-DOP epoch, scaled as
+     * received: 1e-7 deg, mm, mm/s, 1e-5 deg and 1e-2.
+     */
+    static void fill(GpsRecord &record, int32_t latitude, int32_t longitude, int32_t height,
+                     uint32_t speed, int32_t heading, uint16_t hdop, uint8_t satellites,
+                     uint8_t fix) {
+      record.reset(0, 0, 0);
+      record.setPosition(longitude, latitude, height);
+      record.setVelocity(speed, heading);
+      record.setHdop(hdop);
+      record.setInfo(satellites, (GpsRecord::GPS_FIX) fix, 0);
+    }
+
+    /* One epoch at the whole second, as at a navigation rate of 1 Hz. */
+    static void fillEpochs(GpsEpochs &epochs, uint32_t tow, int32_t latitude, int32_t longitude) {
+      epochs.reset(tow);
+      epochs.add(0, latitude, longitude, 0, 0);
+    }
+};
+
+class HCSR04SensorManager {
+  public:
+    uint32_t getNoSignalReadings(uint8_t sensorId) const { return 0; }
+    uint32_t getLastDelayTillStartUs(uint8_t sensorId) const { return 0; }
+    uint32_t getMinDurationUs(uint8_t sensorId) const { return 0; }
+    uint32_t getMaxDurationUs(uint8_t sensorId) const { return 0; }
+    uint32_t getNumberOfLowAfterMeasurement(uint8_t sensorId) const { return 0; }
+    uint32_t getNumberOfToLongMeasurement(uint8_t sensorId) const { return 0; }
+    uint32_t getNumberOfInterruptAdjustments(uint8_t sensorId) const { return 0; }
+    uint32_t getNumberOfCrossTalkRejections(uint8_t sensorId) const { return 0; }
+};
+typedef HCSR04SensorManager PGASensorManager;
+
+static Gps gps;
+static Config config;
+static HCSR04SensorManager hostSensorManager;
+static HCSR04SensorManager *sensorManager = &hostSensorManager;
+static const char *OBSVersion = "v0.0.0-host";
+static const uint8_t LEFT_SENSOR_ID = 1;
+static const uint8_t RIGHT_SENSOR_ID = 0;
+
+#endif
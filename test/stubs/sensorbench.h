@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OBS_TEST_SENSORBENCH_H
+#define OBS_TEST_SENSORBENCH_H
+
+/* Simulated time, pins and trigger timer for the HC-SR04 sensor manager.
+ * Time advances in steps of one micro second, each step fires the echo
+ * pin changes that are due and the timer isr once its period passed. The
+ * echo of a sensor is scheduled by EchoModel when its trigger pulse ends.
+ */
+
+#include <functional>
+#include <vector>
+
+namespace bench {
+
+struct Edge {
+  uint32_t micros;
+  uint8_t pin;
+  uint8_t level;
+  // the level changes but the interrupt is not delivered
+  bool lost;
+};
+
+/* Called at the falling edge of a trigger pin, adds the echo edges. */
+typedef std::function<void(uint8_t triggerPin, uint32_t now, std::vector<Edge> &edges)> EchoModel;
+
+static uint32_t now = 0;
+static uint8_t levels[64];
+static void (*pinIsr[64])();
+static void (*timerIsr)() = nullptr;
+static bool timerEnabled = false;
+static uint32_t timerPeriod = 0;
+static std::vector<Edge> edges;
+static EchoModel echoModel;
+static std::vector<std::pair<uint8_t, uint32_t>> triggers;
+
+inline void reset(const EchoModel &model) {
+  now = 1000000; // like on the device the sensors start after the boot
+  memset(levels, LOW, sizeof(levels));
+  edges.clear();
+  triggers.clear();
+  echoModel = model;
+}
+
+/* Echo pulse of the given duration starting at `start`. */
+inline void echo(std::vector<Edge> &out, uint8_t pin, uint32_t start, uint32_t duration) {
+  out.push_back({start, pin, HIGH});
+  out.push_back({start + duration, pin, LOW});
+}
+
+inline void step() {
+  now++;
+  for (auto it = edges.begin(); it != edges.end();) {
+    if (it->micros == now) {
+      if (levels[it->pin] != it->level) {
+        levels[it->pin] = it->level;
+        if (pinIsr[it->pin] && !it->lost) {
+          pinIsr[it->pin]();
+        }
+      }
+      it = edges.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  if (timerEnabled && timerIsr && timerPeriod && now % timerPeriod == 0) {
+    timerIsr();
+  }
+}
+
+/* Runs the simulation for the given time, `loop` is called every
+ * `loopMicros` like the main loop of the firmware.
+ */
+inline void run(uint32_t micros, uint32_t loopMicros, const std::function<void()> &loop) {
+  for (uint32_t i = 0; i < micros; i++) {
+    step();
+    if (loop && now % loopMicros == 0) {
+      loop();
+    }
+  }
+}
+
+}
+
+unsigned long micros() {
+  return bench::now;
+}
+
+unsigned long millis() {
+  return bench::now / 1000;
+}
+
+void delay(uint32_t ms) {
+  bench::run(ms * 1000, 1, nullptr);
+}
+
+void delayMicroseconds(uint32_t us) {
+  bench::run(us, 1, nullptr);
+}
+
+void pinMode(uint8_t, uint8_t) {
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  if (bench::levels[pin] == HIGH && val == LOW) {
+    bench::triggers.push_back({pin, bench::now});
+    if (bench::echoModel) {
+      bench::echoModel(pin, bench::now, bench::edges);
+    }
+  }
+  bench::levels[pin] = val;
+}
+
+int digitalRead(uint8_t pin) {
+  return bench::levels[pin];
+}
+
+void attachInterrupt(uint8_t pin, void (*isr)(), int) {
+  bench::pinIsr[pin] = isr;
+}
+
+void detachInterrupt(uint8_t pin) {
+  bench::pinIsr[pin] = nullptr;
+}
+
+static int benchTimer;
+
+hw_timer_t *timerBegin(uint8_t, uint16_t, bool) {
+  return reinterpret_cast<hw_timer_t *>(&benchTimer);
+}
+
+void timerAttachInterrupt(hw_timer_t *, void (*fn)(), bool) {
+  bench::timerIsr = fn;
+}
+
+void timerDetachInterrupt(hw_timer_t *) {
+  bench::timerIsr = nullptr;
+}
+
+void timerAlarmWrite(hw_timer_t *, uint64_t alarmValue, bool) {
+  bench::timerPeriod = alarmValue; // 1 tick per micro second
+}
+
+void timerAlarmEnable(hw_timer_t *) {
+  bench::timerEnabled = true;
+}
+
+void timerAlarmDisable(hw_timer_t *) {
+  bench::timerEnabled = false;
+}
+
+void timerEnd(hw_timer_t *) {
+}
+
+#endif
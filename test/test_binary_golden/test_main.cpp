@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+/* Converts the tracks of BinaryFileWriter with tools/obsbin2csv.py, the
+ * result must be the track CSVFileWriter writes for the same data sets.
+ * Ignored if there is no python3.
+ */
+
+#define OBSCLASSIC 1
+#include "hostwriter.h"
+#include "hostclock.h"
+
+#include "writer.cpp"
+#include "trackindex.cpp"
+#include "gpsrecord.cpp"
+#include "gpsepochs.cpp"
+#include "utils/gzip.cpp"
+#include "utils/timeutils.cpp"
+#include "utils/soundspeed.cpp"
+#include "hostdatasets.h"
+
+#include <unity.h>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+static const time_t TRACK_START = 1760000000 - 1760000000 % 60;
+static const int TRACK_SETS = 600;
+
+/* The repository, from the path of this file. */
+static std::string repository() {
+  const std::string file = __FILE__;
+  const size_t test = file.rfind("test/test_binary_golden/");
+  return test == std::string::npos ? "" : file.substr(0, test);
+}
+
+static std::string trackContent(const String &extension) {
+  for (const auto &file : fs::hostCard.files) {
+    if (String(file.first).endsWith(extension)) {
+      return file.second->content;
+    }
+  }
+  return "";
+}
+
+static void writeTrack(FileWriter *writer, std::vector<DataSet> &sets) {
+  writer->setFileName();
+  writer->writeHeader("golden-track");
+  for (DataSet &set : sets) {
+    writer->append(set);
+    writer->flush();
+  }
+  delete writer;
+}
+
+static std::vector<std::string> linesOf(const std::string &content) {
+  std::vector<std::string> lines;
+  std::stringstream stream(content);
+  std::string line;
+  while (std::getline(stream, line)) {
+    lines.push_back(line);
+  }
+  return lines;
+}
+
+static bool convert(const std::string &binary, std::string &csv) {
+  const std::string source = "/tmp/obs-binary-golden.obsdata.bin";
+  const std::string target = "/tmp/obs-binary-golden.obsdata.csv";
+  std::ofstream(source, std::ios::binary) << binary;
+  const std::string command = "python3 " + repository() + "tools/obsbin2csv.py "
+    + source + " " + target + " 2>&1";
+  if (system(command.c_str()) != 0) {
+    return false;
+  }
+  std::ifstream converted(target, std::ios::binary);
+  csv.assign(std::istreambuf_iterator<char>(converted), std::istreambuf_iterator<char>());
+  remove(source.c_str());
+  remove(target.c_str());
+  return true;
+}
+
+static void assertSameTrack(int privacyConfig) {
+  if (system("python3 --version > /dev/null 2>&1") != 0) {
+    TEST_IGNORE_MESSAGE("python3 is needed to run tools/obsbin2csv.py");
+  }
+  config.privacyConfig = privacyConfig;
+  std::vector<DataSet> sets(TRACK_SETS);
+  for (int idx = 0; idx < TRACK_SETS; idx++) {
+    // seconds without development comments, they depend on the writer
+    randomDataSet(sets[idx], TRACK_START + 60 * idx + 45 + idx % 15);
+    if (idx % 3 == 0) {
+      // measurement positions, a record the converter skips
+      Gps::fillEpochs(sets[idx].gpsEpochs, sets[idx].gpsRecord.getTow(),
+                      rand() % 1800000000 - 900000000, rand() % 2000000000 - 1000000000);
+    }
+  }
+
+  writeTrack(new CSVFileWriter, sets);
+  writeTrack(new BinaryFileWriter, sets);
+  const std::string binary = trackContent(BinaryFileWriter::EXTENSION);
+  TEST_ASSERT_GREATER_THAN(0, binary.size());
+  std::string converted;
+  TEST_ASSERT_TRUE_MESSAGE(convert(binary, converted), "obsbin2csv.py failed");
+
+  const std::vector<std::string> expected = linesOf(trackContent(CSVFileWriter::EXTENSION));
+  const std::vector<std::string> lines = linesOf(converted);
+  TEST_ASSERT_GREATER_THAN(TRACK_SETS / 2, expected.size());
+  for (size_t line = 0; line < expected.size() && line < lines.size(); line++) {
+    const std::string message = "line " + std::to_string(line + 1);
+    TEST_ASSERT_EQUAL_STRING_MESSAGE(expected[line].c_str(), lines[line].c_str(), message.c_str());
+  }
+  TEST_ASSERT_EQUAL(expected.size(), lines.size());
+}
+
+void setUp() {
+  fs::hostCard.clear();
+  hostNvs.clear();
+  config.sensorOffsets.assign(2, 30);
+  srand(13);
+  // written in the foreground, the track is complete when the writer is
+  // deleted
+  hostTaskCreationFails() = true;
+}
+
+void tearDown() {
+  hostTaskCreationFails() = false;
+}
+
+void test_converted_track_without_privacy() {
+  assertSameTrack(NoPrivacy);
+}
+
+void test_converted_track_without_position_in_privacy_areas() {
+  assertSameTrack(NoPosition);
+}
+
+void test_converted_track_with_override_privacy() {
+  assertSameTrack(OverridePrivacy | NoPosition);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_converted_track_without_privacy);
+  RUN_TEST(test_converted_track_without_position_in_privacy_areas);
+  RUN_TEST(test_converted_track_with_override_privacy);
+  return UNITY_END();
+}
@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+/* Parallel triggered HC-SR04 sensors where the later triggered sensor
+ * receives the ping of the other one, see rejectCrossTalk().
+ */
+
+#define OBSCLASSIC 1
+#include "hostglobals.h"
+#include "sensorbench.h"
+
+#include "sensor.cpp"
+#include "echocapture.cpp"
+#include "cadence.cpp"
+#include "utils/soundspeed.cpp"
+
+#include <unity.h>
+
+static const uint8_t RIGHT = 0;
+static const uint8_t LEFT = 1;
+static const uint8_t RIGHT_TRIGGER_PIN = 15;
+static const uint8_t RIGHT_ECHO_PIN = 4;
+static const uint8_t LEFT_TRIGGER_PIN = 25;
+static const uint8_t LEFT_ECHO_PIN = 26;
+static const uint32_t ECHO_DELAY = 250;
+static const uint32_t LEFT_ECHO = 5800; // 100cm, primary sensor
+static const uint32_t RIGHT_ECHO = 17000; // 293cm
+// the ping of the left sensor ends up to this later at the right sensor
+static const uint32_t CROSS_TALK_DELAY = 120;
+
+static HCSR04SensorManager *manager;
+static uint32_t leftEchoEnd;
+static uint32_t rightTriggers;
+// decides per trigger of the right sensor what it receives
+static std::function<void(uint32_t now, std::vector<bench::Edge> &edges)> rightEcho;
+
+static void echoModel(uint8_t pin, uint32_t now, std::vector<bench::Edge> &edges) {
+  if (pin == LEFT_TRIGGER_PIN) {
+    leftEchoEnd = now + ECHO_DELAY + LEFT_ECHO;
+    bench::echo(edges, LEFT_ECHO_PIN, now + ECHO_DELAY, LEFT_ECHO);
+  } else {
+    rightTriggers++;
+    rightEcho(now, edges);
+  }
+}
+
+static void ownEcho(uint32_t now, std::vector<bench::Edge> &edges) {
+  bench::echo(edges, RIGHT_ECHO_PIN, now + ECHO_DELAY, RIGHT_ECHO);
+}
+
+static void crossTalk(uint32_t now, std::vector<bench::Edge> &edges) {
+  bench::echo(edges, RIGHT_ECHO_PIN, now + ECHO_DELAY, leftEchoEnd + CROSS_TALK_DELAY - now - ECHO_DELAY);
+}
+
+void setUp() {
+  bench::reset(echoModel);
+  rightTriggers = 0;
+  manager = new HCSR04SensorManager;
+  HCSR04SensorInfo right;
+  right.triggerPin = RIGHT_TRIGGER_PIN;
+  right.echoPin = RIGHT_ECHO_PIN;
+  right.sensorLocation = (char*) "Right";
+  HCSR04SensorInfo left;
+  left.triggerPin = LEFT_TRIGGER_PIN;
+  left.echoPin = LEFT_ECHO_PIN;
+  left.sensorLocation = (char*) "Left";
+  manager->registerSensor(right, RIGHT);
+  manager->registerSensor(left, LEFT);
+  manager->setPrimarySensor(LEFT);
+  DistanceFilterConfig unfiltered;
+  unfiltered.options = 0;
+  manager->setDistanceFilter(unfiltered);
+  manager->setParallelTrigger(true);
+  manager->startTriggerTimer();
+}
+
+void tearDown() {
+  delete manager;
+}
+
+/* Runs for the given seconds and returns the valid echo durations reported
+ * for the right sensor.
+ */
+static std::vector<int32_t> rightDurations(int seconds) {
+  std::vector<int32_t> durations;
+  for (int i = 0; i < seconds; i++) {
+    manager->reset(millis());
+    bench::run(1000000, 100000, []() { manager->pollDistancesAlternating(); });
+    for (uint16_t idx = 0; idx < manager->lastReadingCount; idx++) {
+      const int32_t duration = manager->m_sensors[RIGHT].echoDurationMicroseconds[idx];
+      if (duration >= (int32_t) MIN_DURATION_MICRO_SEC) {
+        durations.push_back(duration);
+      }
+    }
+  }
+  return durations;
+}
+
+static bool isCrossTalk(int32_t duration) {
+  return duration < (int32_t) LEFT_ECHO;
+}
+
+void test_both_sides_are_measured_without_cross_talk() {
+  rightEcho = ownEcho;
+  const auto durations = rightDurations(3);
+  TEST_ASSERT_GREATER_THAN(30, durations.size());
+  for (const int32_t duration : durations) {
+    TEST_ASSERT_INT_WITHIN(10, RIGHT_ECHO, duration);
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, manager->getNumberOfCrossTalkRejections(RIGHT));
+  TEST_ASSERT_EQUAL_UINT32(0, manager->getNumberOfCrossTalkRejections(LEFT));
+  TEST_ASSERT_INT_WITHIN(1, 100, manager->sensorValues[LEFT]);
+}
+
+void test_interleaved_cross_talk_is_dropped() {
+  // every second ping of the left sensor reaches the right sensor first
+  rightEcho = [](uint32_t now, std::vector<bench::Edge> &edges) {
+    if (rightTriggers % 2) {
+      crossTalk(now, edges);
+    } else {
+      ownEcho(now, edges);
+    }
+  };
+  const auto durations = rightDurations(3);
+  TEST_ASSERT_GREATER_THAN(10, durations.size());
+  for (const int32_t duration : durations) {
+    TEST_ASSERT_FALSE(isCrossTalk(duration));
+  }
+  TEST_ASSERT_GREATER_THAN(10, manager->getNumberOfCrossTalkRejections(RIGHT));
+  TEST_ASSERT_EQUAL_UINT32(0, manager->getNumberOfCrossTalkRejections(LEFT));
+}
+
+void test_dropped_reading_does_not_become_the_track() {
+  // After some real readings only cross-talk with nothing in between,
+  // it repeats with the same trigger offset every 4th cycle.
+  rightEcho = [](uint32_t now, std::vector<bench::Edge> &edges) {
+    if (rightTriggers < 10) {
+      ownEcho(now, edges);
+    } else if (rightTriggers % 4 == 0) {
+      crossTalk(now, edges);
+    }
+  };
+  const auto durations = rightDurations(5);
+  TEST_ASSERT_GREATER_THAN(5, manager->getNumberOfCrossTalkRejections(RIGHT));
+  for (const int32_t duration : durations) {
+    TEST_ASSERT_FALSE(isCrossTalk(duration));
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_both_sides_are_measured_without_cross_talk);
+  RUN_TEST(test_interleaved_cross_talk_is_dropped);
+  RUN_TEST(test_dropped_reading_does_not_become_the_track);
+  return UNITY_END();
+}
@@ -0,0 +1,244 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+/* Compares the CSV lines of CSVFileWriter with a String based formatter
+ * like the one it replaced, for random data sets. Also reports the
+ * records per second of both.
+ */
+
+#define OBSCLASSIC 1
+#include "hostwriter.h"
+#include "hostclock.h"
+
+#include "writer.cpp"
+#include "trackindex.cpp"
+#include "gpsrecord.cpp"
+#include "gpsepochs.cpp"
+#include "utils/gzip.cpp"
+#include "utils/timeutils.cpp"
+#include "utils/soundspeed.cpp"
+#include "hostdatasets.h"
+
+#include <unity.h>
+#include <sstream>
+#include <vector>
+
+/* The line as the former String concatenations formatted it. */
+static String referenceLine(const DataSet &set, const String &comment) {
+  tm time;
+  localtime_r(&set.time, &time);
+  char date[32];
+  snprintf(date, sizeof(date), "%02d.%02d.%04d;%02d:%02d:%02d;%u;",
+           time.tm_mday, time.tm_mon + 1, time.tm_year + 1900,
+           time.tm_hour, time.tm_min, time.tm_sec, set.millis);
+  String csv = date;
+  csv += comment;
+  csv += ";";
+  const bool positionWritten = set.gpsRecord.hasValidFix()
+    && !((config.privacyConfig & NoPosition) && set.isInsidePrivacyArea
+         && !((config.privacyConfig & OverridePrivacy) && set.confirmed));
+  if (!positionWritten) {
+    csv += ";;;;;";
+  } else {
+    csv += set.gpsRecord.getLatString() + ";";
+    csv += set.gpsRecord.getLongString() + ";";
+    csv += set.gpsRecord.getAltitudeMetersString() + ";";
+    csv += set.gpsRecord.getCourseString() + ";";
+    csv += set.gpsRecord.getSpeedKmHString() + ";";
+  }
+  csv += set.gpsRecord.getHdopString() + ";";
+  csv += String(set.gpsRecord.getSatellitesUsed()) + ";";
+  csv += String(set.batteryLevelCenti / 100.0, 2) + ";";
+  if (set.sensorValues[LEFT_SENSOR_ID] < MAX_SENSOR_VALUE) {
+    csv += String(set.sensorValues[LEFT_SENSOR_ID]);
+  }
+  csv += ";";
+  if (set.sensorValues[RIGHT_SENSOR_ID] < MAX_SENSOR_VALUE) {
+    csv += String(set.sensorValues[RIGHT_SENSOR_ID]);
+  }
+  csv += ";";
+  csv += String(set.confirmed) + ";";
+  csv += set.marked + ";";
+  csv += String((int) set.invalidMeasurement) + ";";
+  csv += String((int) set.isInsidePrivacyArea) + ";";
+  if (set.factorCenti % 100 == 0) {
+    csv += String(set.factorCenti / 100) + ";";
+  } else {
+    csv += String(set.factorCenti / 100.0, 2) + ";";
+  }
+  csv += String(set.measurements);
+  for (size_t idx = 0; idx < set.measurements; ++idx) {
+    csv += ";" + String(set.startOffsetMilliseconds[idx]) + ";";
+    if (set.readDurationsLeftInMicroseconds[idx] > 0) {
+      csv += String(set.readDurationsLeftInMicroseconds[idx]);
+    }
+    csv += ";";
+    if (set.readDurationsRightInMicroseconds[idx] > 0) {
+      csv += String(set.readDurationsRightInMicroseconds[idx]);
+    }
+  }
+  for (size_t idx = set.measurements; idx < MAX_NUMBER_MEASUREMENTS_PER_INTERVAL; ++idx) {
+    csv += ";;;";
+  }
+  csv += ";" + String((int) set.cadenceMode);
+  csv += "\n";
+  return csv;
+}
+
+static bool isWritten(const DataSet &set) {
+  return !(set.isInsidePrivacyArea
+           && ((config.privacyConfig & AbsolutePrivacy)
+               || ((config.privacyConfig & OverridePrivacy) && !set.confirmed)));
+}
+
+/* The data lines of the only track on the card. */
+static std::vector<std::string> writtenLines() {
+  std::vector<std::string> lines;
+  for (const auto &file : fs::hostCard.files) {
+    if (file.first.find(CSVFileWriter::EXTENSION.c_str()) == std::string::npos) {
+      continue;
+    }
+    std::stringstream content(file.second->content);
+    std::string line;
+    for (int header = 0; header < 2 && std::getline(content, line); header++) {
+    }
+    while (std::getline(content, line)) {
+      lines.push_back(line + "\n");
+    }
+  }
+  return lines;
+}
+
+static std::string commentOf(const std::string &line) {
+  size_t start = 0;
+  for (int field = 0; field < 3; field++) {
+    start = line.find(';', start) + 1;
+  }
+  return line.substr(start, line.find(';', start) - start);
+}
+
+void setUp() {
+  fs::hostCard.clear();
+  hostNvs.clear();
+  config.sensorOffsets.assign(2, 30);
+  srand(42);
+}
+
+void tearDown() {
+}
+
+static void assertSameLines(int privacyConfig) {
+  config.privacyConfig = privacyConfig;
+  fs::hostCard.clear();
+  std::vector<DataSet> sets(500);
+  auto *writer = new CSVFileWriter;
+  writer->setFileName();
+  writer->writeHeader("test-track");
+  time_t time = 1760000000 + rand() % 100000;
+  for (DataSet &set : sets) {
+    randomDataSet(set, time++);
+    writer->append(set);
+    writer->flush();
+  }
+  delete writer;
+
+  const std::vector<std::string> lines = writtenLines();
+  size_t line = 0;
+  for (const DataSet &set : sets) {
+    if (!isWritten(set)) {
+      continue;
+    }
+    TEST_ASSERT_LESS_THAN(lines.size(), line);
+    const String comment(commentOf(lines[line]));
+    TEST_ASSERT_TRUE(comment.startsWith(set.comment));
+    const String expected = referenceLine(set, comment);
+    TEST_ASSERT_EQUAL_STRING(expected.c_str(), lines[line].c_str());
+    line++;
+  }
+  TEST_ASSERT_EQUAL(lines.size(), line);
+}
+
+void test_lines_without_privacy() {
+  assertSameLines(NoPrivacy);
+}
+
+void test_lines_without_position_in_privacy_areas() {
+  assertSameLines(NoPosition);
+}
+
+void test_lines_with_absolute_privacy() {
+  assertSameLines(AbsolutePrivacy);
+}
+
+void test_lines_with_override_privacy() {
+  assertSameLines(OverridePrivacy | NoPosition);
+}
+
+void test_records_per_second() {
+  config.privacyConfig = NoPrivacy;
+  std::vector<DataSet> sets(1000);
+  time_t time = 1760000001;
+  for (DataSet &set : sets) {
+    randomDataSet(set, time++);
+    set.comment.clear();
+  }
+  const int rounds = 20;
+
+  auto *writer = new CSVFileWriter;
+  writer->setFileName();
+  writer->writeHeader("test-track");
+  auto start = std::chrono::steady_clock::now();
+  for (int round = 0; round < rounds; round++) {
+    for (DataSet &set : sets) {
+      writer->append(set);
+      writer->flush();
+    }
+  }
+  const double writerSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  delete writer;
+
+  size_t length = 0;
+  start = std::chrono::steady_clock::now();
+  for (int round = 0; round < rounds; round++) {
+    for (DataSet &set : sets) {
+      length += referenceLine(set, set.comment).length();
+    }
+  }
+  const double referenceSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  char message[160];
+  snprintf(message, sizeof(message),
+           "CSVFileWriter::append() %.0f records/s, String concatenation %.0f records/s (%u bytes)",
+           rounds * sets.size() / writerSeconds, rounds * sets.size() / referenceSeconds, (unsigned) length);
+  TEST_MESSAGE(message);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_lines_without_privacy);
+  RUN_TEST(test_lines_without_position_in_privacy_areas);
+  RUN_TEST(test_lines_with_absolute_privacy);
+  RUN_TEST(test_lines_with_override_privacy);
+  RUN_TEST(test_records_per_second);
+  return UNITY_END();
+}
@@ -0,0 +1,278 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+/* The data sets of loop() come from an ObjectPool and are reused each
+ * second. Covers the pool, the confirmations per set, the heap watermark
+ * of the DEV comments and that appending a reused set to the writer
+ * buffer does not allocate once the track runs.
+ */
+
+#define OBSCLASSIC 1
+#include "hostwriter.h"
+#include "hostclock.h"
+
+#include "writer.cpp"
+#include "trackindex.cpp"
+#include "gpsrecord.cpp"
+#include "gpsepochs.cpp"
+#include "utils/gzip.cpp"
+#include "utils/timeutils.cpp"
+#include "utils/soundspeed.cpp"
+#include "utils/objectpool.h"
+#include "hostdatasets.h"
+
+#include <unity.h>
+#include <cstdlib>
+#include <new>
+
+// heap allocations are counted while counting is set
+static bool counting = false;
+static size_t allocations = 0;
+
+void *operator new(size_t size) {
+  if (counting) {
+    allocations++;
+  }
+  void *memory = malloc(size ? size : 1);
+  if (!memory) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void *operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void *memory) noexcept {
+  free(memory);
+}
+
+void operator delete[](void *memory) noexcept {
+  free(memory);
+}
+
+static const time_t TRACK_START = 1760000000 - 1760000000 % 60;
+
+/* Exposes the fill level to tell appends that handed a buffer over. */
+template<class Writer> class PoolTestWriter : public Writer {
+  public:
+    using FileWriter::getBufferLength;
+};
+
+static std::string trackContent() {
+  for (const auto &file : fs::hostCard.files) {
+    if (CSVFileWriter::isTrackFile(String(file.first))
+        || String(file.first).endsWith(BinaryFileWriter::EXTENSION)) {
+      return file.second->content;
+    }
+  }
+  return "";
+}
+
+/* Appends sets of the pool like loop(), returns the allocations of the
+ * appends that did not hand a buffer over to the SD card.
+ */
+template<class Writer> static size_t appendAllocations(const char *name) {
+  srand(15);
+  ObjectPool<DataSet, 10> pool;
+  auto *writer = new PoolTestWriter<Writer>;
+  writer->setFileName();
+  writer->writeHeader("dataset-pool");
+  const int warmUpSets = 600;
+  const int countedSets = 1200;
+  size_t appendAllocations = 0;
+  size_t handOverAllocations = 0;
+  int handOvers = 0;
+  for (int idx = 0; idx < warmUpSets + countedSets; idx++) {
+    if (idx == warmUpSets) {
+      // the fake card grows its files, the real one does not
+      for (const auto &file : fs::hostCard.files) {
+        file.second->content.reserve(4 << 20);
+      }
+    }
+    DataSet *set = pool.acquire();
+    randomDataSet(*set, TRACK_START + idx);
+    // the firmware never sets a comment
+    set->comment.clear();
+    const uint16_t before = writer->getBufferLength();
+    allocations = 0;
+    counting = idx >= warmUpSets;
+    writer->append(*set);
+    counting = false;
+    if (writer->getBufferLength() > before) {
+      appendAllocations += allocations;
+    } else {
+      handOvers++;
+      handOverAllocations += allocations;
+    }
+    pool.release(set);
+  }
+  TEST_PRINTF("%s: %u allocations in %d appends, %u in %d hand overs",
+              name, (unsigned) appendAllocations, countedSets - handOvers,
+              (unsigned) handOverAllocations, handOvers);
+  TEST_ASSERT_GREATER_THAN(0, handOvers);
+  TEST_ASSERT_EQUAL(10, pool.available());
+  delete writer;
+  return appendAllocations;
+}
+
+void setUp() {
+  hostTaskCreationFails() = true;
+  hostNvs.clear();
+  fs::hostCard.clear();
+  config.sensorOffsets.assign(2, 30);
+  config.privacyConfig = NoPrivacy;
+}
+
+void tearDown() {
+  hostTaskCreationFails() = false;
+  ESP.minFreeHeap = 90000;
+}
+
+void test_pool_hands_out_each_set_once() {
+  ObjectPool<DataSet, 4> pool;
+  DataSet *sets[4];
+  for (int idx = 0; idx < 4; idx++) {
+    sets[idx] = pool.acquire();
+    TEST_ASSERT_NOT_NULL(sets[idx]);
+    for (int other = 0; other < idx; other++) {
+      TEST_ASSERT_TRUE(sets[idx] != sets[other]);
+    }
+  }
+  TEST_ASSERT_EQUAL(0, pool.available());
+  TEST_ASSERT_NULL(pool.acquire());
+
+  pool.release(sets[2]);
+  TEST_ASSERT_EQUAL(1, pool.available());
+  TEST_ASSERT_TRUE(pool.acquire() == sets[2]);
+  TEST_ASSERT_NULL(pool.acquire());
+}
+
+void test_pool_ignores_invalid_releases() {
+  ObjectPool<DataSet, 2> pool;
+  DataSet other;
+  pool.release(nullptr);
+  TEST_ASSERT_EQUAL(2, pool.available());
+  // releasing more than the pool holds must not overflow it
+  pool.release(&other);
+  TEST_ASSERT_EQUAL(2, pool.available());
+
+  DataSet *set = pool.acquire();
+  pool.release(nullptr);
+  TEST_ASSERT_EQUAL(1, pool.available());
+  pool.release(set);
+  TEST_ASSERT_EQUAL(2, pool.available());
+}
+
+void test_confirmations_are_limited_per_set() {
+  DataSet set;
+  set.reset();
+  for (uint16_t idx = 0; idx < MAX_CONFIRMATIONS_PER_SET; idx++) {
+    TEST_ASSERT_TRUE(set.addConfirmation(100 + idx, idx));
+  }
+  TEST_ASSERT_FALSE(set.addConfirmation(42, 42));
+  TEST_ASSERT_EQUAL(MAX_CONFIRMATIONS_PER_SET, set.confirmedCount);
+  for (uint16_t idx = 0; idx < MAX_CONFIRMATIONS_PER_SET; idx++) {
+    TEST_ASSERT_EQUAL(100 + idx, set.confirmedDistances[idx]);
+    TEST_ASSERT_EQUAL(idx, set.confirmedDistancesIndex[idx]);
+  }
+}
+
+void test_reset_prepares_a_reused_set() {
+  DataSet set;
+  randomDataSet(set, TRACK_START);
+  set.comment = "Hello World";
+  set.marked = "OVERTAKING";
+  set.confirmed = 1;
+  set.addConfirmation(100, 1);
+  set.invalidMeasurement = true;
+  set.isInsidePrivacyArea = true;
+  set.factorCenti = 5900;
+  set.cadenceMode = CadenceTracking;
+  set.measurements = 3;
+  set.position = 2;
+
+  set.reset();
+  TEST_ASSERT_TRUE(set.comment.isEmpty());
+  TEST_ASSERT_TRUE(set.marked.isEmpty());
+  TEST_ASSERT_EQUAL(0, set.confirmed);
+  TEST_ASSERT_EQUAL(0, set.confirmedCount);
+  TEST_ASSERT_FALSE(set.invalidMeasurement);
+  TEST_ASSERT_FALSE(set.isInsidePrivacyArea);
+  TEST_ASSERT_EQUAL(SoundSpeed::DEFAULT_MICRO_SEC_TO_CM_DIVIDER_CENTI, set.factorCenti);
+  TEST_ASSERT_EQUAL(CadenceNormal, set.cadenceMode);
+  TEST_ASSERT_EQUAL(0, set.measurements);
+  TEST_ASSERT_EQUAL(0, set.position);
+  TEST_ASSERT_TRUE(set.addConfirmation(100, 1));
+}
+
+void test_heap_watermark_drops_are_reported() {
+  const uint32_t minFreeHeap[] = {90000, 80000, 80000, 70000};
+  auto *writer = new CSVFileWriter;
+  writer->setFileName();
+  writer->writeHeader("dataset-pool");
+  DataSet set;
+  for (int minute = 0; minute < 4; minute++) {
+    ESP.minFreeHeap = minFreeHeap[minute];
+    randomDataSet(set, TRACK_START + 60 * minute + 2);
+    set.comment.clear();
+    writer->append(set);
+  }
+  writer->flush(true);
+  delete writer;
+
+  const std::string content = trackContent();
+  const char *expected[] = {
+    ";DEV: Mem min free: 87k lowered: 0;",
+    ";DEV: Mem min free: 78k lowered: 1;",
+    ";DEV: Mem min free: 78k lowered: 1;",
+    ";DEV: Mem min free: 68k lowered: 2;",
+  };
+  size_t position = 0;
+  for (const char *comment : expected) {
+    position = content.find(comment, position);
+    TEST_ASSERT_TRUE_MESSAGE(position != std::string::npos, comment);
+    position++;
+  }
+}
+
+void test_csv_append_does_not_allocate() {
+  TEST_ASSERT_EQUAL(0, appendAllocations<CSVFileWriter>("CSV"));
+}
+
+void test_binary_append_does_not_allocate() {
+  TEST_ASSERT_EQUAL(0, appendAllocations<BinaryFileWriter>("binary"));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_pool_hands_out_each_set_once);
+  RUN_TEST(test_pool_ignores_invalid_releases);
+  RUN_TEST(test_confirmations_are_limited_per_set);
+  RUN_TEST(test_reset_prepares_a_reused_set);
+  RUN_TEST(test_heap_watermark_drops_are_reported);
+  RUN_TEST(test_csv_append_does_not_allocate);
+  RUN_TEST(test_binary_append_does_not_allocate);
+  return UNITY_END();
+}
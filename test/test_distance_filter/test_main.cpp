@@ -0,0 +1,254 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+/* The distance filter pipeline, with the default configuration compared
+ * to the former hard wired phantom suppression of the sensor managers.
+ */
+
+#define OBSCLASSIC 1
+#include <Arduino.h>
+#include <vector>
+#include "variant.h"
+#include "utils/distancefilter.h"
+#include "utils/soundspeed.h"
+#include "utils/soundspeed.cpp"
+
+#include <unity.h>
+
+/* HCSR04SensorManager::medianMeasure() before the pipeline. */
+class FormerPhantomSuppression {
+  public:
+    uint16_t apply(uint16_t value) {
+      distances[next++] = value;
+      for (uint16_t &distance : distances) {
+        if (distance < value) {
+          distance = value;
+        }
+      }
+      if (next >= MEDIAN_DISTANCE_MEASURES) {
+        next = 0;
+      }
+      return PhantomSuppressionStage::median(distances[0], distances[1], distances[2]);
+    }
+
+  private:
+    uint16_t distances[MEDIAN_DISTANCE_MEASURES] = { MAX_SENSOR_VALUE, MAX_SENSOR_VALUE, MAX_SENSOR_VALUE };
+    uint8_t next = 0;
+};
+
+/* Converts an echo duration like the HC-SR04 sensor manager does. */
+static uint16_t toDistance(uint32_t duration, uint16_t dividerCenti) {
+  if (duration < MIN_DURATION_MICRO_SEC || duration >= MAX_DURATION_MICRO_SEC) {
+    return MAX_SENSOR_VALUE;
+  }
+  return SoundSpeed::toCentimeter(duration, dividerCenti);
+}
+
+/* Echo durations as in the Lus/Rus columns of a track: the kerb with
+ * noise, overtaking cars, phantom readings and timeouts.
+ */
+static std::vector<uint32_t> echoDurations(unsigned seed, size_t count) {
+  srand(seed);
+  std::vector<uint32_t> durations;
+  uint32_t kerb = 9000;
+  while (durations.size() < count) {
+    const int kind = rand() % 10;
+    if (kind < 5) {
+      kerb += rand() % 201 - 100;
+      kerb = std::max<uint32_t>(3000, std::min<uint32_t>(kerb, 15000));
+      durations.push_back(kerb);
+    } else if (kind < 7) {
+      // overtaking car, gets closer and leaves
+      const uint32_t closest = 3000 + rand() % 6000;
+      for (int i = 0; i < 8; i++) {
+        durations.push_back(closest + abs(4 - i) * 600 + rand() % 60);
+      }
+    } else if (kind < 8) {
+      durations.push_back(300 + rand() % 3000); // phantom
+    } else if (kind < 9) {
+      durations.push_back(MAX_DURATION_MICRO_SEC + rand() % 50000); // timeout
+    } else {
+      durations.push_back(rand() % 100); // too short, noise
+    }
+  }
+  durations.resize(count);
+  return durations;
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_default_matches_the_former_phantom_suppression() {
+  for (unsigned seed = 1; seed <= 20; seed++) {
+    SensorDistanceFilter filter;
+    filter.configure(DistanceFilterConfig());
+    filter.reset();
+    FormerPhantomSuppression former;
+    for (const uint32_t duration : echoDurations(seed, 5000)) {
+      const uint16_t distance = toDistance(duration, SoundSpeed::DEFAULT_MICRO_SEC_TO_CM_DIVIDER_CENTI);
+      TEST_ASSERT_EQUAL_UINT16(former.apply(distance), filter.apply(distance));
+    }
+  }
+}
+
+void test_range_gate_drops_out_of_range() {
+  DistanceFilterConfig config;
+  config.options = FilterRangeGate;
+  config.minDistanceCm = 20;
+  config.maxDistanceCm = 250;
+  SensorDistanceFilter filter;
+  filter.configure(config);
+  TEST_ASSERT_EQUAL_UINT16(MAX_SENSOR_VALUE, filter.apply(19));
+  TEST_ASSERT_EQUAL_UINT16(20, filter.apply(20));
+  TEST_ASSERT_EQUAL_UINT16(250, filter.apply(250));
+  TEST_ASSERT_EQUAL_UINT16(MAX_SENSOR_VALUE, filter.apply(251));
+  config.options = 0;
+  filter.configure(config);
+  TEST_ASSERT_EQUAL_UINT16(251, filter.apply(251));
+}
+
+void test_range_gate_keeps_echoes_that_pass_the_duration_check() {
+  for (int celsius = SoundSpeed::MIN_CELSIUS; celsius <= SoundSpeed::MAX_CELSIUS; celsius++) {
+    const uint16_t divider = SoundSpeed::microSecToCmDividerCenti(celsius);
+    RangeGateStage gate;
+    gate.configure(DistanceFilterConfig());
+    gate.setMicroSecToCmDividerCenti(divider);
+    for (uint32_t duration = MIN_DURATION_MICRO_SEC; duration < MAX_DURATION_MICRO_SEC; duration++) {
+      const uint16_t distance = toDistance(duration, divider);
+      TEST_ASSERT_EQUAL_UINT16(distance, gate.apply(distance));
+    }
+  }
+}
+
+void test_configured_range_stays_in_cm() {
+  DistanceFilterConfig config;
+  config.options = FilterRangeGate;
+  config.minDistanceCm = 20;
+  config.maxDistanceCm = 200;
+  RangeGateStage gate;
+  gate.configure(config);
+  for (int celsius : {-20, 15, 40, 50}) {
+    gate.setMicroSecToCmDividerCenti(SoundSpeed::microSecToCmDividerCenti(celsius));
+    TEST_ASSERT_EQUAL_UINT16(MAX_SENSOR_VALUE, gate.apply(19));
+    TEST_ASSERT_EQUAL_UINT16(20, gate.apply(20));
+    TEST_ASSERT_EQUAL_UINT16(200, gate.apply(200));
+    TEST_ASSERT_EQUAL_UINT16(MAX_SENSOR_VALUE, gate.apply(201));
+  }
+}
+
+void test_default_range_scales_with_the_factor() {
+  DistanceFilterConfig config;
+  config.options = FilterRangeGate;
+  RangeGateStage gate;
+  gate.configure(config);
+  TEST_ASSERT_EQUAL_UINT16(MAX_SENSOR_VALUE, gate.apply(MAX_DISTANCE_MEASURED_CM + 1));
+  // 40C, the longest accepted echo is a few percent further
+  gate.setMicroSecToCmDividerCenti(SoundSpeed::microSecToCmDividerCenti(40));
+  TEST_ASSERT_EQUAL_UINT16(MAX_DISTANCE_MEASURED_CM + 5, gate.apply(MAX_DISTANCE_MEASURED_CM + 5));
+  // kept when configured again
+  gate.configure(config);
+  TEST_ASSERT_EQUAL_UINT16(MAX_DISTANCE_MEASURED_CM + 5, gate.apply(MAX_DISTANCE_MEASURED_CM + 5));
+  gate.setMicroSecToCmDividerCenti(SoundSpeed::DEFAULT_MICRO_SEC_TO_CM_DIVIDER_CENTI);
+  TEST_ASSERT_EQUAL_UINT16(MAX_SENSOR_VALUE, gate.apply(MAX_DISTANCE_MEASURED_CM + 1));
+}
+
+void test_invalid_range_is_not_used() {
+  TEST_ASSERT_TRUE(RangeGateStage::isValidRange(0, MAX_SENSOR_VALUE));
+  TEST_ASSERT_FALSE(RangeGateStage::isValidRange(-1, 200));
+  TEST_ASSERT_FALSE(RangeGateStage::isValidRange(200, 200));
+  TEST_ASSERT_FALSE(RangeGateStage::isValidRange(300, 200));
+  TEST_ASSERT_FALSE(RangeGateStage::isValidRange(20, MAX_SENSOR_VALUE + 1));
+  TEST_ASSERT_FALSE(RangeGateStage::isValidRange(20, 70000));
+  // as stored after a wrapped entry, the gate keeps the sensor's range
+  DistanceFilterConfig config;
+  config.options = FilterRangeGate;
+  config.minDistanceCm = 20;
+  config.maxDistanceCm = (uint16_t) 65536 + 10;
+  RangeGateStage gate;
+  gate.configure(config);
+  gate.setMicroSecToCmDividerCenti(SoundSpeed::microSecToCmDividerCenti(40));
+  TEST_ASSERT_EQUAL_UINT16(300, gate.apply(300));
+  TEST_ASSERT_EQUAL_UINT16(MIN_DISTANCE_MEASURED_CM, gate.apply(MIN_DISTANCE_MEASURED_CM));
+}
+
+void test_median_stage() {
+  DistanceFilterConfig config;
+  config.options = FilterMedian;
+  SensorDistanceFilter filter;
+  filter.configure(config);
+  filter.reset();
+  const uint16_t values[] = { 100, 300, 100, 100, 500, 500, 500 };
+  const uint16_t expected[] = { MAX_SENSOR_VALUE, MAX_SENSOR_VALUE, 300, 100, 100, 300, 500 };
+  for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+    TEST_ASSERT_EQUAL_UINT16(expected[i], filter.apply(values[i]));
+  }
+}
+
+void test_tracker_follows_an_approaching_object() {
+  DistanceFilterConfig config;
+  config.options = FilterTracker;
+  SensorDistanceFilter filter;
+  filter.configure(config);
+  TEST_ASSERT_EQUAL_UINT16(200, filter.apply(200)); // starts a track
+  uint16_t distance = 200;
+  uint16_t filtered = 0;
+  for (int i = 0; i < 20; i++) {
+    distance -= 5;
+    // noise of +-4cm
+    filtered = filter.apply(distance + (i % 2 ? 4 : -4));
+  }
+  TEST_ASSERT_INT_WITHIN(3, distance, filtered);
+  // a jump beyond the gate starts a new track
+  TEST_ASSERT_EQUAL_UINT16(300, filter.apply(300));
+  // no object ends the track
+  TEST_ASSERT_EQUAL_UINT16(MAX_SENSOR_VALUE, filter.apply(MAX_SENSOR_VALUE));
+  TEST_ASSERT_EQUAL_UINT16(120, filter.apply(120));
+}
+
+void test_all_stages_disabled_pass_through() {
+  DistanceFilterConfig config;
+  config.options = 0;
+  SensorDistanceFilter filter;
+  filter.configure(config);
+  for (const uint32_t duration : echoDurations(99, 1000)) {
+    const uint16_t distance = toDistance(duration, SoundSpeed::DEFAULT_MICRO_SEC_TO_CM_DIVIDER_CENTI);
+    TEST_ASSERT_EQUAL_UINT16(distance, filter.apply(distance));
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_default_matches_the_former_phantom_suppression);
+  RUN_TEST(test_range_gate_drops_out_of_range);
+  RUN_TEST(test_range_gate_keeps_echoes_that_pass_the_duration_check);
+  RUN_TEST(test_configured_range_stays_in_cm);
+  RUN_TEST(test_default_range_scales_with_the_factor);
+  RUN_TEST(test_invalid_range_is_not_used);
+  RUN_TEST(test_median_stage);
+  RUN_TEST(test_tracker_follows_an_approaching_object);
+  RUN_TEST(test_all_stages_disabled_pass_through);
+  return UNITY_END();
+}
@@ -0,0 +1,224 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+/* SpscRing on its own and the replay of recorded echo edges through the
+ * HC-SR04 sensor manager.
+ */
+
+#include <thread>
+#include "utils/spscring.h"
+
+#define OBSCLASSIC 1
+#include "hostglobals.h"
+#include "sensorbench.h"
+
+#include "sensor.cpp"
+#include "echocapture.cpp"
+#include "cadence.cpp"
+#include "utils/soundspeed.cpp"
+
+#include <unity.h>
+
+static const uint8_t RIGHT = 0;
+static const uint8_t LEFT = 1;
+static const uint8_t RIGHT_TRIGGER_PIN = 15;
+static const uint8_t RIGHT_ECHO_PIN = 4;
+static const uint8_t LEFT_TRIGGER_PIN = 25;
+static const uint8_t LEFT_ECHO_PIN = 26;
+// from the end of the trigger pulse to the start of the echo
+static const uint32_t ECHO_DELAY = 250;
+static const uint32_t RIGHT_ECHO = 5800; // 100cm
+static const uint32_t LEFT_ECHO = 17000; // 293cm
+
+static HCSR04SensorManager *manager;
+
+void setUp() {
+  bench::reset(nullptr);
+  manager = new HCSR04SensorManager;
+  HCSR04SensorInfo right;
+  right.triggerPin = RIGHT_TRIGGER_PIN;
+  right.echoPin = RIGHT_ECHO_PIN;
+  right.sensorLocation = (char*) "Right";
+  HCSR04SensorInfo left;
+  left.triggerPin = LEFT_TRIGGER_PIN;
+  left.echoPin = LEFT_ECHO_PIN;
+  left.sensorLocation = (char*) "Left";
+  manager->registerSensor(right, RIGHT);
+  manager->registerSensor(left, LEFT);
+  manager->setPrimarySensor(LEFT);
+}
+
+void tearDown() {
+  delete manager;
+}
+
+static void runSeconds(int seconds) {
+  for (int i = 0; i < seconds; i++) {
+    manager->reset(millis());
+    bench::run(1000000, 150000, []() { manager->pollDistancesAlternating(); });
+  }
+}
+
+void test_ring_keeps_order_and_drops_when_full() {
+  SpscRing<EchoEdge, 4> ring;
+  EchoEdge edge;
+  TEST_ASSERT_TRUE(ring.isEmpty());
+  TEST_ASSERT_FALSE(ring.peek(edge));
+  for (uint32_t i = 0; i < 4; i++) {
+    TEST_ASSERT_TRUE(ring.push({i, HIGH}));
+  }
+  TEST_ASSERT_FALSE(ring.push({4, HIGH}));
+  TEST_ASSERT_EQUAL_UINT8(4, ring.size());
+  TEST_ASSERT_TRUE(ring.peek(edge));
+  TEST_ASSERT_EQUAL_UINT32(0, edge.micros);
+  for (uint32_t i = 0; i < 4; i++) {
+    TEST_ASSERT_TRUE(ring.pop(edge));
+    TEST_ASSERT_EQUAL_UINT32(i, edge.micros);
+  }
+  TEST_ASSERT_FALSE(ring.pop(edge));
+  ring.push({5, LOW});
+  ring.clear();
+  TEST_ASSERT_TRUE(ring.isEmpty());
+}
+
+void test_ring_positions_wrap() {
+  SpscRing<EchoEdge, 16> ring;
+  EchoEdge edge;
+  for (uint32_t i = 0; i < 1000; i++) {
+    TEST_ASSERT_TRUE(ring.push({i, (uint8_t) (i & 1)}));
+    TEST_ASSERT_TRUE(ring.push({i + 1000000, LOW}));
+    TEST_ASSERT_TRUE(ring.pop(edge));
+    TEST_ASSERT_EQUAL_UINT32(i, edge.micros);
+    TEST_ASSERT_TRUE(ring.pop(edge));
+    TEST_ASSERT_EQUAL_UINT32(i + 1000000, edge.micros);
+  }
+  TEST_ASSERT_TRUE(ring.isEmpty());
+}
+
+void test_ring_producer_thread() {
+  static SpscRing<EchoEdge, 16> ring;
+  static const uint32_t COUNT = 200000;
+  std::thread producer([]() {
+    for (uint32_t i = 0; i < COUNT;) {
+      if (ring.push({i, (uint8_t) (i & 1)})) {
+        i++;
+      }
+    }
+  });
+  EchoEdge edge;
+  uint32_t expected = 0;
+  while (expected < COUNT) {
+    if (ring.pop(edge)) {
+      TEST_ASSERT_EQUAL_UINT32(expected, edge.micros);
+      TEST_ASSERT_EQUAL_UINT8(expected & 1, edge.level);
+      expected++;
+    }
+  }
+  producer.join();
+  TEST_ASSERT_TRUE(ring.isEmpty());
+}
+
+void test_noise_after_the_echo_is_ignored() {
+  bench::echoModel = [](uint8_t pin, uint32_t now, std::vector<bench::Edge> &edges) {
+    const uint8_t echoPin = pin == RIGHT_TRIGGER_PIN ? RIGHT_ECHO_PIN : LEFT_ECHO_PIN;
+    const uint32_t duration = pin == RIGHT_TRIGGER_PIN ? RIGHT_ECHO : LEFT_ECHO;
+    const uint32_t start = now + ECHO_DELAY;
+    bench::echo(edges, echoPin, start, duration);
+    // ringing, more edges than the ring holds
+    for (uint32_t i = 0; i < 12; i++) {
+      bench::echo(edges, echoPin, start + duration + 100 + 40 * i, 20);
+    }
+  };
+  manager->startTriggerTimer();
+  runSeconds(3);
+  TEST_ASSERT_INT_WITHIN(1, 100, manager->sensorValues[RIGHT]);
+  TEST_ASSERT_INT_WITHIN(1, 293, manager->sensorValues[LEFT]);
+  TEST_ASSERT_GREATER_THAN(0, manager->getNumberOfLostEdges(RIGHT));
+}
+
+void test_edges_of_both_sensors_at_the_same_time() {
+  // both echoes start in the same micro second
+  bench::echoModel = [](uint8_t pin, uint32_t now, std::vector<bench::Edge> &edges) {
+    if (pin == RIGHT_TRIGGER_PIN) {
+      bench::echo(edges, LEFT_ECHO_PIN, now + ECHO_DELAY, LEFT_ECHO);
+      bench::echo(edges, RIGHT_ECHO_PIN, now + ECHO_DELAY, RIGHT_ECHO);
+    }
+  };
+  manager->setParallelTrigger(true);
+  manager->startTriggerTimer();
+  runSeconds(3);
+  TEST_ASSERT_INT_WITHIN(1, 100, manager->sensorValues[RIGHT]);
+  TEST_ASSERT_INT_WITHIN(1, 293, manager->sensorValues[LEFT]);
+  TEST_ASSERT_EQUAL_UINT32(0, manager->getNumberOfLostEdges(RIGHT));
+  TEST_ASSERT_EQUAL_UINT32(0, manager->getNumberOfLostEdges(LEFT));
+  TEST_ASSERT_EQUAL_UINT32(0, manager->getNumberOfInterruptAdjustments(RIGHT));
+}
+
+void test_lost_simultaneous_interrupt_takes_the_delay_of_the_other_sensor() {
+  // the rising edge interrupt of the right sensor is never delivered
+  bench::echoModel = [](uint8_t pin, uint32_t now, std::vector<bench::Edge> &edges) {
+    if (pin == RIGHT_TRIGGER_PIN) {
+      edges.push_back({now + ECHO_DELAY, RIGHT_ECHO_PIN, HIGH, true});
+      edges.push_back({now + ECHO_DELAY + RIGHT_ECHO, RIGHT_ECHO_PIN, LOW, false});
+    } else {
+      bench::echo(edges, LEFT_ECHO_PIN, now + ECHO_DELAY, LEFT_ECHO);
+    }
+  };
+  manager->setParallelTrigger(true);
+  manager->startTriggerTimer();
+  runSeconds(3);
+  TEST_ASSERT_INT_WITHIN(1, 100, manager->sensorValues[RIGHT]);
+  TEST_ASSERT_INT_WITHIN(1, 293, manager->sensorValues[LEFT]);
+  TEST_ASSERT_GREATER_THAN(40, manager->getNumberOfInterruptAdjustments(RIGHT));
+  TEST_ASSERT_EQUAL_UINT32(0, manager->getNumberOfInterruptAdjustments(LEFT));
+}
+
+void test_late_collection_keeps_the_edges_of_the_next_measurement() {
+  bench::echoModel = [](uint8_t pin, uint32_t now, std::vector<bench::Edge> &edges) {
+    if (pin == RIGHT_TRIGGER_PIN) {
+      bench::echo(edges, RIGHT_ECHO_PIN, now + ECHO_DELAY, RIGHT_ECHO);
+    } else {
+      bench::echo(edges, LEFT_ECHO_PIN, now + ECHO_DELAY, LEFT_ECHO);
+    }
+  };
+  // polling, the main loop comes along every 45ms only
+  for (int i = 0; i < 3; i++) {
+    manager->reset(millis());
+    bench::run(1000000, 45000, []() { manager->pollDistancesAlternating(); });
+  }
+  TEST_ASSERT_INT_WITHIN(1, 100, manager->sensorValues[RIGHT]);
+  TEST_ASSERT_INT_WITHIN(1, 293, manager->sensorValues[LEFT]);
+  TEST_ASSERT_EQUAL_UINT32(0, manager->getNumberOfLostEdges(LEFT));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_ring_keeps_order_and_drops_when_full);
+  RUN_TEST(test_ring_positions_wrap);
+  RUN_TEST(test_ring_producer_thread);
+  RUN_TEST(test_noise_after_the_echo_is_ignored);
+  RUN_TEST(test_edges_of_both_sensors_at_the_same_time);
+  RUN_TEST(test_lost_simultaneous_interrupt_takes_the_delay_of_the_other_sensor);
+  RUN_TEST(test_late_collection_keeps_the_edges_of_the_next_measurement);
+  return UNITY_END();
+}
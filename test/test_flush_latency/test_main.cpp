@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+/* Time the SD card takes per flush, with the latency model of the card in
+ * FS.h. The track file kept open and written in chunks by FileWriter is
+ * compared with the former FileUtil::appendFile() per flush, which opened
+ * and closed the file each time. The clock advances a second per record
+ * and while the card is busy.
+ */
+
+#define OBSCLASSIC 1
+#include "hostwriter.h"
+
+#include "writer.cpp"
+#include "trackindex.cpp"
+#include "gpsrecord.cpp"
+#include "gpsepochs.cpp"
+#include "utils/file.cpp"
+#include "utils/gzip.cpp"
+#include "utils/timeutils.cpp"
+#include "utils/soundspeed.cpp"
+#include "hostdatasets.h"
+
+#include <unity.h>
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+static unsigned long rideMicros;
+unsigned long micros() { return rideMicros + fs::hostCard.busyMicros; }
+unsigned long millis() { return micros() / 1000; }
+void delay(uint32_t ms) { rideMicros += ms * 1000; }
+
+static const time_t TRACK_START = 1760000000 - 1760000000 % 60;
+// one hour, a confirmed overtake every minute
+static const int TRACK_SETS = 3600;
+static const int SETS_PER_OVERTAKE = 60;
+// tracks of the month so far, in the directory of the new one
+static const int EARLIER_TRACKS = 40;
+// the former FileWriter handed its buffer over at this size
+static const unsigned int FORMER_BUFFER_FLUSH_SIZE = 10000;
+
+/* Typical for an SD card in SPI mode, in microseconds. */
+static void slowCard() {
+  fs::hostCard.clear();
+  const String directory = TrackIndex::directoryFor(TRACK_START);
+  TrackIndex::createDirectories(directory + "/");
+  for (int track = 0; track < EARLIER_TRACKS; track++) {
+    fs::hostCard.files[(directory + "/earlier" + String(track) + CSVFileWriter::EXTENSION).str()] =
+      std::make_shared<fs::HostFileData>();
+  }
+  rideMicros = 0;
+  fs::hostCard.latency.open = 1500;
+  fs::hostCard.latency.sectorRead = 500;
+  fs::hostCard.latency.sectorWrite = 1000;
+  fs::hostCard.latency.sync = 2500;
+}
+
+static bool isOvertake(int idx) {
+  return idx % SETS_PER_OVERTAKE == SETS_PER_OVERTAKE - 1;
+}
+
+struct FlushTimes {
+  std::vector<unsigned long> micros;
+
+  void add(unsigned long busy) {
+    if (busy > 0) {
+      micros.push_back(busy);
+    }
+  }
+
+  unsigned long total() const {
+    unsigned long sum = 0;
+    for (unsigned long time : micros) {
+      sum += time;
+    }
+    return sum;
+  }
+
+  unsigned long percentile(int percent) const {
+    std::vector<unsigned long> sorted(micros);
+    std::sort(sorted.begin(), sorted.end());
+    return sorted[(sorted.size() - 1) * percent / 100];
+  }
+
+  void report(const char *name) const {
+    TEST_PRINTF("%s: %u flushes, mean %.1fms, p50 %.1fms, p90 %.1fms, max %.1fms, card busy %.1fs",
+                name, (unsigned) micros.size(), total() / 1000.0 / micros.size(),
+                percentile(50) / 1000.0, percentile(90) / 1000.0, percentile(100) / 1000.0,
+                total() / 1000000.0);
+  }
+};
+
+/* The track as written by FileWriter, synced with each confirmed overtake. */
+static FlushTimes writeTrack(std::string &content) {
+  srand(5);
+  DataSet set;
+  FlushTimes times;
+  // written in the foreground, flush() returns when the card is done
+  hostTaskCreationFails() = true;
+  auto *writer = new CSVFileWriter;
+  writer->setFileName();
+  unsigned long busy = fs::hostCard.busyMicros;
+  writer->writeHeader("flush-latency");
+  for (int idx = 0; idx < TRACK_SETS; idx++) {
+    rideMicros += 1000000;
+    randomDataSet(set, TRACK_START + idx);
+    writer->append(set);
+    if (isOvertake(idx)) {
+      writer->flush(true);
+    }
+    times.add(fs::hostCard.busyMicros - busy);
+    busy = fs::hostCard.busyMicros;
+  }
+  TEST_MESSAGE(("Writer times: " + writer->getWriteTimeHistogram()).c_str());
+  delete writer;
+  hostTaskCreationFails() = false;
+  for (const auto &file : fs::hostCard.files) {
+    if (CSVFileWriter::isTrackFile(String(file.first))) {
+      content = file.second->content;
+    }
+  }
+  return times;
+}
+
+static std::vector<std::string> linesOf(const std::string &content) {
+  std::vector<std::string> lines;
+  std::stringstream stream(content);
+  std::string line;
+  while (std::getline(stream, line)) {
+    lines.push_back(line + "\n");
+  }
+  return lines;
+}
+
+/* The same lines appended per flush as before the file was kept open. */
+static FlushTimes appendFormerly(const std::vector<std::string> &lines) {
+  FlushTimes times;
+  const size_t header = lines.size() - TRACK_SETS;
+  const String fileName = TrackIndex::directoryFor(TRACK_START) + "/sensorData-former" + CSVFileWriter::EXTENSION;
+  String buffer;
+  for (size_t line = 0; line < lines.size(); line++) {
+    buffer += lines[line].c_str();
+    const int idx = (int) line - (int) header;
+    if (buffer.length() > FORMER_BUFFER_FLUSH_SIZE || (idx >= 0 && isOvertake(idx))) {
+      const unsigned long busy = fs::hostCard.busyMicros;
+      TEST_ASSERT_TRUE(FileUtil::appendFile(SD, fileName.c_str(), buffer.c_str()));
+      times.add(fs::hostCard.busyMicros - busy);
+      buffer = "";
+    }
+  }
+  return times;
+}
+
+void setUp() {
+  fs::hostCard.clear();
+  config.sensorOffsets.assign(2, 30);
+  config.privacyConfig = NoPrivacy;
+}
+
+void tearDown() {
+}
+
+void test_card_model_charges_partial_sectors() {
+  slowCard();
+  File file = SD.open("/model.txt", FILE_APPEND);
+  const std::string data(fs::HOST_SECTOR_SIZE * 2 + 100, 'x');
+  const unsigned long opened = fs::hostCard.busyMicros;
+  TEST_ASSERT_EQUAL(1500, opened);
+  // two whole sectors, the rest stays buffered
+  file.write(reinterpret_cast<const uint8_t *>(data.data()), data.size());
+  TEST_ASSERT_EQUAL(opened + 2000, fs::hostCard.busyMicros);
+  file.close();
+  TEST_ASSERT_EQUAL(opened + 2000 + 1000 + 2500, fs::hostCard.busyMicros);
+  // appending to the partial sector reads it again
+  file = SD.open("/model.txt", FILE_APPEND);
+  const unsigned long reopened = fs::hostCard.busyMicros;
+  file.write(reinterpret_cast<const uint8_t *>(data.data()), 10);
+  TEST_ASSERT_EQUAL(reopened + 500, fs::hostCard.busyMicros);
+  file.close();
+}
+
+void test_open_track_file_takes_less_card_time() {
+  slowCard();
+  std::string content;
+  const FlushTimes kept = writeTrack(content);
+  const std::vector<std::string> lines = linesOf(content);
+  TEST_ASSERT_GREATER_THAN(TRACK_SETS, lines.size());
+
+  slowCard();
+  const FlushTimes former = appendFormerly(lines);
+  const std::string formerContent = fs::hostCard.read(
+    (TrackIndex::directoryFor(TRACK_START) + "/sensorData-former" + CSVFileWriter::EXTENSION).str());
+  TEST_ASSERT_EQUAL_STRING(content.c_str(), formerContent.c_str());
+
+  former.report("open and close per flush");
+  kept.report("file kept open");
+  TEST_ASSERT_LESS_THAN(former.total(), kept.total());
+  TEST_ASSERT_LESS_THAN(former.percentile(50), kept.percentile(50));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_card_model_charges_partial_sectors);
+  RUN_TEST(test_open_track_file_takes_less_card_time);
+  return UNITY_END();
+}
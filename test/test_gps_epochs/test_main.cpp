@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+/* Moving the tracks of older firmware to the monthly directories. */
+/* Positions between the navigation epochs, for synthetic trajectories
+ * that run through the UBX parser at different navigation rates.
+ */
+
+#define OBSCLASSIC 1
+#define GPS_NAV_RATE_HZ 10
+#include "hostgps.h"
+#include "hostclock.h"
+
+#include "gps.cpp"
+#include "gpsrecord.cpp"
+#include "gpsepochs.cpp"
+#include "privacyareaindex.cpp"
+#include "utils/timeutils.cpp"
+
+#include <unity.h>
+
+#include <functional>
+
+static const uint32_t FIRST_TOW = 300000;
+static const double ORIGIN_LATITUDE = 48.7766;
+static const double ORIGIN_LONGITUDE = 9.1822;
+static const double METERS_PER_LATITUDE = 111319.49;
+static const int SECONDS = 4;
+
+/* Meters east and north and the velocity in m/s at the given second. */
+struct Motion {
+  double east, north, velocityEast, velocityNorth;
+};
+typedef std::function<Motion(double)> Trajectory;
+
+static const Trajectory LINE = [](double t) {
+  // 8 m/s to the north-east
+  const double course = 30.0 * M_PI / 180.0;
+  return Motion {8.0 * t * sin(course), 8.0 * t * cos(course), 8.0 * sin(course), 8.0 * cos(course)};
+};
+
+static const Trajectory CIRCLE = [](double t) {
+  // 15m radius at 20 km/h
+  const double radius = 15.0, speed = 20.0 / 3.6, angle = speed / radius * t;
+  return Motion {radius * sin(angle), radius * (1 - cos(angle)), speed * cos(angle), speed * sin(angle)};
+};
+
+static double metersPerLongitude() {
+  return METERS_PER_LATITUDE * cos(ORIGIN_LATITUDE * M_PI / 180.0);
+}
+
+static int32_t toLatitude(const Motion &motion) {
+  return lround((ORIGIN_LATITUDE + motion.north / METERS_PER_LATITUDE) * 1e7);
+}
+
+static int32_t toLongitude(const Motion &motion) {
+  return lround((ORIGIN_LONGITUDE + motion.east / metersPerLongitude()) * 1e7);
+}
+
+static double distance(const Motion &motion, int32_t latitude, int32_t longitude) {
+  const double north = (latitude - toLatitude(motion)) * 1e-7 * METERS_PER_LATITUDE;
+  const double east = (longitude - toLongitude(motion)) * 1e-7 * metersPerLongitude();
+  return sqrt(north * north + east * east);
+}
+
+static std::vector<uint8_t> navPvt(uint32_t tow, const Motion &motion) {
+  std::vector<uint8_t> pvt(92);
+  putU32(pvt, 0, tow);
+  pvt[11] = 0x07;
+  pvt[20] = 3;
+  pvt[21] = 0x01;
+  pvt[23] = 9;
+  putU32(pvt, 24, toLongitude(motion));
+  putU32(pvt, 28, toLatitude(motion));
+  const double speed = sqrt(motion.velocityEast * motion.velocityEast
+                            + motion.velocityNorth * motion.velocityNorth);
+  double course = atan2(motion.velocityEast, motion.velocityNorth) * 180.0 / M_PI;
+  if (course < 0) {
+    course += 360.0;
+  }
+  putU32(pvt, 60, lround(speed * 1000.0));
+  putU32(pvt, 64, lround(course * 1e5));
+  putU16(pvt, 76, 120);
+  return ubxFrame(0x0701, pvt);
+}
+
+/* Largest distance in m of the interpolated positions of each second
+ * from the trajectory, or of the whole second position with
+ * interpolate false.
+ */
+static double maxError(const Trajectory &trajectory, uint8_t rateHz, bool interpolate = true) {
+  Gps gps;
+  GpsTest::setNavigationRateHz(gps, rateHz);
+  double error = 0;
+  for (int second = 0; second <= SECONDS; second++) {
+    for (int epoch = 0; epoch < rateHz; epoch++) {
+      const uint32_t millis = 1000 * second + epoch * 1000 / rateHz;
+      GpsTest::encode(gps, navPvt(FIRST_TOW + millis, trajectory(millis / 1000.0)));
+      if (epoch != 0 || second == 0) {
+        continue;
+      }
+      // the second before is complete
+      const GpsEpochs epochs = gps.getCurrentGpsEpochs();
+      TEST_ASSERT_EQUAL(FIRST_TOW + 1000 * (second - 1), epochs.getTow());
+      TEST_ASSERT_EQUAL(rateHz, epochs.getCount());
+      const GpsRecord record = gps.getCurrentGpsRecord();
+      for (int32_t offset = 0; offset < 1000; offset += 10) {
+        const Motion expected = trajectory(second - 1 + offset / 1000.0);
+        int32_t latitude, longitude;
+        if (interpolate) {
+          TEST_ASSERT_TRUE(epochs.positionAt(offset, latitude, longitude));
+        } else {
+          latitude = lround(record.getLatitude() * 1e7);
+          longitude = lround(record.getLongitude() * 1e7);
+        }
+        error = std::max(error, distance(expected, latitude, longitude));
+      }
+    }
+  }
+  return error;
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_line_is_followed_at_every_rate() {
+  for (uint8_t rateHz : {1, 2, 5, 10}) {
+    const double error = maxError(LINE, rateHz);
+    TEST_PRINTF("line at %dHz: max error %.3fm", rateHz, error);
+    // the 1e-7 degree steps are about 1cm
+    TEST_ASSERT_TRUE(error < 0.05);
+  }
+}
+
+void test_circle_is_followed_closer_at_higher_rates() {
+  double previous = 100;
+  for (uint8_t rateHz : {1, 2, 5, 10}) {
+    const double error = maxError(CIRCLE, rateHz);
+    TEST_PRINTF("15m circle at %dHz: max error %.3fm", rateHz, error);
+    TEST_ASSERT_TRUE(error < previous);
+    previous = error;
+  }
+  TEST_ASSERT_TRUE(maxError(CIRCLE, 1) < 1.5);
+  TEST_ASSERT_TRUE(maxError(CIRCLE, 5) < 0.1);
+}
+
+void test_interpolation_beats_one_position_per_second() {
+  const double once = maxError(LINE, 1, false);
+  TEST_PRINTF("line, one position per second: max error %.2fm", once);
+  TEST_ASSERT_TRUE(once > 7.0);
+  TEST_ASSERT_TRUE(maxError(LINE, 1) < once / 100);
+}
+
+void test_solutions_are_limited_to_one_byte() {
+  Gps gps;
+  TEST_ASSERT_EQUAL(240, GpsTest::solutions(gps, 240));
+  TEST_ASSERT_EQUAL(185, GpsTest::solutions(gps, 185));
+  GpsTest::setNavigationRateHz(gps, 2);
+  TEST_ASSERT_EQUAL(118, GpsTest::solutions(gps, 59));
+  TEST_ASSERT_EQUAL(255, GpsTest::solutions(gps, 185));
+  TEST_ASSERT_EQUAL(255, GpsTest::solutions(gps, 240));
+  GpsTest::setNavigationRateHz(gps, 10);
+  TEST_ASSERT_EQUAL(10, GpsTest::solutions(gps, 1));
+  TEST_ASSERT_EQUAL(250, GpsTest::solutions(gps, 25));
+  TEST_ASSERT_EQUAL(255, GpsTest::solutions(gps, 59));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_line_is_followed_at_every_rate);
+  RUN_TEST(test_circle_is_followed_closer_at_higher_rates);
+  RUN_TEST(test_interpolation_beats_one_position_per_second);
+  RUN_TEST(test_solutions_are_limited_to_one_byte);
+  return UNITY_END();
+}
@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+/* Moving the tracks of older firmware to the monthly directories. */
+/* A u-blox 6 style UBX stream arriving at the UART while the reader task
+ * parses it and loop() reads the records.
+ */
+
+#define OBSCLASSIC 1
+#include "hostgps.h"
+#include "hostclock.h"
+
+#include "gps.cpp"
+#include "gpsrecord.cpp"
+#include "gpsepochs.cpp"
+#include "privacyareaindex.cpp"
+#include "utils/timeutils.cpp"
+
+#include <unity.h>
+
+#include <atomic>
+#include <thread>
+
+static const uint32_t FIRST_TOW = 100000;
+static const size_t UART_CHUNK_SIZE = 120;
+
+/* One epoch, the position is derived from the tow so a record mixing two
+ * epochs shows. Every 7th epoch carries some noise and a message with a
+ * broken checksum.
+ */
+static std::vector<uint8_t> epoch(uint32_t tow, bool noise) {
+  std::vector<uint8_t> stream;
+  std::vector<uint8_t> dop(18);
+  putU32(dop, 0, tow);
+  putU16(dop, 12, 120);
+  auto frame = ubxFrame(0x0401, dop);
+  stream.insert(stream.end(), frame.begin(), frame.end());
+
+  std::vector<uint8_t> sol(52);
+  putU32(sol, 0, tow);
+  putU16(sol, 8, 2300);
+  sol[10] = 3;
+  sol[11] = 0x0d;
+  sol[47] = 9;
+  frame = ubxFrame(0x0601, sol);
+  stream.insert(stream.end(), frame.begin(), frame.end());
+  if (noise) {
+    stream.insert(stream.end(), {0x42, 0xb5, 0x13});
+  }
+
+  std::vector<uint8_t> velned(36);
+  putU32(velned, 0, tow);
+  putU32(velned, 20, tow / 1000 % 1000);
+  frame = ubxFrame(0x1201, velned);
+  stream.insert(stream.end(), frame.begin(), frame.end());
+
+  std::vector<uint8_t> posllh(28);
+  putU32(posllh, 0, tow);
+  putU32(posllh, 4, tow / 1000);
+  putU32(posllh, 8, tow / 100);
+  putU32(posllh, 16, 1000);
+  frame = ubxFrame(0x0201, posllh);
+  stream.insert(stream.end(), frame.begin(), frame.end());
+
+  if (noise) {
+    frame = ubxFrame(0x0401, dop);
+    frame.back() ^= 0xff;
+    stream.insert(stream.end(), frame.begin(), frame.end());
+  }
+  return stream;
+}
+
+static Gps *startGps() {
+  // leaked, the reader thread can not be stopped
+  auto gps = new Gps;
+  GpsTest::serial(*gps).setRxBufferSize(GPS_RX_BUFFER_SIZE);
+  TEST_ASSERT_TRUE(GpsTest::startReaderTask(*gps));
+  return gps;
+}
+
+static bool isTorn(const GpsRecord &record) {
+  return record.getTow() != 0
+    && (lround(record.getLongitude() * 1e7) != record.getTow() / 1000
+        || lround(record.getLatitude() * 1e7) != record.getTow() / 100);
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_loop_sees_every_epoch_whole_and_in_order() {
+  const int epochs = 500;
+  Gps * const gps = startGps();
+  std::atomic<bool> done{false};
+  std::thread uart([gps, &done]() {
+    for (int e = 1; e <= epochs; e++) {
+      const auto data = epoch(FIRST_TOW + e * 1000, e % 7 == 0);
+      for (size_t i = 0; i < data.size(); i += UART_CHUNK_SIZE) {
+        GpsTest::serial(*gps).feed(&data[i], std::min(UART_CHUNK_SIZE, data.size() - i));
+      }
+      delay(5);
+    }
+    delay(50);
+    done = true;
+  });
+
+  int sets = 0, torn = 0, backwards = 0;
+  uint32_t lastTow = 0;
+  while (!done) {
+    if (!gps->hasTowTicks()) {
+      continue;
+    }
+    const uint32_t thisLoopTow = gps->getIncomingGpsRecord().getTow();
+    while (gps->currentTowEquals(thisLoopTow) && !done) {
+      if (isTorn(gps->getCurrentGpsRecord())) {
+        torn++;
+      }
+    }
+    if (done) {
+      break;
+    }
+    const GpsRecord record = gps->getCurrentGpsRecord();
+    if (isTorn(record)) {
+      torn++;
+    }
+    if (record.getTow() <= lastTow) {
+      backwards++;
+    }
+    lastTow = record.getTow();
+    sets++;
+  }
+  uart.join();
+  vTaskDelete(GpsTest::readerTask(*gps));
+
+  TEST_PRINTF("%d epochs, loop saw %d, parse latency avg %u ms max %u ms", epochs, sets,
+              gps->getAverageParseLatencyMillis(), gps->getMaxParseLatencyMillis());
+  TEST_ASSERT_EQUAL(0, torn);
+  TEST_ASSERT_EQUAL(0, backwards);
+  // the loop may miss an epoch when the host is busy, but not many
+  TEST_ASSERT_GREATER_THAN(epochs / 2, sets);
+  // the last epoch stays incoming until the next tow arrives
+  TEST_ASSERT_EQUAL(FIRST_TOW + (epochs - 1) * 1000, lastTow);
+  TEST_ASSERT_EQUAL(4 * epochs, gps->getValidMessageCount());
+  TEST_ASSERT_EQUAL(epochs / 7, gps->getMessagesWithFailedCrcCount());
+  TEST_ASSERT_EQUAL(0, gps->getRxOverflowCount());
+  TEST_ASSERT_EQUAL(0, gps->getDroppedBytes());
+}
+
+void test_rx_buffer_overflow_is_counted() {
+  Gps * const gps = startGps();
+  std::vector<uint8_t> data;
+  for (int e = 1; data.size() <= GPS_RX_BUFFER_SIZE; e++) {
+    const auto more = epoch(FIRST_TOW + e * 1000, false);
+    data.insert(data.end(), more.begin(), more.end());
+  }
+  // all at once, more than the buffer holds
+  GpsTest::serial(*gps).feed(data.data(), data.size());
+  delay(200);
+  vTaskDelete(GpsTest::readerTask(*gps));
+
+  TEST_ASSERT_EQUAL(1, gps->getRxOverflowCount());
+  TEST_ASSERT_TRUE(gps->getValidMessageCount() > 0);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_loop_sees_every_epoch_whole_and_in_order);
+  RUN_TEST(test_rx_buffer_overflow_is_counted);
+  return UNITY_END();
+}
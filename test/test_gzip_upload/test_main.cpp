@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+/* Compressed tracks are decompressed while they are uploaded. Checks
+ * GzipDecoder and GzipFileStream on the output of GzipEncoder, on zlib
+ * streams with stored, fixed and dynamic blocks and on broken files.
+ */
+
+#define OBSCLASSIC 1
+#include <Arduino.h>
+#include <SD.h>
+
+#include "utils/gzip.cpp"
+#include "utils/streams.cpp"
+
+#include <unity.h>
+#include <zlib.h>
+
+static const char *const TRACK = "/track.obsdata.csv.gz";
+
+/* Lines like a track, repetitive but not too much. */
+static std::string csvLines(int lines) {
+  std::string csv = "OBSFirmwareVersion=v0.0.0-host&OBSDataFormat=2\n";
+  for (int line = 0; line < lines; line++) {
+    char text[160];
+    snprintf(text, sizeof(text), "18.10.2026;12:%02d:%02d;%d;;48.%06d;9.%06d;%d;%d;%d;;0;;0;0;58;%d\n",
+             line / 60 % 60, line % 60, rand(), rand() % 1000000, rand() % 1000000,
+             rand() % 500, rand() % 400, rand() % 300, rand() % 60);
+    csv += text;
+  }
+  return csv;
+}
+
+static std::string encode(const std::string &plain, int syncEvery) {
+  GzipEncoder encoder;
+  String out;
+  encoder.begin(out);
+  for (size_t position = 0; position < plain.size(); position += syncEvery) {
+    const size_t length = std::min((size_t) syncEvery, plain.size() - position);
+    encoder.write(reinterpret_cast<const uint8_t *>(plain.data() + position), length, out);
+    encoder.sync(out);
+  }
+  encoder.finish(out);
+  return out.str();
+}
+
+static std::string zlibGzip(const std::string &plain, int level, int strategy, bool withName) {
+  z_stream stream = {};
+  TEST_ASSERT_EQUAL(Z_OK, deflateInit2(&stream, level, Z_DEFLATED, 16 + 14, 8, strategy));
+  gz_header header = {};
+  char name[] = "track.obsdata.csv";
+  char comment[] = "host";
+  Bytef extra[] = {'O', 'B', 2, 0, 1, 2};
+  if (withName) {
+    header.name = (Bytef *) name;
+    header.comment = (Bytef *) comment;
+    header.extra = extra;
+    header.extra_len = sizeof(extra);
+    header.hcrc = 1;
+    TEST_ASSERT_EQUAL(Z_OK, deflateSetHeader(&stream, &header));
+  }
+  std::string result(deflateBound(&stream, plain.size()) + 64, 0);
+  stream.next_in = (Bytef *) plain.data();
+  stream.avail_in = plain.size();
+  stream.next_out = (Bytef *) &result[0];
+  stream.avail_out = result.size();
+  TEST_ASSERT_EQUAL(Z_STREAM_END, deflate(&stream, Z_FINISH));
+  result.resize(stream.total_out);
+  deflateEnd(&stream);
+  return result;
+}
+
+static void storeTrack(const std::string &content) {
+  fs::hostCard.clear();
+  fs::hostCard.files[TRACK] = std::make_shared<fs::HostFileData>();
+  fs::hostCard.files[TRACK]->content = content;
+}
+
+/* Reads the stream with a mix of read() and readBytes() of random sizes. */
+static std::string readAll(GzipFileStream &stream) {
+  std::string result;
+  while (stream.available() > 0) {
+    if (rand() % 8 == 0) {
+      const int peeked = stream.peek();
+      const int c = stream.read();
+      TEST_ASSERT_EQUAL(peeked, c);
+      result += (char) c;
+    } else {
+      char buffer[1200];
+      const size_t count = stream.readBytes(buffer, 1 + rand() % sizeof(buffer));
+      if (count == 0) {
+        break;
+      }
+      result.append(buffer, count);
+    }
+  }
+  return result;
+}
+
+static void assertUploadedAsPlain(const std::string &compressed, const std::string &plain) {
+  storeTrack(compressed);
+  File file = SD.open(TRACK);
+  GzipFileStream stream(&file);
+  TEST_ASSERT_TRUE(stream.begin());
+  TEST_ASSERT_EQUAL(plain.size(), stream.size());
+  const std::string uploaded = readAll(stream);
+  TEST_ASSERT_FALSE(stream.hasFailed());
+  TEST_ASSERT_EQUAL(0, stream.available());
+  TEST_ASSERT_EQUAL(-1, stream.read());
+  TEST_ASSERT_TRUE(uploaded == plain);
+}
+
+void setUp() {
+  srand(16);
+}
+
+void tearDown() {
+}
+
+void test_encoder_tracks_decompress() {
+  const std::string plain = csvLines(3000);
+  for (const int syncEvery : {100000000, 10000, 777}) {
+    assertUploadedAsPlain(encode(plain, syncEvery), plain);
+  }
+  assertUploadedAsPlain(encode("", 1000), "");
+}
+
+void test_recovered_tracks_decompress() {
+  const std::string plain = csvLines(500);
+  GzipEncoder encoder;
+  String out;
+  encoder.begin(out);
+  encoder.write(reinterpret_cast<const uint8_t *>(plain.data()), plain.size(), out);
+  encoder.sync(out);
+  // like recoverTrack() after a power loss
+  GzipEncoder::finishAfterSync(encoder.getCrc(), encoder.getInputSize(), out);
+  assertUploadedAsPlain(out.str(), plain);
+}
+
+void test_zlib_blocks_decompress() {
+  // long matches, distances up to 16k and all block types
+  std::string plain = csvLines(2000);
+  plain += plain.substr(0, 20000);
+  assertUploadedAsPlain(zlibGzip(plain, 0, Z_DEFAULT_STRATEGY, false), plain);
+  assertUploadedAsPlain(zlibGzip(plain, 6, Z_FIXED, false), plain);
+  assertUploadedAsPlain(zlibGzip(plain, 9, Z_DEFAULT_STRATEGY, true), plain);
+  assertUploadedAsPlain(zlibGzip(plain, 1, Z_HUFFMAN_ONLY, false), plain);
+  assertUploadedAsPlain(zlibGzip(std::string(70000, 'a'), 9, Z_RLE, false), std::string(70000, 'a'));
+}
+
+void test_broken_tracks_fail() {
+  const std::string plain = csvLines(1000);
+  const std::string compressed = encode(plain, 5000);
+
+  storeTrack(compressed.substr(0, 10));
+  File tooShort = SD.open(TRACK);
+  GzipFileStream noTrailer(&tooShort);
+  TEST_ASSERT_FALSE(noTrailer.begin());
+  TEST_ASSERT_EQUAL(0, noTrailer.available());
+
+  storeTrack(plain);
+  File notCompressed = SD.open(TRACK);
+  GzipFileStream noHeader(&notCompressed);
+  TEST_ASSERT_FALSE(noHeader.begin());
+
+  for (int run = 0; run < 50; run++) {
+    std::string broken = compressed;
+    if (run % 2) {
+      // cut, like a track that was never finished
+      broken.resize(GzipEncoder::HEADER_SIZE + rand() % (broken.size() - GzipEncoder::HEADER_SIZE));
+      broken += compressed.substr(compressed.size() - 4);
+    } else {
+      broken[GzipEncoder::HEADER_SIZE + rand() % (broken.size() - GzipEncoder::HEADER_SIZE - 8)] ^= 1 << rand() % 8;
+    }
+    storeTrack(broken);
+    File file = SD.open(TRACK);
+    GzipFileStream stream(&file);
+    TEST_ASSERT_TRUE(stream.begin());
+    const std::string uploaded = readAll(stream);
+    TEST_ASSERT_TRUE(stream.hasFailed());
+    TEST_ASSERT_EQUAL(0, stream.available());
+    TEST_ASSERT_LESS_OR_EQUAL(plain.size(), uploaded.size());
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_encoder_tracks_decompress);
+  RUN_TEST(test_recovered_tracks_decompress);
+  RUN_TEST(test_zlib_blocks_decompress);
+  RUN_TEST(test_broken_tracks_fail);
+  return UNITY_END();
+}
@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+/* Median against a sorted copy of the window, and the time per reading
+ * compared to the former implementation that sorted on each median().
+ */
+
+#include <Arduino.h>
+#include <chrono>
+#include <vector>
+#include "variant.h"
+#include "utils/median.h"
+
+#include <unity.h>
+
+/* The former implementation, sorts a copy of the window. */
+template<typename T> class SortingMedian {
+  public:
+    SortingMedian(size_t size, T initialValue) : data(size, initialValue), temp(size) {
+    }
+    void addValue(T value) {
+      sorted = false;
+      data[pos++] = value;
+      if (pos >= data.size()) {
+        pos = 0;
+      }
+    }
+    T median() {
+      if (!sorted) {
+        temp = data;
+        std::sort(temp.begin(), temp.end());
+        sorted = true;
+      }
+      return temp[data.size() / 2];
+    }
+
+  private:
+    std::vector<T> data;
+    std::vector<T> temp;
+    size_t pos = 0;
+    bool sorted = false;
+};
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+/* Mostly random distances with runs of equal and very close values. */
+static uint16_t reading(int i) {
+  return rand() % (i % 7 ? MAX_SENSOR_VALUE + 1 : 3);
+}
+
+template<size_t SIZE> static void checkAgainstSortedWindow() {
+  srand(SIZE);
+  Median<uint16_t, SIZE> median(MAX_SENSOR_VALUE);
+  SortingMedian<uint16_t> reference(SIZE, MAX_SENSOR_VALUE);
+  TEST_ASSERT_EQUAL_UINT16(MAX_SENSOR_VALUE, median.median());
+  for (int i = 0; i < 100000; i++) {
+    const uint16_t value = reading(i);
+    median.addValue(value);
+    reference.addValue(value);
+    TEST_ASSERT_EQUAL_UINT16(reference.median(), median.median());
+  }
+}
+
+void test_median_of_1() {
+  checkAgainstSortedWindow<1>();
+}
+
+void test_median_of_3() {
+  checkAgainstSortedWindow<3>();
+}
+
+void test_median_of_5() {
+  checkAgainstSortedWindow<5>();
+}
+
+void test_median_of_31() {
+  checkAgainstSortedWindow<31>();
+}
+
+void test_signed_values() {
+  Median<int32_t, 5> median(0);
+  const int32_t values[] = { -5, 7, -9, 3, 3, -1, 100 };
+  const int32_t expected[] = { 0, 0, 0, 0, 3, 3, 3 };
+  for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+    median.addValue(values[i]);
+    TEST_ASSERT_EQUAL_INT32(expected[i], median.median());
+  }
+}
+
+/* Like in the firmware a median is requested for each reading. */
+template<size_t SIZE> static void benchmark() {
+  static const int READINGS = 1000000;
+  std::vector<uint16_t> values(READINGS);
+  for (int i = 0; i < READINGS; i++) {
+    values[i] = reading(i);
+  }
+  uint32_t check = 0;
+  auto start = std::chrono::steady_clock::now();
+  Median<uint16_t, SIZE> median(MAX_SENSOR_VALUE);
+  for (const uint16_t value : values) {
+    median.addValue(value);
+    check += median.median();
+  }
+  const double fixedNs = std::chrono::duration<double, std::nano>(
+    std::chrono::steady_clock::now() - start).count() / READINGS;
+  start = std::chrono::steady_clock::now();
+  SortingMedian<uint16_t> reference(SIZE, MAX_SENSOR_VALUE);
+  for (const uint16_t value : values) {
+    reference.addValue(value);
+    check -= reference.median();
+  }
+  const double sortingNs = std::chrono::duration<double, std::nano>(
+    std::chrono::steady_clock::now() - start).count() / READINGS;
+  TEST_ASSERT_EQUAL_UINT32(0, check);
+  char message[96];
+  snprintf(message, sizeof(message), "window %u: %.1fns per reading, former %.1fns",
+           (unsigned) SIZE, fixedNs, sortingNs);
+  TEST_MESSAGE(message);
+}
+
+void test_benchmark() {
+  benchmark<MEDIAN_DISTANCE_MEASURES>();
+  benchmark<RAW_MEDIAN_DISTANCE_MEASURES>();
+  benchmark<31>();
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_median_of_1);
+  RUN_TEST(test_median_of_3);
+  RUN_TEST(test_median_of_5);
+  RUN_TEST(test_median_of_31);
+  RUN_TEST(test_signed_values);
+  RUN_TEST(test_benchmark);
+  return UNITY_END();
+}
@@ -0,0 +1,339 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+/* Replays dump,/meas, lines as recorded for tools/plot_pga_dump.py through
+ * a PGA460 frame model. The manager must store the same echoes and print
+ * the same lines again.
+ */
+
+#define OBSPRO 1
+#define PGA_DUMP_ENABLE 1
+#include "hostglobals.h"
+
+#include "pgaSensor.cpp"
+#include "cadence.cpp"
+#include "utils/soundspeed.cpp"
+
+#include <unity.h>
+#include <sstream>
+#include <vector>
+
+// a PGA_DUMP_ENABLE capture with PGA_NUMBER_OF_OBJECTS 3, a car passes on the
+// left (1) while the right sensor sees a parked car
+static const char * const RECORDED_MEASUREMENTS[] = {
+  "meas,0,3012,61,170,9850,25,55,65535,0,0",
+  "meas,1,12180,40,92,65535,0,0,65535,0,0",
+  "meas,0,3008,63,168,9862,24,51,65535,0,0",
+  "meas,1,10420,88,141,12210,31,77,65535,0,0",
+  "meas,0,2996,60,172,65535,0,0,65535,0,0",
+  "meas,1,8750,120,188,14020,35,61,15890,12,40",
+  "meas,0,3004,62,169,9844,26,57,0,0,0",
+  "meas,1,7710,144,201,8750,40,72,14100,30,58",
+  "meas,0,65535,0,0,65535,0,0,65535,0,0",
+  "meas,1,7702,151,203,9990,18,44,65535,0,0",
+  "meas,0,3010,61,171,9851,25,54,65535,0,0",
+  "meas,1,8120,132,190,65535,0,0,65535,0,0",
+  "meas,0,3001,61,170,9848,25,56,65535,0,0",
+  "meas,1,12990,52,99,65535,0,0,65535,0,0",
+  "meas,0,3006,60,170,9853,24,55,65535,0,0",
+  "meas,1,65535,0,0,65535,0,0,65535,0,0",
+};
+
+static const size_t RECORDED_LINES = sizeof(RECORDED_MEASUREMENTS) / sizeof(RECORDED_MEASUREMENTS[0]);
+
+static const char * const RECORDED_DUMP =
+  "255,206,164,127,102,79,64,54,41,35,26,24,22,16,16,11,12,13,9,11,7,9,11,7,"
+  "10,9,22,52,102,162,186,161,104,49,22,9,8,10,7,9,6,8,10,7,9,7,14,32,53,69,"
+  "52,30,16,8,9,6,8,10,7,9,6,8,10,7,9,6,8,10,7,9,6,8,10,7,9,6,8,10,7,9,6,8,"
+  "10,7,9,6,8,10,7,9,6,8,10,7,9,6,8,10,7,9,6,8,10,7,9,6,8,10,7,9,6,8,10,7,9,"
+  "6,8,10,7,9,6,8,10,7,9,6,8,10";
+
+static std::vector<int> parseValues(const char *csv) {
+  std::vector<int> values;
+  std::stringstream stream(csv);
+  std::string value;
+  while (std::getline(stream, value, ',')) {
+    values.push_back(atoi(value.c_str()));
+  }
+  return values;
+}
+
+// sensor id followed by tof, width and amplitude of each object
+static std::vector<int> measurement(const char *line) {
+  return parseValues(line + strlen("meas,"));
+}
+
+static unsigned long nowMicros;
+unsigned long micros() { return nowMicros += 10; }
+unsigned long millis() { return micros() / 1000; }
+void pinMode(uint8_t, uint8_t) {}
+void digitalWrite(uint8_t, uint8_t) {}
+int digitalRead(uint8_t) { return LOW; }
+
+// inverted sum with carry, as in the PGA460 datasheet
+static uint8_t checksum(const uint8_t *data, size_t length) {
+  uint8_t sum = 0;
+  uint8_t carry = 0;
+  for (size_t i = 0; i < length; i++) {
+    const uint16_t value = (uint16_t) sum + data[i] + carry;
+    carry = value >> 8;
+    sum = value;
+  }
+  return ~(sum + carry);
+}
+
+/* Answers the frames like a PGA460 that measured the recorded lines. */
+class RecordedPga : public PGATransport {
+  public:
+    bool attach(uint8_t, uint8_t, uint8_t, uint8_t) override { return true; }
+    const char *getName() const override { return "recorded"; }
+
+    void transfer(uint8_t idx, const uint8_t *tx, uint8_t *rx, size_t length) override {
+      uint8_t answer[140] = {};
+      const uint8_t diag = 0x40 | (micros() < busyUntil[idx] ? PGA_DIAG_BUSY_MASK : 0);
+      switch (tx[1] & 0x1f) {
+        case PGA_CMD_REGISTER_READ:
+          answer[4] = diag;
+          answer[5] = tx[2] == PGA_REG_DEV_STAT0 ? 0x40 : registers[idx][tx[2]];
+          answer[6] = checksum(&answer[4], 2);
+          break;
+        case PGA_CMD_REGISTER_WRITE:
+          registers[idx][tx[2]] = tx[3];
+          break;
+        case PGA_CMD_BURST_AND_LISTEN_1:
+        case PGA_CMD_BURST_AND_LISTEN_2:
+          TEST_ASSERT_EQUAL(PGA_NUMBER_OF_OBJECTS, tx[2]);
+          busyUntil[idx] = micros() + 16000;
+          dumping[idx] = registers[idx][PGA_REG_EE_CNTRL] & PGA_DATADUMP_EN(1);
+          measured[idx] = dumping[idx] ? noObject(idx) : next(idx);
+          break;
+        case PGA_CMD_ULTRASONIC_RESULT: {
+          answer[2] = diag;
+          reported[idx] = measured[idx];
+          reportedDump[idx] = dumping[idx];
+          if (!dumping[idx]) {
+            answered.push_back(measured[idx]);
+          }
+          const std::vector<int> values = measurement(measured[idx].c_str());
+          for (size_t obj = 0; 3 + obj * 4 + 4 < length; obj++) {
+            const int tof = values[1 + obj * 3];
+            answer[3 + obj * 4] = tof >> 8;
+            answer[4 + obj * 4] = tof;
+            answer[5 + obj * 4] = values[2 + obj * 3];
+            answer[6 + obj * 4] = values[3 + obj * 3];
+          }
+          answer[length - 1] = checksum(&answer[2], length - 3);
+          break;
+        }
+        case PGA_CMD_DATA_DUMP: {
+          TEST_ASSERT_EQUAL(2 + 1 + 128 + 1, length);
+          answer[2] = diag;
+          const std::vector<int> values = parseValues(RECORDED_DUMP);
+          TEST_ASSERT_EQUAL(128, values.size());
+          for (size_t i = 0; i < 128; i++) {
+            answer[3 + i] = values[i];
+          }
+          answer[length - 1] = checksum(&answer[2], 1 + 128);
+          break;
+        }
+        default:
+          TEST_FAIL_MESSAGE("unexpected command");
+      }
+      if (rx) {
+        memcpy(rx, answer, length);
+      }
+    }
+
+    bool done() const {
+      return position[0] >= RECORDED_LINES && position[1] >= RECORDED_LINES;
+    }
+
+    // the measurement of the last ultrasonic result read
+    std::string reported[NUMBER_OF_TOF_SENSORS];
+    bool reportedDump[NUMBER_OF_TOF_SENSORS] = {};
+    // all measurements read, except the ones of a data dump
+    std::vector<std::string> answered;
+
+  private:
+    std::string next(uint8_t idx) {
+      for (size_t &line = position[idx]; line < RECORDED_LINES; line++) {
+        if (measurement(RECORDED_MEASUREMENTS[line])[0] == idx) {
+          return RECORDED_MEASUREMENTS[line++];
+        }
+      }
+      return noObject(idx);
+    }
+
+    static std::string noObject(uint8_t idx) {
+      std::string line = "meas," + std::to_string(idx);
+      for (size_t obj = 0; obj < PGA_NUMBER_OF_OBJECTS; obj++) {
+        line += ",65535,0,0";
+      }
+      return line;
+    }
+
+    std::string measured[NUMBER_OF_TOF_SENSORS] = {noObject(0), noObject(1)};
+    bool dumping[NUMBER_OF_TOF_SENSORS] = {};
+
+    uint8_t registers[NUMBER_OF_TOF_SENSORS][256] = {};
+    unsigned long busyUntil[NUMBER_OF_TOF_SENSORS] = {};
+    size_t position[NUMBER_OF_TOF_SENSORS] = {};
+};
+
+static RecordedPga *pga;
+
+PGATransport *PGATransport::create() {
+  return pga = new RecordedPga;
+}
+
+static PGASensorManager *manager;
+
+void setUp() {
+  nowMicros = 1000000;
+  Serial.output.clear();
+  manager = new PGASensorManager;
+  PGASensorInfo right;
+  right.sensorLocation = "Right";
+  PGASensorInfo left;
+  left.sensorLocation = "Left";
+  manager->registerSensor(right, 0);
+  manager->registerSensor(left, 1);
+  manager->setPrimarySensor(1);
+  manager->reset(millis());
+}
+
+void tearDown() {
+  delete manager;
+}
+
+static std::string toString(const EchoProfile &profile) {
+  char buffer[64];
+  LineBuffer line(buffer, sizeof(buffer));
+  profile.appendTo(line);
+  return std::string(line.c_str(), line.length());
+}
+
+/* The profile as expected from a recorded line, empty slots end it. */
+static std::string expectedProfile(const char *recorded) {
+  const std::vector<int> values = measurement(recorded);
+  std::string expected;
+  for (size_t obj = 0; obj < PGA_NUMBER_OF_OBJECTS; obj++) {
+    const int tof = values[1 + obj * 3];
+    if (tof == 0 || tof == 0xffff) {
+      break;
+    }
+    if (!expected.empty()) {
+      expected += "|";
+    }
+    expected += std::to_string(tof) + ":" + std::to_string(values[2 + obj * 3])
+      + ":" + std::to_string(values[3 + obj * 3]);
+  }
+  return expected;
+}
+
+static std::vector<std::string> printedLines(const char *prefix) {
+  std::vector<std::string> lines;
+  std::stringstream stream(Serial.output);
+  std::string line;
+  while (std::getline(stream, line)) {
+    if (line.compare(0, strlen(prefix), prefix) == 0) {
+      lines.push_back(line);
+    }
+  }
+  return lines;
+}
+
+void test_echoes_are_stored_per_measurement() {
+  int checked = 0;
+  for (int i = 0; i < 100000 && !pga->done(); i++) {
+    if (!manager->pollDistancesAlternating()) {
+      continue;
+    }
+    const uint16_t idx = manager->getCurrentMeasureIndex();
+    for (uint8_t sensor = 0; sensor < NUMBER_OF_TOF_SENSORS; sensor++) {
+      if (pga->reportedDump[sensor]) {
+        continue;
+      }
+      const char *recorded = pga->reported[sensor].c_str();
+      const PGASensorInfo &info = manager->m_sensors[sensor];
+      const std::string expected = expectedProfile(recorded);
+      const std::string stored = toString(info.echoes[idx]);
+      TEST_ASSERT_EQUAL_STRING(expected.c_str(), stored.c_str());
+      const int tof = measurement(recorded)[1];
+      TEST_ASSERT_EQUAL_INT32(tof, info.echoDurationMicroseconds[idx]);
+      if (tof < 0xffff) {
+        TEST_ASSERT_EQUAL_UINT16(tof * 1715 / 100000, info.rawDistance);
+      } else {
+        TEST_ASSERT_EQUAL_UINT16(MAX_SENSOR_VALUE, info.rawDistance);
+      }
+      checked++;
+    }
+  }
+  TEST_ASSERT_TRUE(pga->done());
+  TEST_ASSERT_GREATER_THAN(6, checked);
+}
+
+void test_printed_lines_match_the_recording() {
+  for (int i = 0; i < 100000 && !pga->done(); i++) {
+    manager->pollDistancesAlternating();
+  }
+  // the last measurements are printed when they are collected
+  const unsigned long end = millis() + 500;
+  while (millis() < end) {
+    manager->pollDistancesAlternating();
+  }
+
+  const std::vector<std::string> measurements = printedLines("meas,");
+  TEST_ASSERT_EQUAL(pga->answered.size(), measurements.size());
+  for (size_t i = 0; i < measurements.size(); i++) {
+    TEST_ASSERT_EQUAL_STRING(pga->answered[i].c_str(), measurements[i].c_str());
+  }
+  // each sensor printed all of its recorded lines in order
+  for (uint8_t sensor = 0; sensor < NUMBER_OF_TOF_SENSORS; sensor++) {
+    size_t line = 0;
+    for (const std::string &printed : measurements) {
+      while (line < RECORDED_LINES && measurement(RECORDED_MEASUREMENTS[line])[0] != sensor) {
+        line++;
+      }
+      if (line < RECORDED_LINES && printed == RECORDED_MEASUREMENTS[line]) {
+        line++;
+      }
+    }
+    while (line < RECORDED_LINES && measurement(RECORDED_MEASUREMENTS[line])[0] != sensor) {
+      line++;
+    }
+    TEST_ASSERT_EQUAL(RECORDED_LINES, line);
+  }
+  const std::vector<std::string> dumps = printedLines("dump,");
+  TEST_ASSERT_GREATER_OR_EQUAL(2, dumps.size());
+  for (const std::string &dump : dumps) {
+    TEST_ASSERT_EQUAL_STRING(RECORDED_DUMP, dump.c_str() + strlen("dump,0,"));
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_echoes_are_stored_per_measurement);
+  RUN_TEST(test_printed_lines_match_the_recording);
+  return UNITY_END();
+}
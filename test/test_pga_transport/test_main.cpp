@@ -0,0 +1,402 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+/* The PGA460 frames on the wire. A model of the chip clocks the frames in
+ * bit by bit and checks the checksum of each one against the former
+ * bit-wise calculation, for the bit-banged transport as well as for the
+ * HSPI one.
+ */
+
+#define OBSPRO 1
+#include "hostglobals.h"
+
+#include "pgatransport.cpp"
+#include "pgaSensor.cpp"
+#include "cadence.cpp"
+#include "utils/soundspeed.cpp"
+
+#include <unity.h>
+#include <vector>
+
+static const uint8_t SCK_PINS[NUMBER_OF_TOF_SENSORS] = {16, 21};
+static const uint8_t MOSI_PINS[NUMBER_OF_TOF_SENSORS] = {17, 22};
+static const uint8_t MISO_PINS[NUMBER_OF_TOF_SENSORS] = {18, 23};
+
+static unsigned long nowMicros;
+unsigned long micros() { return nowMicros += 10; }
+unsigned long millis() { return micros() / 1000; }
+
+/* The checksum as calculated bit by bit before the transports, kept as the
+ * reference.
+ */
+class FormerChecksum {
+  public:
+    void appendBit(uint8_t val) {
+      tmpData |= (val << offset);
+      if (!offset) {
+        appendByte(tmpData);
+      } else {
+        offset--;
+      }
+    }
+
+    void appendByte(uint8_t val) {
+      const uint16_t sum16 = (uint16_t) sum + (uint16_t) val + (uint16_t) carry;
+      carry = sum16 >> 8;
+      sum = (uint8_t) sum16;
+      offset = 7;
+      tmpData = 0;
+    }
+
+    uint8_t get() {
+      while (offset != 7) {
+        appendBit(0);
+      }
+      return ~(sum + carry);
+    }
+
+    static uint8_t of(const uint8_t *data, size_t length) {
+      FormerChecksum checksum;
+      for (size_t pos = 0; pos < length; pos++) {
+        for (int bit = 7; bit >= 0; bit--) {
+          checksum.appendBit((data[pos] >> bit) & 1);
+        }
+      }
+      return checksum.get();
+    }
+
+  private:
+    uint8_t sum = 0;
+    uint8_t tmpData = 0;
+    uint8_t offset = 7;
+    uint8_t carry = 0;
+};
+
+struct Frame {
+  uint8_t sensor;
+  std::vector<uint8_t> tx;
+  std::vector<uint8_t> rx;
+};
+
+/* One PGA460 in synchronous UART mode: reads MOSI on the rising edge of
+ * the clock and answers on MISO at the same time, LSB first.
+ */
+class Pga460 {
+  public:
+    explicit Pga460(uint8_t sensor) : sensor(sensor) {
+      registers[PGA_REG_DEV_STAT0] = 0x40;
+    }
+
+    uint8_t clock(uint8_t level) {
+      const uint8_t out = (answer[position] >> bit) & 1;
+      received |= (level & 1) << bit;
+      if (++bit == 8) {
+        tx[position] = received;
+        received = 0;
+        bit = 0;
+        byteReceived();
+        if (++position == length) {
+          frameReceived();
+        }
+      }
+      return out;
+    }
+
+    uint8_t registers[256] = {};
+    std::vector<Frame> frames;
+    size_t checkedChecksums = 0;
+
+  private:
+    void byteReceived() {
+      if (position == 0) {
+        TEST_ASSERT_EQUAL_HEX8_MESSAGE(0x55, tx[0], "sync byte");
+        return;
+      }
+      if (position == 1) {
+        TEST_ASSERT_EQUAL_MESSAGE(0, tx[1] >> 5, "chip address");
+        memset(answer, 0, sizeof(answer));
+        const uint8_t diag = 0x40;
+        switch (tx[1] & 0x1f) {
+          case PGA_CMD_REGISTER_READ:
+            length = 7;
+            break;
+          case PGA_CMD_REGISTER_WRITE:
+            length = 5;
+            break;
+          case PGA_CMD_BURST_AND_LISTEN_1:
+          case PGA_CMD_BURST_AND_LISTEN_2:
+            length = 4;
+            break;
+          case PGA_CMD_ULTRASONIC_RESULT:
+            length = 2 + 1 + 4 * objects + 1;
+            answer[2] = diag;
+            for (uint8_t obj = 0; obj < objects; obj++) {
+              const uint16_t tof = echoTime(obj);
+              answer[3 + obj * 4] = tof >> 8;
+              answer[4 + obj * 4] = tof;
+              answer[5 + obj * 4] = 60 - obj;
+              answer[6 + obj * 4] = 170 - 10 * obj;
+            }
+            answer[length - 1] = FormerChecksum::of(&answer[2], length - 3);
+            break;
+          default:
+            TEST_FAIL_MESSAGE("unexpected command");
+        }
+        return;
+      }
+      if (position == 3 && (tx[1] & 0x1f) == PGA_CMD_REGISTER_READ) {
+        checkChecksum(2);
+        answer[4] = 0x40;
+        answer[5] = registers[tx[2]];
+        answer[6] = FormerChecksum::of(&answer[4], 2);
+      }
+    }
+
+    void frameReceived() {
+      switch (tx[1] & 0x1f) {
+        case PGA_CMD_REGISTER_WRITE:
+          checkChecksum(3);
+          registers[tx[2]] = tx[3];
+          break;
+        case PGA_CMD_BURST_AND_LISTEN_1:
+        case PGA_CMD_BURST_AND_LISTEN_2:
+          checkChecksum(2);
+          TEST_ASSERT_TRUE(tx[2] >= 1 && tx[2] <= 8);
+          objects = tx[2];
+          break;
+      }
+      frames.push_back({sensor, std::vector<uint8_t>(tx, tx + length),
+                        std::vector<uint8_t>(answer, answer + length)});
+      position = 0;
+      length = SIZE_MAX;
+    }
+
+    // the checksum follows the command and its payload bytes
+    void checkChecksum(size_t payload) {
+      TEST_ASSERT_EQUAL_HEX8_MESSAGE(FormerChecksum::of(&tx[1], payload), tx[1 + payload],
+                                     "checksum of the host frame");
+      checkedChecksums++;
+    }
+
+    uint16_t echoTime(uint8_t obj) const {
+      return 3000 + 1000 * obj + 500 * sensor;
+    }
+
+    const uint8_t sensor;
+    uint8_t tx[2 + 1 + 4 * 8 + 1] = {};
+    uint8_t answer[sizeof(tx)] = {};
+    size_t position = 0;
+    size_t length = SIZE_MAX;
+    uint8_t received = 0;
+    uint8_t bit = 0;
+    // the manager reads a result of the left sensor before its first burst
+    uint8_t objects = PGA_NUMBER_OF_OBJECTS;
+};
+
+struct Clock {
+  int8_t sck;
+  int8_t mosi;
+  int8_t miso;
+  uint8_t mosiLevel;
+  uint8_t misoLevel;
+
+  bool operator==(const Clock &other) const {
+    return sck == other.sck && mosi == other.mosi && miso == other.miso
+      && mosiLevel == other.mosiLevel && misoLevel == other.misoLevel;
+  }
+};
+
+static Pga460 *chips[NUMBER_OF_TOF_SENSORS];
+static std::vector<Clock> clocks;
+static uint8_t levels[64];
+
+static uint8_t busClock(int8_t sck, int8_t mosi, int8_t miso, uint8_t level) {
+  for (uint8_t sensor = 0; sensor < NUMBER_OF_TOF_SENSORS; sensor++) {
+    if (sck == SCK_PINS[sensor]) {
+      TEST_ASSERT_EQUAL(MOSI_PINS[sensor], mosi);
+      TEST_ASSERT_EQUAL(MISO_PINS[sensor], miso);
+      const uint8_t out = chips[sensor]->clock(level);
+      clocks.push_back({sck, mosi, miso, level, out});
+      return out;
+    }
+  }
+  TEST_FAIL_MESSAGE("clock on a pin without a sensor");
+  return LOW;
+}
+
+// the bit-banged transport drives the same chips through the pins
+void pinMode(uint8_t, uint8_t) {}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  const uint8_t former = levels[pin];
+  levels[pin] = val;
+  for (uint8_t sensor = 0; sensor < NUMBER_OF_TOF_SENSORS; sensor++) {
+    if (pin == SCK_PINS[sensor] && former == LOW && val == HIGH) {
+      levels[MISO_PINS[sensor]] = busClock(SCK_PINS[sensor], MOSI_PINS[sensor],
+                                           MISO_PINS[sensor], levels[MOSI_PINS[sensor]]);
+    }
+  }
+}
+
+int digitalRead(uint8_t pin) { return levels[pin]; }
+
+/* Reaches the checksum of the manager. */
+class PgaTest : public PGASensorManager {
+  public:
+    using PGASensorManager::checksum;
+};
+
+static void resetBus() {
+  for (uint8_t sensor = 0; sensor < NUMBER_OF_TOF_SENSORS; sensor++) {
+    delete chips[sensor];
+    chips[sensor] = new Pga460(sensor);
+  }
+  clocks.clear();
+  memset(levels, 0, sizeof(levels));
+}
+
+/* Setup of both sensors and a few measurements, as in the firmware. */
+static void measure(PGASensorManager &manager) {
+  for (uint8_t sensor = 0; sensor < NUMBER_OF_TOF_SENSORS; sensor++) {
+    PGASensorInfo info;
+    info.sensorLocation = sensor ? "Left" : "Right";
+    info.sck_pin = SCK_PINS[sensor];
+    info.mosi_pin = MOSI_PINS[sensor];
+    info.miso_pin = MISO_PINS[sensor];
+    manager.registerSensor(info, sensor);
+  }
+  manager.setPrimarySensor(1);
+  manager.reset(millis());
+  int collected = 0;
+  for (int i = 0; i < 10000 && collected < 4; i++) {
+    if (manager.pollDistancesAlternating()) {
+      collected++;
+    }
+  }
+  TEST_ASSERT_EQUAL(4, collected);
+}
+
+void setUp() {
+  nowMicros = 1000000;
+  resetBus();
+  hostSpiClock() = busClock;
+}
+
+void tearDown() {
+  for (uint8_t sensor = 0; sensor < NUMBER_OF_TOF_SENSORS; sensor++) {
+    delete chips[sensor];
+    chips[sensor] = nullptr;
+  }
+  hostSpiClock() = nullptr;
+}
+
+void test_checksum_matches_the_former_bitwise_one() {
+  uint8_t frame[140];
+  for (int run = 0; run < 20000; run++) {
+    const size_t length = run % sizeof(frame);
+    for (size_t pos = 0; pos < length; pos++) {
+      frame[pos] = random(256);
+    }
+    TEST_ASSERT_EQUAL_HEX8(FormerChecksum::of(frame, length), PgaTest::checksum(frame, length));
+  }
+  // the carry of the last byte, and a sum that ends at 0xff
+  const uint8_t carries[] = {0xff, 0xff, 0xff, 0xff};
+  TEST_ASSERT_EQUAL_HEX8(FormerChecksum::of(carries, 4), PgaTest::checksum(carries, 4));
+  const uint8_t full[] = {0x80, 0x7f};
+  TEST_ASSERT_EQUAL_HEX8(FormerChecksum::of(full, 2), PgaTest::checksum(full, 2));
+}
+
+void test_every_host_frame_has_a_valid_checksum() {
+  PGASensorManager manager;  // the bit-banged transport as built by default
+  measure(manager);
+
+  for (uint8_t sensor = 0; sensor < NUMBER_OF_TOF_SENSORS; sensor++) {
+    const Pga460 &chip = *chips[sensor];
+    // the writes of the setup arrived, the manager accepted the answers
+    TEST_ASSERT_EQUAL(55, chip.registers[PGA_REG_FREQUENCY]);
+    TEST_ASSERT_EQUAL(PGA_P1_REC(PGA_P1_REC_LENGTH) | PGA_P2_REC(PGA_P2_REC_LENGTH),
+                      chip.registers[PGA_REG_REC_LENGTH]);
+    TEST_ASSERT_GREATER_THAN(40, chip.checkedChecksums);
+    size_t bursts = 0;
+    size_t results = 0;
+    for (const Frame &frame : chip.frames) {
+      const uint8_t command = frame.tx[1] & 0x1f;
+      bursts += command == PGA_CMD_BURST_AND_LISTEN_1 || command == PGA_CMD_BURST_AND_LISTEN_2;
+      results += command == PGA_CMD_ULTRASONIC_RESULT;
+    }
+    TEST_ASSERT_GREATER_OR_EQUAL(3, bursts);
+    TEST_ASSERT_GREATER_OR_EQUAL(4, results);
+    TEST_ASSERT_EQUAL_UINT16((3000 + 500 * sensor) * 1715 / 100000, manager.m_sensors[sensor].rawDistance);
+  }
+}
+
+void test_bit_bang_and_hardware_spi_send_the_same_frames() {
+  std::vector<Frame> frames;
+  std::vector<Clock> bitBangClocks;
+  {
+    PGASensorManager manager;
+    measure(manager);
+    for (uint8_t sensor = 0; sensor < NUMBER_OF_TOF_SENSORS; sensor++) {
+      frames.insert(frames.end(), chips[sensor]->frames.begin(), chips[sensor]->frames.end());
+    }
+    bitBangClocks = clocks;
+  }
+  // the same frames in the order they were sent
+  std::vector<Frame> ordered;
+  size_t next[NUMBER_OF_TOF_SENSORS] = {};
+  for (size_t pos = 0; pos < bitBangClocks.size();) {
+    const uint8_t sensor = bitBangClocks[pos].sck == SCK_PINS[0] ? 0 : 1;
+    const Frame &frame = chips[sensor]->frames[next[sensor]++];
+    ordered.push_back(frame);
+    pos += frame.tx.size() * 8;
+  }
+  TEST_ASSERT_EQUAL(frames.size(), ordered.size());
+
+  resetBus();
+  PGAHardwareSpiTransport hardware;
+  for (uint8_t sensor = 0; sensor < NUMBER_OF_TOF_SENSORS; sensor++) {
+    TEST_ASSERT_TRUE(hardware.attach(sensor, SCK_PINS[sensor], MOSI_PINS[sensor], MISO_PINS[sensor]));
+  }
+  const spi_t *bus = hostSpiBus(HSPI);
+  TEST_ASSERT_EQUAL(SPI_MODE0, bus->dataMode);
+  TEST_ASSERT_EQUAL(SPI_LSBFIRST, bus->bitOrder);
+  for (const Frame &frame : ordered) {
+    std::vector<uint8_t> rx(frame.tx.size());
+    hardware.transfer(frame.sensor, frame.tx.data(), rx.data(), rx.size());
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(frame.rx.data(), rx.data(), rx.size());
+  }
+
+  TEST_ASSERT_EQUAL(bitBangClocks.size(), clocks.size());
+  for (size_t pos = 0; pos < clocks.size(); pos++) {
+    TEST_ASSERT_TRUE_MESSAGE(bitBangClocks[pos] == clocks[pos], "clock differs");
+  }
+  TEST_PRINTF("%u frames, %u clocks", (unsigned) ordered.size(), (unsigned) clocks.size());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_checksum_matches_the_former_bitwise_one);
+  RUN_TEST(test_every_host_frame_has_a_valid_checksum);
+  RUN_TEST(test_bit_bang_and_hardware_spi_send_the_same_frames);
+  return UNITY_END();
+}
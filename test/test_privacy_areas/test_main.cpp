@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+/* Moving the tracks of older firmware to the monthly directories. */
+/* The privacy area index against the haversine loop over all areas it
+ * replaced, and how long a lookup takes with many areas.
+ */
+
+#define OBSCLASSIC 1
+#include "hostglobals.h"
+#include "hostclock.h"
+
+#include "privacyareaindex.cpp"
+
+#include <unity.h>
+
+#include <functional>
+#include <random>
+
+static const size_t AREA_COUNT = 1000;
+static const int POINTS_PER_AREA = 50;
+static const int BENCHMARK_POINTS = 20000;
+
+static std::minstd_rand generator(815);
+
+static double uniform(double from, double to) {
+  return std::uniform_real_distribution<double>(from, to)(generator);
+}
+
+/* The lookup before the index, each area with a haversine. */
+static bool isInsideAny(const std::vector<PrivacyArea> &areas, double latitude, double longitude) {
+  for (const PrivacyArea &pa : areas) {
+    if (PrivacyAreaIndex::haversine(
+      latitude, longitude, pa.transformedLatitude, pa.transformedLongitude) < pa.radius) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static PrivacyArea area(double latitude, double longitude, double radius) {
+  return {latitude, longitude, latitude, longitude, radius};
+}
+
+/* Random areas with radii from 0 to 300km, and areas at the poles, the
+ * antimeridian and 0/0.
+ */
+static std::vector<PrivacyArea> areas(size_t count) {
+  std::vector<PrivacyArea> result = {
+    area(0, 0, 500), area(90, 0, 20000), area(-89.999, 42, 1000), area(89.5, -120, 300000),
+    area(12.5, 180, 2000), area(-33.3, -179.999, 50000), area(65.1, 179.99, 100),
+    area(48.7766, 9.1822, 0),
+  };
+  while (result.size() < count) {
+    const double radius = pow(10, uniform(0, log10(300000)));
+    result.push_back(area(uniform(-90, 90), uniform(-180, 180), radius));
+  }
+  return result;
+}
+
+/* The point at the distance in m and the bearing in rad, on a sphere. */
+static void destination(const PrivacyArea &from, double distance, double bearing,
+                        double &latitude, double &longitude) {
+  const double angle = distance / 6371000.0;
+  const double lat1 = from.transformedLatitude * M_PI / 180.0;
+  const double lat2 = asin(sin(lat1) * cos(angle) + cos(lat1) * sin(angle) * cos(bearing));
+  const double deltaLongitude = atan2(sin(bearing) * sin(angle) * cos(lat1),
+                                      cos(angle) - sin(lat1) * sin(lat2));
+  latitude = lat2 * 180.0 / M_PI;
+  longitude = remainder(from.transformedLongitude + deltaLongitude * 180.0 / M_PI, 360.0);
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_index_matches_the_haversine_loop() {
+  const std::vector<PrivacyArea> all = areas(AREA_COUNT);
+  PrivacyAreaIndex index;
+  index.build(all);
+  int checked = 0, inside = 0;
+  for (const PrivacyArea &pa : all) {
+    for (int i = 0; i < POINTS_PER_AREA; i++) {
+      double latitude, longitude;
+      // mostly close to the border, where the flat earth distance is not
+      // good enough
+      const double distance = i % 5 == 0
+        ? uniform(0, 2 * pa.radius) : pa.radius * uniform(0.98, 1.02);
+      destination(pa, distance, uniform(0, 2 * M_PI), latitude, longitude);
+      const bool expected = isInsideAny(all, latitude, longitude);
+      if (expected != index.contains(latitude, longitude)) {
+        TEST_PRINTF("lat %.9f lon %.9f, area %.6f/%.6f r %.1fm", latitude, longitude,
+                    pa.transformedLatitude, pa.transformedLongitude, pa.radius);
+        TEST_ASSERT_EQUAL(expected, index.contains(latitude, longitude));
+      }
+      checked++;
+      inside += expected;
+    }
+  }
+  for (int i = 0; i < 10000; i++) {
+    const double latitude = uniform(-90, 90), longitude = uniform(-180, 180);
+    TEST_ASSERT_EQUAL(isInsideAny(all, latitude, longitude), index.contains(latitude, longitude));
+    checked++;
+  }
+  TEST_PRINTF("%d points, %d of them inside", checked, inside);
+}
+
+void test_no_areas_contain_nothing() {
+  PrivacyAreaIndex index;
+  index.build({});
+  TEST_ASSERT_FALSE(index.contains(0, 0));
+  TEST_ASSERT_FALSE(index.contains(48.7766, 9.1822));
+}
+
+static double lookupMicros(const std::function<bool(double, double)> &lookup,
+                           const std::vector<std::pair<double, double>> &points, int &inside) {
+  inside = 0;
+  const unsigned long start = micros();
+  for (const auto &point : points) {
+    inside += lookup(point.first, point.second);
+  }
+  return (double) (micros() - start) / points.size();
+}
+
+void test_lookup_benchmark() {
+  std::vector<std::pair<double, double>> points;
+  for (int i = 0; i < BENCHMARK_POINTS; i++) {
+    // in and around Europe, where the areas are
+    points.emplace_back(uniform(45, 55), uniform(5, 15));
+  }
+  for (size_t count : {10, 1000}) {
+    std::vector<PrivacyArea> all;
+    while (all.size() < count) {
+      all.push_back(area(uniform(45, 55), uniform(5, 15), uniform(50, 500)));
+    }
+    PrivacyAreaIndex index;
+    index.build(all);
+    int loopInside, indexInside;
+    const double loop = lookupMicros(
+      [&all](double latitude, double longitude) { return isInsideAny(all, latitude, longitude); },
+      points, loopInside);
+    const double indexed = lookupMicros(
+      [&index](double latitude, double longitude) { return index.contains(latitude, longitude); },
+      points, indexInside);
+    TEST_PRINTF("%u areas: haversine loop %.3fus, index %.3fus per lookup",
+                (unsigned) count, loop, indexed);
+    TEST_ASSERT_EQUAL(loopInside, indexInside);
+    if (count == 1000) {
+      TEST_ASSERT_TRUE(indexed * 10 < loop);
+    }
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_index_matches_the_haversine_loop);
+  RUN_TEST(test_no_areas_contain_nothing);
+  RUN_TEST(test_lookup_benchmark);
+  return UNITY_END();
+}
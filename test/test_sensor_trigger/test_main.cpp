@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+/* Drives the HC-SR04 trigger timer and the captureCycle() hand-over to
+ * the main loop with simulated echoes, see sensorbench.h.
+ */
+
+#define OBSCLASSIC 1
+#include "hostglobals.h"
+#include "sensorbench.h"
+
+#include "sensor.cpp"
+#include "echocapture.cpp"
+#include "cadence.cpp"
+#include "utils/soundspeed.cpp"
+
+#include <unity.h>
+
+static const uint8_t RIGHT = 0;
+static const uint8_t LEFT = 1;
+static const uint8_t RIGHT_TRIGGER_PIN = 15;
+static const uint8_t RIGHT_ECHO_PIN = 4;
+static const uint8_t LEFT_TRIGGER_PIN = 25;
+static const uint8_t LEFT_ECHO_PIN = 26;
+
+static HCSR04SensorManager *manager;
+
+// 100cm on the right, 293cm on the left
+static void fixedEcho(uint8_t pin, uint32_t now, std::vector<bench::Edge> &edges) {
+  if (pin == RIGHT_TRIGGER_PIN) {
+    bench::echo(edges, RIGHT_ECHO_PIN, now + 300, 5800);
+  } else {
+    bench::echo(edges, LEFT_ECHO_PIN, now + 300, 17000);
+  }
+}
+
+static std::vector<uint32_t> triggerIntervals(uint8_t pin) {
+  std::vector<uint32_t> intervals;
+  uint32_t last = 0;
+  for (const auto &trigger : bench::triggers) {
+    if (trigger.first == pin) {
+      if (last) {
+        intervals.push_back(trigger.second - last);
+      }
+      last = trigger.second;
+    }
+  }
+  return intervals;
+}
+
+void setUp() {
+  bench::reset(fixedEcho);
+  manager = new HCSR04SensorManager;
+  HCSR04SensorInfo right;
+  right.triggerPin = RIGHT_TRIGGER_PIN;
+  right.echoPin = RIGHT_ECHO_PIN;
+  right.sensorLocation = (char*) "Right";
+  HCSR04SensorInfo left;
+  left.triggerPin = LEFT_TRIGGER_PIN;
+  left.echoPin = LEFT_ECHO_PIN;
+  left.sensorLocation = (char*) "Left";
+  manager->registerSensor(right, RIGHT);
+  manager->registerSensor(left, LEFT);
+  manager->setPrimarySensor(LEFT);
+}
+
+void tearDown() {
+  delete manager;
+}
+
+static void runSeconds(int seconds, uint32_t loopMicros) {
+  for (int i = 0; i < seconds; i++) {
+    manager->reset(millis());
+    bench::run(1000000, loopMicros, []() { manager->pollDistancesAlternating(); });
+  }
+}
+
+void test_timer_measures_both_sides() {
+  TEST_ASSERT_TRUE(manager->startTriggerTimer());
+  runSeconds(3, 150000);
+  TEST_ASSERT_INT_WITHIN(1, 100, manager->sensorValues[RIGHT]);
+  TEST_ASSERT_INT_WITHIN(1, 293, manager->sensorValues[LEFT]);
+  // one cycle is 61.2ms, the main loop collects every 150ms only
+  TEST_ASSERT_INT_WITHIN(1, 16, manager->m_sensors[LEFT].numberOfTriggers);
+  TEST_ASSERT_INT_WITHIN(1, 16, manager->m_sensors[RIGHT].numberOfTriggers);
+  TEST_ASSERT_INT_WITHIN(2, 16, manager->lastReadingCount);
+  TEST_ASSERT_EQUAL_UINT32(0, manager->getNumberOfLostCycles());
+}
+
+void test_timer_cadence_does_not_jitter_with_the_loop() {
+  manager->startTriggerTimer();
+  // the main loop is slow and irregular
+  bench::run(3000000, 1, []() {
+    if (rand() % 50000 == 0) {
+      manager->pollDistancesAlternating();
+    }
+  });
+  const auto intervals = triggerIntervals(LEFT_TRIGGER_PIN);
+  TEST_ASSERT_GREATER_THAN(40, intervals.size());
+  const auto minmax = std::minmax_element(intervals.begin(), intervals.end());
+  TEST_ASSERT_LESS_OR_EQUAL(TRIGGER_TIMER_TICK_MICRO_SEC, *minmax.second - *minmax.first);
+  // every trigger starts on a timer tick
+  for (const auto &trigger : bench::triggers) {
+    TEST_ASSERT_EQUAL_UINT32(0, trigger.second % TRIGGER_TIMER_TICK_MICRO_SEC);
+  }
+}
+
+void test_cycles_are_lost_only_if_the_loop_stalls() {
+  manager->startTriggerTimer();
+  runSeconds(2, 400000);
+  TEST_ASSERT_EQUAL_UINT32(0, manager->getNumberOfLostCycles());
+  // 8 buffered cycles cover about 490ms
+  runSeconds(2, 1000000);
+  TEST_ASSERT_GREATER_THAN(0, manager->getNumberOfLostCycles());
+  TEST_ASSERT_INT_WITHIN(1, 100, manager->sensorValues[RIGHT]);
+  TEST_ASSERT_INT_WITHIN(1, 293, manager->sensorValues[LEFT]);
+}
+
+void test_reset_restarts_trigger_count() {
+  manager->startTriggerTimer();
+  runSeconds(1, 150000);
+  manager->reset(millis());
+  TEST_ASSERT_EQUAL_UINT16(0, manager->m_sensors[LEFT].numberOfTriggers);
+  TEST_ASSERT_EQUAL_UINT16(0, manager->m_sensors[RIGHT].numberOfTriggers);
+  bench::run(500000, 150000, []() { manager->pollDistancesAlternating(); });
+  TEST_ASSERT_INT_WITHIN(1, 8, manager->m_sensors[LEFT].numberOfTriggers);
+}
+
+void test_stop_timer_falls_back_to_polling() {
+  manager->startTriggerTimer();
+  runSeconds(1, 150000);
+  manager->stopTriggerTimer();
+  TEST_ASSERT_FALSE(manager->isTriggeredByTimer());
+  runSeconds(2, 1000);
+  TEST_ASSERT_INT_WITHIN(1, 100, manager->sensorValues[RIGHT]);
+  TEST_ASSERT_INT_WITHIN(1, 293, manager->sensorValues[LEFT]);
+  TEST_ASSERT_GREATER_THAN(10, manager->lastReadingCount);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_timer_measures_both_sides);
+  RUN_TEST(test_timer_cadence_does_not_jitter_with_the_loop);
+  RUN_TEST(test_cycles_are_lost_only_if_the_loop_stalls);
+  RUN_TEST(test_reset_restarts_trigger_count);
+  RUN_TEST(test_stop_timer_falls_back_to_polling);
+  return UNITY_END();
+}
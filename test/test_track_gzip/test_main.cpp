@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+/* Writes random tracks plain and gzip compressed, the compressed track
+ * must inflate to the plain one, also when SD card writes fail for a
+ * while. Reports the CPU time per record the compression takes.
+ */
+
+#define OBSCLASSIC 1
+#include "hostwriter.h"
+#include "hostclock.h"
+
+static bool hostCompressTracks = false;
+#define COMPRESS_TRACK_FILES hostCompressTracks
+
+#include "writer.cpp"
+#include "trackindex.cpp"
+#include "gpsrecord.cpp"
+#include "gpsepochs.cpp"
+#include "utils/gzip.cpp"
+#include "utils/timeutils.cpp"
+#include "utils/soundspeed.cpp"
+#include "hostdatasets.h"
+
+#include <unity.h>
+#include <zlib.h>
+#include <chrono>
+
+static const time_t TRACK_START = 1760000000 - 1760000000 % 60;
+static bool lastFlushResult;
+
+/* Writes the track in the foreground, writes fail from set failFrom
+ * till failTo. Returns the content of the track file.
+ */
+static std::string writeTrack(bool compressed, int sets, int failFrom = -1, int failTo = -1) {
+  hostCompressTracks = compressed;
+  fs::hostCard.clear();
+  srand(7);
+  DataSet set;
+  auto *writer = new CSVFileWriter;
+  writer->setFileName();
+  writer->writeHeader("test-track");
+  for (int idx = 0; idx < sets; idx++) {
+    // seconds without development comments, they depend on timing
+    randomDataSet(set, TRACK_START + 60 * idx + 45 + idx % 15);
+    fs::hostCard.failWrites = idx >= failFrom && idx < failTo;
+    writer->append(set);
+    lastFlushResult = writer->flush(idx % 30 == 29);
+  }
+  delete writer;
+  fs::hostCard.failWrites = false;
+  for (const auto &file : fs::hostCard.files) {
+    if (CSVFileWriter::isTrackFile(String(file.first))) {
+      return file.second->content;
+    }
+  }
+  return "";
+}
+
+/* Inflates the gzip data, complete tells if the stream had its end. */
+static std::string inflateGzip(const std::string &data, bool &complete) {
+  z_stream stream = {};
+  TEST_ASSERT_EQUAL(Z_OK, inflateInit2(&stream, 16 + MAX_WBITS));
+  stream.next_in = (Bytef *) data.data();
+  stream.avail_in = data.size();
+  std::string result;
+  int status;
+  do {
+    char buffer[16384];
+    stream.next_out = (Bytef *) buffer;
+    stream.avail_out = sizeof(buffer);
+    status = inflate(&stream, Z_SYNC_FLUSH);
+    result.append(buffer, sizeof(buffer) - stream.avail_out);
+  } while (status == Z_OK && (stream.avail_in > 0 || stream.avail_out == 0));
+  TEST_ASSERT_TRUE(status == Z_STREAM_END || status == Z_OK || status == Z_BUF_ERROR);
+  complete = status == Z_STREAM_END && stream.avail_in == 0;
+  inflateEnd(&stream);
+  return result;
+}
+
+static std::string inflateGzip(const std::string &data) {
+  bool complete;
+  const std::string result = inflateGzip(data, complete);
+  TEST_ASSERT_TRUE(complete);
+  return result;
+}
+
+void setUp() {
+  hostTaskCreationFails() = true;
+  hostNvs.clear();
+  config.sensorOffsets.assign(2, 30);
+  config.privacyConfig = NoPrivacy;
+}
+
+void tearDown() {
+  hostTaskCreationFails() = false;
+}
+
+void test_compressed_track_inflates_to_the_plain_track() {
+  const std::string plain = writeTrack(false, 600);
+  const std::string compressed = writeTrack(true, 600);
+  TEST_ASSERT_GREATER_THAN(10000, plain.size());
+  TEST_ASSERT_LESS_THAN(plain.size() / 2, compressed.size());
+  const std::string inflated = inflateGzip(compressed);
+  TEST_ASSERT_TRUE(inflated == plain);
+}
+
+void test_failed_writes_are_retried() {
+  const std::string plain = writeTrack(false, 600);
+  const std::string retried = writeTrack(false, 600, 100, 160);
+  TEST_ASSERT_TRUE(retried == plain);
+}
+
+void test_failed_compressed_writes_are_retried() {
+  const std::string plain = writeTrack(false, 600);
+  const std::string retried = writeTrack(true, 600, 100, 160);
+  const std::string inflated = inflateGzip(retried);
+  TEST_ASSERT_TRUE(inflated == plain);
+}
+
+void test_track_fails_when_the_card_stays_away() {
+  const std::string plain = writeTrack(false, 600);
+  const std::string failed = writeTrack(false, 600, 100, 600);
+  TEST_ASSERT_FALSE(lastFlushResult);
+  TEST_ASSERT_GREATER_THAN(0, failed.size());
+  TEST_ASSERT_LESS_THAN(plain.size(), failed.size());
+  TEST_ASSERT_TRUE(plain.compare(0, failed.size(), failed) == 0);
+}
+
+void test_failed_compressed_track_inflates_partially() {
+  const std::string plain = writeTrack(false, 600);
+  const std::string failed = writeTrack(true, 600, 100, 600);
+  bool complete;
+  const std::string inflated = inflateGzip(failed, complete);
+  TEST_ASSERT_FALSE(complete);
+  TEST_ASSERT_GREATER_THAN(0, inflated.size());
+  TEST_ASSERT_TRUE(plain.compare(0, inflated.size(), inflated) == 0);
+}
+
+void test_cpu_time_per_record() {
+  const int sets = 3000;
+  auto start = std::chrono::steady_clock::now();
+  const std::string plain = writeTrack(false, sets);
+  const double plainSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  start = std::chrono::steady_clock::now();
+  const std::string compressed = writeTrack(true, sets);
+  const double compressedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  char message[160];
+  snprintf(message, sizeof(message),
+           "plain %.1f us/record, gzip %.1f us/record, %.1f%% of the plain size",
+           1e6 * plainSeconds / sets, 1e6 * compressedSeconds / sets,
+           100.0 * compressed.size() / plain.size());
+  TEST_MESSAGE(message);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_compressed_track_inflates_to_the_plain_track);
+  RUN_TEST(test_failed_writes_are_retried);
+  RUN_TEST(test_failed_compressed_writes_are_retried);
+  RUN_TEST(test_track_fails_when_the_card_stays_away);
+  RUN_TEST(test_failed_compressed_track_inflates_partially);
+  RUN_TEST(test_cpu_time_per_record);
+  return UNITY_END();
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+/* Moving the tracks of older firmware to the monthly directories. */
+
+#define OBSCLASSIC 1
+#include "hostwriter.h"
+#include "hostclock.h"
+
+#include "writer.cpp"
+#include "trackindex.cpp"
+#include "gpsrecord.cpp"
+#include "gpsepochs.cpp"
+#include "utils/gzip.cpp"
+#include "utils/timeutils.cpp"
+#include "utils/soundspeed.cpp"
+
+#include <unity.h>
+
+static const char * const ROOT_TRACK = "/2025-07-01T17.22.41-abcd.obsdata.csv";
+static const char * const MIGRATED_TRACK = "/tracks/2025/07/2025-07-01T17.22.41-abcd.obsdata.csv";
+static const char * const UPLOADED_TRACK = "/uploaded/2025-06-03T08.00.12-abcd.obsdata.csv";
+static const char * const MIGRATED_UPLOADED_TRACK = "/uploaded/2025/06/2025-06-03T08.00.12-abcd.obsdata.csv";
+
+static void addFile(const char *fileName) {
+  TrackIndex::createDirectories(fileName);
+  File file = SD.open(fileName, FILE_WRITE);
+  file.print("track");
+  file.close();
+}
+
+void setUp() {
+  fs::hostCard.clear();
+}
+
+void tearDown() {
+}
+
+void test_tracks_are_moved_once() {
+  addFile(ROOT_TRACK);
+  addFile(UPLOADED_TRACK);
+  TEST_ASSERT_EQUAL(2, TrackIndex::migrate());
+  TEST_ASSERT_TRUE(SD.exists(MIGRATED_TRACK));
+  TEST_ASSERT_TRUE(SD.exists(MIGRATED_UPLOADED_TRACK));
+  TEST_ASSERT_TRUE(SD.exists(TrackIndex::MIGRATED_FILE_NAME));
+
+  addFile(ROOT_TRACK);
+  TEST_ASSERT_EQUAL(0, TrackIndex::migrate());
+  TEST_ASSERT_TRUE(SD.exists(ROOT_TRACK));
+}
+
+void test_interrupted_migration_is_continued() {
+  // the power was cut after the first directory was created
+  SD.mkdir(TrackIndex::TRACKS_DIRECTORY);
+  addFile(ROOT_TRACK);
+  TEST_ASSERT_EQUAL(1, TrackIndex::migrate());
+  TEST_ASSERT_FALSE(SD.exists(ROOT_TRACK));
+  TEST_ASSERT_TRUE(SD.exists(MIGRATED_TRACK));
+}
+
+void test_failed_move_is_retried() {
+  addFile(ROOT_TRACK);
+  addFile(MIGRATED_TRACK);
+  TEST_ASSERT_EQUAL(0, TrackIndex::migrate());
+  TEST_ASSERT_FALSE(SD.exists(TrackIndex::MIGRATED_FILE_NAME));
+
+  SD.remove(MIGRATED_TRACK);
+  TEST_ASSERT_EQUAL(1, TrackIndex::migrate());
+  TEST_ASSERT_TRUE(SD.exists(MIGRATED_TRACK));
+  TEST_ASSERT_TRUE(SD.exists(TrackIndex::MIGRATED_FILE_NAME));
+}
+
+void test_uploaded_name_keeps_the_month() {
+  const String uploaded = TrackIndex::uploadedName(MIGRATED_TRACK);
+  TEST_ASSERT_EQUAL_STRING("/uploaded/2025/07/2025-07-01T17.22.41-abcd.obsdata.csv", uploaded.c_str());
+  const String pending = TrackIndex::pendingName(uploaded);
+  TEST_ASSERT_EQUAL_STRING(MIGRATED_TRACK, pending.c_str());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_tracks_are_moved_once);
+  RUN_TEST(test_interrupted_migration_is_continued);
+  RUN_TEST(test_failed_move_is_retried);
+  RUN_TEST(test_uploaded_name_keeps_the_month);
+  return UNITY_END();
+}
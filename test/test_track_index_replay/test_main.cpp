@@ -0,0 +1,248 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+/* The track index file: replaying its "+", ">" and "-" lines, the
+ * compaction when it grew long or lost its last line to a power cut, and
+ * rebuilding it from a card written by older firmware.
+ */
+
+#define OBSCLASSIC 1
+#include "hostwriter.h"
+#include "hostclock.h"
+
+#include "writer.cpp"
+#include "trackindex.cpp"
+#include "gpsrecord.cpp"
+#include "gpsepochs.cpp"
+#include "utils/gzip.cpp"
+#include "utils/timeutils.cpp"
+#include "utils/soundspeed.cpp"
+
+#include <unity.h>
+#include <algorithm>
+#include <vector>
+
+static const char * const TRACK_A = "/tracks/2025/07/2025-07-01T17.22.41-abcd.obsdata.csv";
+static const char * const UPLOADED_A = "/uploaded/2025/07/2025-07-01T17.22.41-abcd.obsdata.csv";
+static const char * const TRACK_B = "/tracks/2025/07/2025-07-02T08.00.00-abcd.obsdata.csv";
+static const char * const TRACK_C = "/tracks/2025/08/2025-08-11T19.30.05-abcd.obsdata.csv.gz";
+
+static void writeIndex(const std::string &content) {
+  fs::hostCard.files[TrackIndex::FILE_NAME] = std::make_shared<fs::HostFileData>();
+  fs::hostCard.files[TrackIndex::FILE_NAME]->content = content;
+}
+
+static std::string readIndex() {
+  return fs::hostCard.read(TrackIndex::FILE_NAME);
+}
+
+static size_t countLines(const std::string &content) {
+  return std::count(content.begin(), content.end(), '\n');
+}
+
+static void writeFile(const char *fileName, const std::string &content) {
+  TrackIndex::createDirectories(fileName);
+  File file = SD.open(fileName, FILE_WRITE);
+  file.print(content.c_str());
+  file.close();
+}
+
+static time_t localTime(int year, int month, int day, int hour, int minute, int second) {
+  tm time = {};
+  time.tm_year = year - 1900;
+  time.tm_mon = month - 1;
+  time.tm_mday = day;
+  time.tm_hour = hour;
+  time.tm_min = minute;
+  time.tm_sec = second;
+  return mktime(&time);
+}
+
+/* A track as older firmware wrote it, a confirmed overtake every 10th line. */
+static std::string oldTrack(int day, int lines) {
+  std::string csv = "OBSFirmwareVersion=v0.3.5&OBSDataFormat=2\n"
+                    "Date;Time;Millis;Comment;Latitude;Longitude;Altitude;Course;Speed;"
+                    "HDOP;Satellites;BatteryLevel;Left;Right;Confirmed;Marked;Invalid\n";
+  for (int line = 0; line < lines; line++) {
+    char text[96];
+    snprintf(text, sizeof(text), "%02d.07.2025;10:%02d:%02d;%d;;;;;;;;;3.9;150;;%d;;0\n",
+             day, line / 60, line % 60, line * 1000, line % 10 == 9 ? 150 : 0);
+    csv += text;
+  }
+  return csv;
+}
+
+void setUp() {
+  fs::hostCard.clear();
+}
+
+void tearDown() {
+}
+
+void test_lines_are_replayed_in_order() {
+  std::vector<TrackSummary> tracks;
+  TEST_ASSERT_FALSE(TrackIndex::load(tracks));
+
+  writeIndex(std::string("+ ") + TRACK_A + ";1751390561;600;600;3;0\n"
+             + "+ " + TRACK_B + ";1751436000;60;60;0;0\n"
+             // a later summary replaces the earlier one in place
+             + "+ " + TRACK_A + ";1751390561;900;901;4;0\n"
+             + "> " + TRACK_A + ";" + UPLOADED_A + "\n"
+             + "- " + TRACK_B + "\n"
+             + "+ " + TRACK_C + ";1754933405;1200;1190;7;0\n"
+             // unknown tracks and lines are ignored
+             + "> /tracks/unknown.obsdata.csv;/uploaded/unknown.obsdata.csv\n"
+             + "- /tracks/unknown.obsdata.csv\n"
+             + "? what\n"
+             + "+ " + TRACK_B + ";no numbers\n");
+  TEST_ASSERT_TRUE(TrackIndex::load(tracks));
+  TEST_ASSERT_EQUAL(2, tracks.size());
+
+  TEST_ASSERT_EQUAL_STRING(UPLOADED_A, tracks[0].fileName.c_str());
+  TEST_ASSERT_TRUE(tracks[0].uploaded);
+  TEST_ASSERT_EQUAL(1751390561, tracks[0].start);
+  TEST_ASSERT_EQUAL(900, tracks[0].durationSeconds);
+  TEST_ASSERT_EQUAL(901, tracks[0].records);
+  TEST_ASSERT_EQUAL(4, tracks[0].overtakes);
+
+  TEST_ASSERT_EQUAL_STRING(TRACK_C, tracks[1].fileName.c_str());
+  TEST_ASSERT_FALSE(tracks[1].uploaded);
+  TEST_ASSERT_EQUAL(1754933405, tracks[1].start);
+  TEST_ASSERT_EQUAL(1200, tracks[1].durationSeconds);
+  TEST_ASSERT_EQUAL(1190, tracks[1].records);
+  TEST_ASSERT_EQUAL(7, tracks[1].overtakes);
+
+  // moved back to upload it again
+  TrackIndex::move(UPLOADED_A, TRACK_A);
+  TrackIndex::remove(TRACK_C);
+  TEST_ASSERT_TRUE(TrackIndex::load(tracks));
+  TEST_ASSERT_EQUAL(1, tracks.size());
+  TEST_ASSERT_EQUAL_STRING(TRACK_A, tracks[0].fileName.c_str());
+  TEST_ASSERT_FALSE(tracks[0].uploaded);
+}
+
+void test_changes_need_an_index() {
+  TrackSummary track;
+  track.fileName = TRACK_A;
+  TrackIndex::add(track);
+  TrackIndex::move(TRACK_A, UPLOADED_A);
+  // rebuild() finds them all later
+  TEST_ASSERT_FALSE(SD.exists(TrackIndex::FILE_NAME));
+}
+
+void test_long_index_is_compacted() {
+  std::string content;
+  for (int update = 1; update <= 40; update++) {
+    content += std::string("+ ") + TRACK_A + ";1751390561;" + std::to_string(update)
+               + ";" + std::to_string(update) + ";0;0\n";
+  }
+  content += std::string("+ ") + TRACK_B + ";1751436000;60;60;0;0\n";
+  writeIndex(content);
+
+  std::vector<TrackSummary> tracks;
+  TEST_ASSERT_TRUE(TrackIndex::load(tracks));
+  TEST_ASSERT_EQUAL(2, tracks.size());
+  const std::string compacted = readIndex();
+  const std::string expected = std::string("+ ") + TRACK_A + ";1751390561;40;40;0;0\n"
+                               + "+ " + TRACK_B + ";1751436000;60;60;0;0\n";
+  TEST_ASSERT_EQUAL_STRING(expected.c_str(), compacted.c_str());
+  TEST_ASSERT_FALSE(SD.exists(String(TrackIndex::FILE_NAME) + ".tmp"));
+
+  // a short index is left as it is
+  const std::string shortIndex = expected + "+ " + TRACK_A + ";1751390561;41;41;0;0\n";
+  writeIndex(shortIndex);
+  TEST_ASSERT_TRUE(TrackIndex::load(tracks));
+  const std::string unchanged = readIndex();
+  TEST_ASSERT_EQUAL_STRING(shortIndex.c_str(), unchanged.c_str());
+  TEST_ASSERT_EQUAL(41, tracks[0].records);
+}
+
+void test_index_cut_by_a_power_loss_is_rewritten() {
+  const std::string complete = std::string("+ ") + TRACK_A + ";1751390561;600;600;3;0\n"
+                               + "+ " + TRACK_B + ";1751436000;60;60;0;0\n";
+  writeIndex(complete + "- " + std::string(TRACK_A).substr(0, 20));
+  std::vector<TrackSummary> tracks;
+  TEST_ASSERT_TRUE(TrackIndex::load(tracks));
+  TEST_ASSERT_EQUAL(2, tracks.size());
+  const std::string rewritten = readIndex();
+  TEST_ASSERT_EQUAL_STRING(complete.c_str(), rewritten.c_str());
+
+  // the next change is not glued to the cut line
+  TrackIndex::remove(TRACK_B);
+  TEST_ASSERT_TRUE(TrackIndex::load(tracks));
+  TEST_ASSERT_EQUAL(1, tracks.size());
+  TEST_ASSERT_EQUAL_STRING(TRACK_A, tracks[0].fileName.c_str());
+  TEST_ASSERT_EQUAL(3, countLines(readIndex()));
+}
+
+void test_rebuild_indexes_a_card_of_older_firmware() {
+  writeFile("/2025-07-03T10.00.00-abcd.obsdata.csv", oldTrack(3, 120));
+  writeFile("/uploaded/2025-07-01T10.00.00-abcd.obsdata.csv", oldTrack(1, 30));
+  writeFile("/tracks/2025/07/2025-07-02T10.00.00-abcd.obsdata.csv", oldTrack(2, 61));
+  writeFile(TRACK_C, "not read for a summary");
+  writeFile("/tracknumber.txt", "12");
+  writeFile("/ald_ini.ubx", "ubx");
+  writeIndex("+ /gone.obsdata.csv;1;1;1;0;0\n");
+
+  TEST_ASSERT_EQUAL(4, TrackIndex::rebuild());
+  std::vector<TrackSummary> tracks;
+  TEST_ASSERT_TRUE(TrackIndex::load(tracks));
+  TEST_ASSERT_EQUAL(4, tracks.size());
+
+  // sorted by start
+  TEST_ASSERT_EQUAL_STRING("/uploaded/2025-07-01T10.00.00-abcd.obsdata.csv", tracks[0].fileName.c_str());
+  TEST_ASSERT_TRUE(tracks[0].uploaded);
+  TEST_ASSERT_EQUAL(localTime(2025, 7, 1, 10, 0, 0), tracks[0].start);
+  TEST_ASSERT_EQUAL(29, tracks[0].durationSeconds);
+  TEST_ASSERT_EQUAL(30, tracks[0].records);
+  TEST_ASSERT_EQUAL(3, tracks[0].overtakes);
+
+  TEST_ASSERT_EQUAL_STRING("/tracks/2025/07/2025-07-02T10.00.00-abcd.obsdata.csv", tracks[1].fileName.c_str());
+  TEST_ASSERT_FALSE(tracks[1].uploaded);
+  TEST_ASSERT_EQUAL(60, tracks[1].durationSeconds);
+  TEST_ASSERT_EQUAL(61, tracks[1].records);
+  TEST_ASSERT_EQUAL(6, tracks[1].overtakes);
+
+  TEST_ASSERT_EQUAL_STRING("/2025-07-03T10.00.00-abcd.obsdata.csv", tracks[2].fileName.c_str());
+  TEST_ASSERT_FALSE(tracks[2].uploaded);
+  TEST_ASSERT_EQUAL(localTime(2025, 7, 3, 10, 0, 0), tracks[2].start);
+  TEST_ASSERT_EQUAL(119, tracks[2].durationSeconds);
+  TEST_ASSERT_EQUAL(120, tracks[2].records);
+  TEST_ASSERT_EQUAL(12, tracks[2].overtakes);
+
+  // compressed tracks are not read, the start comes from the name
+  TEST_ASSERT_EQUAL_STRING(TRACK_C, tracks[3].fileName.c_str());
+  TEST_ASSERT_EQUAL(localTime(2025, 8, 11, 19, 30, 5), tracks[3].start);
+  TEST_ASSERT_EQUAL(0, tracks[3].records);
+  TEST_ASSERT_EQUAL(4, countLines(readIndex()));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_lines_are_replayed_in_order);
+  RUN_TEST(test_changes_need_an_index);
+  RUN_TEST(test_long_index_is_compacted);
+  RUN_TEST(test_index_cut_by_a_power_loss_is_rewritten);
+  RUN_TEST(test_rebuild_indexes_a_card_of_older_firmware);
+  return UNITY_END();
+}
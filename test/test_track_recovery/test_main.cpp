@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+/* Cuts the power at each SD card write while a track is written, with a
+ * random part of the unflushed data on the card. FileWriter::recoverTrack()
+ * must leave a track that is a prefix of the complete one and ends with a
+ * complete line.
+ */
+
+#define OBSCLASSIC 1
+#include "hostwriter.h"
+#include "hostclock.h"
+
+static bool hostCompressTracks = false;
+#define COMPRESS_TRACK_FILES hostCompressTracks
+
+#include "writer.cpp"
+#include "trackindex.cpp"
+#include "gpsrecord.cpp"
+#include "gpsepochs.cpp"
+#include "utils/gzip.cpp"
+#include "utils/timeutils.cpp"
+#include "utils/soundspeed.cpp"
+#include "hostdatasets.h"
+
+#include <unity.h>
+#include <zlib.h>
+
+static const time_t TRACK_START = 1760000000 - 1760000000 % 60;
+static const int TRACK_SETS = 300;
+static const int POWER_CUT_ROUNDS = 3;
+// never destroyed, that would write to the card after the power cut
+static std::vector<FileWriter *> powerCutWriters;
+
+static std::string trackContent() {
+  for (const auto &file : fs::hostCard.files) {
+    if (CSVFileWriter::isTrackFile(String(file.first))) {
+      return file.second->content;
+    }
+  }
+  return "";
+}
+
+/* Writes a track in the foreground, writes fail from set failFrom on.
+ * Returns the number of SD card writes before the writer is closed.
+ */
+static uint32_t writeTrack(bool compressed, int failFrom = TRACK_SETS) {
+  hostCompressTracks = compressed;
+  srand(11);
+  DataSet set;
+  auto *writer = new CSVFileWriter;
+  try {
+    writer->setFileName();
+    writer->writeHeader("test-track");
+    for (int idx = 0; idx < TRACK_SETS; idx++) {
+      // seconds without development comments, they depend on timing
+      randomDataSet(set, TRACK_START + 60 * idx + 45 + idx % 15);
+      fs::hostCard.failWrites = idx >= failFrom;
+      writer->append(set);
+      writer->flush(idx % 30 == 29);
+    }
+  } catch (fs::PowerCut &) {
+    powerCutWriters.push_back(writer);
+    return fs::hostCard.writes;
+  }
+  const uint32_t writes = fs::hostCard.writes;
+  delete writer;
+  fs::hostCard.failWrites = false;
+  return writes;
+}
+
+static std::string inflateGzip(const std::string &data) {
+  z_stream stream = {};
+  TEST_ASSERT_EQUAL(Z_OK, inflateInit2(&stream, 16 + MAX_WBITS));
+  stream.next_in = (Bytef *) data.data();
+  stream.avail_in = data.size();
+  std::string result;
+  int status;
+  do {
+    char buffer[16384];
+    stream.next_out = (Bytef *) buffer;
+    stream.avail_out = sizeof(buffer);
+    status = inflate(&stream, Z_NO_FLUSH);
+    result.append(buffer, sizeof(buffer) - stream.avail_out);
+  } while (status == Z_OK);
+  TEST_ASSERT_EQUAL(Z_STREAM_END, status);
+  TEST_ASSERT_EQUAL(0, stream.avail_in);
+  inflateEnd(&stream);
+  return result;
+}
+
+/* The recovered track is a prefix of the complete one of whole lines. */
+static void assertRecovered(bool compressed, const std::string &complete) {
+  const String fileName = FileWriter::recoverTrack();
+  TEST_ASSERT_FALSE(SD.exists("/track.journal"));
+  const std::string content = trackContent();
+  if (fileName.isEmpty()) {
+    TEST_ASSERT_TRUE(content.empty());
+    return;
+  }
+  const std::string csv = compressed ? inflateGzip(content) : content;
+  TEST_ASSERT_LESS_OR_EQUAL(complete.size(), csv.size());
+  TEST_ASSERT_TRUE(complete.compare(0, csv.size(), csv) == 0);
+  TEST_ASSERT_TRUE(csv.empty() || csv.back() == '\n');
+}
+
+static void assertPowerCutsRecovered(bool compressed) {
+  fs::hostCard.clear();
+  writeTrack(false);
+  const std::string complete = trackContent();
+  fs::hostCard.clear();
+  const uint32_t writes = writeTrack(compressed);
+
+  // the cut write and the unflushed data reach the card up to a random
+  // length, see HostCard::powerCut()
+  for (int round = 0; round < POWER_CUT_ROUNDS; round++) {
+    for (uint32_t cut = 1; cut <= writes; cut++) {
+      fs::hostCard.clear();
+      hostNvs.clear();
+      fs::hostCard.random.seed(round * writes + cut);
+      fs::hostCard.cutPowerAfter(cut);
+      writeTrack(compressed);
+      assertRecovered(compressed, complete);
+    }
+  }
+}
+
+void setUp() {
+  hostTaskCreationFails() = true;
+  hostNvs.clear();
+  config.sensorOffsets.assign(2, 30);
+  config.privacyConfig = NoPrivacy;
+}
+
+void tearDown() {
+  hostTaskCreationFails() = false;
+  fs::hostCard.clear();
+}
+
+void test_plain_track_power_cuts() {
+  assertPowerCutsRecovered(false);
+}
+
+void test_compressed_track_power_cuts() {
+  assertPowerCutsRecovered(true);
+}
+
+void test_failed_track_is_recovered() {
+  for (bool compressed : {false, true}) {
+    fs::hostCard.clear();
+    writeTrack(false);
+    const std::string complete = trackContent();
+    fs::hostCard.clear();
+    writeTrack(compressed, 100);
+    TEST_ASSERT_TRUE(SD.exists("/track.journal"));
+    assertRecovered(compressed, complete);
+    TEST_ASSERT_GREATER_THAN(0, trackContent().size());
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_plain_track_power_cuts);
+  RUN_TEST(test_compressed_track_power_cuts);
+  RUN_TEST(test_failed_track_is_recovered);
+  return UNITY_END();
+}
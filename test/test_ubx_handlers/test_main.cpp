@@ -0,0 +1,310 @@
+/*
+ * Copyright (C) 2019-2026 OpenBikeSensor Contributors
+ * Contact: https://openbikesensor.org
+ *
+ * This file is part of the OpenBikeSensor firmware.
+ *
+ * The OpenBikeSensor firmware is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU
+ * Lesser General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenBikeSensor firmware is distributed in the hope that
+ * it will be useful, but WITHOUT ANY WARRANTY; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the OpenBikeSensor firmware.  If not,
+ * see <http://www.gnu.org/licenses/>.
+ */
+
+/* Moving the tracks of older firmware to the monthly directories. */
+/* Replays UBX and NMEA input against the receive buffer and
+ * UBX_HANDLERS: message sets as u-blox 6, 8 and 10 send them, too short
+ * and too long messages and random data. Build with ASan to also see
+ * reads past the handled payload.
+ */
+
+#define OBSCLASSIC 1
+#include "hostgps.h"
+#include "hostclock.h"
+
+#include "gps.cpp"
+#include "gpsrecord.cpp"
+#include "gpsepochs.cpp"
+#include "privacyareaindex.cpp"
+#include "utils/timeutils.cpp"
+
+#include <unity.h>
+
+#include <fcntl.h>
+#include <random>
+#include <unistd.h>
+
+static const uint32_t TOW = 200000;
+static const int32_t LONGITUDE = 91822000;
+static const int32_t LATITUDE = 487766000;
+static const int FUZZ_ROUNDS = 20000;
+
+static Gps *gps;
+
+static std::vector<uint8_t> &operator+=(std::vector<uint8_t> &stream, const std::vector<uint8_t> &more) {
+  stream.insert(stream.end(), more.begin(), more.end());
+  return stream;
+}
+
+/* Feeds the data, false if the parser ever wrote past its buffer. */
+static bool encode(const std::vector<uint8_t> &data) {
+  bool inBuffer = true;
+  for (uint8_t byte : data) {
+    GpsTest::encode(*gps, byte);
+    inBuffer &= GpsTest::bufferBytePos(*gps) < GpsTest::maxMessageLength();
+  }
+  return inBuffer;
+}
+
+static std::vector<uint8_t> monVer(const char *hwVersion) {
+  std::vector<uint8_t> payload(40);
+  strcpy((char *) &payload[0], "ROM CORE 1.00 (59842)");
+  strcpy((char *) &payload[30], hwVersion);
+  return ubxFrame(0x040a, payload);
+}
+
+/* MON-HW of a u-blox 6, 68 bytes with 25 virtual pins. */
+static std::vector<uint8_t> monHwM6() {
+  std::vector<uint8_t> payload(68);
+  putU16(payload, 16, 80);
+  putU16(payload, 18, 4000);
+  payload[20] = 2;
+  payload[53] = 12;
+  return ubxFrame(0x090a, payload);
+}
+
+/* MON-HW of a u-blox 8 or 10, 60 bytes with 17 virtual pins. */
+static std::vector<uint8_t> monHwM8() {
+  std::vector<uint8_t> payload(60);
+  putU16(payload, 16, 90);
+  putU16(payload, 18, 5000);
+  payload[20] = 2;
+  payload[45] = 13;
+  return ubxFrame(0x090a, payload);
+}
+
+static std::vector<uint8_t> navDop(uint32_t tow) {
+  std::vector<uint8_t> payload(18);
+  putU32(payload, 0, tow);
+  putU16(payload, 12, 120);
+  return ubxFrame(0x0401, payload);
+}
+
+/* NAV-DOP, NAV-SOL, NAV-VELNED and NAV-POSLLH as a u-blox 6 sends them. */
+static std::vector<uint8_t> epochM6(uint32_t tow) {
+  std::vector<uint8_t> stream = navDop(tow);
+  std::vector<uint8_t> sol(52);
+  putU32(sol, 0, tow);
+  putU16(sol, 8, 2300);
+  sol[10] = 3;
+  sol[11] = 0x0d;
+  sol[47] = 9;
+  stream += ubxFrame(0x0601, sol);
+  std::vector<uint8_t> velned(36);
+  putU32(velned, 0, tow);
+  putU32(velned, 20, 500);
+  stream += ubxFrame(0x1201, velned);
+  std::vector<uint8_t> posllh(28);
+  putU32(posllh, 0, tow);
+  putU32(posllh, 4, LONGITUDE);
+  putU32(posllh, 8, LATITUDE);
+  putU32(posllh, 16, 24500);
+  putU32(posllh, 20, 1800);
+  stream += ubxFrame(0x0201, posllh);
+  return stream;
+}
+
+/* NAV-PVT as u-blox 10 sends it, with NAV-DOP. */
+static std::vector<uint8_t> epochM10(uint32_t tow) {
+  std::vector<uint8_t> pvt(92);
+  putU32(pvt, 0, tow);
+  pvt[11] = 0x07;
+  pvt[20] = 3;
+  pvt[21] = 0x01;
+  pvt[23] = 11;
+  putU32(pvt, 24, LONGITUDE);
+  putU32(pvt, 28, LATITUDE);
+  putU32(pvt, 36, 24500);
+  putU32(pvt, 40, 1800);
+  putU32(pvt, 60, 5000);
+  putU16(pvt, 76, 150);
+  std::vector<uint8_t> stream = ubxFrame(0x0701, pvt);
+  stream += navDop(tow);
+  return stream;
+}
+
+static void assertEpochDecoded(uint8_t satellites) {
+  const GpsRecord record = gps->getIncomingGpsRecord();
+  TEST_ASSERT_EQUAL(TOW, record.getTow());
+  TEST_ASSERT_EQUAL(LONGITUDE, lround(record.getLongitude() * 1e7));
+  TEST_ASSERT_EQUAL(LATITUDE, lround(record.getLatitude() * 1e7));
+  TEST_ASSERT_EQUAL(satellites, record.getSatellitesUsed());
+  TEST_ASSERT_TRUE(record.hasValidFix());
+  TEST_ASSERT_EQUAL(1800, record.getHorizontalAccuracy());
+  const String speed = record.getSpeedKmHString();
+  TEST_ASSERT_EQUAL_STRING("18.0", speed.c_str());
+}
+
+void setUp() {
+  gps = new Gps;
+}
+
+void tearDown() {
+  delete gps;
+}
+
+void test_m6_messages_decode() {
+  std::vector<uint8_t> stream = monVer("00040007");
+  stream += monHwM6();
+  stream += epochM6(TOW);
+  TEST_ASSERT_TRUE(encode(stream));
+  TEST_ASSERT_EQUAL(6, gps->getValidMessageCount());
+  TEST_ASSERT_TRUE(gps->is_neo6());
+  TEST_ASSERT_EQUAL(80, gps->getLastNoiseLevel());
+  TEST_ASSERT_EQUAL(4000, gps->getLastAntennaGain());
+  TEST_ASSERT_EQUAL(12, gps->getLastJamInd());
+  assertEpochDecoded(9);
+}
+
+void test_m8_messages_decode() {
+  std::vector<uint8_t> stream = monVer("00080000");
+  stream += monHwM8();
+  stream += epochM6(TOW);
+  TEST_ASSERT_TRUE(encode(stream));
+  TEST_ASSERT_EQUAL(6, gps->getValidMessageCount());
+  TEST_ASSERT_TRUE(gps->is_neo8());
+  TEST_ASSERT_EQUAL(90, gps->getLastNoiseLevel());
+  TEST_ASSERT_EQUAL(5000, gps->getLastAntennaGain());
+  TEST_ASSERT_EQUAL(13, gps->getLastJamInd());
+  assertEpochDecoded(9);
+}
+
+void test_m10_messages_decode() {
+  std::vector<uint8_t> stream = monVer("000A0000");
+  stream += monHwM8();
+  stream += epochM10(TOW);
+  TEST_ASSERT_TRUE(encode(stream));
+  TEST_ASSERT_EQUAL(4, gps->getValidMessageCount());
+  TEST_ASSERT_TRUE(gps->is_neo10());
+  TEST_ASSERT_EQUAL(13, gps->getLastJamInd());
+  assertEpochDecoded(11);
+}
+
+void test_short_messages_are_not_handled() {
+  TEST_ASSERT_TRUE(encode(navDop(TOW)));
+  int32_t valid = gps->getValidMessageCount();
+  for (const auto &handler : GpsTest::ubxHandlers()) {
+    if (handler.second == 0) {
+      continue;
+    }
+    const std::vector<uint8_t> payload(handler.second - 1, 0xff);
+    TEST_ASSERT_TRUE(encode(ubxFrame(handler.first, payload)));
+    TEST_ASSERT_EQUAL_MESSAGE(++valid, gps->getValidMessageCount(), "checksum");
+    // a handler would have taken the 0xffffffff tow
+    TEST_ASSERT_EQUAL_MESSAGE(TOW, gps->getIncomingGpsRecord().getTow(), "handled");
+  }
+}
+
+void test_empty_message_is_complete() {
+  std::vector<uint8_t> stream = ubxFrame(0x3406, {});
+  stream += navDop(TOW);
+  TEST_ASSERT_TRUE(encode(stream));
+  TEST_ASSERT_EQUAL(2, gps->getValidMessageCount());
+  TEST_ASSERT_EQUAL(0, gps->getMessagesWithFailedCrcCount());
+}
+
+void test_longest_message_fits() {
+  const int maxPayload = GpsTest::maxMessageLength() - 9;
+  std::vector<uint8_t> stream = ubxFrame(0x0404, std::vector<uint8_t>(maxPayload, 'a'));
+  stream += navDop(TOW);
+  TEST_ASSERT_TRUE(encode(stream));
+  TEST_ASSERT_EQUAL(2, gps->getValidMessageCount());
+  TEST_ASSERT_EQUAL(TOW, gps->getIncomingGpsRecord().getTow());
+}
+
+void test_too_long_messages_reset_the_parser() {
+  // the header claims one byte more than the buffer holds with checksum
+  std::vector<uint8_t> tooLong = ubxFrame(0x0404, std::vector<uint8_t>(GpsTest::maxMessageLength() - 8, 'a'));
+  tooLong.resize(6);
+  std::string nmea = "$GPTXT,01,01,02," + std::string(2 * GpsTest::maxMessageLength(), 'x');
+  std::vector<uint8_t> stream = tooLong;
+  stream.insert(stream.end(), nmea.begin(), nmea.end());
+  stream += navDop(TOW);
+  TEST_ASSERT_TRUE(encode(stream));
+  TEST_ASSERT_EQUAL(1, gps->getValidMessageCount());
+  TEST_ASSERT_EQUAL(TOW, gps->getIncomingGpsRecord().getTow());
+  TEST_ASSERT_TRUE(gps->getUnexpectedCharReceivedCount() > 0);
+}
+
+void test_random_input_stays_in_the_buffer() {
+  std::minstd_rand random(4711);
+  const auto handlers = GpsTest::ubxHandlers();
+  const std::vector<uint8_t> epochs[] = {epochM6(TOW), epochM10(TOW), monHwM6(), monHwM8()};
+  // the parser complains a lot, ASan still fails the run
+  fflush(stderr);
+  const int savedStderr = dup(2);
+  const int devNull = open("/dev/null", O_WRONLY);
+  dup2(devNull, 2);
+  bool inBuffer = true;
+  for (int round = 0; round < FUZZ_ROUNDS && inBuffer; round++) {
+    std::vector<uint8_t> data;
+    switch (random() % 3) {
+      case 0: // noise
+        data.resize(random() % 64);
+        for (uint8_t &byte : data) {
+          byte = random();
+        }
+        break;
+      case 1: { // any length and content behind a valid checksum
+        std::vector<uint8_t> payload(random() % (GpsTest::maxMessageLength() + 16));
+        for (uint8_t &byte : payload) {
+          byte = random();
+        }
+        data = ubxFrame(handlers[random() % handlers.size()].first, payload);
+        break;
+      }
+      default: // flipped and truncated messages
+        data = epochs[random() % 4];
+        for (int flips = random() % 4; flips > 0; flips--) {
+          data[random() % data.size()] ^= 1 << (random() % 8);
+        }
+        data.resize(random() % (data.size() + 1));
+    }
+    inBuffer = encode(data);
+  }
+  fflush(stderr);
+  dup2(savedStderr, 2);
+  close(devNull);
+  close(savedStderr);
+  TEST_ASSERT_TRUE(inBuffer);
+
+  // ends whatever message is open, then the parser works as before
+  TEST_ASSERT_TRUE(encode(std::vector<uint8_t>(GpsTest::maxMessageLength(), 0)));
+  const int32_t valid = gps->getValidMessageCount();
+  TEST_ASSERT_TRUE(encode(epochM6(TOW + 1000000)));
+  TEST_ASSERT_EQUAL(valid + 4, gps->getValidMessageCount());
+  TEST_ASSERT_EQUAL(TOW + 1000000, gps->getIncomingGpsRecord().getTow());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_m6_messages_decode);
+  RUN_TEST(test_m8_messages_decode);
+  RUN_TEST(test_m10_messages_decode);
+  RUN_TEST(test_short_messages_are_not_handled);
+  RUN_TEST(test_empty_message_is_complete);
+  RUN_TEST(test_longest_message_fits);
+  RUN_TEST(test_too_long_messages_reset_the_parser);
+  RUN_TEST(test_random_input_stays_in_the_buffer);
+  return UNITY_END();
+}
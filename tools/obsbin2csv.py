@@ -0,0 +1,151 @@
+# Converts a binary track (.obsdata.bin) as written with BINARY_TRACK_FORMAT
+# set to 1 into the CSV format (.obsdata.csv, OBSDataFormat=2) exactly as the
+# firmware would have written it. The format is described in
+# docs/software/firmware/binary_format.md.
+# Usage:
+#   python3 obsbin2csv.py track.obsdata.bin [track.obsdata.csv]
+# Without a target file name the extension is replaced by .obsdata.csv.
+
+import struct
+import sys
+import time
+from urllib.parse import parse_qs
+
+MAGIC = b"OBSB"
+FORMAT_VERSION = 1
+RECORD_DATA_SET = 1
+MAX_SENSOR_VALUE = 999
+
+COLUMNS = ("Date;Time;Millis;Comment;Latitude;Longitude;Altitude;"
+           "Course;Speed;HDOP;Satellites;BatteryLevel;Left;Right;Confirmed;Marked;Invalid;"
+           "InsidePrivacyArea;Factor;Measurements")
+
+
+class Reader:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def unpack(self, fmt):
+        values = struct.unpack_from("<" + fmt, self.data, self.pos)
+        self.pos += struct.calcsize("<" + fmt)
+        return values if len(values) > 1 else values[0]
+
+    def string(self):
+        length = self.unpack("H")
+        value = self.data[self.pos:self.pos + length]
+        self.pos += length
+        return value.decode("latin-1")
+
+
+def c_div(a, b):
+    # integer division truncating towards zero like C
+    q = abs(a) // abs(b)
+    return q if (a >= 0) == (b >= 0) else -q
+
+
+def c_mod(a, b):
+    return a - b * c_div(a, b)
+
+
+def scaled(value, scale):
+    # same as GpsRecord::toScaledString()
+    if value == 0:
+        return ""
+    scl = 10 ** scale
+    return "%d.%0*d" % (c_div(value, scl), scale, abs(c_mod(value, scl)))
+
+
+def header(metadata):
+    params = parse_qs(metadata)
+    data_per_measurement = int(params.get("DataPerMeasurement", ["3"])[0])
+    max_measurements = int(params["MaximumMeasurementsPerLine"][0])
+    names = ["Tms", "Lus", "Rus", "Lecho", "Recho"][:data_per_measurement]
+    columns = COLUMNS
+    for idx in range(1, max_measurements + 1):
+        for name in names:
+            columns += ";%s%d" % (name, idx)
+    columns += ";Cadence"
+    return metadata + "\n" + columns + "\n", data_per_measurement, max_measurements
+
+
+def echoes(reader):
+    objects = []
+    for _ in range(reader.unpack("B")):
+        objects.append("%d:%d:%d" % reader.unpack("HBB"))
+    return "|".join(objects)
+
+
+def data_set(reader, data_per_measurement, max_measurements):
+    timestamp, millis, flags = reader.unpack("IIB")
+    t = time.gmtime(timestamp)
+    csv = "%02d.%02d.%04d;%02d:%02d:%02d;%u;" % (
+        t.tm_mday, t.tm_mon, t.tm_year, t.tm_hour, t.tm_min, t.tm_sec, millis)
+    if flags & 0x01:
+        lat, lon, height, speed, course = reader.unpack("iiiii")
+        position = ";".join([scaled(lat, 7), scaled(lon, 7), scaled(c_div(height + 5, 10), 2),
+                             scaled(course, 5), scaled(c_div(speed * 60 * 60, 10000), 1)]) + ";"
+    else:
+        position = ";;;;;"
+    hdop, satellites, battery, left, right, confirmed, factor, cadence = reader.unpack("HBhHHHHB")
+    comment = reader.string()
+    marked = reader.string()
+    measurements = reader.unpack("B")
+    csv += comment + ";" + position
+    csv += scaled(hdop, 2) + ";"
+    csv += "%d;%.2f;" % (satellites, battery / 100.0)
+    csv += (str(left) if left < MAX_SENSOR_VALUE else "") + ";"
+    csv += (str(right) if right < MAX_SENSOR_VALUE else "") + ";"
+    csv += "%d;%s;%d;%d;" % (confirmed, marked, 1 if flags & 0x02 else 0, 1 if flags & 0x04 else 0)
+    csv += ("%d;" % (factor // 100) if factor % 100 == 0 else "%.2f;" % (factor / 100.0))
+    csv += "%d" % measurements
+    entries = []
+    for _ in range(measurements):
+        tms, lus, rus = reader.unpack("Hii")
+        entries.append([str(tms), str(lus) if lus > 0 else "", str(rus) if rus > 0 else ""])
+    if data_per_measurement == 5:
+        for entry in entries:
+            entry.append(echoes(reader))
+            entry.append(echoes(reader))
+    for entry in entries:
+        csv += ";" + ";".join(entry)
+    csv += ";" * (data_per_measurement * (max_measurements - measurements))
+    csv += ";%d" % cadence
+    return csv + "\n"
+
+
+def convert(data):
+    reader = Reader(data)
+    if data[:4] != MAGIC:
+        raise ValueError("not a binary OBS track")
+    reader.pos = 4
+    version = reader.unpack("B")
+    if version != FORMAT_VERSION:
+        raise ValueError("unsupported format version %d" % version)
+    csv, data_per_measurement, max_measurements = header(reader.string())
+    while reader.pos + 2 <= len(data):
+        length = reader.unpack("H")
+        end = reader.pos + length
+        if end > len(data):
+            break  # incomplete last record, e.g. power was cut
+        record_type = reader.unpack("B")
+        if record_type == RECORD_DATA_SET:
+            csv += data_set(reader, data_per_measurement, max_measurements)
+        reader.pos = end  # skip unknown records and data added by newer versions
+    return csv
+
+
+def main():
+    if len(sys.argv) < 2:
+        print("usage: obsbin2csv.py track.obsdata.bin [track.obsdata.csv]")
+        sys.exit(1)
+    source = sys.argv[1]
+    target = sys.argv[2] if len(sys.argv) > 2 else source.replace(".obsdata.bin", "") + ".obsdata.csv"
+    with open(source, "rb") as f:
+        csv = convert(f.read())
+    with open(target, "w", encoding="latin-1", newline="") as f:
+        f.write(csv)
+
+
+if __name__ == "__main__":
+    main()
@@ -6,11 +6,13 @@
 # comma-separated format over the USB-serial line. The output will look like this:
 # dump,0,123,45,67,89,23,45,67,...
 # dump,1,234,56,78,90,34,56,78,...
-# meas,0,1234,345,56
-# meas,1,2345,678,67
+# meas,0,1234,345,56,3456,120,34,65535,0,0
+# meas,1,2345,678,67,65535,0,0,65535,0,0
 # First value after dump/meas is always the sensor ID (0 or 1).
 # The "dump" line contains the raw PGA values over time (128 values).
-# The "meas" line contains: time-of-flight [µs], peak width [µs], peak amplitude
+# The "meas" line contains for each detected object (PGA_NUMBER_OF_OBJECTS):
+# time-of-flight [µs], peak width [µs], peak amplitude. Slots without an object
+# have a time-of-flight of 0 or 65535.
 # Note that the measurement will probably never exactly match the dump values, because the
 # dump and measurement lines are taken from different measurements. Also the measurement
 # value is updated much more frequently than the dump values.
@@ -49,9 +51,12 @@ def parse_line(line):
     if len(parts) < 5:
         return None
     try:
-        return "meas", sensor_id, float(parts[2]), float(parts[4])
+        values = [float(v) for v in parts[2:]]
     except ValueError:
         return None
+    objects = [(values[i], values[i + 2]) for i in range(0, len(values) - 2, 3)
+               if values[i] not in (0, 65535)]
+    return "meas", sensor_id, objects
 
 
 def open_serial():
@@ -76,7 +81,7 @@ def update_plot(ax, sensor_id, state):
         x = np.arange(len(dump_values), dtype=float) * SAMPLE_US
         ax.plot(x, dump_values, label="dump")
     if meas:
-        ax.plot([meas[0]], [meas[1]], "ro", label="meas")
+        ax.plot([m[0] for m in meas], [m[1] for m in meas], "ro", label="meas")
 
     # Plot thresholds
     # These thresholds are defined in the firmware, so copy them from there!
@@ -133,7 +138,7 @@ def main():
                     state["dump"][parsed[1]] = parsed[2]
                     changed = True
                 else:
-                    state["meas"][parsed[1]] = (parsed[2], parsed[3])
+                    state["meas"][parsed[1]] = parsed[2]
                     changed = True
 
         if changed: